@@ -0,0 +1,105 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _BENCH_REPORT_H
+#define _BENCH_REPORT_H
+
+#include <utils/otools.h>
+
+#include <chrono>
+
+/*
+ * Timings of one benchmark case: a name, its parameters and one wall-clock
+ * time per repetition. Parameters are stored as already formatted JSON values.
+ */
+struct bench_result {
+	string name;
+	vector < pair < string, string > > params;
+	vector < double > times;
+	string note;
+};
+
+/*
+ * Collects benchmark results and writes them as a single JSON document,
+ * so that runs from different releases can be compared by scripts.
+ */
+class bench_report {
+public:
+	string tool;
+	vector < pair < string, string > > context;
+	vector < bench_result > results;
+
+	bench_report(string _tool) : tool(_tool) {
+	}
+
+	static string jstr(string s) {
+		string out = "\"";
+		for (char c : s) {
+			if (c == '"' || c == '\\') out += '\\';
+			out += c;
+		}
+		return out + "\"";
+	}
+
+	static string jnum(double x, int precision = 4) {
+		return stb.str(x, precision);
+	}
+
+	//Times n_reps calls of f (after one untimed warm-up call) and stores them in milliseconds
+	template < class F >
+	bench_result & measure(string name, vector < pair < string, string > > params, int n_reps, F f) {
+		bench_result R;
+		R.name = name;
+		R.params = params;
+		f();
+		for (int r = 0 ; r < n_reps ; r ++) {
+			auto t0 = std::chrono::steady_clock::now();
+			f();
+			R.times.push_back(std::chrono::duration < double, std::milli > (std::chrono::steady_clock::now() - t0).count());
+		}
+		results.push_back(R);
+		return results.back();
+	}
+
+	void write(ostream & out) {
+		out << "{" << endl;
+		out << "  \"tool\": " << jstr(tool) << "," << endl;
+		for (int c = 0 ; c < context.size() ; c ++) out << "  " << jstr(context[c].first) << ": " << context[c].second << "," << endl;
+		out << "  \"benchmarks\": [";
+		for (int b = 0 ; b < results.size() ; b ++) {
+			bench_result & R = results[b];
+			vector < double > sorted = R.times;
+			sort(sorted.begin(), sorted.end());
+			basic_stats S(R.times);
+			double median = sorted.empty() ? 0.0 : ((sorted.size() % 2) ? sorted[sorted.size()/2] : (sorted[sorted.size()/2-1] + sorted[sorted.size()/2]) / 2);
+			out << (b ? "," : "") << endl << "    { \"name\": " << jstr(R.name) << ", \"params\": {";
+			for (int p = 0 ; p < R.params.size() ; p ++) out << (p ? ", " : " ") << jstr(R.params[p].first) << ": " << R.params[p].second;
+			out << (R.params.empty() ? "}" : " }") << ", \"reps\": " << R.times.size();
+			if (!sorted.empty()) out << ", \"min_ms\": " << jnum(sorted[0]) << ", \"median_ms\": " << jnum(median) << ", \"mean_ms\": " << jnum(S.mean()) << ", \"sd_ms\": " << jnum(S.sd());
+			if (!R.note.empty()) out << ", \"note\": " << jstr(R.note);
+			out << " }";
+		}
+		out << endl << "  ]" << endl << "}" << endl;
+	}
+};
+
+#endif
@@ -0,0 +1,231 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * Size, encoding and decoding speed of the sparse BIN formats v1 and v2 on rare genotypes
+ * simulated in-process. Timings and file sizes are written as JSON.
+ */
+
+#define _DECLARE_TOOLBOX_HERE
+#include <utils/otools.h>
+#include <objects/rare_genotype.h>
+#include <io/sparse_bin.h>
+
+#include <bench_report.h>
+
+class bench {
+public:
+	//COMMAND LINE OPTIONS
+	bpo::options_description descriptions;
+	bpo::variables_map options;
+	int n_reps;
+
+	//SYNTHETIC DATA
+	vector < int > positions;
+	vector < vector < unsigned int > > genotypes;
+	unsigned long n_genotypes;
+
+	//RESULTS
+	bench_report R;
+
+	bench() : R("convert") { n_reps = 0; n_genotypes = 0; }
+	~bench() {}
+
+	void declare_options();
+	void parse_command_line(vector < string > &);
+	void simulate();
+	void benchFormat(int);
+	void run(vector < string > &);
+};
+
+void bench::declare_options() {
+	bpo::options_description opt_base ("Basic options");
+	opt_base.add_options()
+			("help", "Produce help message")
+			("seed", bpo::value < int >()->default_value(15052011), "Seed of the random number generator")
+			("reps", bpo::value < int >()->default_value(5), "Number of timed repetitions per benchmark");
+
+	bpo::options_description opt_data ("Synthetic data");
+	opt_data.add_options()
+			("samples", bpo::value < int >()->default_value(100000), "Number of simulated samples")
+			("sites", bpo::value < int >()->default_value(20000), "Number of simulated rare variant sites")
+			("maf", bpo::value < double >()->default_value(0.001), "Maximal minor allele frequency of the simulated sites")
+			("missing", bpo::value < double >()->default_value(0.001), "Rate of missing genotypes");
+
+	bpo::options_description opt_output ("Output files");
+	opt_output.add_options()
+			("tmp", bpo::value < string >()->default_value("bench_sparse"), "Prefix of the temporary BIN files written")
+			("output,O", bpo::value< string >(), "Benchmark results in JSON format [stdout by default]");
+
+	descriptions.add(opt_base).add(opt_data).add(opt_output);
+}
+
+void bench::parse_command_line(vector < string > & args) {
+	try {
+		bpo::store(bpo::command_line_parser(args).options(descriptions).run(), options);
+		bpo::notify(options);
+	} catch ( const boost::program_options::error& e ) { cerr << "Error parsing command line arguments: " << string(e.what()) << endl; exit(0); }
+
+	if (options.count("help")) { cout << descriptions << endl; exit(0); }
+	if (options["reps"].as < int > () < 1) vrb.error("--reps must be at least 1");
+	if (options["samples"].as < int > () < 1 || options["samples"].as < int > () >= (1 << 27)) vrb.error("--samples must be in [1, 2^27)");
+	if (options["sites"].as < int > () < 1) vrb.error("--sites must be at least 1");
+	if (options.count("output") && !ofstream(options["output"].as < string > ()).good()) vrb.error("Cannot open [" + options["output"].as < string > () + "] for writing");
+}
+
+//Carriers are drawn by geometric skips so that simulating large cohorts stays linear in the number of rare genotypes
+void bench::simulate() {
+	int n_samples = options["samples"].as < int > ();
+	int n_sites = options["sites"].as < int > ();
+	double maxmaf = options["maf"].as < double > ();
+	double minmaf = min(maxmaf, 1.0 / (2 * n_samples));
+	double rmiss = options["missing"].as < double > ();
+
+	positions.resize(n_sites);
+	genotypes.resize(n_sites);
+	n_genotypes = 0;
+	for (int v = 0, pos = 1 ; v < n_sites ; v ++) {
+		pos += 1 + rng.getInt(200);
+		positions[v] = pos;
+		double maf = exp(log(minmaf) + rng.getDouble() * (log(maxmaf) - log(minmaf)));
+		double p_het = 2 * maf * (1 - maf), p_hom = maf * maf;
+		double p_any = min(1.0, p_het + p_hom + rmiss);
+		genotypes[v].clear();
+		for (long i = -1 ; ; ) {
+			i += 1 + (long)floor(log(1.0 - rng.getDouble()) / log(1.0 - p_any));
+			if (i >= n_samples) break;
+			double u = rng.getDouble() * p_any;
+			bool mi = (u < rmiss), het = (!mi && u < rmiss + p_het);
+			bool a0 = !mi && (het ? rng.flipCoin() : true);
+			bool a1 = !mi && (het ? !a0 : true);
+			genotypes[v].push_back(rare_genotype(i, het, mi, a0, a1, false).get());
+		}
+		n_genotypes += genotypes[v].size();
+	}
+}
+
+void bench::benchFormat(int version) {
+	string fname = options["tmp"].as < string > () + ".v" + stb.str(version) + ".bin";
+	vector < int > seeks (2 * positions.size(), 0);
+	vector < pair < string, string > > params;
+	params.emplace_back("version", stb.str(version));
+	params.emplace_back("sites", stb.str(positions.size()));
+	params.emplace_back("genotypes", stb.str(n_genotypes));
+
+	//1. Encoding
+	unsigned long n_bytes = 0;
+	bench_result & E = R.measure("sparse_bin/encode", params, n_reps, [&] () {
+		sparse_bin_writer W;
+		W.open(fname, version);
+		for (int v = 0 ; v < positions.size() ; v ++) W.write(positions[v], genotypes[v], &seeks[2*v]);
+		W.close();
+		n_bytes = W.n_bytes;
+	});
+	E.params.emplace_back("bytes", stb.str(n_bytes));
+	E.params.emplace_back("bytes_per_genotype", bench_report::jnum(n_bytes * 1.0 / max(1UL, n_genotypes), 3));
+
+	//2. Sequential decoding, as done by phase_rare and sparse2plain, checked against the simulated data
+	unsigned long checksum = 0;
+	bench_result & D = R.measure("sparse_bin/decode", params, n_reps, [&] () {
+		sparse_bin_reader S;
+		S.open(fname);
+		checksum = 0;
+		for (int v = 0 ; v < positions.size() ; v ++) {
+			const unsigned int * rg_words = S.read(seeks[2*v+0], seeks[2*v+1], positions[v]);
+			for (int r = 0 ; r < seeks[2*v+1] ; r ++) checksum += rg_words[r];
+		}
+		S.close();
+	});
+	D.params.emplace_back("checksum", stb.str(checksum));
+
+	//2b. Former v1 reading path of phase_rare [one buffer, seek and read per variant], as a baseline for the memory map
+	if (version == 1) {
+		unsigned long checksum_ifs = 0;
+		bench_result & I = R.measure("sparse_bin/decode_ifstream", params, n_reps, [&] () {
+			std::ifstream fp_binary (fname, std::ios::in | std::ios::binary);
+			checksum_ifs = 0;
+			for (int v = 0 ; v < positions.size() ; v ++) {
+				unsigned int * rg_buffer = (unsigned int *)malloc(seeks[2*v+1] * sizeof(unsigned int));
+				fp_binary.seekg(seeks[2*v+0]*sizeof(unsigned int), fp_binary.beg);
+				fp_binary.read((char *)rg_buffer, seeks[2*v+1] * sizeof(unsigned int));
+				for (int r = 0 ; r < seeks[2*v+1] ; r ++) checksum_ifs += rg_buffer[r];
+				free(rg_buffer);
+			}
+			fp_binary.close();
+		});
+		I.params.emplace_back("checksum", stb.str(checksum_ifs));
+		if (checksum_ifs != checksum) vrb.error("Rare genotypes read through ifstream differ from the memory mapped ones");
+	}
+
+	sparse_bin_reader S;
+	S.open(fname);
+	for (int v = 0 ; v < positions.size() ; v ++) {
+		const unsigned int * rg_words = S.read(seeks[2*v+0], seeks[2*v+1], positions[v]);
+		if (!std::equal(genotypes[v].begin(), genotypes[v].end(), rg_words)) vrb.error("Decoded rare genotypes differ from the encoded ones [v" + stb.str(version) + " / site " + stb.str(v) + "]");
+	}
+
+	//3. Region lookups through the block index [v2 only]
+	if (version == 2) {
+		int n_queries = 100, span = (positions.back() - positions.front()) / 100 + 1;
+		vector < pair < string, string > > rparams = params;
+		rparams.emplace_back("queries", stb.str(n_queries));
+		R.measure("sparse_bin/locate", rparams, n_reps, [&] () {
+			for (int q = 0 ; q < n_queries ; q ++) {
+				unsigned int first, last;
+				int start = positions.front() + rng.getInt(positions.back() - positions.front() + 1);
+				if (S.locate(start, start + span, first, last)) checksum += last - first;
+			}
+		});
+	}
+	S.close();
+	remove(fname.c_str());
+}
+
+void bench::run(vector < string > & args) {
+	declare_options();
+	parse_command_line(args);
+	n_reps = options["reps"].as < int > ();
+	rng.setSeed(options["seed"].as < int > ());
+	vrb.set_silent();
+
+	simulate();
+	R.context.emplace_back("commit", bench_report::jstr(string(__COMMIT_ID__)));
+	R.context.emplace_back("reps", stb.str(n_reps));
+	R.context.emplace_back("seed", stb.str(options["seed"].as < int > ()));
+	R.context.emplace_back("samples", stb.str(options["samples"].as < int > ()));
+	R.context.emplace_back("maf", bench_report::jnum(options["maf"].as < double > (), 6));
+
+	benchFormat(1);
+	benchFormat(2);
+
+	if (options.count("output")) {
+		ofstream fd (options["output"].as < string > ());
+		R.write(fd);
+	} else R.write(cout);
+}
+
+int main(int argc, char ** argv) {
+	vector < string > args;
+	for (int a = 1 ; a < argc ; a ++) args.push_back(string(argv[a]));
+	bench().run(args);
+	return 0;
+}
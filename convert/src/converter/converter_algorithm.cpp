@@ -31,7 +31,7 @@ void converter::convert() {
 	int mode2 = options.count("input-sparse") + options.count("output-plain");
 
 	if (mode1==2 && mode2==0) {
-		plain2sparse(options["input-plain"].as < string > (), options["output-sparse"].as < string > (), options["region"].as < string > (), options["thread"].as < int > (), options["maf"].as < double > ()).convert();
+		plain2sparse(options["input-plain"].as < string > (), options["output-sparse"].as < string > (), options["region"].as < string > (), options["thread"].as < int > (), options["maf"].as < double > (), options["output-sparse-version"].as < int > ()).convert();
 	} else if (mode1==0 && mode2==2) {
 		sparse2plain(options["output-plain"].as < string > (), options["input-sparse"].as < string > (), options["region"].as < string > (), options["thread"].as < int > ()).convert();
 	}
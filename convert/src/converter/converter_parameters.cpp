@@ -29,7 +29,7 @@ void converter::declare_options() {
 	opt_base.add_options()
 			("help", "Produce help message")
 			("seed", bpo::value<int>()->default_value(15052011), "Seed of the random number generator")
-			("thread", bpo::value<int>()->default_value(1), "Number of thread used for VCF/BCF (de-)compression");
+			("thread", bpo::value<int>()->default_value(1), "Number of threads used for record conversion and VCF/BCF (de-)compression");
 
 	bpo::options_description opt_input ("Input files");
 	opt_input.add_options()
@@ -42,6 +42,7 @@ void converter::declare_options() {
 	opt_output.add_options()
 			("output-plain", bpo::value< string >(), "Output genotype data in plain VCF/BCF format")
 			("output-sparse", bpo::value< string >(), "Output genotype data in sparse VCF/BCF format")
+			("output-sparse-version", bpo::value< int >()->default_value(1), "Format version of the BIN file written with --output-sparse: 1 (flat, readable by all versions) or 2 (compressed blocks with position index, needs phase_rare / convert from this release on)")
 			("log", bpo::value< string >(), "Log file");
 
 	descriptions.add(opt_base).add(opt_input).add(opt_output);
@@ -80,6 +81,9 @@ void converter::check_options() {
 
 	if (options.count("thread") && options["thread"].as < int > () < 1)
 		vrb.error("You must use at least 1 thread");
+
+	if (options["output-sparse-version"].as < int > () != 1 && options["output-sparse-version"].as < int > () != 2)
+		vrb.error("--output-sparse-version must be 1 or 2");
 }
 
 void converter::verbose_files() {
@@ -23,9 +23,13 @@
 #include "../../versions/versions.h"
 
 #include <io/plain2sparse.h>
+#include <io/sparse_bin.h>
 #include <objects/rare_genotype.h>
 
-plain2sparse::plain2sparse(string _plain_vcf, string _sparse_prefix, string _region, int _nthreads, float _minmaf) {
+//Maximum number of GT values held by the records of a block processed in parallel
+#define OBLOCK_GTS	(1UL << 27)
+
+plain2sparse::plain2sparse(string _plain_vcf, string _sparse_prefix, string _region, int _nthreads, float _minmaf, int _bin_version) {
 	file_full_vcf = _plain_vcf;
 	file_comm_bcf = _sparse_prefix +".comm.bcf";
 	file_rare_bcf = _sparse_prefix +".rare.bcf";
@@ -33,6 +37,7 @@ plain2sparse::plain2sparse(string _plain_vcf, string _sparse_prefix, string _reg
 	region = _region;
 	minmaf = _minmaf;
 	nthreads = _nthreads;
+	bin_version = _bin_version;
 
 	vector < string > tokens;
 	stb.split(region, tokens, ":");
@@ -43,12 +48,73 @@ plain2sparse::plain2sparse(string _plain_vcf, string _sparse_prefix, string _reg
 plain2sparse::~plain2sparse() {
 }
 
+void plain2sparse::encodeRecord(bcf_hdr_t * hdr_full_vcf, bcf_hdr_t * hdr_comm_bcf, bcf_hdr_t * hdr_rare_bcf, int id_worker, int r) {
+	bcf1_t * line_input = records_input[r];
+	bcf1_t * line_output = records_output[r];
+	bcf_unpack(line_input, BCF_UN_STR);
+
+	//Get variant infos
+	string chr = bcf_hdr_id2name(hdr_full_vcf, line_input->rid);
+	string alleles = string(line_input->d.allele[0]) + "," + string(line_input->d.allele[1]);
+
+	//Check variant MAF
+	bcf_get_info_int32(hdr_full_vcf, line_input, "AN", &van[id_worker], &nan[id_worker]);
+	bcf_get_info_int32(hdr_full_vcf, line_input, "AC", &vac[id_worker], &nac[id_worker]);
+	if (nan[id_worker]!=1) vrb.error("AN field is needed in main file for MAF filtering");
+	if (nac[id_worker]!=1) vrb.error("AC field is needed in main file for MAF filtering");
+	int an = van[id_worker][0], ac = vac[id_worker][0];
+	float currmaf = min(ac * 1.0f / an, (an - ac) * 1.0f / an);
+	records_rare[r] = (currmaf < minmaf);
+	records_ac[r] = ac;
+	records_an[r] = an;
+
+	//Get genotypes
+	bcf_get_genotypes(hdr_full_vcf, line_input, &vgt[id_worker], &ngt[id_worker]);
+	int * gt = vgt[id_worker];
+	int n_samples = bcf_hdr_nsamples(hdr_full_vcf);
+
+	//RARE VARIANT: record without INFO fields, completed once SEEK is known
+	if (records_rare[r]) {
+		bcf_clear1(line_output);
+		line_output->rid = bcf_hdr_name2id(hdr_rare_bcf, chr.c_str());
+		line_output->pos = line_input->pos;
+		bcf_update_id(hdr_rare_bcf, line_output, line_input->d.id);
+		bcf_update_alleles_str(hdr_rare_bcf, line_output, alleles.c_str());
+
+		records_words[r].clear();
+		bool minor_allele = ((an - ac) > ac);
+		for(int i = 0 ; i < 2 * n_samples ; i += 2) {
+			bool a0 = (bcf_gt_allele(gt[i+0])==1);
+			bool a1 = (bcf_gt_allele(gt[i+1])==1);
+			bool mi = (gt[i+0] == bcf_gt_missing || gt[i+1] == bcf_gt_missing);
+			bool ph = (bcf_gt_is_phased(gt[i+0]) || bcf_gt_is_phased(gt[i+1]));
+			if ( a0 == minor_allele || a1 == minor_allele || mi) {
+				rare_genotype rg_struct = rare_genotype(i/2, (a0!=a1), mi, a0, a1, ph);
+				records_words[r].push_back(rg_struct.get());
+			}
+		}
+	}
+
+	//COMMON VARIANT
+	else {
+		bcf_clear1(line_output);
+		line_output->rid = bcf_hdr_name2id(hdr_comm_bcf, chr.c_str());
+		line_output->pos = line_input->pos;
+		bcf_update_id(hdr_comm_bcf, line_output, line_input->d.id);
+		bcf_update_alleles_str(hdr_comm_bcf, line_output, alleles.c_str());
+		bcf_update_info_int32(hdr_comm_bcf, line_output, "AC", &ac, 1);
+		bcf_update_info_int32(hdr_comm_bcf, line_output, "AN", &an, 1);
+		bcf_update_genotypes(hdr_comm_bcf, line_output, gt, ngt[id_worker]);
+	}
+}
+
 void plain2sparse::convert() {
 	tac.clock();
 	vrb.title("Converting from plain VCF/BCF file to sparse BCF");
 	vrb.bullet("Region        : " + region);
 	vrb.bullet("Contig        : " + contig);
 	vrb.bullet("MAF threshold : " + stb.str(minmaf));
+	vrb.bullet("BIN format    : v" + stb.str(bin_version));
 
 	//Opening plain VCF/BCF file
 	bcf_srs_t * sr =  bcf_sr_init();
@@ -71,8 +137,8 @@ void plain2sparse::convert() {
 	if (nthreads > 1) hts_set_threads(fp_comm_bcf, nthreads);
 	htsFile * fp_rare_bcf = hts_open(file_rare_bcf.c_str(), "wb");
 	if (!fp_rare_bcf) vrb.error("Cannot open " + file_rare_bcf + " for writing, check permissions");
-	ofstream fp_rare_bin (file_rare_bin, std::ios::out | std::ios::binary);
-	if (!fp_rare_bin) vrb.error("Cannot open " + file_rare_bin + " for writing, check permissions");
+	sparse_bin_writer fp_rare_bin;
+	fp_rare_bin.open(file_rare_bin, bin_version);
 
 	//Create and write VCF header for common
 	bcf_hdr_t * hdr_comm_bcf = bcf_hdr_init("w");
@@ -92,105 +158,72 @@ void plain2sparse::convert() {
 	bcf_hdr_append(hdr_rare_bcf, string("##contig=<ID="+ contig + ">").c_str());
 	bcf_hdr_append(hdr_rare_bcf, "##INFO=<ID=AN,Number=1,Type=Integer,Description=\"Allele Frequency\">");
 	bcf_hdr_append(hdr_rare_bcf, "##INFO=<ID=AC,Number=1,Type=Integer,Description=\"Allele count\">");
-	bcf_hdr_append(hdr_rare_bcf, "##INFO=<ID=SEEK,Number=2,Type=Integer,Description=\"Index of the first record and number of records for the variant site in associated bin file\">");
+	if (bin_version == 1) bcf_hdr_append(hdr_rare_bcf, "##INFO=<ID=SEEK,Number=2,Type=Integer,Description=\"Index of the first record and number of records for the variant site in associated bin file\">");
+	else bcf_hdr_append(hdr_rare_bcf, "##INFO=<ID=SEEK,Number=2,Type=Integer,Description=\"Index of the variant site and number of records for the variant site in associated bin file (v2)\">");
 	bcf_hdr_add_sample(hdr_rare_bcf, NULL);
 	if (bcf_hdr_write(fp_rare_bcf, hdr_rare_bcf) < 0) vrb.error("Failing to write VCF/header for rare variants");
 
 
-	//
-	bcf1_t * line_input = NULL;
-	bcf1_t * line_output_comm = bcf_init1();
-	bcf1_t * line_output_rare = bcf_init1();
-	int ngt = 0, rgt = 0, *vgt = NULL;
-	int nac = 0, rac = 0, *vac = NULL;
-	int nan = 0, ran = 0, *van = NULL;
-	int nsk, rsk, *vsk = (int*)malloc(2*sizeof(int));
+	//Records are read and copied serially, decoded and encoded in parallel, then written in order
+	pool.start(nthreads);
+	int n_block = max(4 * pool.size(), (int)min(1024UL, OBLOCK_GTS / (2UL * max(n_samples, 1))));
+	records_input = vector < bcf1_t * > (n_block);
+	records_output = vector < bcf1_t * > (n_block);
+	for (int r = 0 ; r < n_block ; r ++) { records_input[r] = bcf_init1(); records_output[r] = bcf_init1(); }
+	records_rare = vector < char > (n_block, 0);
+	records_ac = vector < int > (n_block, 0);
+	records_an = vector < int > (n_block, 0);
+	records_words = vector < vector < unsigned int > > (n_block);
+	vgt = vector < int * > (pool.size(), NULL); ngt = vector < int > (pool.size(), 0);
+	vac = vector < int * > (pool.size(), NULL); nac = vector < int > (pool.size(), 0);
+	van = vector < int * > (pool.size(), NULL); nan = vector < int > (pool.size(), 0);
+	int * vsk = (int*)malloc(2*sizeof(int));
 
 	//
-	unsigned int nseek = 0, nrare = 0, ncomm = 0, nfull = 0;
-	while (bcf_sr_next_line (sr)) {
-		line_input = bcf_sr_get_line(sr, 0);
-
-		//Skip not bi-allelic
-		if (line_input->n_allele != 2) continue;
-
-		//Get variant infos
-		string chr = bcf_hdr_id2name(sr->readers[0].header, line_input->rid);
-		int pos = line_input->pos;
-		string id = string(line_input->d.id);
-		string ref = string(line_input->d.allele[0]);
-		string alt = string(line_input->d.allele[1]);
-
-		//Check variant MAF
-		ran = bcf_get_info_int32(sr->readers[0].header, line_input, "AN", &van, &nan);
-		rac = bcf_get_info_int32(sr->readers[0].header, line_input, "AC", &vac, &nac);
-		if (nan!=1) vrb.error("AN field is needed in main file for MAF filtering");
-		if (nac!=1) vrb.error("AC field is needed in main file for MAF filtering");
-		float currmaf = min(vac[0] * 1.0f / van[0], (van[0] - vac[0]) * 1.0f / van[0]);
-
-		//Get genotypes
-		rgt = bcf_get_genotypes(sr->readers[0].header, line_input, &vgt, &ngt);
-
-		//RARE VARIANT
-		if (currmaf < minmaf) {
-			bcf_clear1(line_output_rare);
-			line_output_rare->rid = bcf_hdr_name2id(hdr_rare_bcf, chr.c_str());
-			line_output_rare->pos = pos;
-			bcf_update_id(hdr_rare_bcf, line_output_rare, id.c_str());
-			string alleles = ref + "," + alt;
-			bcf_update_alleles_str(hdr_rare_bcf, line_output_rare, alleles.c_str());
-
-			//
-
-			vsk[0] = nseek; vsk[1] = 0;
-			bool minor_allele = ((van[0] - vac[0]) > vac[0]);
-			for(int i = 0 ; i < 2 * n_samples ; i += 2) {
-				bool a0 = (bcf_gt_allele(vgt[i+0])==1);
-				bool a1 = (bcf_gt_allele(vgt[i+1])==1);
-				bool mi = (vgt[i+0] == bcf_gt_missing || vgt[i+1] == bcf_gt_missing);
-				bool ph = (bcf_gt_is_phased(vgt[i+0]) || bcf_gt_is_phased(vgt[i+1]));
-				if ( a0 == minor_allele || a1 == minor_allele || mi) {
-					rare_genotype rg_struct = rare_genotype(i/2, (a0!=a1), mi, a0, a1, ph);
-					unsigned int rg_int = rg_struct.get();
-					fp_rare_bin.write(reinterpret_cast < char * > (&rg_int), sizeof(unsigned int));
-					vsk[1] ++;
-					nseek ++;
-				}
-			}
-
-			//
-			bcf_update_info_int32(hdr_rare_bcf, line_output_rare, "SEEK", vsk, 2);
-			bcf_update_info_int32(hdr_rare_bcf, line_output_rare, "AC", vac, 1);
-			bcf_update_info_int32(hdr_rare_bcf, line_output_rare, "AN", van, 1);
-			if (bcf_write1(fp_rare_bcf, hdr_rare_bcf, line_output_rare) < 0) vrb.error("Failing to write VCF/record for rare variants");
-			nrare++;
+	unsigned int nrare = 0, ncomm = 0, nfull = 0;
+	bool done = false;
+	while (!done) {
+		int n_rec = 0;
+		while (n_rec < n_block) {
+			if (!bcf_sr_next_line (sr)) { done = true; break; }
+			bcf1_t * line_input = bcf_sr_get_line(sr, 0);
+
+			//Skip not bi-allelic
+			if (line_input->n_allele != 2) continue;
+
+			bcf_copy(records_input[n_rec++], line_input);
 		}
 
-		//COMMON VARIANT
-		if (currmaf >= minmaf) {
-			bcf_clear1(line_output_comm);
-			line_output_comm->rid = bcf_hdr_name2id(hdr_comm_bcf, chr.c_str());
-			line_output_comm->pos = pos;
-			bcf_update_id(hdr_comm_bcf, line_output_comm, id.c_str());
-			string alleles = ref + "," + alt;
-			bcf_update_alleles_str(hdr_comm_bcf, line_output_comm, alleles.c_str());
-			bcf_update_info_int32(hdr_comm_bcf, line_output_comm, "AC", vac, 1);
-			bcf_update_info_int32(hdr_comm_bcf, line_output_comm, "AN", van, 1);
-			bcf_update_genotypes(hdr_comm_bcf, line_output_comm, vgt, ngt);
-			if (bcf_write1(fp_comm_bcf, hdr_comm_bcf, line_output_comm) < 0) vrb.error("Failing to write VCF/record for rare variants");
-			ncomm ++;
-		}
-		nfull ++;
+		pool.run(n_rec, [this, sr, hdr_comm_bcf, hdr_rare_bcf] (int id_worker, int id_job) { encodeRecord(sr->readers[0].header, hdr_comm_bcf, hdr_rare_bcf, id_worker, id_job); });
+
+		for (int r = 0 ; r < n_rec ; r ++) {
+			//RARE VARIANT: SEEK is assigned here so that it only depends on record order
+			if (records_rare[r]) {
+				fp_rare_bin.write(records_input[r]->pos + 1, records_words[r], vsk);
+				bcf_update_info_int32(hdr_rare_bcf, records_output[r], "SEEK", vsk, 2);
+				bcf_update_info_int32(hdr_rare_bcf, records_output[r], "AC", &records_ac[r], 1);
+				bcf_update_info_int32(hdr_rare_bcf, records_output[r], "AN", &records_an[r], 1);
+				if (bcf_write1(fp_rare_bcf, hdr_rare_bcf, records_output[r]) < 0) vrb.error("Failing to write VCF/record for rare variants");
+				nrare++;
+			}
 
-		if (nfull % 10000 == 0) vrb.bullet("VCF/BCF parsing [nfull=" + stb.str(nfull) + ", ncomm=" + stb.str(ncomm) + ", nrare=" + stb.str(nrare) + "]");
+			//COMMON VARIANT
+			else {
+				if (bcf_write1(fp_comm_bcf, hdr_comm_bcf, records_output[r]) < 0) vrb.error("Failing to write VCF/record for rare variants");
+				ncomm ++;
+			}
+			nfull ++;
 
+			if (nfull % 10000 == 0) vrb.bullet("VCF/BCF parsing [nfull=" + stb.str(nfull) + ", ncomm=" + stb.str(ncomm) + ", nrare=" + stb.str(nrare) + "]");
+		}
 	}
 
 	//Closing stuffs
-	free(vgt);
-	free(vac);
-	free(van);
+	for (int t = 0 ; t < pool.size() ; t ++) { free(vgt[t]); free(vac[t]); free(van[t]); }
 	free(vsk);
+	for (int r = 0 ; r < n_block ; r ++) { bcf_destroy1(records_input[r]); bcf_destroy1(records_output[r]); }
+	records_words.clear();
+	pool.stop();
 	bcf_sr_destroy(sr);
 	fp_rare_bin.close();
 	if (hts_close(fp_rare_bcf)) vrb.error("Non zero status when closing VCF/BCF file descriptor for rare variants");
@@ -198,6 +231,6 @@ void plain2sparse::convert() {
 
 
 	// Report
-	vrb.bullet("VCF/BCF parsing done ("+stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
+	vrb.bullet("VCF/BCF parsing done [bin=" + stb.str(fp_rare_bin.n_bytes * 1.0 / 1024 / 1024, 2) + "Mb] ("+stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
 }
 
@@ -24,7 +24,7 @@
 #define _PLAIN2SPARSE_H
 
 #include <utils/otools.h>
-
+#include <utils/thread_pool.h>
 
 class plain2sparse {
 public:
@@ -37,12 +37,26 @@ public:
 	string contig;
 	float minmaf;
 	int nthreads;
+	int bin_version;
+
+	//THREADING
+	thread_pool pool;
+	vector < int * > vgt, vac, van;							//Per worker htslib buffers
+	vector < int > ngt, nac, nan;
+
+	//RECORD BLOCK
+	vector < bcf1_t * > records_input;						//Copies of the input records of the current block
+	vector < bcf1_t * > records_output;						//Common record with genotypes or rare record without INFO
+	vector < char > records_rare;
+	vector < int > records_ac, records_an;
+	vector < vector < unsigned int > > records_words;		//Sparse genotypes of rare records
 
 	//CONSTRUCTORS/DESCTRUCTORS
-	plain2sparse(string, string, string, int, float);
+	plain2sparse(string, string, string, int, float, int);
 	~plain2sparse();
 
 	//PROCESS
+	void encodeRecord(bcf_hdr_t *, bcf_hdr_t *, bcf_hdr_t *, int, int);
 	void convert();
 };
 
@@ -23,8 +23,12 @@
 #include "../../versions/versions.h"
 
 #include <io/sparse2plain.h>
+#include <io/sparse_bin.h>
 #include <objects/rare_genotype.h>
 
+//Maximum number of GT values held by the records of a block processed in parallel
+#define OBLOCK_GTS	(1UL << 27)
+
 sparse2plain::sparse2plain(string _plain_vcf, string _sparse_prefix, string _region, int _nthreads) {
 	file_full_bcf = _plain_vcf;
 	file_comm_bcf = _sparse_prefix +".comm.bcf";
@@ -42,6 +46,59 @@ sparse2plain::sparse2plain(string _plain_vcf, string _sparse_prefix, string _reg
 sparse2plain::~sparse2plain() {
 }
 
+void sparse2plain::decodeRecord(bcf_hdr_t * hdr_comm_bcf, bcf_hdr_t * hdr_rare_bcf, bcf_hdr_t * hdr_full_bcf, int id_worker, int r) {
+	bcf1_t * line_input = records_input[r];
+	bcf1_t * line_output = records_output[r];
+	bcf_hdr_t * hdr_input = records_rare[r] ? hdr_rare_bcf : hdr_comm_bcf;
+	string file_type = records_rare[r] ? "rare" : "common";
+	bcf_unpack(line_input, BCF_UN_STR);
+
+	//Reading in variant information
+	string chr = bcf_hdr_id2name(hdr_input, line_input->rid);
+	string alleles = string(line_input->d.allele[0]) + "," + string(line_input->d.allele[1]);
+	bcf_get_info_int32(hdr_input, line_input, "AN", &van[id_worker], &nan[id_worker]); if (nan[id_worker]!=1) vrb.error("AN field is needed in " + file_type + " file");
+	bcf_get_info_int32(hdr_input, line_input, "AC", &vac[id_worker], &nac[id_worker]); if (nac[id_worker]!=1) vrb.error("AC field is needed in " + file_type + " file");
+
+	//Writing variant information
+	bcf_clear1(line_output);
+	line_output->rid = bcf_hdr_name2id(hdr_full_bcf, chr.c_str());
+	line_output->pos = line_input->pos;
+	bcf_update_id(hdr_full_bcf, line_output, line_input->d.id);
+	bcf_update_alleles_str(hdr_full_bcf, line_output, alleles.c_str());
+
+	//Writing genotypes COMMON
+	if (!records_rare[r]) {
+		bcf_get_genotypes(hdr_input, line_input, &vgt[id_worker], &ngt[id_worker]);
+		bcf_update_genotypes(hdr_full_bcf, line_output, vgt[id_worker], ngt[id_worker]);
+	}
+
+	//Writing genotypes RARE
+	else {
+		vector < int > & gs = vgs[id_worker];
+		float curraf = vac[id_worker][0] * 1.0f / van[id_worker][0];
+		fill(gs.begin(), gs.end(), bcf_gt_phased(curraf >= 0.5f));
+		for (int k = 0 ; k < records_words[r].size() ; k++) {
+			rare_genotype rg;
+			rg.set(records_words[r][k]);
+			if (rg.mis) {
+				gs[2*rg.idx+0] = bcf_gt_missing;
+				gs[2*rg.idx+1] = bcf_gt_missing;
+			} else if (rg.het) {
+				if (rg.pha) {
+					gs[2*rg.idx+0] = bcf_gt_phased(rg.al0);
+					gs[2*rg.idx+1] = bcf_gt_phased(rg.al1);
+				} else {
+					gs[2*rg.idx+0] = bcf_gt_unphased(rg.al0);
+					gs[2*rg.idx+1] = bcf_gt_unphased(rg.al1);
+				}
+			}
+		}
+		bcf_update_genotypes(hdr_full_bcf, line_output, gs.data(), gs.size());
+	}
+	bcf_update_info_int32(hdr_full_bcf, line_output, "AC", vac[id_worker], 1);
+	bcf_update_info_int32(hdr_full_bcf, line_output, "AN", van[id_worker], 1);
+}
+
 void sparse2plain::convert() {
 	tac.clock();
 	vrb.title("Converting from sparse BCF file to plain BCF");
@@ -72,8 +129,9 @@ void sparse2plain::convert() {
 	}
 
 	//Opening sparse BIN file
-	std::ifstream fp_rare_bin (file_rare_bin, std::ios::in | std::ios::binary);
-	if (!fp_rare_bin) vrb.error("Cannot open " + file_rare_bin + " for reading, check permissions");
+	sparse_bin_reader fp_rare_bin;
+	fp_rare_bin.open(file_rare_bin);
+	vrb.bullet("BIN format    : v" + stb.str(fp_rare_bin.version));
 
 	//Opening plain file
 	htsFile * fp_full_bcf = hts_open(file_full_bcf.c_str(), "wb");
@@ -92,115 +150,67 @@ void sparse2plain::convert() {
 	bcf_hdr_add_sample(hdr_full_bcf, NULL);
 	if (bcf_hdr_write(fp_full_bcf, hdr_full_bcf) < 0) vrb.error("Failing to write VCF/header for common variants");
 
-	//
-	bcf1_t * line_input_comm = NULL;
-	bcf1_t * line_input_rare = NULL;
-	bcf1_t * line_output = bcf_init1();
-	int ngt = 0, rgt = 0, *vgt = NULL;
-	int nac = 0, rac = 0, *vac = NULL;
-	int nan = 0, ran = 0, *van = NULL;
-	int nsk = 0, rsk = 0, *vsk = NULL;
-	int ngs = 0, rgs = 0, *vgs = (int*)malloc(bcf_hdr_nsamples(hdr_full_bcf)*2*sizeof(int));
+	//Records are read and copied serially, decoded and encoded in parallel, then written in order
+	pool.start(nthreads);
+	int n_block = max(4 * pool.size(), (int)min(1024UL, OBLOCK_GTS / (2UL * max(n_samples, 1))));
+	records_input = vector < bcf1_t * > (n_block);
+	records_output = vector < bcf1_t * > (n_block);
+	for (int r = 0 ; r < n_block ; r ++) { records_input[r] = bcf_init1(); records_output[r] = bcf_init1(); }
+	records_rare = vector < char > (n_block, 0);
+	records_words = vector < vector < unsigned int > > (n_block);
+	vgt = vector < int * > (pool.size(), NULL); ngt = vector < int > (pool.size(), 0);
+	vac = vector < int * > (pool.size(), NULL); nac = vector < int > (pool.size(), 0);
+	van = vector < int * > (pool.size(), NULL); nan = vector < int > (pool.size(), 0);
+	vgs = vector < vector < int > > (pool.size(), vector < int > (2 * n_samples));
+	int nsk = 0, *vsk = NULL;
 
 	//
-	unsigned int nseek = 0, nrare = 0, ncomm = 0, nfull = 0, nset = 0;
-	while (nset = bcf_sr_next_line (sr)) {
-		line_input_comm = bcf_sr_get_line(sr, 0);
-		line_input_rare = bcf_sr_get_line(sr, 1);
-
-		//Variant information
-		string chr, id, ref, alt;
-		int pos;
-
-		//Skip not bi-allelic
-		if (nset != 1) continue;
-		if (line_input_comm && line_input_comm->n_allele != 2) continue;
-		if (line_input_rare && line_input_rare->n_allele != 2) continue;
-
-		//
-		if (line_input_comm && line_input_rare) vrb.error("Duplicate variant!");
-
-		//Reading in variant information for COMMON
-		if (line_input_comm) {
-			chr = bcf_hdr_id2name(sr->readers[0].header, line_input_comm->rid);
-			pos = line_input_comm->pos;
-			id = string(line_input_comm->d.id);
-			ref = string(line_input_comm->d.allele[0]);
-			alt = string(line_input_comm->d.allele[1]);
-
-			ran = bcf_get_info_int32(sr->readers[0].header, line_input_comm, "AN", &van, &nan); if (nan!=1) vrb.error("AN field is needed in common file " + stb.str(nan));
-			rac = bcf_get_info_int32(sr->readers[0].header, line_input_comm, "AC", &vac, &nac); if (nac!=1) vrb.error("AC field is needed in common file");
-
-			rgt = bcf_get_genotypes(sr->readers[0].header, line_input_comm, &vgt, &ngt);
-			ncomm++;
+	unsigned int nrare = 0, ncomm = 0, nfull = 0, nset = 0;
+	bool done = false;
+	while (!done) {
+		int n_rec = 0;
+		while (n_rec < n_block) {
+			if (!(nset = bcf_sr_next_line (sr))) { done = true; break; }
+			bcf1_t * line_input_comm = bcf_sr_get_line(sr, 0);
+			bcf1_t * line_input_rare = bcf_sr_get_line(sr, 1);
+
+			//Skip not bi-allelic
+			if (nset != 1) continue;
+			if (line_input_comm && line_input_comm->n_allele != 2) continue;
+			if (line_input_rare && line_input_rare->n_allele != 2) continue;
+
+			//
+			if (line_input_comm && line_input_rare) vrb.error("Duplicate variant!");
+
+			//The BIN reader is sequential, so sparse genotypes are fetched here in record order
+			if (line_input_rare) {
+				bcf_get_info_int32(sr->readers[1].header, line_input_rare, "SEEK", &vsk, &nsk); if (nsk!=2) vrb.error("SEEK field is needed in rare file");
+				const unsigned int * rg_buffer = fp_rare_bin.read(vsk[0], vsk[1], line_input_rare->pos + 1);
+				records_words[n_rec].assign(rg_buffer, rg_buffer + vsk[1]);
+			}
+			records_rare[n_rec] = (line_input_rare != NULL);
+			bcf_copy(records_input[n_rec++], line_input_rare ? line_input_rare : line_input_comm);
 		}
 
-		//Reading in variant information for RARE
-		if (line_input_rare) {
-			chr = bcf_hdr_id2name(sr->readers[1].header, line_input_rare->rid);
-			pos = line_input_rare->pos;
-			id = string(line_input_rare->d.id);
-			ref = string(line_input_rare->d.allele[0]);
-			alt = string(line_input_rare->d.allele[1]);
-
-			ran = bcf_get_info_int32(sr->readers[1].header, line_input_rare, "AN", &van, &nan); if (nan!=1) vrb.error("AN field is needed in rare file");
-			rac = bcf_get_info_int32(sr->readers[1].header, line_input_rare, "AC", &vac, &nac); if (nac!=1) vrb.error("AC field is needed in rare file");
-			rsk = bcf_get_info_int32(sr->readers[1].header, line_input_rare, "SEEK", &vsk, &nsk); if (nsk!=2) vrb.error("SEEK field is needed in rare file");
-
-			float curraf = vac[0] * 1.0f / van[0];
-			for (int i = 0 ; i < 2*n_samples; i ++) vgs[i] = bcf_gt_phased(curraf >= 0.5f);
-			ngs = 2*n_samples;
-
-			unsigned int * rg_buffer = (unsigned int *)malloc(vsk[1] * sizeof(unsigned int));
-			fp_rare_bin.seekg(vsk[0]*sizeof(unsigned int), fp_rare_bin.beg);
-			fp_rare_bin.read((char *)rg_buffer, vsk[1] * sizeof(unsigned int));
-
-			for (int r = 0 ; r < vsk[1] ; r++) {
-				rare_genotype rg;
-				rg.set(rg_buffer[r]);
-				if (rg.mis) {
-					vgs[2*rg.idx+0] = bcf_gt_missing;
-					vgs[2*rg.idx+1] = bcf_gt_missing;
-				} else if (rg.het) {
-					if (rg.pha) {
-						vgs[2*rg.idx+0] = bcf_gt_phased(rg.al0);
-						vgs[2*rg.idx+1] = bcf_gt_phased(rg.al1);
-					} else {
-						vgs[2*rg.idx+0] = bcf_gt_unphased(rg.al0);
-						vgs[2*rg.idx+1] = bcf_gt_unphased(rg.al1);
-					}
-				}
-			}
+		pool.run(n_rec, [this, sr, hdr_full_bcf] (int id_worker, int id_job) { decodeRecord(sr->readers[0].header, sr->readers[1].header, hdr_full_bcf, id_worker, id_job); });
 
-			free(rg_buffer);
-			nrare++;
-		}
+		for (int r = 0 ; r < n_rec ; r ++) {
+			if (bcf_write1(fp_full_bcf, hdr_full_bcf, records_output[r]) < 0) vrb.error("Failing to write VCF/record");
+			if (records_rare[r]) nrare++;
+			else ncomm++;
+			nfull ++;
 
-		//Writing variant information
-		bcf_clear1(line_output);
-		line_output->rid = bcf_hdr_name2id(hdr_full_bcf, chr.c_str());
-		line_output->pos = pos;
-		bcf_update_id(hdr_full_bcf, line_output, id.c_str());
-		string alleles = ref + "," + alt;
-		bcf_update_alleles_str(hdr_full_bcf, line_output, alleles.c_str());
-
-		//Writing genotypes COMMON
-		if (line_input_comm) bcf_update_genotypes(hdr_full_bcf, line_output, vgt, ngt);
-		if (line_input_rare) bcf_update_genotypes(hdr_full_bcf, line_output, vgs, ngs);
-		bcf_update_info_int32(hdr_full_bcf, line_output, "AC", vac, 1);
-		bcf_update_info_int32(hdr_full_bcf, line_output, "AN", van, 1);
-		if (bcf_write1(fp_full_bcf, hdr_full_bcf, line_output) < 0) vrb.error("Failing to write VCF/record");
-		nfull ++;
-
-		if (nfull % 10000 == 0) vrb.bullet("VCF/BCF writing [nfull=" + stb.str(nfull) + ", ncomm=" + stb.str(ncomm) + ", nrare=" + stb.str(nrare) + "]");
+			if (nfull % 10000 == 0) vrb.bullet("VCF/BCF writing [nfull=" + stb.str(nfull) + ", ncomm=" + stb.str(ncomm) + ", nrare=" + stb.str(nrare) + "]");
+		}
 	}
 
 	//Closing stuffs
-	free(vgt);
-	free(vgs);
-	free(vac);
-	free(van);
+	for (int t = 0 ; t < pool.size() ; t ++) { free(vgt[t]); free(vac[t]); free(van[t]); }
 	free(vsk);
+	for (int r = 0 ; r < n_block ; r ++) { bcf_destroy1(records_input[r]); bcf_destroy1(records_output[r]); }
+	records_words.clear();
+	vgs.clear();
+	pool.stop();
 	bcf_sr_destroy(sr);
 
 	fp_rare_bin.close();
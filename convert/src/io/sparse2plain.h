@@ -24,6 +24,7 @@
 #define _SPARSE2PLAIN_H
 
 #include <utils/otools.h>
+#include <utils/thread_pool.h>
 
 class sparse2plain {
 public:
@@ -36,11 +37,24 @@ public:
 	string contig;
 	int nthreads;
 
+	//THREADING
+	thread_pool pool;
+	vector < int * > vgt, vac, van;							//Per worker htslib buffers
+	vector < int > ngt, nac, nan;
+	vector < vector < int > > vgs;							//Per worker genotypes expanded from sparse records
+
+	//RECORD BLOCK
+	vector < bcf1_t * > records_input;						//Copies of the input records of the current block
+	vector < bcf1_t * > records_output;
+	vector < char > records_rare;
+	vector < vector < unsigned int > > records_words;		//Sparse genotypes of rare records, read in order from the BIN file
+
 	//CONSTRUCTORS/DESCTRUCTORS
 	sparse2plain(string, string, string, int);
 	~sparse2plain();
 
 	//PROCESS
+	void decodeRecord(bcf_hdr_t *, bcf_hdr_t *, bcf_hdr_t *, int, int);
 	void convert();
 };
 
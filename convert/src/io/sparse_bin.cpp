@@ -0,0 +1,380 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <io/sparse_bin.h>
+
+#include <zlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static inline void sparse_bin_put(vector < unsigned char > & buffer, uint32_t value) {
+	while (value >= 0x80) {
+		buffer.push_back((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	buffer.push_back(value);
+}
+
+static inline bool sparse_bin_get(const unsigned char * & ptr, const unsigned char * end, uint32_t & value) {
+	value = 0;
+	for (int shift = 0 ; shift < 35 && ptr < end ; shift += 7) {
+		unsigned char byte = *(ptr++);
+		value |= (uint32_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+//Tops up the bit buffer to at least 56 valid bits [less at the end of the stream]. Bits above nbits are either
+//zero or the next bits of the stream, which are loaded again at the same place by the next refill.
+static inline void sparse_bin_refill(const unsigned char * & ptr, const unsigned char * end, uint64_t & acc, unsigned int & nbits) {
+	if (end - ptr >= 8) {
+		uint64_t next;
+		memcpy(&next, ptr, 8);
+		acc |= next << nbits;
+		ptr += (63 - nbits) >> 3;
+		nbits |= 56;
+	} else while (nbits < 56 && ptr < end) {
+		acc |= (uint64_t)*(ptr++) << nbits;
+		nbits += 8;
+	}
+}
+
+/*****************************************************************************/
+/*                                  WRITER                                   */
+/*****************************************************************************/
+
+sparse_bin_writer::sparse_bin_writer() {
+	version = 1;
+	n_words = 0;
+	n_variants = 0;
+	n_bytes = 0;
+	prev_pos = 0;
+	rice_acc = 0;
+	rice_nbits = 0;
+	curr = sparse_bin_block();
+}
+
+sparse_bin_writer::~sparse_bin_writer() {
+	close();
+}
+
+void sparse_bin_writer::open(string _fname, int _version) {
+	fname = _fname;
+	version = _version;
+	if (version != 1 && version != 2) vrb.error("Unsupported sparse BIN format version [" + stb.str(version) + "]");
+	fd.open(fname, std::ios::out | std::ios::binary);
+	if (!fd) vrb.error("Cannot open " + fname + " for writing, check permissions");
+	n_words = n_variants = 0;
+	n_bytes = 0;
+	index.clear();
+	meta.clear();
+	flags.clear();
+	rice.clear();
+	rice_acc = 0;
+	rice_nbits = 0;
+	curr = sparse_bin_block();
+	if (version == 2) {
+		sparse_bin_header hdr;
+		memcpy(hdr.magic, SPARSE_BIN_MAGIC, 8);
+		hdr.version = 2;
+		hdr.block_variants = SPARSE_BIN_BLOCK_VARIANTS;
+		fd.write(reinterpret_cast < char * > (&hdr), sizeof(sparse_bin_header));
+		n_bytes += sizeof(sparse_bin_header);
+	}
+}
+
+//Appends the rare genotype words of the next variant (sorted by sample index) and returns its SEEK field
+void sparse_bin_writer::write(int pos, const vector < unsigned int > & rg_words, int * seek) {
+	seek[1] = rg_words.size();
+	if (version == 1) {
+		seek[0] = n_words;
+		if (!rg_words.empty()) fd.write(reinterpret_cast < const char * > (rg_words.data()), rg_words.size() * sizeof(unsigned int));
+		n_words += rg_words.size();
+		n_bytes += rg_words.size() * sizeof(unsigned int);
+		return;
+	}
+
+	if (curr.n_variants == 0) {
+		curr.first_variant = n_variants;
+		curr.first_pos = prev_pos = pos;
+	}
+	if (pos < prev_pos) vrb.error("Variants are not sorted by position when writing " + fname);
+	sparse_bin_put(meta, pos - prev_pos);
+	sparse_bin_put(meta, rg_words.size());
+	if (!rg_words.empty()) {
+		//Rice parameter from the mean gap between carriers
+		double mean_gap = ((rg_words.back() >> 5) + 1.0) / rg_words.size();
+		unsigned int k = (unsigned int)max(0.0, min(26.0, floor(log2(max(1.0, mean_gap * M_LN2)))));
+		meta.push_back(k);
+		for (unsigned int w = 0, prev_idx = 0 ; w < rg_words.size() ; w ++) {
+			unsigned int idx = rg_words[w] >> 5;
+			if (w > 0 && idx <= prev_idx) vrb.error("Rare genotypes are not sorted by sample when writing " + fname);
+			unsigned int gap = w ? (idx - prev_idx - 1) : idx;
+			for (unsigned int q = gap >> k ; ; q -= 32) {
+				if (q < 32) { putBits(1U << q, q + 1); break; }
+				putBits(0, 32);
+			}
+			putBits(gap & ((1U << k) - 1), k);
+			flags.push_back(rg_words[w] & 31);
+			prev_idx = idx;
+		}
+	}
+	curr.last_pos = prev_pos = pos;
+	curr.n_variants ++;
+	curr.n_words += rg_words.size();
+	seek[0] = n_variants ++;
+	n_words += rg_words.size();
+	if (curr.n_variants == SPARSE_BIN_BLOCK_VARIANTS || meta.size() + flags.size() + rice.size() >= SPARSE_BIN_BLOCK_BYTES) flush();
+}
+
+//Appends the n lowest bits of value to the Rice bitstream [n <= 32, least significant bits first]
+void sparse_bin_writer::putBits(uint32_t value, unsigned int n) {
+	rice_acc |= (uint64_t)value << rice_nbits;
+	rice_nbits += n;
+	while (rice_nbits >= 8) {
+		rice.push_back(rice_acc & 0xFF);
+		rice_acc >>= 8;
+		rice_nbits -= 8;
+	}
+}
+
+void sparse_bin_writer::flush() {
+	if (curr.n_variants == 0) return;
+	if (rice_nbits) rice.push_back(rice_acc & 0xFF);
+	rice_acc = 0;
+	rice_nbits = 0;
+	meta.insert(meta.end(), flags.begin(), flags.end());
+	uLongf n_compressed = compressBound(meta.size());
+	compressed.resize(n_compressed);
+	if (compress2(compressed.data(), &n_compressed, meta.data(), meta.size(), Z_DEFAULT_COMPRESSION) != Z_OK) vrb.error("Failed compressing a block of " + fname);
+	curr.offset = n_bytes;
+	curr.compressed_bytes = n_compressed;
+	curr.raw_bytes = meta.size();
+	curr.rice_bytes = rice.size();
+	fd.write(reinterpret_cast < char * > (compressed.data()), n_compressed);
+	if (!rice.empty()) fd.write(reinterpret_cast < char * > (rice.data()), rice.size());
+	n_bytes += n_compressed + rice.size();
+	index.push_back(curr);
+	curr = sparse_bin_block();
+	meta.clear();
+	flags.clear();
+	rice.clear();
+}
+
+void sparse_bin_writer::close() {
+	if (!fd.is_open()) return;
+	if (version == 2) {
+		flush();
+		//Block index is 8 bytes aligned so that it can be used in place once mapped
+		unsigned long n_padding = (8 - n_bytes % 8) % 8;
+		const char padding [8] = { 0 };
+		fd.write(padding, n_padding);
+		n_bytes += n_padding;
+		sparse_bin_trailer trl;
+		trl.index_offset = n_bytes;
+		trl.n_blocks = index.size();
+		memcpy(trl.magic, SPARSE_BIN_INDEX_MAGIC, 8);
+		if (!index.empty()) fd.write(reinterpret_cast < char * > (index.data()), index.size() * sizeof(sparse_bin_block));
+		fd.write(reinterpret_cast < char * > (&trl), sizeof(sparse_bin_trailer));
+		n_bytes += index.size() * sizeof(sparse_bin_block) + sizeof(sparse_bin_trailer);
+	}
+	fd.close();
+	if (fd.fail()) vrb.error("Failed writing " + fname);
+}
+
+/*****************************************************************************/
+/*                                  READER                                   */
+/*****************************************************************************/
+
+sparse_bin_reader::sparse_bin_reader() {
+	version = 0;
+	addr = NULL;
+	n_bytes = 0;
+	words = NULL;
+	n_words = 0;
+	index = NULL;
+	n_blocks = 0;
+	curr_block = -1;
+}
+
+sparse_bin_reader::~sparse_bin_reader() {
+	close();
+}
+
+//Maps the whole file read-only; blocks / words are then read sequentially in most cases
+void sparse_bin_reader::open(string _fname) {
+	close();
+	fname = _fname;
+	int fd = ::open(fname.c_str(), O_RDONLY);
+	if (fd < 0) vrb.error("Cannot open " + fname + " for reading, check permissions");
+	struct stat st;
+	if (fstat(fd, &st) != 0) vrb.error("Cannot stat " + fname);
+	n_bytes = st.st_size;
+	if (n_bytes > 0) {
+		addr = mmap(NULL, n_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr == MAP_FAILED) vrb.error("Cannot map " + fname + " in memory");
+		madvise(addr, n_bytes, MADV_SEQUENTIAL);
+	} else addr = NULL;
+	::close(fd);
+
+	const char * base = static_cast < const char * > (addr);
+	if (n_bytes >= sizeof(sparse_bin_header) + sizeof(sparse_bin_trailer) && memcmp(base, SPARSE_BIN_MAGIC, 8) == 0) {
+		const sparse_bin_header * hdr = reinterpret_cast < const sparse_bin_header * > (base);
+		const sparse_bin_trailer * trl = reinterpret_cast < const sparse_bin_trailer * > (base + n_bytes - sizeof(sparse_bin_trailer));
+		if (hdr->version != 2) vrb.error("Unsupported sparse BIN format version [" + stb.str(hdr->version) + "] in " + fname);
+		if (memcmp(trl->magic, SPARSE_BIN_INDEX_MAGIC, 8) != 0 || trl->index_offset % 8 || trl->index_offset + trl->n_blocks * sizeof(sparse_bin_block) + sizeof(sparse_bin_trailer) != n_bytes) vrb.error("Truncated or corrupted block index in " + fname);
+		version = 2;
+		index = reinterpret_cast < const sparse_bin_block * > (base + trl->index_offset);
+		n_blocks = trl->n_blocks;
+		for (unsigned long b = 0 ; b < n_blocks ; b ++) if (index[b].offset + index[b].compressed_bytes + index[b].rice_bytes > trl->index_offset) vrb.error("Corrupted block index in " + fname);
+	} else {
+		if (n_bytes % sizeof(unsigned int)) vrb.error("Size of " + fname + " is not a multiple of 4 bytes");
+		version = 1;
+		words = static_cast < const unsigned int * > (addr);
+		n_words = n_bytes / sizeof(unsigned int);
+	}
+}
+
+void sparse_bin_reader::close() {
+	if (addr) munmap(addr, n_bytes);
+	addr = NULL;
+	n_bytes = 0;
+	words = NULL;
+	n_words = 0;
+	index = NULL;
+	n_blocks = 0;
+	curr_block = -1;
+	version = 0;
+}
+
+unsigned long sparse_bin_reader::findBlock(unsigned int variant) {
+	if (curr_block >= 0 && curr_block + 1 < n_blocks && index[curr_block+1].first_variant <= variant && variant < index[curr_block+1].first_variant + index[curr_block+1].n_variants) return curr_block + 1;
+	unsigned long lo = 0, hi = n_blocks;
+	while (hi - lo > 1) {
+		unsigned long mid = (lo + hi) / 2;
+		if (index[mid].first_variant <= variant) lo = mid;
+		else hi = mid;
+	}
+	return lo;
+}
+
+void sparse_bin_reader::decode(unsigned long b) {
+	const sparse_bin_block & B = index[b];
+	const unsigned char * base = static_cast < const unsigned char * > (addr) + B.offset;
+	string error = "Corrupted block #" + stb.str(b) + " in " + fname;
+	raw.resize(B.raw_bytes);
+	uLongf n_raw = B.raw_bytes;
+	if (B.raw_bytes < B.n_words || uncompress(raw.data(), &n_raw, base, B.compressed_bytes) != Z_OK || n_raw != B.raw_bytes) vrb.error(error);
+
+	//Variant headers first, flags of all words at the end of the inflated stream
+	const unsigned char * meta = raw.data(), * meta_end = raw.data() + B.raw_bytes - B.n_words;
+	const unsigned char * flags = meta_end;
+	const unsigned char * bits = base + B.compressed_bytes, * bits_end = bits + B.rice_bytes;
+	uint64_t acc = 0;
+	unsigned int nbits = 0;
+
+	block_words.resize(B.n_words);
+	block_offsets.resize(B.n_variants + 1);
+	block_positions.resize(B.n_variants);
+	unsigned int w = 0;
+	int pos = B.first_pos;
+	for (unsigned int v = 0 ; v < B.n_variants ; v ++) {
+		uint32_t delta, count;
+		if (!sparse_bin_get(meta, meta_end, delta) || !sparse_bin_get(meta, meta_end, count) || w + count > B.n_words) vrb.error(error);
+		pos += delta;
+		block_positions[v] = pos;
+		block_offsets[v] = w;
+		if (count == 0) continue;
+		if (meta >= meta_end) vrb.error(error);
+		unsigned int k = *(meta++);
+		for (uint32_t c = 0, idx = 0 ; c < count ; c ++, w ++) {
+			//Unary coded quotient: number of zero bits before the next one
+			uint32_t q = 0;
+			for (;;) {
+				if (nbits < 56) sparse_bin_refill(bits, bits_end, acc, nbits);
+				unsigned int z = acc ? __builtin_ctzll(acc) : 64;
+				if (z < nbits) {
+					q += z;
+					acc >>= z + 1;
+					nbits -= z + 1;
+					break;
+				}
+				if (nbits == 0) vrb.error(error);
+				q += nbits;
+				acc = 0;
+				nbits = 0;
+			}
+			//Remainder on k bits
+			if (nbits < k) {
+				sparse_bin_refill(bits, bits_end, acc, nbits);
+				if (nbits < k) vrb.error(error);
+			}
+			uint32_t gap = (q << k) | (uint32_t)(acc & ((1UL << k) - 1));
+			acc >>= k;
+			nbits -= k;
+			idx += c ? (gap + 1) : gap;
+			block_words[w] = (idx << 5) | flags[w];
+		}
+	}
+	if (w != B.n_words || meta != meta_end) vrb.error(error);
+	block_offsets[B.n_variants] = w;
+	curr_block = b;
+}
+
+//Returns the seek[1] rare genotype words of the variant with SEEK field seek[0]/seek[1] and position pos [or -1 to skip the check]
+const unsigned int * sparse_bin_reader::read(unsigned int seek0, unsigned int seek1, int pos) {
+	if (version == 1) {
+		if ((unsigned long)seek0 + seek1 > n_words) vrb.error("SEEK field of variant at position " + stb.str(pos) + " points outside of " + fname);
+		return words + seek0;
+	}
+	if (n_blocks == 0 || seek0 >= index[n_blocks-1].first_variant + index[n_blocks-1].n_variants) vrb.error("SEEK field of variant at position " + stb.str(pos) + " points outside of " + fname);
+	if (curr_block < 0 || seek0 < index[curr_block].first_variant || seek0 >= index[curr_block].first_variant + index[curr_block].n_variants) decode(findBlock(seek0));
+	unsigned int v = seek0 - index[curr_block].first_variant;
+	if (block_offsets[v+1] - block_offsets[v] != seek1 || (pos >= 0 && block_positions[v] != pos)) vrb.error("SEEK field of variant at position " + stb.str(pos) + " does not match " + fname);
+	return block_words.data() + block_offsets[v];
+}
+
+//Finds the first and last variants stored with positions in [start, stop], only possible in v2
+bool sparse_bin_reader::locate(int start, int stop, unsigned int & first, unsigned int & last) {
+	if (version != 2) return false;
+	unsigned long lo = 0, hi = n_blocks;
+	while (lo < hi) {
+		unsigned long mid = (lo + hi) / 2;
+		if (index[mid].last_pos < start) lo = mid + 1;
+		else hi = mid;
+	}
+	bool found = false;
+	for (unsigned long b = lo ; b < n_blocks && index[b].first_pos <= stop ; b ++) {
+		decode(b);
+		for (unsigned int v = 0 ; v < index[b].n_variants ; v ++) {
+			if (block_positions[v] >= start && block_positions[v] <= stop) {
+				if (!found) first = index[b].first_variant + v;
+				last = index[b].first_variant + v;
+				found = true;
+			}
+		}
+	}
+	return found;
+}
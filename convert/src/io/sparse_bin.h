@@ -0,0 +1,134 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _SPARSE_BIN_H
+#define _SPARSE_BIN_H
+
+#include <utils/otools.h>
+
+/*
+ * Binary store of the rare genotypes of a sparse VCF/BCF, one list of packed rare_genotype words
+ * (sample index in the upper 27 bits, flags in the lower 5) per variant, addressed by the INFO/SEEK
+ * field of the rare BCF.
+ *
+ * v1: flat stream of 32-bit words, SEEK = (index of the first word, number of words).
+ * v2: header, blocks of consecutive variants, block index and trailer; SEEK = (index of the variant
+ *     in the file, number of words). The block index holds the position range of each block so that
+ *     regions can be located without the companion BCF. Each block is made of:
+ *     - a deflate stream with, per variant, varint(position delta), varint(number of words) and the
+ *       Rice parameter of its sample gaps, followed by the flags of all the words of the block [1 byte each],
+ *     - a Rice coded bitstream of the gaps between consecutive sample indices of each variant.
+ *     Gaps between carriers of a rare variant are close to geometric, so Rice codes are near optimal for
+ *     them and cheap to decode, while the flags are highly redundant and left to deflate.
+ */
+
+#define SPARSE_BIN_MAGIC			"SP5RBIN2"
+#define SPARSE_BIN_INDEX_MAGIC		"SP5RIDX2"
+#define SPARSE_BIN_BLOCK_VARIANTS	4096
+#define SPARSE_BIN_BLOCK_BYTES		(256UL * 1024)
+
+struct sparse_bin_header {
+	char magic [8];
+	uint32_t version;
+	uint32_t block_variants;
+};
+
+struct sparse_bin_block {
+	uint64_t offset;				// Offset of the block in the file
+	uint32_t compressed_bytes;		// Size of the deflate stream
+	uint32_t raw_bytes;				// Size of the deflate stream once inflated
+	uint32_t rice_bytes;			// Size of the Rice bitstream following the deflate stream
+	uint32_t first_variant;			// Index of the first variant of the block in the file
+	uint32_t n_variants;
+	uint32_t n_words;
+	int32_t first_pos;
+	int32_t last_pos;
+};
+
+struct sparse_bin_trailer {
+	uint64_t index_offset;
+	uint64_t n_blocks;
+	char magic [8];
+};
+
+class sparse_bin_writer {
+protected:
+	ofstream fd;
+	string fname;
+	uint32_t n_words;
+	uint32_t n_variants;
+	vector < unsigned char > meta;
+	vector < unsigned char > flags;
+	vector < unsigned char > rice;
+	vector < unsigned char > compressed;
+	vector < sparse_bin_block > index;
+	sparse_bin_block curr;
+	int prev_pos;
+	uint64_t rice_acc;
+	unsigned int rice_nbits;
+
+	void putBits(uint32_t, unsigned int);
+	void flush();
+
+public:
+	int version;
+	unsigned long n_bytes;
+
+	sparse_bin_writer();
+	~sparse_bin_writer();
+
+	void open(string, int);
+	void write(int, const vector < unsigned int > &, int *);
+	void close();
+};
+
+class sparse_bin_reader {
+protected:
+	string fname;
+	void * addr;
+	unsigned long n_bytes;
+	const unsigned int * words;				// v1 mapping
+	unsigned long n_words;
+	const sparse_bin_block * index;			// v2 mapping
+	unsigned long n_blocks;
+	long curr_block;
+	vector < unsigned char > raw;
+	vector < unsigned int > block_words;
+	vector < unsigned int > block_offsets;	// First word of each variant of the current block [+1 sentinel]
+	vector < int > block_positions;
+
+	void decode(unsigned long);
+	unsigned long findBlock(unsigned int);
+
+public:
+	int version;
+
+	sparse_bin_reader();
+	~sparse_bin_reader();
+
+	void open(string);
+	void close();
+	const unsigned int * read(unsigned int, unsigned int, int);
+	bool locate(int, int, unsigned int &, unsigned int &);
+};
+
+#endif
@@ -0,0 +1,187 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <utils/otools.h>
+
+#include <atomic>
+#include <functional>
+#include <pthread.h>
+
+/*
+ * Persistent pool of worker threads shared by all multi-threaded loops.
+ * Workers are spawned once by start() and sleep between two calls to run().
+ * Jobs are handed out through a single atomic counter, so that fetching the
+ * next job costs one fetch_add instead of a lock/unlock of a global mutex.
+ * The calling thread takes part in the computations as worker 0; a pool of
+ * size 1 therefore spawns no thread at all and runs jobs sequentially.
+ */
+class thread_pool;
+
+struct thread_pool_worker {
+	thread_pool * pool;
+	int id_worker;
+};
+
+class thread_pool {
+protected:
+	//WORKERS
+	int n_workers;
+	vector < pthread_t > id_workers;
+	vector < thread_pool_worker > args_workers;
+
+	//SYNCHRONISATION
+	pthread_mutex_t mutex_pool;
+	pthread_mutex_t mutex_progress;
+	pthread_cond_t cond_start;
+	pthread_cond_t cond_done;
+	unsigned long generation;
+	int n_busy;
+	bool stopping;
+
+	//CURRENT TASK
+	int n_jobs;
+	std::atomic < int > i_job;
+	std::atomic < int > d_job;
+	std::function < void (int, int) > task;
+	string progress_prefix;
+
+	static void * callback(void * ptr) {
+		thread_pool_worker * W = static_cast < thread_pool_worker * > (ptr);
+		W->pool->loop(W->id_worker);
+		return NULL;
+	}
+
+	void loop(int id_worker) {
+		unsigned long seen = 0;
+		for (;;) {
+			pthread_mutex_lock(&mutex_pool);
+			while (!stopping && generation == seen) pthread_cond_wait(&cond_start, &mutex_pool);
+			if (stopping) { pthread_mutex_unlock(&mutex_pool); return; }
+			seen = generation;
+			pthread_mutex_unlock(&mutex_pool);
+
+			work(id_worker);
+
+			pthread_mutex_lock(&mutex_pool);
+			if (--n_busy == 0) pthread_cond_signal(&cond_done);
+			pthread_mutex_unlock(&mutex_pool);
+		}
+	}
+
+	void work(int id_worker) {
+		for (int id_job = i_job.fetch_add(1, std::memory_order_relaxed) ; id_job < n_jobs ; id_job = i_job.fetch_add(1, std::memory_order_relaxed)) {
+			task(id_worker, id_job);
+			int done = d_job.fetch_add(1, std::memory_order_relaxed) + 1;
+			//Progress is reported by whichever worker gets the lock, the others simply move on
+			if (!progress_prefix.empty() && pthread_mutex_trylock(&mutex_progress) == 0) {
+				vrb.progress(progress_prefix, done * 1.0f / n_jobs);
+				pthread_mutex_unlock(&mutex_progress);
+			}
+		}
+	}
+
+public:
+	thread_pool() {
+		n_workers = 1;
+		generation = 0;
+		n_busy = 0;
+		stopping = false;
+		n_jobs = 0;
+		i_job = 0;
+		d_job = 0;
+		pthread_mutex_init(&mutex_pool, NULL);
+		pthread_mutex_init(&mutex_progress, NULL);
+		pthread_cond_init(&cond_start, NULL);
+		pthread_cond_init(&cond_done, NULL);
+	}
+
+	~thread_pool() {
+		stop();
+		pthread_mutex_destroy(&mutex_pool);
+		pthread_mutex_destroy(&mutex_progress);
+		pthread_cond_destroy(&cond_start);
+		pthread_cond_destroy(&cond_done);
+	}
+
+	thread_pool(const thread_pool &) = delete;
+	thread_pool & operator = (const thread_pool &) = delete;
+
+	void start(int _n_workers) {
+		stop();
+		n_workers = max(_n_workers, 1);
+		stopping = false;
+		id_workers = vector < pthread_t > (n_workers);
+		args_workers = vector < thread_pool_worker > (n_workers);
+		for (int t = 1 ; t < n_workers ; t ++) {
+			args_workers[t].pool = this;
+			args_workers[t].id_worker = t;
+			pthread_create(&id_workers[t], NULL, callback, static_cast < void * > (&args_workers[t]));
+		}
+	}
+
+	void stop() {
+		if (n_workers > 1) {
+			pthread_mutex_lock(&mutex_pool);
+			stopping = true;
+			pthread_cond_broadcast(&cond_start);
+			pthread_mutex_unlock(&mutex_pool);
+			for (int t = 1 ; t < n_workers ; t ++) pthread_join(id_workers[t], NULL);
+		}
+		n_workers = 1;
+		id_workers.clear();
+		args_workers.clear();
+	}
+
+	int size() const {
+		return n_workers;
+	}
+
+	//Runs task(id_worker, id_job) for id_job in [0, _n_jobs) and returns once all jobs are done.
+	//id_worker is in [0, size()) and is stable for the duration of a job, so it can index per-thread data.
+	void run(int _n_jobs, std::function < void (int, int) > _task, string prefix = "") {
+		if (_n_jobs <= 0) return;
+		task = _task;
+		n_jobs = _n_jobs;
+		progress_prefix = prefix;
+		i_job.store(0);
+		d_job.store(0);
+		if (n_workers > 1) {
+			pthread_mutex_lock(&mutex_pool);
+			n_busy = n_workers - 1;
+			generation ++;
+			pthread_cond_broadcast(&cond_start);
+			pthread_mutex_unlock(&mutex_pool);
+		}
+		work(0);
+		if (n_workers > 1) {
+			pthread_mutex_lock(&mutex_pool);
+			while (n_busy > 0) pthread_cond_wait(&cond_done, &mutex_pool);
+			pthread_mutex_unlock(&mutex_pool);
+		}
+		task = nullptr;
+	}
+};
+
+#endif
@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <bench_header.h>
+
+/*
+ * This algorithm for transposing bit matrices is adapted from the code of Timur Kristóf
+ * Timur Kristóf: https://github.com/venemo
+ * Original version of the code (MIT license): https://github.com/Venemo/fecmagic/blob/master/src/binarymatrix.h
+ * Of note, function abracadabra is the same than getMultiplyUpperPart function in the original code from Timur Kristóf.
+ */
+static inline unsigned int abracadabra(const unsigned int &i1, const unsigned int &i2) {
+	return static_cast<unsigned int>((static_cast<unsigned long int>(i1) * static_cast<unsigned long int>(i2)) >> 32);
+}
+
+/*
+ * Former multiply-based 8x8 transpose, kept as a baseline for bitmatrix::transpose.
+ */
+static void transposeReference(bitmatrix & S, bitmatrix & BM, unsigned int _max_row, unsigned int _max_col) {
+	unsigned int max_row = _max_row + ((_max_row%8)?(8-(_max_row%8)):0);
+	unsigned int max_col = _max_col + ((_max_col%8)?(8-(_max_col%8)):0);
+	unsigned long targetAddr, sourceAddr;
+	union { unsigned int x[2]; unsigned char b[8]; } m4x8d;
+	for (unsigned int row = 0; row < max_row; row += 8) {
+		for (unsigned int col = 0; col < max_col; col += 8) {
+			for (unsigned int i = 0; i < 8; i++) {
+				sourceAddr = (row+i) * ((unsigned long)(S.n_cols/8)) + col/8;
+				m4x8d.b[7 - i] = S.bytes[sourceAddr];
+			}
+			for (unsigned int i = 0; i < 7; i++) {
+				targetAddr = ((col+i) * ((unsigned long)(S.n_rows/8)) + (row) / 8);
+				BM.bytes[targetAddr]  = static_cast<unsigned char>(abracadabra(m4x8d.x[1] & (0x80808080 >> i), (0x02040810 << i)) & 0x0f) << 4;
+				BM.bytes[targetAddr] |= static_cast<unsigned char>(abracadabra(m4x8d.x[0] & (0x80808080 >> i), (0x02040810 << i)) & 0x0f) << 0;
+			}
+			targetAddr = ((col+7) * ((unsigned long)(S.n_rows/8)) + (row) / 8);
+			BM.bytes[targetAddr]  = static_cast<unsigned char>(abracadabra((m4x8d.x[1] << 7) & (0x80808080 >> 0), (0x02040810 << 0)) & 0x0f) << 4;
+			BM.bytes[targetAddr] |= static_cast<unsigned char>(abracadabra((m4x8d.x[0] << 7) & (0x80808080 >> 0), (0x02040810 << 0)) & 0x0f) << 0;
+		}
+	}
+}
+
+/*
+ * H2V transpose of the simulated haplotypes with the baseline and the tiled
+ * implementation (the outputs are compared), and IBD2 het matching between
+ * random pairs of samples, as done when collecting conditioning states.
+ */
+void bench::benchBitmatrix() {
+	vector < pair < string, string > > params = { { "rows", stb.str(H.n_hap) }, { "cols", stb.str(H.n_site) } };
+	bitmatrix Tref, Tnew;
+	Tref.allocate(H.n_site, H.n_hap);
+	Tnew.allocate(H.n_site, H.n_hap);
+	if (enabled("bitmatrix_transpose_reference")) R.measure("bitmatrix_transpose_reference", params, n_reps, [&] () { transposeReference(H.H_opt_hap, Tref, H.n_hap, H.n_site); });
+	if (enabled("bitmatrix_transpose")) {
+		bench_result & B = R.measure("bitmatrix_transpose", params, n_reps, [&] () { H.H_opt_hap.transpose(Tnew, H.n_hap, H.n_site, &pool); });
+		transposeReference(H.H_opt_hap, Tref, H.n_hap, H.n_site);
+		if (memcmp(Tref.bytes, Tnew.bytes, Tref.n_bytes)) B.note = "output differs from reference";
+	}
+
+	if (enabled("bitmatrix_getMatchHetCount")) {
+		const int n_calls = 10000;
+		vector < unsigned int > pairs = vector < unsigned int > (2 * n_calls);
+		for (int c = 0 ; c < 2 * n_calls ; c ++) pairs[c] = rng.getInt(H.n_ind);
+		int count_het, match_het;
+		R.measure("bitmatrix_getMatchHetCount", { { "calls", stb.str(n_calls) }, { "cols", stb.str(H.n_site) } }, n_reps, [&] () {
+			for (int c = 0 ; c < n_calls ; c ++) H.H_opt_hap.getMatchHetCount(pairs[2*c+0], pairs[2*c+1], 0, H.n_site - 1, count_het, match_het);
+		});
+	}
+}
@@ -0,0 +1,84 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <bench_header.h>
+
+/*
+ * Simulates --samples genotypes at --sites variant sites. Haplotypes are mosaics of
+ * --founders founder haplotypes, so that PBWT neighbours and HMM states behave as on
+ * real data, with 0.5% missing genotypes. The data is then prepared as in
+ * phaser::read_files_and_initialise: graphs built, H filled and PBWT states selected.
+ */
+void bench::simulate() {
+	int n_ind = options["samples"].as < int > ();
+	int n_site = options["sites"].as < int > ();
+	int n_founders = options["founders"].as < int > ();
+
+	//Variant sites, one every kb on average (1cM per Mb), skewed towards low frequencies
+	string chr = "1", ref = "A", alt = "T";
+	vector < double > freq = vector < double > (n_site);
+	for (int l = 0, bp = 1 ; l < n_site ; l ++, bp += 1 + rng.getInt(2000)) {
+		string id = "rs" + stb.str(l + 1);
+		V.push(new variant (chr, bp, id, ref, alt, l));
+		freq[l] = pow(rng.getDouble(), 3.0);
+	}
+	V.setGeneticMap();
+
+	//Founder haplotypes
+	vector < vector < bool > > founders = vector < vector < bool > > (n_founders, vector < bool > (n_site));
+	for (int f = 0 ; f < n_founders ; f ++) for (int l = 0 ; l < n_site ; l ++) founders[f][l] = (rng.getDouble() < freq[l]);
+
+	//Genotypes as pairs of founder mosaics
+	G.allocate(n_ind, n_site);
+	for (int i = 0 ; i < n_ind ; i ++) {
+		G.vecG[i]->name = "sample" + stb.str(i + 1);
+		int f0 = rng.getInt(n_founders), f1 = rng.getInt(n_founders);
+		for (int l = 0 ; l < n_site ; l ++) {
+			if (rng.getDouble() < 0.002) f0 = rng.getInt(n_founders);
+			if (rng.getDouble() < 0.002) f1 = rng.getInt(n_founders);
+			bool a0 = founders[f0][l] ^ (rng.getDouble() < 0.0005);
+			bool a1 = founders[f1][l] ^ (rng.getDouble() < 0.0005);
+			unsigned char & code = G.vecG[i]->Variants[DIV2(l)];
+			if (rng.getDouble() < 0.005) {
+				VAR_SET_MIS(MOD2(l), code);
+				V.vec_pos[l]->cmis ++;
+			} else {
+				if (a0 != a1) VAR_SET_HET(MOD2(l), code);
+				V.vec_pos[l]->calt += a0 + a1;
+				V.vec_pos[l]->cref += 2 - a0 - a1;
+			}
+			if (a0) VAR_SET_HAP0(MOD2(l), code);
+			if (a1) VAR_SET_HAP1(MOD2(l), code);
+		}
+	}
+	G.imputeMonomorphic(V);
+	pool.run(G.n_ind, [this] (int id_worker, int id_job) { G.vecG[id_job]->build(); });
+
+	//HMM parameters and PBWT conditioning states
+	M.initialise(V, 15000, 2 * n_ind);
+	H.allocate(n_ind, 0, n_site);
+	H.setThreadPool(&pool);
+	H.updateHaplotypes(G, true);
+	H.transposeHaplotypes_H2V(true, false);
+	H.initialize(V, 0.1, 4.0, 0.1, 4, 5);
+	H.select();
+}
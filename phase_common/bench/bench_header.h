@@ -0,0 +1,77 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _BENCH_HEADER_H
+#define _BENCH_HEADER_H
+
+#include <utils/otools.h>
+#include <utils/thread_pool.h>
+
+#include <containers/conditioning_set/conditioning_set_header.h>
+#include <containers/genotype_set.h>
+#include <containers/variant_map.h>
+#include <objects/hmm_parameters.h>
+
+#include <bench_report.h>
+
+class bench {
+public:
+	//COMMAND LINE OPTIONS
+	bpo::options_description descriptions;
+	bpo::variables_map options;
+	int n_reps;
+
+	//MULTI-THREADING
+	thread_pool pool;
+
+	//SYNTHETIC DATA
+	variant_map V;
+	genotype_set G;
+	conditioning_set H;
+	hmm_parameters M;
+
+	//RESULTS
+	bench_report R;
+
+	//CONSTRUCTOR/DESTRUCTOR
+	bench();
+	~bench();
+
+	//PARAMETERS
+	void declare_options();
+	void parse_command_line(vector < string > &);
+	bool enabled(string);
+
+	//DATA
+	void simulate();
+
+	//BENCHMARKS
+	void benchHMM();
+	void benchPBWT();
+	void benchBitmatrix();
+	void benchReader();
+
+	//MAIN
+	void run(vector < string > &);
+};
+
+#endif
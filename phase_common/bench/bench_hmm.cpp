@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <bench_header.h>
+
+#include <models/haplotype_segment_single.h>
+#include <models/haplotype_segment_double.h>
+
+/*
+ * Forward+backward of one genotype graph in one window, in single and double precision,
+ * for a grid of numbers of conditioning haplotypes (K) and minimal window sizes (cM).
+ * Conditioning haplotypes are drawn at random among the other samples.
+ */
+void bench::benchHMM() {
+	vector < int > Ksizes = { 100, 400, 1600 };
+	vector < double > Wsizes = { 1.0, 2.0, 4.0 };
+	genotype * g = G.vecG[0];
+	vector < double > T = vector < double > (G.largestNumberOfTransitions(), 0.0);
+	vector < float > Mis = vector < float > (G.largestNumberOfMissings(), 0.0f);
+	vector < unsigned int > candidates = vector < unsigned int > (2 * G.n_ind - 2);
+	iota(candidates.begin(), candidates.end(), 2);
+
+	int prev_stop_locus = -1;
+	for (int w = 0 ; w < Wsizes.size() ; w ++) {
+		window_set WS;
+		random_stream RS (options["seed"].as < int > (), 0, 0, w);
+		WS.build(V, g, Wsizes[w], RS);
+		window & W = WS.W[0];
+		if (W.stop_locus == prev_stop_locus) continue;
+		prev_stop_locus = W.stop_locus;
+		for (int k = 0 ; k < Ksizes.size() ; k ++) {
+			if (Ksizes[k] > candidates.size()) continue;
+			vector < unsigned int > Kstates = candidates;
+			shuffle(Kstates.begin(), Kstates.end(), rng.getEngine());
+			Kstates.resize(Ksizes[k]);
+			sort(Kstates.begin(), Kstates.end());
+			vector < float > Kweights = vector < float > (Kstates.size(), 1.0f);
+			vector < pair < string, string > > params = {
+				{ "K", stb.str(Ksizes[k]) },
+				{ "L", stb.str(W.stop_locus - W.start_locus + 1) },
+				{ "cM", bench_report::jnum(V.vec_pos[W.stop_locus]->cm - V.vec_pos[W.start_locus]->cm, 3) },
+				{ "segments", stb.str(W.stop_segment - W.start_segment + 1) } };
+
+			int outcome = 0;
+			if (enabled("hmm_single")) {
+				bench_result & B = R.measure("hmm_single", params, n_reps, [&] () {
+					haplotype_segment_single HS(g, H.H_opt_hap, Kstates, Kweights, W, M);
+					HS.forward();
+					outcome = HS.backward(T, Mis);
+				});
+				if (outcome != 0) B.note = "underflow";
+			}
+			if (enabled("hmm_double")) {
+				bench_result & B = R.measure("hmm_double", params, n_reps, [&] () {
+					haplotype_segment_double HS(g, H.H_opt_hap, Kstates, Kweights, W, M);
+					HS.forward();
+					outcome = HS.backward(T, Mis);
+				});
+				if (outcome != 0) B.note = "underflow";
+			}
+		}
+	}
+}
@@ -0,0 +1,59 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <bench_header.h>
+
+#include <io/genotype_reader/genotype_reader_header.h>
+
+/*
+ * Parsing of the VCF/BCF file given with --input, as in step2 of
+ * phaser::read_files_and_initialise (scan, allocation and pipelined read).
+ */
+void bench::benchReader() {
+	if (!enabled("reader_parse")) return;
+	if (!options.count("input")) {
+		R.results.emplace_back();
+		R.results.back().name = "reader_parse";
+		R.results.back().note = "skipped, no --input file";
+		return;
+	}
+	string filename = options["input"].as < string > ();
+	string region = options["region"].as < string > ();
+	unsigned long n_variants = 0, n_samples = 0;
+	bench_result & B = R.measure("reader_parse", { { "file", bench_report::jstr(filename) }, { "region", bench_report::jstr(region) } }, n_reps, [&] () {
+		variant_map RV;
+		genotype_set RG;
+		haplotype_set RH;
+		genotype_reader readerG(RH, RG, RV);
+		readerG.setThreads(pool.size());
+		readerG.setThreadPool(&pool);
+		readerG.setRegion(region);
+		readerG.setMainFilename(filename);
+		readerG.scanGenotypes();
+		readerG.allocateGenotypes();
+		readerG.readGenotypes();
+		n_variants = readerG.n_variants;
+		n_samples = readerG.n_main_samples;
+	});
+	B.params.emplace_back("variants", stb.str(n_variants));
+	B.params.emplace_back("samples", stb.str(n_samples));
+}
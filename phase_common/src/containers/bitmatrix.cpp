@@ -21,6 +21,7 @@
  ******************************************************************************/
 
 #include <containers/bitmatrix.h>
+#include <utils/simd_vector.h>
 
 static unsigned char nbit_set[256] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8 };
 
@@ -127,34 +128,117 @@ void bitmatrix::allocateFast(unsigned int nrow, unsigned int ncol) {
 
 
 /*
- * This algorithm for transposing bit matrices is adapted from the code of Timur Kristóf
- * Timur Kristóf: https://github.com/venemo
- * Original version of the code (MIT license): https://github.com/Venemo/fecmagic/blob/master/src/binarymatrix.h
- * Of note, function abracadabra is the same than getMultiplyUpperPart function in the original code from Timur Kristóf.
+ * Transposes an 8x8 bit block packed in a 64-bit word. The most significant byte
+ * holds the first row and the most significant bit of a byte the first column,
+ * which is the byte layout used by bitmatrix. Three rounds of delta swaps.
  */
-void bitmatrix::transpose(bitmatrix & BM, unsigned int _max_row, unsigned int _max_col) {
-	unsigned int max_row = _max_row + ((_max_row%8)?(8-(_max_row%8)):0);
-	unsigned int max_col = _max_col + ((_max_col%8)?(8-(_max_col%8)):0);
-	unsigned long targetAddr, sourceAddr;
-	union { unsigned int x[2]; unsigned char b[8]; } m4x8d;
-	for (unsigned int row = 0; row < max_row; row += 8) {
-		for (unsigned int col = 0; col < max_col; col += 8) {
-			for (unsigned int i = 0; i < 8; i++) {
-				sourceAddr = (row+i) * ((unsigned long)(n_cols/8)) + col/8;
-				m4x8d.b[7 - i] = this->bytes[sourceAddr];
+static inline unsigned long transposeBlock8x8(unsigned long x) {
+	unsigned long t;
+	t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAUL; x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCUL; x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0UL; x ^= t ^ (t << 28);
+	return x;
+}
+
+//Gathers the bytes of 8 consecutive rows in a 64-bit word, first row in the most significant byte
+static inline unsigned long loadBlock8x8(const unsigned char * src, unsigned long stride) {
+	unsigned long x = 0;
+	for (unsigned int i = 0 ; i < 8 ; i ++) x |= ((unsigned long)src[i * stride]) << (56 - 8 * i);
+	return x;
+}
+
+/*
+ * Transposes rows [row_from, row_to) x columns [0, max_col) into BM.
+ * The columns are processed by tiles of TRANSPOSE_TILE_COLS so that the
+ * source bytes (row tile x 32 bytes) and the destination cache lines
+ * (TRANSPOSE_TILE_COLS lines) stay in L1 while the row tile is swept.
+ * With AVX2, blocks of 32 rows x 8 columns are transposed with movemask:
+ * each movemask extracts one column (32 bits = 4 destination bytes) and
+ * doubling the bytes brings the next column in the sign bit.
+ */
+void bitmatrix::transposeTile(bitmatrix & BM, unsigned int row_from, unsigned int row_to, unsigned int max_col) {
+	const unsigned long src_stride = n_cols/8, dst_stride = n_rows/8;
+	for (unsigned int col_from = 0 ; col_from < max_col ; col_from += TRANSPOSE_TILE_COLS) {
+		unsigned int col_to = min(max_col, col_from + TRANSPOSE_TILE_COLS);
+		unsigned int row = row_from;
+#if defined(SIMD_AVX2)
+		for (; row + 32 <= row_to ; row += 32) {
+			for (unsigned int col = col_from ; col < col_to ; col += 8) {
+				//Lane g holds rows 8g..8g+7, the first one in the most significant byte, so that movemask bits come out in row order
+				const unsigned char * src = bytes + row * src_stride + col/8;
+				__m256i _block = _mm256_set_epi64x(loadBlock8x8(src + 24 * src_stride, src_stride), loadBlock8x8(src + 16 * src_stride, src_stride), loadBlock8x8(src + 8 * src_stride, src_stride), loadBlock8x8(src, src_stride));
+				unsigned char * dst = BM.bytes + col * dst_stride + row/8;
+				for (unsigned int k = 0 ; k < 8 ; k ++) {
+					unsigned int mask = _mm256_movemask_epi8(_block);
+					memcpy(dst + k * dst_stride, &mask, 4);
+					_block = _mm256_add_epi8(_block, _block);
+				}
 			}
-			for (unsigned int i = 0; i < 7; i++) {
-				targetAddr = ((col+i) * ((unsigned long)(n_rows/8)) + (row) / 8);
-				BM.bytes[targetAddr]  = static_cast<unsigned char>(abracadabra(m4x8d.x[1] & (0x80808080 >> i), (0x02040810 << i)) & 0x0f) << 4;
-                BM.bytes[targetAddr] |= static_cast<unsigned char>(abracadabra(m4x8d.x[0] & (0x80808080 >> i), (0x02040810 << i)) & 0x0f) << 0;
+		}
+#endif
+		for (; row < row_to ; row += 8) {
+			for (unsigned int col = col_from ; col < col_to ; col += 8) {
+				const unsigned char * src = bytes + row * src_stride + col/8;
+				unsigned long x = transposeBlock8x8(loadBlock8x8(src, src_stride));
+				unsigned char * dst = BM.bytes + col * dst_stride + row/8;
+				for (unsigned int k = 0 ; k < 8 ; k ++) dst[k * dst_stride] = (unsigned char)(x >> (56 - 8 * k));
 			}
-			targetAddr = ((col+7) * ((unsigned long)(n_rows/8)) + (row) / 8);
-			BM.bytes[targetAddr]  = static_cast<unsigned char>(abracadabra((m4x8d.x[1] << 7) & (0x80808080 >> 0), (0x02040810 << 0)) & 0x0f) << 4;
-            BM.bytes[targetAddr] |= static_cast<unsigned char>(abracadabra((m4x8d.x[0] << 7) & (0x80808080 >> 0), (0x02040810 << 0)) & 0x0f) << 0;
 		}
 	}
 }
 
+/*
+ * Transposes the first _max_row x _max_col bits into BM (rounded up to multiples of 8).
+ * Row tiles of TRANSPOSE_TILE_ROWS write disjoint byte columns of BM, so that they
+ * are distributed over the thread pool when one is given.
+ */
+void bitmatrix::transpose(bitmatrix & BM, unsigned int _max_row, unsigned int _max_col, thread_pool * pool) {
+	unsigned int max_row = _max_row + ((_max_row%8)?(8-(_max_row%8)):0);
+	unsigned int max_col = _max_col + ((_max_col%8)?(8-(_max_col%8)):0);
+	int n_tiles = (max_row + TRANSPOSE_TILE_ROWS - 1) / TRANSPOSE_TILE_ROWS;
+	auto task = [this, &BM, max_row, max_col] (int id_worker, int id_tile) {
+		unsigned int row_from = id_tile * TRANSPOSE_TILE_ROWS;
+		transposeTile(BM, row_from, min(max_row, row_from + TRANSPOSE_TILE_ROWS), max_col);
+	};
+	if (pool && pool->size() > 1 && n_tiles > 1) pool->run(n_tiles, task);
+	else for (int t = 0 ; t < n_tiles ; t ++) task(0, t);
+}
+
 void bitmatrix::transpose(bitmatrix & BM) {
 	transpose(BM, n_rows, n_cols);
 }
+
+/*
+ * Expands the first n bits of a row into 32-bit integers, val1 where the bit is set and val0 otherwise.
+ * Returns the number of bits set. Used to turn a row of H_opt_var into a GT array in one pass.
+ */
+unsigned long bitmatrix::expandRow(unsigned int row, unsigned int n, int * out, int val0, int val1) {
+	const unsigned char * src = bytes + ((unsigned long)row) * (n_cols/8);
+	unsigned long n_full = n / 8, n_set = 0, b = 0;
+#if defined(SIMD_AVX2)
+	const __m256i _bits = _mm256_setr_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+	const __m256i _val0 = _mm256_set1_epi32(val0);
+	const __m256i _diff = _mm256_set1_epi32(val1 - val0);
+	for (; b + 8 <= n_full ; b += 8) {
+		unsigned long word;
+		memcpy(&word, src + b, 8);
+		n_set += __builtin_popcountl(word);
+		for (int k = 0 ; k < 8 ; k ++) {
+			__m256i _byte = _mm256_set1_epi32(src[b+k]);
+			__m256i _mask = _mm256_cmpeq_epi32(_mm256_and_si256(_byte, _bits), _bits);
+			_mm256_storeu_si256((__m256i *)(out + 8 * (b + k)), _mm256_add_epi32(_val0, _mm256_and_si256(_mask, _diff)));
+		}
+	}
+#endif
+	for (; b < n_full ; b ++) {
+		unsigned char byte = src[b];
+		n_set += __builtin_popcount(byte);
+		for (int k = 0 ; k < 8 ; k ++) out[8 * b + k] = ((byte >> (7 - k)) & 1) ? val1 : val0;
+	}
+	for (unsigned long c = 8 * n_full ; c < n ; c ++) {
+		bool bit = (src[c/8] >> (7 - (c%8))) & 1;
+		out[c] = bit ? val1 : val0;
+		n_set += bit;
+	}
+	return n_set;
+}
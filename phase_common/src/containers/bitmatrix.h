@@ -24,10 +24,11 @@
 #define _BITMATRIX_H
 
 #include <utils/otools.h>
+#include <utils/thread_pool.h>
 
-inline static unsigned int abracadabra(const unsigned int &i1, const unsigned int &i2) {
-	return static_cast<unsigned int>((static_cast<unsigned long int>(i1) * static_cast<unsigned long int>(i2)) >> 32);
-}
+//Transpose tiling: 512 rows give one cache line per destination row, 256 columns keep both sides of a tile in L1
+#define TRANSPOSE_TILE_ROWS	512
+#define TRANSPOSE_TILE_COLS	256
 
 class bitmatrix	{
 public:
@@ -44,7 +45,9 @@ public:
 	void allocateFast(unsigned int nrow, unsigned int ncol);
 	void set(unsigned int row, unsigned int col, unsigned char bit);
 	unsigned char get(unsigned int row, unsigned int col);
-	void transpose(bitmatrix & BM, unsigned int _max_row, unsigned int _max_col);
+	unsigned long expandRow(unsigned int row, unsigned int n, int * out, int val0, int val1);
+	void transposeTile(bitmatrix & BM, unsigned int row_from, unsigned int row_to, unsigned int max_col);
+	void transpose(bitmatrix & BM, unsigned int _max_row, unsigned int _max_col, thread_pool * pool = NULL);
 	void transpose(bitmatrix & BM);
 };
 
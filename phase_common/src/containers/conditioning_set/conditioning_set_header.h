@@ -27,6 +27,7 @@
 
 #include <containers/haplotype_set.h>
 #include <containers/ibd2_tracks.h>
+#include <containers/pbwt_sweep.h>
 
 class conditioning_set : public haplotype_set {
 public:
@@ -41,7 +42,7 @@ public:
 	unsigned int sites_pbwt_ngroups;
 
 	//PARAMETERS FOR PBWT
-	int depth, nthread;
+	int depth;
 
 	//IBD2 TRACKS
 	ibd2_tracks Kbanned;
@@ -52,15 +53,10 @@ public:
 	//SOLVER DATA
 	vector < float > scoreBit;
 
-	//MULTI-THREADING
-	int i_worker, i_job, d_job;
-	pthread_mutex_t mutex_workers;
-	vector < pthread_t > id_workers;
-
 	//CONSTRUCTOR/DESTRUCTOR
 	conditioning_set();
 	~conditioning_set();
-	void initialize(variant_map & V, float _modulo_selection, float _modulo_multithreading, float _mdr, int _depth, int _mac, int _nthread);
+	void initialize(variant_map & V, float _modulo_selection, float _modulo_multithreading, float _mdr, int _depth, int _mac);
 
 	//VARIANT PROCESSING
 	bool split(variant_map & V, float min_length, int left_index, int right_index, vector < int > & output);
@@ -24,18 +24,10 @@
 
 conditioning_set::conditioning_set() {
 	depth = 0;
-	nthread = 0;
 }
 
 conditioning_set::~conditioning_set() {
-	if (nthread > 1) {
-		i_worker = 0;
-		i_job = 0;
-		pthread_mutex_destroy(&mutex_workers);
-		id_workers.clear();
-	}
 	depth = 0;
-	nthread = 0;
 	sites_pbwt_mthreading.clear();
 	sites_pbwt_evaluation.clear();
 	sites_pbwt_selection.clear();
@@ -66,18 +58,11 @@ bool conditioning_set::split(variant_map & V, float min_length, int left_index,
 	} else return false;
 }
 
-void conditioning_set::initialize(variant_map & V, float _modulo_selection, float _modulo_multithreading, float _mdr, int _depth, int _mac, int _nthread) {
+void conditioning_set::initialize(variant_map & V, float _modulo_selection, float _modulo_multithreading, float _mdr, int _depth, int _mac) {
 	tac.clock();
 
 	//SETTING PARAMETERS
 	depth = _depth;
-	nthread = _nthread;
-	if (nthread > 1) {
-		i_worker = 0;
-		i_job = 0;
-		id_workers = vector < pthread_t > (nthread);
-		pthread_mutex_init(&mutex_workers, NULL);
-	}
 
 	//MAPPING EVAL+GRP
 	int n_evaluated = 0;
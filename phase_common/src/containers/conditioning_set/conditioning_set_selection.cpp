@@ -22,29 +22,6 @@
 
 #include <containers/conditioning_set/conditioning_set_header.h>
 
-void * selecter_callback(void * ptr) {
-	conditioning_set * S = static_cast< conditioning_set * >( ptr );
-
-	int id_worker, id_job;
-	pthread_mutex_lock(&S->mutex_workers);
-	id_worker = S->i_worker ++;
-	pthread_mutex_unlock(&S->mutex_workers);
-
-	for(;;) {
-		pthread_mutex_lock(&S->mutex_workers);
-		id_job = S->i_job ++;
-		pthread_mutex_unlock(&S->mutex_workers);
-
-		if (id_job <= S->sites_pbwt_mthreading.back()) {
-			S->select(id_job);
-			pthread_mutex_lock(&S->mutex_workers);
-			vrb.progress("  * PBWT selection", (++S->d_job)*1.0/(S->sites_pbwt_mthreading.back()+1));
-			pthread_mutex_unlock(&S->mutex_workers);
-		}
-		else pthread_exit(NULL);
-	}
-}
-
 void conditioning_set::transposePBWTneighbours() {
 	int block = 32;
 	unsigned long addr_tar, addr_src;
@@ -66,9 +43,8 @@ void conditioning_set::transposePBWTneighbours() {
 
 void conditioning_set::select(int chunk) {
 	vector < int > A = vector < int > (n_hap, 0);
-	vector < int > B = vector < int > (n_hap, 0);
 	vector < int > C = vector < int > (n_hap, 0);
-	vector < int > D = vector < int > (n_hap, 0);
+	pbwt_sweep PS (n_hap);
 	iota(A.begin(), A.end(), 0);
 	fill(C.begin(), C.end(), 0);
 
@@ -79,25 +55,7 @@ void conditioning_set::select(int chunk) {
 		bool buff = (sites_pbwt_mthreading[l] < chunk) && (l >= starts_pbwt_mthreading[chunk]);
 
 		if (eval && (chnk || buff)) {
-			int u = 0, v = 0, p = l, q = l;
-			for (int h = 0 ; h < n_hap ; h ++) {
-				int alookup = A[h], dlookup = C[h];
-				if (dlookup > p) p = dlookup;
-				if (dlookup > q) q = dlookup;
-				if (!H_opt_var.get(l, alookup)) {
-					A[u] = alookup;
-					C[u] = p;
-					p = 0;
-					u++;
-				} else {
-					B[v] = alookup;
-					D[v] = q;
-					q = 0;
-					v++;
-				}
-			}
-			std::copy(B.begin(), B.begin()+v, A.begin()+u);
-			std::copy(D.begin(), D.begin()+v, C.begin()+u);
+			PS.sortForward(H_opt_var, l, A, C);
 			if (selc && chnk) store(l, A, C);
 		}
 	}
@@ -147,7 +105,6 @@ void conditioning_set::store(int l, vector < int > & A, vector < int > & C) {
 
 void conditioning_set::select() {
 	tac.clock();
-	i_worker = 0; i_job = 0, d_job = 0;
 
 	//Select new sites at which to trigger storage
 	vector < vector < int > > candidates = vector < vector < int > > (sites_pbwt_grouping.back() + 1);
@@ -164,13 +121,7 @@ void conditioning_set::select() {
 
 	//Perform multi-threaded selection
 	vrb.progress("  * PBWT selection", 0.0f);
-	if (nthread > 1) {
-		for (int t = 0 ; t < nthread ; t++) pthread_create( &id_workers[t] , NULL, selecter_callback, static_cast<void *>(this));
-		for (int t = 0 ; t < nthread ; t++) pthread_join( id_workers[t] , NULL);
-	} else for (int c = 0 ; c  <= sites_pbwt_mthreading.back() ; c ++) {
-		select(c);
-		vrb.progress("  * PBWT selection", c*1.0/(sites_pbwt_mthreading.back()+1));
-	}
+	pool->run(sites_pbwt_mthreading.back() + 1, [this] (int id_worker, int id_job) { select(id_job); }, "  * PBWT selection");
 
 	//Transpose matrix with selected states
 	transposePBWTneighbours();
@@ -22,46 +22,19 @@
 
 #include <containers/conditioning_set/conditioning_set_header.h>
 
-struct solver_callback_params {
-	genotype_set * GS;
-	conditioning_set * CS;
-};
-
-void * solver_callback(void * ptr) {
-	solver_callback_params * P  = static_cast < solver_callback_params * >( ptr );
-
-	int id_worker, id_job;
-	pthread_mutex_lock(&P->CS->mutex_workers);
-	id_worker = P->CS->i_worker ++;
-	pthread_mutex_unlock(&P->CS->mutex_workers);
-
-	for(;;) {
-		pthread_mutex_lock(&P->CS->mutex_workers);
-		id_job = P->CS->i_job ++;
-		pthread_mutex_unlock(&P->CS->mutex_workers);
-		if (id_job <= P->CS->sites_pbwt_mthreading.back()) {
-			P->CS->solve(id_job, P->GS);
-			pthread_mutex_lock(&P->CS->mutex_workers);
-			vrb.progress("  * PBWT phasing sweep", (++P->CS->d_job)*1.0/(P->CS->sites_pbwt_mthreading.back()+1));
-			pthread_mutex_unlock(&P->CS->mutex_workers);
-
-		} else pthread_exit(NULL);
-	}
-}
-
 void conditioning_set::solve(int chunk, genotype_set * GS) {
 
 	//Allocate
 	vector < int > A = vector < int > (n_hap, 0);
-	vector < int > B = vector < int > (n_hap, 0);
 	vector < int > C = vector < int > (n_hap, 0);
-	vector < int > D = vector < int > (n_hap, 0);
 	vector < int > R = vector < int > (n_hap, 0);
 	vector < int > G = vector < int > (n_hap, 0);
 	vector < bool > Het = vector < bool > (n_ind, 0);
 	vector < bool > Mis = vector < bool > (n_ind, 0);
 	vector < bool > Amb = vector < bool > (n_ind, 0);
 
+	pbwt_sweep PS (n_hap);
+
 	iota(A.begin(), A.end(), 0);
 	fill(C.begin(), C.end(), 0);
 
@@ -151,26 +124,7 @@ void conditioning_set::solve(int chunk, genotype_set * GS) {
 		}
 
 		if (chnk || buff) {
-			int u = 0, v = 0, p = l, q = l;
-			for (int h = 0 ; h < n_hap ; h ++) {
-				int alookup = A[h], dlookup = C[h];
-				if (dlookup > p) p = dlookup;
-				if (dlookup > q) q = dlookup;
-				if (!H_opt_var.get(l, alookup)) {
-					A[u] = alookup;
-					C[u] = p;
-					p = 0;
-					u++;
-				} else {
-					B[v] = alookup;
-					D[v] = q;
-					q = 0;
-					v++;
-				}
-			}
-			std::copy(B.begin(), B.begin()+v, A.begin()+u);
-			std::copy(D.begin(), D.begin()+v, C.begin()+u);
-
+			PS.sortForward(H_opt_var, l, A, C);
 			for (int h = 0 ; h < n_hap ; h ++) R[A[h]] = h;
 		}
 	}
@@ -179,26 +133,14 @@ void conditioning_set::solve(int chunk, genotype_set * GS) {
 
 void conditioning_set::solve(genotype_set * GS) {
 	tac.clock();
-	i_worker = 0; i_job = 0, d_job = 0;
 
 	//
 	scoreBit = vector < float > (n_site, 0.0);
 	for (int l = 0 ; l < n_site ; ++l) scoreBit[l] = log (l + 1.0);
 
 	//Perform multi-threaded selection
-
-	solver_callback_params tp;
-	tp.GS = GS;
-	tp.CS = this;
-
 	vrb.progress("  * PBWT phasing sweep", 0.0f);
-	if (nthread > 1) {
-		for (int t = 0 ; t < nthread ; t++) pthread_create( &id_workers[t] , NULL, solver_callback, static_cast < void * > (&tp));
-		for (int t = 0 ; t < nthread ; t++) pthread_join( id_workers[t] , NULL);
-	} else for (int c = 0 ; c  <= sites_pbwt_mthreading.back() ; c ++) {
-		solve(c, GS);
-		vrb.progress("  * PBWT phasing sweep", c*1.0/(sites_pbwt_mthreading.back()+1));
-	}
+	pool->run(sites_pbwt_mthreading.back() + 1, [this, GS] (int id_worker, int id_job) { solve(id_job, GS); }, "  * PBWT phasing sweep");
 
 	//Transpose to push new haps into H hap first
 	transposeHaplotypes_V2H(false, false);
@@ -30,6 +30,7 @@ genotype_set::genotype_set() {
 genotype_set::~genotype_set() {
 	for (int i = 0 ; i< vecG.size() ; i ++) delete vecG[i];
 	vecG.clear();
+	Arena.clear();
 	n_site = 0;
 	n_ind = 0;
 }
@@ -37,9 +38,9 @@ genotype_set::~genotype_set() {
 void genotype_set::allocate(unsigned long n_main_samples, unsigned long n_variants) {
 	vecG = vector < genotype * > (n_main_samples);
 	for (unsigned int i = 0 ; i < n_main_samples ; i ++) {
-		vecG[i] = new genotype (i);
+		vecG[i] = new genotype (i, &Arena);
 		vecG[i]->n_variants = n_variants;
-		vecG[i]->Variants = vector < unsigned char > (DIV2(n_variants) + MOD2(n_variants), 0);
+		vecG[i]->Variants = Arena.allocate < unsigned char > (DIV2(n_variants) + MOD2(n_variants));
 	}
 	n_ind = n_main_samples;
 	n_site = n_variants;
@@ -89,9 +90,17 @@ unsigned long genotype_set::numberOfSegments() {
 	return size;
 }
 
+void genotype_set::reportMemory(string prefix) {
+	double used = Arena.bytesUsed() / 1024.0 / 1024.0;
+	double reserved = Arena.bytesReserved() / 1024.0 / 1024.0;
+	double saved = (Arena.bytesHeapEquivalent() * 1.0 - Arena.bytesUsed()) / 1024.0 / 1024.0;
+	vrb.bullet(prefix + " [arrays=" + stb.str(Arena.numberOfArrays()) + " / slabs=" + stb.str(Arena.numberOfSlabs()) + " / used=" + stb.str(used, 1) + "Mb / reserved=" + stb.str(reserved, 1) + "Mb / saved=" + stb.str(saved, 1) + "Mb]");
+}
+
 void genotype_set::solve() {
 	tac.clock();
-	for (int i = 0 ; i < vecG.size() ; i ++) vecG[i]->solve();
+	genotype_scratch S;
+	for (int i = 0 ; i < vecG.size() ; i ++) vecG[i]->solve(S);
 	vrb.bullet("HAP solving (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
 }
 
@@ -37,6 +37,7 @@ public:
 	vector < genotype * > vecG;					//Vector of genotype graphs
 	vector < genotype * > vecFathers;			//Points to fathers, NULL otherwise
 	vector < genotype * > vecMothers;			//Points to mothers, NULL otherwise
+	slab_allocator Arena;						//Backing store of all arrays in genotype graphs
 
 	//CONSTRUCTOR/DESTRUCTOR
 	genotype_set();
@@ -48,6 +49,7 @@ public:
 	unsigned int largestNumberOfTransitions();	//Get the number of transitions in the larger genotype graph. Used to initialize memory space for multi-threading.
 	unsigned int largestNumberOfMissings();		//Get the number of transitions in the larger genotype graph. Used to initialize memory space for multi-threading.
 	unsigned long numberOfSegments();			//Total number of segments across all genotype graphs (used for verbose).
+	void reportMemory(string);					//Memory used by genotype graphs (used for verbose).
 	void solve();								//
 	void scaffoldUsingPedigrees(pedigree_reader &);
 
@@ -34,6 +34,11 @@ void haplotype_set::clear() {
 	n_site = 0;
 	n_hap = 0;
 	n_ind = 0;
+	pool = NULL;
+}
+
+void haplotype_set::setThreadPool(thread_pool * _pool) {
+	pool = _pool;
 }
 
 void haplotype_set::allocate(unsigned long n_main_samples, unsigned long n_ref_samples, unsigned long n_variants) {
@@ -44,32 +49,72 @@ void haplotype_set::allocate(unsigned long n_main_samples, unsigned long n_ref_s
 	H_opt_hap.allocate(n_hap, n_site);
 }
 
+/*
+ * The first time, all bits of H_opt_hap are set and H_opt_var has to be obtained by transposition.
+ * Afterwards, only heterozygous and missing genotypes can change, so that their bits are written
+ * directly in both H_opt_hap and H_opt_var and no transposition is needed.
+ */
 void haplotype_set::updateHaplotypes(genotype_set & G, bool first_time) {
 	tac.clock();
-	for (unsigned int i = 0 ; i < G.n_ind ; i ++) {
-		for (unsigned int v = 0 ; v < n_site ; v ++) {
-			if (first_time || (VAR_GET_HET(MOD2(v), G.vecG[i]->Variants[DIV2(v)])) || (VAR_GET_MIS(MOD2(v), G.vecG[i]->Variants[DIV2(v)]))) {
+	if (first_time) {
+		for (unsigned int i = 0 ; i < G.n_ind ; i ++) {
+			for (unsigned int v = 0 ; v < n_site ; v ++) {
 				bool a0 = VAR_GET_HAP0(MOD2(v), G.vecG[i]->Variants[DIV2(v)]);
 				bool a1 = VAR_GET_HAP1(MOD2(v), G.vecG[i]->Variants[DIV2(v)]);
 				H_opt_hap.set(2*i+0, v, a0);
 				H_opt_hap.set(2*i+1, v, a1);
 			}
 		}
+	} else {
+		int n_blocks = (G.n_ind + UPDATE_BLOCK - 1) / UPDATE_BLOCK;
+		if (pool) pool->run(n_blocks, [this, &G] (int id_worker, int id_block) { updateHaplotypesIncremental(G, id_block * UPDATE_BLOCK, min((id_block + 1) * UPDATE_BLOCK, G.n_ind)); });
+		else for (int b = 0 ; b < n_blocks ; b ++) updateHaplotypesIncremental(G, b * UPDATE_BLOCK, min((b + 1) * UPDATE_BLOCK, G.n_ind));
 	}
 	vrb.bullet("HAP update (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
 }
 
+/*
+ * Rewrites the het and missing bits of individuals [ind_from, ind_to) in H_opt_hap and H_opt_var.
+ * Variant codes are scanned 16 at a time: the two low bits of a code differ only for missing (01)
+ * and het (10) genotypes. Within a chunk, all individuals of the block are processed before moving
+ * on, so that each row of H_opt_var is touched once per block. Blocks are multiples of 4
+ * individuals, so that blocks write disjoint bytes of H_opt_var.
+ */
+void haplotype_set::updateHaplotypesIncremental(genotype_set & G, int ind_from, int ind_to) {
+	const unsigned long n_bytes = (n_site + 1) / 2;
+	for (unsigned long b = 0 ; b < n_bytes ; b += 8) {
+		unsigned long n_chunk = min(8UL, n_bytes - b);
+		for (int i = ind_from ; i < ind_to ; i ++) {
+			unsigned long codes = 0;
+			memcpy(&codes, &G.vecG[i]->Variants[b], n_chunk);
+			unsigned long unphased = (codes ^ (codes >> 1)) & 0x1111111111111111UL;
+			while (unphased) {
+				unsigned int k = __builtin_ctzl(unphased) >> 2;
+				unsigned int v = 2 * b + k;
+				unphased &= unphased - 1;
+				if (v >= n_site) break;
+				bool a0 = VAR_GET_HAP0(MOD2(v), G.vecG[i]->Variants[DIV2(v)]);
+				bool a1 = VAR_GET_HAP1(MOD2(v), G.vecG[i]->Variants[DIV2(v)]);
+				H_opt_hap.set(2*i+0, v, a0);
+				H_opt_hap.set(2*i+1, v, a1);
+				H_opt_var.set(v, 2*i+0, a0);
+				H_opt_var.set(v, 2*i+1, a1);
+			}
+		}
+	}
+}
+
 void haplotype_set::transposeHaplotypes_H2V(bool full, bool verbose) {
 	if (verbose) tac.clock();
-	if (!full) H_opt_hap.transpose(H_opt_var, 2*n_ind, n_site);
-	else H_opt_hap.transpose(H_opt_var, n_hap, n_site);
+	if (!full) H_opt_hap.transpose(H_opt_var, 2*n_ind, n_site, pool);
+	else H_opt_hap.transpose(H_opt_var, n_hap, n_site, pool);
 	if (verbose) vrb.bullet("H2V transpose (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
 }
 
 void haplotype_set::transposeHaplotypes_V2H(bool full, bool verbose) {
 	if (verbose) tac.clock();
-	if (!full) H_opt_var.transpose(H_opt_hap, n_site, 2*n_ind);
-	else H_opt_var.transpose(H_opt_hap, n_site, n_hap);
+	if (!full) H_opt_var.transpose(H_opt_hap, n_site, 2*n_ind, pool);
+	else H_opt_var.transpose(H_opt_hap, n_site, n_hap, pool);
 	if (verbose) vrb.bullet("V2H transpose (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
 }
 
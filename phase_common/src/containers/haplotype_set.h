@@ -24,11 +24,15 @@
 #define _HAPLOTYPE_SET_H
 
 #include <utils/otools.h>
+#include <utils/thread_pool.h>
 
 #include <containers/bitmatrix.h>
 #include <containers/genotype_set.h>
 #include <containers/variant_map.h>
 
+//Number of individuals per job of the incremental haplotype update (multiple of 4: one byte of H_opt_var)
+#define UPDATE_BLOCK	512
+
 class haplotype_set {
 public:
 	//Haplotype Data
@@ -38,14 +42,19 @@ public:
 	unsigned long n_hap;		// #haplotypes
 	unsigned long n_ind;		// #individuals
 
+	//Multi-threading
+	thread_pool * pool;			// Shared thread pool, transposes run single-threaded when NULL
+
 	//CONSTRUCTOR/DESTRUCTOR/INITIALIZATION
 	haplotype_set();
 	~haplotype_set();
 	void clear();
 	void allocate(unsigned long, unsigned long, unsigned long);
+	void setThreadPool(thread_pool *);
 
 	//Haplotype routines
 	void updateHaplotypes(genotype_set & G, bool first_time = false);
+	void updateHaplotypesIncremental(genotype_set & G, int ind_from, int ind_to);
 	void transposeHaplotypes_H2V(bool full, bool verbose = true);
 	void transposeHaplotypes_V2H(bool full, bool verbose = true);
 };
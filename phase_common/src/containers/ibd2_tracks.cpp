@@ -97,5 +97,11 @@ void ibd2_tracks::pushIBD2(int ind, vector < track > & T) {
 		IBD2[min(ind, T[t].ind)].emplace_back(max(ind, T[t].ind), T[t].from, T[t].to);
 }
 
+void ibd2_tracks::pushIBD2(vector < pair < int, track > > & T) {
+	for (int t = 0 ; t < T.size() ; t ++)
+		IBD2[min(T[t].first, T[t].second.ind)].emplace_back(max(T[t].first, T[t].second.ind), T[t].second.from, T[t].second.to);
+	T.clear();
+}
+
 
 
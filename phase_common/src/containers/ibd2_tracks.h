@@ -63,6 +63,7 @@ public:
 
 	bool noIBD2(int, int, int);
 	void pushIBD2(int, vector < track > &);
+	void pushIBD2(vector < pair < int, track > > &);
 
 	int collapse(vector < track > &);
 	void collapse();
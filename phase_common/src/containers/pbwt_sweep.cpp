@@ -0,0 +1,259 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <containers/pbwt_sweep.h>
+#include <utils/simd_vector.h>
+
+pbwt_sweep::pbwt_sweep() {
+	n_hap = 0;
+}
+
+pbwt_sweep::pbwt_sweep(unsigned int _n_hap) {
+	allocate(_n_hap);
+}
+
+pbwt_sweep::~pbwt_sweep() {
+	n_hap = 0;
+	alleles.clear();
+	B.clear();
+	D.clear();
+}
+
+void pbwt_sweep::allocate(unsigned int _n_hap) {
+	n_hap = _n_hap;
+	alleles = vector < unsigned char > (n_hap / 8 + 1, 0);
+	B = vector < int > (n_hap + 8, 0);
+	D = vector < int > (n_hap + 8, 0);
+}
+
+#if defined(SIMD_AVX2)
+
+/*
+ * For each 8-bit mask, the permutation moving the lanes whose bit is set to the front, in order.
+ */
+static const int * compressTable() {
+	static const vector < int > table = [] () {
+		vector < int > T (256 * 8, 0);
+		for (int m = 0 ; m < 256 ; m ++) for (int b = 0, k = 0 ; b < 8 ; b ++) if (m & (1 << b)) T[m * 8 + (k++)] = b;
+		return T;
+	} ();
+	return table.data();
+}
+
+/*
+ * Inclusive running max (forward) or min (backward) of x across the 8 lanes, restarting at lanes flagged in s (all bits set).
+ * Lanes before the first restart are also combined with the carry c.
+ */
+template < bool forward >
+static inline __m256i segmentedScan(__m256i x, __m256i s, __m256i c, __m256i identity) {
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	for (int d = 1 ; d < 8 ; d <<= 1) {
+		__m256i low = _mm256_cmpgt_epi32(_mm256_set1_epi32(d), lanes);
+		__m256i idx = _mm256_sub_epi32(lanes, _mm256_set1_epi32(d));
+		__m256i xs = _mm256_blendv_epi8(_mm256_permutevar8x32_epi32(x, idx), identity, low);
+		__m256i ss = _mm256_andnot_si256(low, _mm256_permutevar8x32_epi32(s, idx));
+		__m256i xo = forward ? _mm256_max_epi32(x, xs) : _mm256_min_epi32(x, xs);
+		x = _mm256_blendv_epi8(xo, x, s);
+		s = _mm256_or_si256(s, ss);
+	}
+	__m256i xc = forward ? _mm256_max_epi32(x, c) : _mm256_min_epi32(x, c);
+	return _mm256_blendv_epi8(xc, x, s);
+}
+
+#endif
+
+void pbwt_sweep::gather(bitmatrix & BM, unsigned int row, const int * A) {
+	unsigned long stride = BM.n_cols >> 3;
+	const unsigned char * base = BM.bytes + row * stride;
+	unsigned int h = 0;
+#if defined(SIMD_AVX2)
+	//32-bit gathers starting at the byte holding the bit; the last row would read up to 3 bytes past the end and is done in scalar
+	if ((row + 1UL) * stride + 3 <= BM.n_bytes) {
+		const __m256i seven = _mm256_set1_epi32(7);
+		const __m256i twentyfour = _mm256_set1_epi32(24);
+		for ( ; h + 8 <= n_hap ; h += 8) {
+			__m256i a = _mm256_loadu_si256((const __m256i *)(A + h));
+			__m256i w = _mm256_i32gather_epi32((const int *)base, _mm256_srli_epi32(a, 3), 1);
+			w = _mm256_sllv_epi32(w, _mm256_add_epi32(twentyfour, _mm256_and_si256(a, seven)));
+			alleles[h >> 3] = _mm256_movemask_ps(_mm256_castsi256_ps(w));
+		}
+	}
+#endif
+	for ( ; h < n_hap ; h += 8) {
+		unsigned char m = 0;
+		for (unsigned int k = 0 ; k < 8 && h + k < n_hap ; k ++) m |= ((base[A[h+k] >> 3] >> (7 - (A[h+k] & 7))) & 1) << k;
+		alleles[h >> 3] = m;
+	}
+}
+
+unsigned int pbwt_sweep::partition(int * A) {
+	unsigned int u = 0, v = 0, h = 0;
+#if defined(SIMD_AVX2)
+	const int * T = compressTable();
+	for ( ; h + 8 <= n_hap ; h += 8) {
+		unsigned int m1 = alleles[h >> 3], m0 = m1 ^ 0xFF;
+		__m256i a = _mm256_loadu_si256((const __m256i *)(A + h));
+		_mm256_storeu_si256((__m256i *)(A + u), _mm256_permutevar8x32_epi32(a, _mm256_loadu_si256((const __m256i *)(T + m0 * 8))));
+		_mm256_storeu_si256((__m256i *)(B.data() + v), _mm256_permutevar8x32_epi32(a, _mm256_loadu_si256((const __m256i *)(T + m1 * 8))));
+		u += __builtin_popcount(m0);
+		v += __builtin_popcount(m1);
+	}
+#endif
+	for ( ; h < n_hap ; h ++) {
+		if (!((alleles[h >> 3] >> (h & 7)) & 1)) A[u++] = A[h];
+		else B[v++] = A[h];
+	}
+	std::copy(B.begin(), B.begin() + v, A + u);
+	return u;
+}
+
+template < bool forward >
+unsigned int pbwt_sweep::partition(int * A, int * C, int init, int reset) {
+	unsigned int u = 0, v = 0, h = 0;
+	int p = init, q = init;
+#if defined(SIMD_AVX2)
+	const int * T = compressTable();
+	const __m256i bit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	const __m256i identity = _mm256_set1_epi32(reset);
+	for ( ; h + 8 <= n_hap ; h += 8) {
+		unsigned int m1 = alleles[h >> 3], m0 = m1 ^ 0xFF;
+		__m256i a = _mm256_loadu_si256((const __m256i *)(A + h));
+		__m256i c = _mm256_loadu_si256((const __m256i *)(C + h));
+
+		//Blocks on a single side [most of them at low frequency sites]: divergences pass through, only the carries are updated
+		if (m1 == 0 || m0 == 0) {
+			__m256i r = forward ? _mm256_max_epi32(c, _mm256_permute2x128_si256(c, c, 1)) : _mm256_min_epi32(c, _mm256_permute2x128_si256(c, c, 1));
+			r = forward ? _mm256_max_epi32(r, _mm256_shuffle_epi32(r, 0x4E)) : _mm256_min_epi32(r, _mm256_shuffle_epi32(r, 0x4E));
+			r = forward ? _mm256_max_epi32(r, _mm256_shuffle_epi32(r, 0xB1)) : _mm256_min_epi32(r, _mm256_shuffle_epi32(r, 0xB1));
+			int c0 = _mm256_extract_epi32(c, 0), all = _mm256_extract_epi32(r, 0);
+			if (m1 == 0) {
+				_mm256_storeu_si256((__m256i *)(A + u), a);
+				_mm256_storeu_si256((__m256i *)(C + u), _mm256_insert_epi32(c, forward ? max(p, c0) : min(p, c0), 0));
+				p = reset;
+				q = forward ? max(q, all) : min(q, all);
+				u += 8;
+			} else {
+				_mm256_storeu_si256((__m256i *)(B.data() + v), a);
+				_mm256_storeu_si256((__m256i *)(D.data() + v), _mm256_insert_epi32(c, forward ? max(q, c0) : min(q, c0), 0));
+				q = reset;
+				p = forward ? max(p, all) : min(p, all);
+				v += 8;
+			}
+			continue;
+		}
+
+		//Restart lanes: those following a lane that output on the same side
+		__m256i is1 = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(m1 << 1), bit), bit);
+		__m256i is0 = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(m0 << 1), bit), bit);
+		__m256i x0 = segmentedScan < forward > (c, is0, _mm256_set1_epi32(p), identity);
+		__m256i x1 = segmentedScan < forward > (c, is1, _mm256_set1_epi32(q), identity);
+
+		__m256i perm0 = _mm256_loadu_si256((const __m256i *)(T + m0 * 8));
+		__m256i perm1 = _mm256_loadu_si256((const __m256i *)(T + m1 * 8));
+		_mm256_storeu_si256((__m256i *)(A + u), _mm256_permutevar8x32_epi32(a, perm0));
+		_mm256_storeu_si256((__m256i *)(C + u), _mm256_permutevar8x32_epi32(x0, perm0));
+		_mm256_storeu_si256((__m256i *)(B.data() + v), _mm256_permutevar8x32_epi32(a, perm1));
+		_mm256_storeu_si256((__m256i *)(D.data() + v), _mm256_permutevar8x32_epi32(x1, perm1));
+		u += __builtin_popcount(m0);
+		v += __builtin_popcount(m1);
+
+		//Carries: running value after the last lane, unless that lane was output on the same side
+		p = (m1 & 0x80) ? _mm256_extract_epi32(x0, 7) : reset;
+		q = (m1 & 0x80) ? reset : _mm256_extract_epi32(x1, 7);
+	}
+#endif
+	for ( ; h < n_hap ; h ++) {
+		int alookup = A[h], dlookup = C[h];
+		if (forward) { if (dlookup > p) p = dlookup; if (dlookup > q) q = dlookup; }
+		else { if (dlookup < p) p = dlookup; if (dlookup < q) q = dlookup; }
+		if (!((alleles[h >> 3] >> (h & 7)) & 1)) {
+			A[u] = alookup;
+			C[u] = p;
+			p = reset;
+			u++;
+		} else {
+			B[v] = alookup;
+			D[v] = q;
+			q = reset;
+			v++;
+		}
+	}
+	std::copy(B.begin(), B.begin() + v, A + u);
+	std::copy(D.begin(), D.begin() + v, C + u);
+	return u;
+}
+
+template unsigned int pbwt_sweep::partition < true > (int * A, int * C, int init, int reset);
+template unsigned int pbwt_sweep::partition < false > (int * A, int * C, int init, int reset);
+
+template < bool forward >
+unsigned int pbwt_sweep::sortScalar(bitmatrix & BM, unsigned int row, int * A, int * C, int reset) {
+	unsigned int u = 0, v = 0;
+	int p = row, q = row;
+	for (int h = 0 ; h < n_hap ; h ++) {
+		int alookup = A[h];
+		int dlookup = C ? C[h] : 0;
+		if (forward) { if (dlookup > p) p = dlookup; if (dlookup > q) q = dlookup; }
+		else { if (dlookup < p) p = dlookup; if (dlookup < q) q = dlookup; }
+		if (!BM.get(row, alookup)) {
+			A[u] = alookup;
+			if (C) C[u] = p;
+			p = reset;
+			u++;
+		} else {
+			B[v] = alookup;
+			D[v] = q;
+			q = reset;
+			v++;
+		}
+	}
+	std::copy(B.begin(), B.begin() + v, A + u);
+	if (C) std::copy(D.begin(), D.begin() + v, C + u);
+	return u;
+}
+
+unsigned int pbwt_sweep::sort(bitmatrix & BM, unsigned int row, vector < int > & A) {
+#if defined(SIMD_AVX2)
+	gather(BM, row, A.data());
+	return partition(A.data());
+#else
+	return sortScalar < true > (BM, row, A.data(), NULL, 0);
+#endif
+}
+
+unsigned int pbwt_sweep::sortForward(bitmatrix & BM, unsigned int row, vector < int > & A, vector < int > & C) {
+#if defined(SIMD_AVX2)
+	gather(BM, row, A.data());
+	return partition < true > (A.data(), C.data(), row, 0);
+#else
+	return sortScalar < true > (BM, row, A.data(), C.data(), 0);
+#endif
+}
+
+unsigned int pbwt_sweep::sortBackward(bitmatrix & BM, unsigned int row, vector < int > & A, vector < int > & C, int reset) {
+#if defined(SIMD_AVX2)
+	gather(BM, row, A.data());
+	return partition < false > (A.data(), C.data(), row, reset);
+#else
+	return sortScalar < false > (BM, row, A.data(), C.data(), reset);
+#endif
+}
@@ -0,0 +1,59 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _PBWT_SWEEP_H
+#define _PBWT_SWEEP_H
+
+#include <utils/otools.h>
+#include <containers/bitmatrix.h>
+
+/*
+ * One step of the PBWT: stable partition of the prefix array A (and of the divergence array C) on the alleles carried at a given row of a
+ * haplotype bitmatrix. The alleles are first gathered in prefix order into a dense bit vector (one byte per 8 haplotypes), which makes the
+ * partition branchless: 8 haplotypes at a time are compacted with a permutation table and the divergence running max/min is done as a
+ * segmented scan across the 8 lanes.
+ * The divergence variants reproduce the classic loop: p = q = row, then per haplotype p = op(p, C[h]), q = op(q, C[h]) and reset of p (resp. q)
+ * to the identity of op each time a 0 (resp. 1) is output; op is max in forward sweeps (identity 0) and min in backward ones (identity = reset).
+ * Without AVX2, the sort functions fall back on the classic single pass loop, which is faster than two scalar passes.
+ */
+class pbwt_sweep {
+public:
+	unsigned int n_hap;
+	vector < unsigned char > alleles;	//Alleles in prefix order, bit h%8 of byte h/8
+	vector < int > B, D;				//Buffers for haplotypes carrying the 1 allele, padded by 8 for vector stores
+
+	pbwt_sweep();
+	pbwt_sweep(unsigned int _n_hap);
+	~pbwt_sweep();
+	void allocate(unsigned int _n_hap);
+
+	void gather(bitmatrix & BM, unsigned int row, const int * A);
+	unsigned int partition(int * A);
+	template < bool forward > unsigned int partition(int * A, int * C, int init, int reset);
+	template < bool forward > unsigned int sortScalar(bitmatrix & BM, unsigned int row, int * A, int * C, int reset);
+
+	unsigned int sort(bitmatrix & BM, unsigned int row, vector < int > & A);
+	unsigned int sortForward(bitmatrix & BM, unsigned int row, vector < int > & A, vector < int > & C);
+	unsigned int sortBackward(bitmatrix & BM, unsigned int row, vector < int > & A, vector < int > & C, int reset);
+};
+
+#endif
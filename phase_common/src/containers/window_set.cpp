@@ -38,18 +38,20 @@ int window_set::size() {
 	return W.size();
 }
 
-bool window_set::split(double min_length_cm, int left_index, int right_index, vector < int > & idx_sta, vector < int > & idx_sto, vector < double > & ccm_sta, vector < double > & ccm_sto, vector < int > & output) {
+bool window_set::split(variant_map & V, const unsigned int * layout, double min_length_cm, int left_index, int right_index, vector < int > & output, random_stream & R) {
+	unsigned int first_locus = layout[left_index * LAYOUT_STRIDE + LAYOUT_LOC];
+	unsigned int last_locus = layout[(right_index + 1) * LAYOUT_STRIDE + LAYOUT_LOC] - 1;
 	int number_of_segments = right_index-left_index+1;
-	int number_of_variants = idx_sto[right_index] - idx_sta[left_index] + 1;
-	double length_of_region = ccm_sto[right_index] - ccm_sta[left_index];
+	int number_of_variants = last_locus - first_locus + 1;
+	double length_of_region = V.vec_pos[last_locus]->cm - V.vec_pos[first_locus]->cm;
 
 	//A phasing window must (i) span >=4 segments, (ii) contain >= 100 variants and (iii) span more than "min_length_cm" cM
 	if (number_of_segments < 4 || number_of_variants < 100 || length_of_region < min_length_cm) return false;
 	else {
-		int split_point = rng.getInt(number_of_segments/2) + number_of_segments/4 + 1;
+		int split_point = R.getInt(number_of_segments/2) + number_of_segments/4 + 1;
 		vector <  int > left_output, right_output;
-		bool ret1 = split(min_length_cm, left_index, left_index + split_point, idx_sta, idx_sto, ccm_sta, ccm_sto, left_output);
-		bool ret2 = split(min_length_cm, left_index + split_point, right_index, idx_sta, idx_sto, ccm_sta, ccm_sto, right_output);
+		bool ret1 = split(V, layout, min_length_cm, left_index, left_index + split_point, left_output, R);
+		bool ret2 = split(V, layout, min_length_cm, left_index + split_point, right_index, right_output, R);
 
 		if (ret1 && ret2) {
 			//succesful split, so operate it
@@ -67,70 +69,34 @@ bool window_set::split(double min_length_cm, int left_index, int right_index, ve
 }
 
 
-int window_set::build (variant_map & V, genotype * g, float min_window_size) {
+int window_set::build (variant_map & V, genotype * g, float min_window_size, random_stream & R) {
 
-	//1. Mapping coordinates of each segment
-	vector < unsigned int > loc_idx = vector < unsigned int >(g->n_segments, 0);
-	vector < unsigned int > loc_siz = vector < unsigned int >(g->n_segments, 0);
-	vector < unsigned int > amb_idx = vector < unsigned int >(g->n_segments, 0);
-	vector < unsigned int > amb_siz = vector < unsigned int >(g->n_segments, 0);
-	vector < unsigned int > mis_idx = vector < unsigned int >(g->n_segments, 0);
-	vector < unsigned int > mis_siz = vector < unsigned int >(g->n_segments, 0);
-	vector < unsigned int > tra_idx = vector < unsigned int >(g->n_segments, 0);
-	vector < unsigned int > tra_siz = vector < unsigned int >(g->n_segments, 0);
-	vector < double > ccm_sta = vector < double >(g->n_segments, 0);
-	vector < double > ccm_sto = vector < double >(g->n_segments, 0);
-	vector < int > idx_sta = vector < int >(g->n_segments, 0);
-	vector < int > idx_sto = vector < int >(g->n_segments, 0);
-
-	unsigned int prev_dipcounts = 1, curr_dipcounts = 0;
-	for (unsigned int s = 0, a = 0, t = 0, v = 0, m = 0 ; s < g->n_segments ; s ++) {
-		//update a
-		amb_idx[s] = a;
-		for (unsigned int vrel = 0 ; vrel < g->Lengths[s] ; vrel ++) amb_siz[s] += VAR_GET_AMB(MOD2(v+vrel), g->Variants[DIV2(v+vrel)]);
-		a += amb_siz[s];
-		//update m
-		mis_idx[s] = m;
-		for (unsigned int vrel = 0 ; vrel < g->Lengths[s] ; vrel ++) mis_siz[s] += VAR_GET_MIS(MOD2(v+vrel), g->Variants[DIV2(v+vrel)]);
-		m += mis_siz[s];
-		//update v
-		loc_idx[s] = v;
-		loc_siz[s] = g->Lengths[s];
-		v += loc_siz[s];
-		//update idx
-		idx_sta[s] = loc_idx[s];
-		idx_sto[s] = loc_idx[s]+loc_siz[s]-1;
-		//update ccm
-		ccm_sta[s] = V.vec_pos[idx_sta[s]]->cm;
-		ccm_sto[s] = V.vec_pos[idx_sto[s]]->cm;
-		//update t
-		tra_idx[s] = t;
-		curr_dipcounts = g->countDiplotypes(g->Diplotypes[s]);
-		tra_siz[s] = prev_dipcounts * curr_dipcounts;
-		t += tra_siz[s];
-		prev_dipcounts = curr_dipcounts;
-	}
+	//1. Coordinates of each segment, mapped once per genotype graph
+	if (g->Layout.size() != (g->n_segments + 1) * LAYOUT_STRIDE) g->mapLayout();
+	const unsigned int * layout = g->Layout.data();
 
 	//2. Reccursive split
 	vector < int > output;
 	output.push_back(0);
 	output.push_back(g->n_segments-1);
-	split(min_window_size, 0, g->n_segments-1, idx_sta, idx_sto, ccm_sta, ccm_sto, output);
+	split(V, layout, min_window_size, 0, g->n_segments-1, output, R);
 	int n_windows = output.size()/2;
 
 	//3. Update coordinates
-	W = vector < window > (n_windows);
+	W.resize(n_windows);
 	for (unsigned int w = 0 ; w < n_windows ; w ++) {
+		const unsigned int * first = layout + output[2*w+0] * LAYOUT_STRIDE;
+		const unsigned int * last = layout + (output[2*w+1] + 1) * LAYOUT_STRIDE;
 		W[w].start_segment = output[2*w+0];
 		W[w].stop_segment = output[2*w+1];
-		W[w].start_ambiguous = amb_idx[W[w].start_segment];
-		W[w].stop_ambiguous = amb_idx[W[w].stop_segment] + amb_siz[W[w].stop_segment] - 1;
-		W[w].start_missing = mis_idx[W[w].start_segment];
-		W[w].stop_missing = mis_idx[W[w].stop_segment] + mis_siz[W[w].stop_segment] - 1;
-		W[w].start_locus = loc_idx[W[w].start_segment];
-		W[w].stop_locus = loc_idx[W[w].stop_segment] + loc_siz[W[w].stop_segment] - 1;
-		W[w].start_transition = tra_idx[W[w].start_segment] + tra_siz[W[w].start_segment];
-		W[w].stop_transition = tra_idx[W[w].stop_segment] + tra_siz[W[w].stop_segment] - 1;
+		W[w].start_ambiguous = first[LAYOUT_AMB];
+		W[w].stop_ambiguous = last[LAYOUT_AMB] - 1;
+		W[w].start_missing = first[LAYOUT_MIS];
+		W[w].stop_missing = last[LAYOUT_MIS] - 1;
+		W[w].start_locus = first[LAYOUT_LOC];
+		W[w].stop_locus = last[LAYOUT_LOC] - 1;
+		W[w].start_transition = first[LAYOUT_STRIDE + LAYOUT_TRA];
+		W[w].stop_transition = last[LAYOUT_TRA] - 1;
 	}
 	return n_windows;
 }
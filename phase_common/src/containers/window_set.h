@@ -81,8 +81,8 @@ public:
 
 	//
 	int size();
-	bool split(double, int, int, vector < int > &, vector < int > &, vector < double > &, vector < double > &, vector < int > &);
-	int build (variant_map &, genotype *, float);
+	bool split(variant_map &, const unsigned int *, double, int, int, vector < int > &, random_stream &);
+	int build (variant_map &, genotype *, float, random_stream &);
 };
 
 #endif
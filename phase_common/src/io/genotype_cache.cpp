@@ -0,0 +1,201 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <io/genotype_cache.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static uint64_t cache_align(uint64_t offset) {
+	return ((offset + GENOTYPE_CACHE_ALIGNMENT - 1) / GENOTYPE_CACHE_ALIGNMENT) * GENOTYPE_CACHE_ALIGNMENT;
+}
+
+static void cache_pad(ofstream & fd, uint64_t offset) {
+	static const char zeros[GENOTYPE_CACHE_ALIGNMENT] = { 0 };
+	uint64_t pos = fd.tellp();
+	assert(offset >= pos);
+	fd.write(zeros, offset - pos);
+}
+
+genotype_cache::genotype_cache(haplotype_set & _H, genotype_set & _G, variant_map & _V) : H(_H), G(_G), V(_V) {
+	n_variants = 0;
+	n_main_samples = 0;
+	n_ref_samples = 0;
+	n_genotypes = vector < unsigned long > (5, 0);
+	key = "";
+}
+
+genotype_cache::~genotype_cache() {
+	n_variants = 0;
+	n_main_samples = 0;
+	n_ref_samples = 0;
+	n_genotypes.clear();
+	key = "";
+}
+
+void genotype_cache::setKey(vector < pair < string, string > > & files, string params) {
+	//The cache is only reused by the same format version, with the same files in the same roles [input, reference, scaffold], unchanged [size + modification time], and identical parameters
+	key = "format=" + stb.str(GENOTYPE_CACHE_VERSION) + "|" + params;
+	for (int f = 0 ; f < files.size() ; f ++) {
+		struct stat st;
+		if (stat(files[f].second.c_str(), &st) != 0) vrb.error("Impossible to stat [" + files[f].second + "]");
+		key += "|" + files[f].first + "=" + files[f].second + ":" + stb.str((unsigned long)st.st_size) + ":" + stb.str((long)st.st_mtime);
+	}
+}
+
+bool genotype_cache::readCache(string fname) {
+	tac.clock();
+	int fd = open(fname.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < sizeof(genotype_cache_header)) { close(fd); return false; }
+	void * addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) return false;
+	madvise(addr, st.st_size, MADV_SEQUENTIAL);
+	const char * base = static_cast < const char * > (addr);
+
+	//Check header and key
+	const genotype_cache_header * hdr = reinterpret_cast < const genotype_cache_header * > (base);
+	string reason = "";
+	if (strncmp(hdr->magic, GENOTYPE_CACHE_MAGIC, 8) != 0) reason = "not a genotype cache";
+	else if (hdr->version != GENOTYPE_CACHE_VERSION) reason = "version " + stb.str(hdr->version) + " while " + stb.str(GENOTYPE_CACHE_VERSION) + " expected";
+	else if (hdr->alignment != GENOTYPE_CACHE_ALIGNMENT) reason = "unsupported alignment";
+	else if (hdr->offset_haplotypes + hdr->hap_bytes > st.st_size) reason = "truncated file";
+	else if (string(base + hdr->offset_key, hdr->size_key) != key) reason = "built from different inputs or parameters";
+	else if (hdr->n_main_samples == 0) reason = "no target samples";
+	if (reason != "") {
+		vrb.warning("Genotype cache [" + fname + "] ignored: " + reason);
+		munmap(addr, st.st_size);
+		return false;
+	}
+
+	//Counts
+	n_variants = hdr->n_variants;
+	n_main_samples = hdr->n_main_samples;
+	n_ref_samples = hdr->n_ref_samples;
+	for (int g = 0 ; g < 5 ; g ++) n_genotypes[g] = hdr->n_genotypes[g];
+
+	//Variants
+	const genotype_cache_variant * vars = reinterpret_cast < const genotype_cache_variant * > (base + hdr->offset_variants);
+	const char * strings = base + hdr->offset_strings;
+	for (unsigned long l = 0 ; l < n_variants ; l ++) {
+		string chr = string(strings + vars[l].str_chr);
+		string id = string(strings + vars[l].str_id);
+		string ref = string(strings + vars[l].str_ref);
+		string alt = string(strings + vars[l].str_alt);
+		variant * v = new variant (chr, vars[l].bp, id, ref, alt, V.size());
+		v->cref = vars[l].cref;
+		v->calt = vars[l].calt;
+		v->cmis = vars[l].cmis;
+		V.push(v);
+	}
+
+	//Genotypes and haplotypes
+	G.allocate(n_main_samples, n_variants);
+	H.allocate(n_main_samples, n_ref_samples, n_variants);
+	const char * names = strings + hdr->str_samples;
+	for (unsigned long i = 0 ; i < n_main_samples ; i ++) {
+		G.vecG[i]->name = string(names);
+		names += G.vecG[i]->name.size() + 1;
+		assert(G.vecG[i]->Variants.size() == hdr->size_genotype);
+		memcpy(G.vecG[i]->Variants.data(), base + hdr->offset_genotypes + i * hdr->size_genotype, hdr->size_genotype);
+	}
+	assert(H.H_opt_hap.n_rows == hdr->hap_rows && H.H_opt_hap.n_cols == hdr->hap_cols && H.H_opt_hap.n_bytes == hdr->hap_bytes);
+	memcpy(H.H_opt_hap.bytes, base + hdr->offset_haplotypes, hdr->hap_bytes);
+	munmap(addr, st.st_size);
+
+	// Report
+	unsigned long n_genotypes_total = accumulate(n_genotypes.begin(), n_genotypes.begin() + 4, 0UL);
+	vrb.bullet("#target=" + stb.str(n_main_samples) + " / #reference=" + stb.str(n_ref_samples) + " / #sites=" + stb.str(n_variants));
+	vrb.bullet("Cache loading [0/0=" + stb.str(n_genotypes[0]*100.0/n_genotypes_total, 3) + "% / 0/1=" + stb.str(n_genotypes[1]*100.0/n_genotypes_total, 3) + "% / 1/1=" + stb.str(n_genotypes[2]*100.0/n_genotypes_total, 3) + "% / ./.=" + stb.str(n_genotypes[3]*100.0/n_genotypes_total, 3) + "% / 0|1=" + stb.str(n_genotypes[4]*100.0/n_genotypes_total, 3) + "%] (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
+	return true;
+}
+
+void genotype_cache::writeCache(string fname) {
+	tac.clock();
+	if (G.vecG.empty()) {
+		vrb.warning("Genotype cache [" + fname + "] not written: no target samples");
+		return;
+	}
+
+	//Build string table and variant records
+	string strings;
+	vector < genotype_cache_variant > vars = vector < genotype_cache_variant > (n_variants);
+	for (unsigned long l = 0 ; l < n_variants ; l ++) {
+		vars[l].bp = V.vec_pos[l]->bp;
+		vars[l].cref = V.vec_pos[l]->cref;
+		vars[l].calt = V.vec_pos[l]->calt;
+		vars[l].cmis = V.vec_pos[l]->cmis;
+		vars[l].str_chr = strings.size(); strings += V.vec_pos[l]->chr; strings.push_back('\0');
+		vars[l].str_id = strings.size(); strings += V.vec_pos[l]->id; strings.push_back('\0');
+		vars[l].str_ref = strings.size(); strings += V.vec_pos[l]->ref; strings.push_back('\0');
+		vars[l].str_alt = strings.size(); strings += V.vec_pos[l]->alt; strings.push_back('\0');
+	}
+	uint64_t str_samples = strings.size();
+	for (unsigned long i = 0 ; i < n_main_samples ; i ++) { strings += G.vecG[i]->name; strings.push_back('\0'); }
+
+	//Header with aligned section offsets
+	genotype_cache_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	strncpy(hdr.magic, GENOTYPE_CACHE_MAGIC, 8);
+	hdr.version = GENOTYPE_CACHE_VERSION;
+	hdr.alignment = GENOTYPE_CACHE_ALIGNMENT;
+	hdr.n_variants = n_variants;
+	hdr.n_main_samples = n_main_samples;
+	hdr.n_ref_samples = n_ref_samples;
+	for (int g = 0 ; g < 5 ; g ++) hdr.n_genotypes[g] = n_genotypes[g];
+	hdr.offset_key = cache_align(sizeof(hdr));
+	hdr.size_key = key.size();
+	hdr.offset_variants = cache_align(hdr.offset_key + hdr.size_key);
+	hdr.offset_strings = cache_align(hdr.offset_variants + n_variants * sizeof(genotype_cache_variant));
+	hdr.size_strings = strings.size();
+	hdr.str_samples = str_samples;
+	hdr.size_genotype = G.vecG[0]->Variants.size();
+	hdr.offset_genotypes = cache_align(hdr.offset_strings + hdr.size_strings);
+	hdr.offset_haplotypes = cache_align(hdr.offset_genotypes + n_main_samples * hdr.size_genotype);
+	hdr.hap_rows = H.H_opt_hap.n_rows;
+	hdr.hap_cols = H.H_opt_hap.n_cols;
+	hdr.hap_bytes = H.H_opt_hap.n_bytes;
+
+	//Write into a temporary file first, so that an interrupted run never leaves a truncated cache behind
+	string ftmp = fname + ".tmp";
+	ofstream fd (ftmp, ios::out | ios::binary);
+	if (!fd.good()) vrb.error("Impossible to create genotype cache [" + ftmp + "]");
+	fd.write(reinterpret_cast < char * > (&hdr), sizeof(hdr));
+	cache_pad(fd, hdr.offset_key);
+	fd.write(key.data(), key.size());
+	cache_pad(fd, hdr.offset_variants);
+	fd.write(reinterpret_cast < char * > (vars.data()), n_variants * sizeof(genotype_cache_variant));
+	cache_pad(fd, hdr.offset_strings);
+	fd.write(strings.data(), strings.size());
+	cache_pad(fd, hdr.offset_genotypes);
+	for (unsigned long i = 0 ; i < n_main_samples ; i ++) fd.write(reinterpret_cast < char * > (G.vecG[i]->Variants.data()), hdr.size_genotype);
+	cache_pad(fd, hdr.offset_haplotypes);
+	fd.write(reinterpret_cast < char * > (H.H_opt_hap.bytes), hdr.hap_bytes);
+	fd.close();
+	if (fd.fail()) vrb.error("Impossible to write genotype cache [" + ftmp + "]");
+	if (rename(ftmp.c_str(), fname.c_str()) != 0) vrb.error("Impossible to rename genotype cache into [" + fname + "]");
+	vrb.bullet("Cache writing [" + fname + " / " + stb.str((hdr.offset_haplotypes + hdr.hap_bytes) * 1.0 / (1024 * 1024), 1) + "MB] (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
+}
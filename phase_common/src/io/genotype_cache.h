@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _GENOTYPE_CACHE_H
+#define _GENOTYPE_CACHE_H
+
+#include <utils/otools.h>
+
+#include <containers/variant_map.h>
+#include <containers/haplotype_set.h>
+
+#define GENOTYPE_CACHE_MAGIC		"SHP5GCH"
+#define GENOTYPE_CACHE_VERSION		2
+#define GENOTYPE_CACHE_ALIGNMENT	4096
+
+/*
+ * On-disk layout of the genotype cache. The header sits at offset 0 and every
+ * section starts on a GENOTYPE_CACHE_ALIGNMENT boundary so that the file can be
+ * mapped as is and each section accessed in place:
+ *  - key: description of the inputs the cache was built from
+ *  - variants: one genotype_cache_variant per site
+ *  - strings: null-terminated chr/id/ref/alt of the variants, then sample names
+ *  - genotypes: packed genotype::Variants of each main sample, back to back
+ *  - haplotypes: raw bytes of H_opt_hap
+ */
+struct genotype_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t alignment;
+	uint64_t n_variants;
+	uint64_t n_main_samples;
+	uint64_t n_ref_samples;
+	uint64_t n_genotypes[5];
+	uint64_t offset_key, size_key;
+	uint64_t offset_variants;
+	uint64_t offset_strings, size_strings, str_samples;
+	uint64_t offset_genotypes, size_genotype;
+	uint64_t offset_haplotypes, hap_rows, hap_cols, hap_bytes;
+};
+
+struct genotype_cache_variant {
+	int32_t bp;
+	uint32_t cref;
+	uint32_t calt;
+	uint32_t cmis;
+	uint64_t str_chr, str_id, str_ref, str_alt;
+};
+
+class genotype_cache {
+public:
+	//DATA
+	haplotype_set & H;
+	genotype_set & G;
+	variant_map & V;
+
+	//COUNTS
+	unsigned long n_variants;
+	unsigned long n_main_samples;
+	unsigned long n_ref_samples;
+	vector < unsigned long > n_genotypes;
+
+	//PARAMETERS
+	string key;
+
+	//CONSTRUCTORS/DESCTRUCTORS
+	genotype_cache(haplotype_set &, genotype_set &, variant_map &);
+	~genotype_cache();
+
+	//PARAMS
+	void setKey(vector < pair < string, string > > &, string);
+
+	//IO
+	bool readCache(string);
+	void writeCache(string);
+};
+
+#endif
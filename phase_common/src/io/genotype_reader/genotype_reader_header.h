@@ -24,14 +24,25 @@
 #define _GENOTYPE_READER_H
 
 #include <utils/otools.h>
+#include <utils/thread_pool.h>
 
 #include <containers/variant_map.h>
 #include <containers/haplotype_set.h>
 
+//Block of consecutive variants unpacked by the reading thread, then decoded in parallel across samples
+struct genotype_batch {
+	unsigned int first;						//Index of the first variant in the batch
+	unsigned int size;						//Number of variants in the batch
+	vector < int * > gt_main, gt_ref, gt_scaf;
+	vector < int > ngt_main, ngt_ref, ngt_scaf;
+	vector < bool > has_scaf;
+};
+
 class genotype_reader {
 public:
 	//DATA
 	int nthreads;
+	thread_pool * pool;
 	haplotype_set & H;
 	genotype_set & G;
 	variant_map & V;
@@ -51,6 +62,16 @@ public:
 	bool filter_snp_only;
 	vector < bool > variant_mask;
 
+	//PIPELINE
+	bcf_srs_t * pipe_sr;
+	vector < genotype_batch > pipe_slots;
+	unsigned long pipe_produced, pipe_consumed;
+	bool pipe_done;
+	pthread_mutex_t pipe_mutex;
+	pthread_cond_t pipe_cond_full, pipe_cond_empty;
+	vector < vector < unsigned long > > pipe_counts;
+	vector < vector < int > > mappingM2S;	//Scaffold columns of each main sample, in scaffold order [several when names only differ after '_']
+
 	//CONSTRUCTORS/DESCTRUCTORS
 	genotype_reader(haplotype_set &, genotype_set &, variant_map &);
 	~genotype_reader();
@@ -62,11 +83,14 @@ public:
 	void addReferenceFilename(string);
 	void addScaffoldFilename(string);
 	void setThreads(int);
+	void setThreadPool(thread_pool *);
 	void setRegion(string);
 
 	//IO
 	void scanGenotypes();
 	void readGenotypes();
+	void produceGenotypes();
+	void decodeGenotypes(genotype_batch &, int, int);
 	void allocateGenotypes();
 };
 
@@ -24,6 +24,7 @@
 
 genotype_reader::genotype_reader(haplotype_set & _H, genotype_set & _G, variant_map & _V) : H(_H), G(_G), V(_V) {
 	nthreads = 1;
+	pool = NULL;
 	n_variants = 0;
 	n_main_samples = 0;
 	n_ref_samples = 0;
@@ -66,5 +67,7 @@ void genotype_reader::addScaffoldFilename(string file) { filenames[2] = file; pa
 
 void genotype_reader::setThreads(int _threads) { threads = _threads; }
 
+void genotype_reader::setThreadPool(thread_pool * _pool) { pool = _pool; }
+
 void genotype_reader::setRegion(string _region) { region = _region; }
 
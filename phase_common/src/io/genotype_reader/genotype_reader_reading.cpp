@@ -22,6 +22,144 @@
 
 #include <io/genotype_reader/genotype_reader_header.h>
 
+//Maximum number of GT values held by a batch of the reading pipeline, and number of batches in flight
+#define PIPE_BATCH_GTS	(1UL << 22)
+#define PIPE_SLOTS		4
+
+void * genotype_producer_callback(void * ptr) {
+	genotype_reader * R = static_cast< genotype_reader * >( ptr );
+	R->produceGenotypes();
+	return NULL;
+}
+
+void genotype_reader::produceGenotypes() {
+	unsigned int i_variant_total = 0, i_variant_kept = 0;
+	int n_scaf_samples = panels[2] ? bcf_hdr_nsamples(pipe_sr->readers[panels[1]+panels[2]].header) : 0;
+	genotype_batch * B = NULL;
+	while (bcf_sr_next_line (pipe_sr)) {
+		if (variant_mask[i_variant_total]) {
+
+			//Wait for a free batch in the ring buffer
+			if (!B) {
+				pthread_mutex_lock(&pipe_mutex);
+				while (pipe_produced - pipe_consumed == pipe_slots.size()) pthread_cond_wait(&pipe_cond_empty, &pipe_mutex);
+				B = &pipe_slots[pipe_produced % pipe_slots.size()];
+				pthread_mutex_unlock(&pipe_mutex);
+				B->first = i_variant_kept;
+				B->size = 0;
+			}
+			unsigned int v = B->size;
+
+			//Retrieve data in main file
+			bcf1_t * line_main = bcf_sr_get_line(pipe_sr, 0);
+			int ngt_main = bcf_get_genotypes(pipe_sr->readers[0].header, line_main, &B->gt_main[v], &B->ngt_main[v]); assert(ngt_main == 2 * n_main_samples);
+
+			//Retrieve data in reference file if necessary
+			if (panels[1]) {
+				bcf1_t * line_ref = bcf_sr_get_line(pipe_sr, 1);
+				int ngt_ref = bcf_get_genotypes(pipe_sr->readers[1].header, line_ref, &B->gt_ref[v], &B->ngt_ref[v]); assert(ngt_ref == 2 * n_ref_samples);
+			}
+
+			//Retrieve data in scaffold file if necessary and available
+			B->has_scaf[v] = false;
+			if (panels[2]) {
+				bcf1_t * line_scaf = bcf_sr_get_line(pipe_sr, panels[1]+panels[2]);
+				if (line_scaf) {
+					int ngt_scaf = bcf_get_genotypes(pipe_sr->readers[panels[1]+panels[2]].header, line_scaf, &B->gt_scaf[v], &B->ngt_scaf[v]);
+					assert(ngt_scaf == 2 * n_scaf_samples);
+					B->has_scaf[v] = true;
+				}
+			}
+
+			//Hand over the batch to the decoding workers once full
+			B->size ++;
+			i_variant_kept ++;
+			if (B->size == B->gt_main.size()) {
+				pthread_mutex_lock(&pipe_mutex);
+				pipe_produced ++;
+				pthread_cond_signal(&pipe_cond_full);
+				pthread_mutex_unlock(&pipe_mutex);
+				B = NULL;
+			}
+		}
+		i_variant_total++;
+	}
+	pthread_mutex_lock(&pipe_mutex);
+	if (B) pipe_produced ++;
+	pipe_done = true;
+	pthread_cond_signal(&pipe_cond_full);
+	pthread_mutex_unlock(&pipe_mutex);
+}
+
+void genotype_reader::decodeGenotypes(genotype_batch & B, int range, int n_ranges) {
+	//Counts: 5 genotype classes followed by [cref, calt, cmis] for each variant of the batch
+	vector < unsigned long > & C = pipe_counts[range];
+	fill(C.begin(), C.end(), 0UL);
+	unsigned long main_from = n_main_samples * range / n_ranges, main_to = n_main_samples * (range + 1) / n_ranges;
+	unsigned long ref_from = n_ref_samples * range / n_ranges, ref_to = n_ref_samples * (range + 1) / n_ranges;
+
+	for (unsigned int v = 0 ; v < B.size ; v ++) {
+		unsigned int i_variant_kept = B.first + v;
+		unsigned long * Cv = &C[5 + 3 * v];
+
+		//Process main data
+		int * gt_arr_main = B.gt_main[v];
+		for(unsigned long i = 2 * main_from ; i < 2 * main_to ; i += 2) {
+			bool a0 = (bcf_gt_allele(gt_arr_main[i+0])==1);
+			bool a1 = (bcf_gt_allele(gt_arr_main[i+1])==1);
+			bool mi = (gt_arr_main[i+0] == bcf_gt_missing || gt_arr_main[i+1] == bcf_gt_missing);
+			bool he = !mi && a0 != a1;
+			if (a0) VAR_SET_HAP0(MOD2(i_variant_kept), G.vecG[DIV2(i)]->Variants[DIV2(i_variant_kept)]);
+			if (a1) VAR_SET_HAP1(MOD2(i_variant_kept), G.vecG[DIV2(i)]->Variants[DIV2(i_variant_kept)]);
+			if (mi) VAR_SET_MIS(MOD2(i_variant_kept), G.vecG[DIV2(i)]->Variants[DIV2(i_variant_kept)]);
+			if (he) VAR_SET_HET(MOD2(i_variant_kept), G.vecG[DIV2(i)]->Variants[DIV2(i_variant_kept)]);
+			if (mi) {
+				Cv[2] ++;
+				C[3] ++;
+			} else {
+				Cv[0] += (1-a0)+(1-a1);
+				Cv[1] += a0+a1;
+				C[a0+a1] ++;
+			}
+		}
+
+		//Process reference data
+		if (panels[1]) {
+			int * gt_arr_ref = B.gt_ref[v];
+			for(unsigned long i = 2 * ref_from ; i < 2 * ref_to ; i += 2) {
+				bool a0 = (bcf_gt_allele(gt_arr_ref[i+0])==1);
+				bool a1 = (bcf_gt_allele(gt_arr_ref[i+1])==1);
+				if (gt_arr_ref[i+0] == bcf_gt_missing || gt_arr_ref[i+1] == bcf_gt_missing) vrb.error("Missing genotype(s) in reference panel");
+				if (!bcf_gt_is_phased(gt_arr_ref[i+1])) vrb.error("Unphased genotype(s) in reference panel");
+				H.H_opt_hap.set(i+2*n_main_samples+0, i_variant_kept, a0);
+				H.H_opt_hap.set(i+2*n_main_samples+1, i_variant_kept, a1);
+				Cv[0] += (1-a0)+(1-a1);
+				Cv[1] += a0+a1;
+			}
+		}
+
+		//Process scaffold data [main samples of this range only]
+		if (B.has_scaf[v]) {
+			int * gt_arr_scaf = B.gt_scaf[v];
+			for(unsigned long ind = main_from ; ind < main_to ; ind ++) {
+				for (int s = 0 ; s < mappingM2S[ind].size() ; s ++) {
+					int i = 2 * mappingM2S[ind][s];
+					bool sa0 = (bcf_gt_allele(gt_arr_scaf[i+0])==1);
+					bool sa1 = (bcf_gt_allele(gt_arr_scaf[i+1])==1);
+					bool sph = (bcf_gt_is_phased(gt_arr_scaf[i+0]) || bcf_gt_is_phased(gt_arr_scaf[i+1]));
+					bool smi = (gt_arr_scaf[i+0] == bcf_gt_missing || gt_arr_scaf[i+1] == bcf_gt_missing);
+					if ((sa0 != sa1) && !smi && sph && VAR_GET_HET(MOD2(i_variant_kept), G.vecG[ind]->Variants[DIV2(i_variant_kept)])) {
+						VAR_SET_SCA(MOD2(i_variant_kept), G.vecG[ind]->Variants[DIV2(i_variant_kept)]);
+						sa0?VAR_SET_HAP0(MOD2(i_variant_kept), G.vecG[ind]->Variants[DIV2(i_variant_kept)]):VAR_CLR_HAP0(MOD2(i_variant_kept), G.vecG[ind]->Variants[DIV2(i_variant_kept)]);
+						sa1?VAR_SET_HAP1(MOD2(i_variant_kept), G.vecG[ind]->Variants[DIV2(i_variant_kept)]):VAR_CLR_HAP1(MOD2(i_variant_kept), G.vecG[ind]->Variants[DIV2(i_variant_kept)]);
+						C[4] ++;
+					}
+				}
+			}
+		}
+	}
+}
+
 void genotype_reader::readGenotypes() {
 	tac.clock();
 	vrb.wait("  * VCF/BCF parsing");
@@ -52,11 +190,10 @@ void genotype_reader::readGenotypes() {
 
 	//Scaffold sample IDs processing
 	int n_scaf_samples = 0;
-	vector < int > mappingS2M;
+	mappingM2S = vector < vector < int > > (n_main_samples);
 	if (panels[2]) {
 		int n_with_scaffold = 0;
 		n_scaf_samples = bcf_hdr_nsamples(sr->readers[panels[1]+panels[2]].header);
-		mappingS2M = vector < int > (n_scaf_samples, -1);
 		vector < string > tokens_tmp;
 		for (int i = 0 ; i < n_scaf_samples ; i ++) {
 			string buffer_tmp = string(sr->readers[panels[1]+panels[2]].header->samples[i]);
@@ -64,102 +201,82 @@ void genotype_reader::readGenotypes() {
 			string scaf_name = tokens_tmp[0];
 			map < string, int > :: iterator it = map_names.find(scaf_name);
 			if (it != map_names.end()) {
-				mappingS2M[i] = it->second;
+				//Every matching scaffold sample is applied in turn, so that the last one with a phased het wins
+				mappingM2S[it->second].push_back(i);
 				n_with_scaffold++;
 			}
 		}
 		vrb.bullet(stb.str(n_with_scaffold) + " samples with scaffold");
+		int n_multiple = 0;
+		for (int i = 0 ; i < n_main_samples ; i ++) n_multiple += (mappingM2S[i].size() > 1);
+		if (n_multiple) vrb.warning(stb.str(n_multiple) + " samples match several scaffold samples, all of them are applied in scaffold order");
 	}
 
-	//Parsing VCF/BCF
-	unsigned int i_variant_total = 0, i_variant_kept = 0, nset = 0;
-	int ngt_main, *gt_arr_main = NULL, ngt_arr_main = 0;
-	int ngt_scaf, *gt_arr_scaf = NULL, ngt_arr_scaf = 0;
-	int ngt_ref, *gt_arr_ref = NULL, ngt_arr_ref = 0;
-	bcf1_t * line_main, * line_ref, * line_scaf;
-	while ((nset = bcf_sr_next_line (sr))) {
-		if (variant_mask[i_variant_total]) {
-
-			//Retrieve data in main file
-			line_main = bcf_sr_get_line(sr, 0);
-			ngt_main = bcf_get_genotypes(sr->readers[0].header, line_main, &gt_arr_main, &ngt_arr_main); assert(ngt_main == 2 * n_main_samples);
-
-			//Retrieve data in reference file if necessary
-			if (panels[1]) {
-				line_ref = bcf_sr_get_line(sr, 1);
-				ngt_ref = bcf_get_genotypes(sr->readers[1].header, line_ref, &gt_arr_ref, &ngt_arr_ref); assert(ngt_ref == 2 * n_ref_samples);
-			}
+	//Set up the pipeline: one thread unpacks records into a ring of batches, workers decode disjoint sample ranges
+	thread_pool serial;
+	thread_pool & P = pool ? *pool : serial;
+	int n_ranges = P.size();
+	unsigned long n_gts_per_variant = 2 * (n_main_samples + n_ref_samples + n_scaf_samples);
+	unsigned int batch_size = max(1UL, min(1024UL, PIPE_BATCH_GTS / n_gts_per_variant));
+	pipe_sr = sr;
+	pipe_produced = pipe_consumed = 0;
+	pipe_done = false;
+	pipe_slots = vector < genotype_batch > (PIPE_SLOTS);
+	for (int b = 0 ; b < PIPE_SLOTS ; b ++) {
+		pipe_slots[b].first = pipe_slots[b].size = 0;
+		pipe_slots[b].gt_main = vector < int * > (batch_size, NULL);
+		pipe_slots[b].gt_ref = vector < int * > (batch_size, NULL);
+		pipe_slots[b].gt_scaf = vector < int * > (batch_size, NULL);
+		pipe_slots[b].ngt_main = vector < int > (batch_size, 0);
+		pipe_slots[b].ngt_ref = vector < int > (batch_size, 0);
+		pipe_slots[b].ngt_scaf = vector < int > (batch_size, 0);
+		pipe_slots[b].has_scaf = vector < bool > (batch_size, false);
+	}
+	pipe_counts = vector < vector < unsigned long > > (n_ranges, vector < unsigned long > (5 + 3 * batch_size, 0UL));
+	pthread_mutex_init(&pipe_mutex, NULL);
+	pthread_cond_init(&pipe_cond_full, NULL);
+	pthread_cond_init(&pipe_cond_empty, NULL);
 
-			//Retrieve data in scaffold file if necessary and available
-			if (panels[2]) {
-				line_scaf = bcf_sr_get_line(sr, panels[1]+panels[2]);
-				if (line_scaf) {
-					ngt_scaf = bcf_get_genotypes(sr->readers[panels[1]+panels[2]].header, line_scaf, &gt_arr_scaf, &ngt_arr_scaf);
-					assert(ngt_scaf == 2 * n_scaf_samples);
-				}
-			}
+	//Parsing VCF/BCF
+	pthread_t id_producer;
+	pthread_create(&id_producer, NULL, genotype_producer_callback, static_cast<void *>(this));
+	for (;;) {
+		pthread_mutex_lock(&pipe_mutex);
+		while (pipe_consumed == pipe_produced && !pipe_done) pthread_cond_wait(&pipe_cond_full, &pipe_mutex);
+		bool finished = (pipe_consumed == pipe_produced);
+		pthread_mutex_unlock(&pipe_mutex);
+		if (finished) break;
 
-			//Process main data
-			for(int i = 0 ; i < 2 * n_main_samples ; i += 2) {
-				bool a0 = (bcf_gt_allele(gt_arr_main[i+0])==1);
-				bool a1 = (bcf_gt_allele(gt_arr_main[i+1])==1);
-				bool mi = (gt_arr_main[i+0] == bcf_gt_missing || gt_arr_main[i+1] == bcf_gt_missing);
-				bool he = !mi && a0 != a1;
-				bool ho = !mi && a0 == a1;
-				if (a0) VAR_SET_HAP0(MOD2(i_variant_kept), G.vecG[DIV2(i)]->Variants[DIV2(i_variant_kept)]);
-				if (a1) VAR_SET_HAP1(MOD2(i_variant_kept), G.vecG[DIV2(i)]->Variants[DIV2(i_variant_kept)]);
-				if (mi) VAR_SET_MIS(MOD2(i_variant_kept), G.vecG[DIV2(i)]->Variants[DIV2(i_variant_kept)]);
-				if (he) VAR_SET_HET(MOD2(i_variant_kept), G.vecG[DIV2(i)]->Variants[DIV2(i_variant_kept)]);
-				if (mi) {
-					V.vec_pos[i_variant_kept]->cmis++;
-					n_genotypes[3] ++;
-				} else {
-					V.vec_pos[i_variant_kept]->cref += (1-a0)+(1-a1);
-					V.vec_pos[i_variant_kept]->calt += a0+a1;
-					n_genotypes[a0+a1] ++;
-				}
+		genotype_batch & B = pipe_slots[pipe_consumed % pipe_slots.size()];
+		P.run(n_ranges, [this, &B, n_ranges] (int id_worker, int id_job) { decodeGenotypes(B, id_job, n_ranges); });
+		for (int r = 0 ; r < n_ranges ; r ++) {
+			for (int g = 0 ; g < 5 ; g ++) n_genotypes[g] += pipe_counts[r][g];
+			for (unsigned int v = 0 ; v < B.size ; v ++) {
+				V.vec_pos[B.first + v]->cref += pipe_counts[r][5 + 3 * v + 0];
+				V.vec_pos[B.first + v]->calt += pipe_counts[r][5 + 3 * v + 1];
+				V.vec_pos[B.first + v]->cmis += pipe_counts[r][5 + 3 * v + 2];
 			}
+		}
+		vrb.progress("  * VCF/BCF parsing", (B.first + B.size) * 1.0 / n_variants);
 
-			//Process reference data
-			if (panels[1]) {
-				for(int i = 0 ; i < 2 * n_ref_samples ; i += 2) {
-					bool a0 = (bcf_gt_allele(gt_arr_ref[i+0])==1);
-					bool a1 = (bcf_gt_allele(gt_arr_ref[i+1])==1);
-					if (gt_arr_ref[i+0] == bcf_gt_missing || gt_arr_ref[i+1] == bcf_gt_missing) vrb.error("Missing genotype(s) in reference panel");
-					if (!bcf_gt_is_phased(gt_arr_ref[i+1])) vrb.error("Unphased genotype(s) in reference panel");
-					H.H_opt_hap.set(i+2*n_main_samples+0, i_variant_kept, a0);
-					H.H_opt_hap.set(i+2*n_main_samples+1, i_variant_kept, a1);
-					V.vec_pos[i_variant_kept]->cref += (1-a0)+(1-a1);
-					V.vec_pos[i_variant_kept]->calt += a0+a1;
-				}
-			}
+		pthread_mutex_lock(&pipe_mutex);
+		pipe_consumed ++;
+		pthread_cond_signal(&pipe_cond_empty);
+		pthread_mutex_unlock(&pipe_mutex);
+	}
+	pthread_join(id_producer, NULL);
 
-			//Process scaffold data
-			if (panels[2] && line_scaf) {
-				for(int i = 0 ; i < 2 * n_scaf_samples ; i += 2) {
-					int ind = mappingS2M[DIV2(i)];
-					if (ind >= 0) {
-						bool sa0 = (bcf_gt_allele(gt_arr_scaf[i+0])==1);
-						bool sa1 = (bcf_gt_allele(gt_arr_scaf[i+1])==1);
-						bool sph = (bcf_gt_is_phased(gt_arr_scaf[i+0]) || bcf_gt_is_phased(gt_arr_scaf[i+1]));
-						bool smi = (gt_arr_scaf[i+0] == bcf_gt_missing || gt_arr_scaf[i+1] == bcf_gt_missing);
-						if ((sa0 != sa1) && !smi && sph && VAR_GET_HET(MOD2(i_variant_kept), G.vecG[ind]->Variants[DIV2(i_variant_kept)])) {
-							VAR_SET_SCA(MOD2(i_variant_kept), G.vecG[ind]->Variants[DIV2(i_variant_kept)]);
-							sa0?VAR_SET_HAP0(MOD2(i_variant_kept), G.vecG[ind]->Variants[DIV2(i_variant_kept)]):VAR_CLR_HAP0(MOD2(i_variant_kept), G.vecG[ind]->Variants[DIV2(i_variant_kept)]);
-							sa1?VAR_SET_HAP1(MOD2(i_variant_kept), G.vecG[ind]->Variants[DIV2(i_variant_kept)]):VAR_CLR_HAP1(MOD2(i_variant_kept), G.vecG[ind]->Variants[DIV2(i_variant_kept)]);
-							n_genotypes[4] ++;
-						}
-					}
-				}
-			}
-			vrb.progress("  * VCF/BCF parsing", i_variant_kept * 1.0 / n_variants);
-			i_variant_kept ++;
-		}
-		i_variant_total++;
+	//Clean up
+	pthread_mutex_destroy(&pipe_mutex);
+	pthread_cond_destroy(&pipe_cond_full);
+	pthread_cond_destroy(&pipe_cond_empty);
+	for (int b = 0 ; b < PIPE_SLOTS ; b ++) for (unsigned int v = 0 ; v < batch_size ; v ++) {
+		free(pipe_slots[b].gt_main[v]);
+		free(pipe_slots[b].gt_ref[v]);
+		free(pipe_slots[b].gt_scaf[v]);
 	}
-	free(gt_arr_main);
-	if (panels[1]) free(gt_arr_ref);
-	if (panels[2]) free(gt_arr_scaf);
+	pipe_slots.clear();
+	pipe_counts.clear();
 	bcf_sr_destroy(sr);
 
 	// Report
@@ -28,12 +28,16 @@ graph_writer::graph_writer(genotype_set & _G, variant_map & _V): G(_G), V(_V) {
 graph_writer::~graph_writer() {
 }
 
-void graph_writer::binary_write(output_file & fout, const vector<bool> & x) {
-	vector<bool>::size_type n = x.size();
+void graph_writer::binary_write(output_file & fout, genotype * g) {
+	vector<bool>::size_type n = g->n_storage_events?g->n_transitions:0;
+	unsigned int iidx = 0, trel = 0, tnext = g->n_stored_transitionProbs?g->nextStoredTransition(iidx, PINDEX_NONE):PINDEX_NONE;
 	fout.write((const char*)&n, sizeof(std::vector<bool>::size_type));
 	for(std::vector<bool>::size_type i = 0; i < n;) {
 		unsigned char aggr = 0;
-		for(unsigned char mask = 1; mask > 0 && i < n; ++i, mask <<= 1) if(x.at(i)) aggr |= mask;
+		for(unsigned char mask = 1; mask > 0 && i < n; ++i, mask <<= 1) if(i == tnext) {
+			aggr |= mask;
+			tnext = (++trel < g->n_stored_transitionProbs)?g->nextStoredTransition(iidx, tnext):PINDEX_NONE;
+		}
 		fout.write((const char*)&aggr, sizeof(unsigned char));
     }
 }
@@ -81,7 +85,7 @@ void graph_writer::writeGraphs(string fname) {
 		fd.write(reinterpret_cast<char*>(&G.vecG[g]->Ambiguous[0]), G.vecG[g]->Ambiguous.size());
 		fd.write(reinterpret_cast<char*>(&G.vecG[g]->Diplotypes[0]), G.vecG[g]->Diplotypes.size() * sizeof(unsigned long));
 		fd.write(reinterpret_cast<char*>(&G.vecG[g]->Lengths[0]), G.vecG[g]->Lengths.size() * sizeof(unsigned short));
-		binary_write(fd, G.vecG[g]->ProbMask);
+		binary_write(fd, G.vecG[g]);
 		fd.write(reinterpret_cast<char*>(&G.vecG[g]->ProbStored[0]), G.vecG[g]->ProbStored.size() * sizeof(float));
 		fd.write(reinterpret_cast<char*>(&G.vecG[g]->ProbMissing[0]), G.vecG[g]->ProbMissing.size() * sizeof(float));
 	}
@@ -39,7 +39,7 @@ public:
 	~graph_writer();
 
 	//ROUTINES
-	void binary_write(output_file & fout, const vector<bool> & x);
+	void binary_write(output_file & fout, genotype * g);
 	void string_write(output_file & fout, string & x);
 
 	//IO
@@ -27,13 +27,29 @@
 #define OFILE_VCFC	1
 #define OFILE_BCFC	2
 
-haplotype_writer::haplotype_writer(haplotype_set & _H, genotype_set & _G, variant_map & _V, int _nthreads): H(_H), G(_G), V(_V) {
-	nthreads = _nthreads;
+//Maximum number of GT values held by the records of a block built in parallel
+#define OBLOCK_GTS	(1UL << 27)
+
+haplotype_writer::haplotype_writer(haplotype_set & _H, genotype_set & _G, variant_map & _V, thread_pool & _pool): pool(_pool), H(_H), G(_G), V(_V) {
 }
 
 haplotype_writer::~haplotype_writer() {
 }
 
+void haplotype_writer::buildRecord(bcf_hdr_t * hdr, bcf1_t * rec, int l, int * genotypes) {
+	bcf_clear1(rec);
+	rec->rid = bcf_hdr_name2id(hdr, V.vec_pos[l]->chr.c_str());
+	rec->pos = V.vec_pos[l]->bp - 1;
+	bcf_update_id(hdr, rec, V.vec_pos[l]->id.c_str());
+	string alleles = V.vec_pos[l]->ref + "," + V.vec_pos[l]->alt;
+	bcf_update_alleles_str(hdr, rec, alleles.c_str());
+	int count_alt = H.H_opt_var.expandRow(l, 2 * G.n_ind, genotypes, bcf_gt_phased(0), bcf_gt_phased(1));
+	int count_tot = H.n_hap;
+	bcf_update_info_int32(hdr, rec, "AC", &count_alt, 1);
+	bcf_update_info_int32(hdr, rec, "AN", &count_tot, 1);
+	bcf_update_genotypes(hdr, rec, genotypes, bcf_hdr_nsamples(hdr)*2);
+}
+
 void haplotype_writer::writeHaplotypes(string fname) {
 	// Init
 	tac.clock();
@@ -42,9 +58,8 @@ void haplotype_writer::writeHaplotypes(string fname) {
 	if (fname.size() > 6 && fname.substr(fname.size()-6) == "vcf.gz") { file_format = "wz"; file_type = OFILE_VCFC; }
 	if (fname.size() > 3 && fname.substr(fname.size()-3) == "bcf") { file_format = "wb"; file_type = OFILE_BCFC; }
 	htsFile * fp = hts_open(fname.c_str(),file_format.c_str());
-	if (nthreads > 1) hts_set_threads(fp, nthreads);
+	if (pool.size() > 1) hts_set_threads(fp, pool.size());
 	bcf_hdr_t * hdr = bcf_hdr_init("w");
-	bcf1_t *rec = bcf_init1();
 
 	// Create VCF header
 	bcf_hdr_append(hdr, string("##fileDate="+tac.date()).c_str());
@@ -59,31 +74,18 @@ void haplotype_writer::writeHaplotypes(string fname) {
 	bcf_hdr_add_sample(hdr, NULL);      // to update internal structures
 	if (bcf_hdr_write(fp, hdr) < 0) vrb.error("Failing to write VCF/header");
 
-	//Add records
-	int * genotypes = (int*)malloc(bcf_hdr_nsamples(hdr)*2*sizeof(int));
-	for (int l = 0 ; l < V.size() ; l ++) {
-		bcf_clear1(rec);
-		rec->rid = bcf_hdr_name2id(hdr, V.vec_pos[l]->chr.c_str());
-		rec->pos = V.vec_pos[l]->bp - 1;
-		bcf_update_id(hdr, rec, V.vec_pos[l]->id.c_str());
-		string alleles = V.vec_pos[l]->ref + "," + V.vec_pos[l]->alt;
-		bcf_update_alleles_str(hdr, rec, alleles.c_str());
-		int count_alt = 0, count_tot = H.n_hap;
-		for (int i = 0 ; i < G.n_ind ; i++) {
-			bool a0 = H.H_opt_var.get(l, 2*i+0);
-			bool a1 = H.H_opt_var.get(l, 2*i+1);
-			count_alt += a0+a1;
-			genotypes[2*i+0] = bcf_gt_phased(a0);
-			genotypes[2*i+1] = bcf_gt_phased(a1);
-		}
-		bcf_update_info_int32(hdr, rec, "AC", &count_alt, 1);
-		bcf_update_info_int32(hdr, rec, "AN", &count_tot, 1);
-		bcf_update_genotypes(hdr, rec, genotypes, bcf_hdr_nsamples(hdr)*2);
-		if (bcf_write1(fp, hdr, rec) < 0) vrb.error("Failing to write VCF/record");
-		vrb.progress("  * VCF writing", (l+1)*1.0/V.size());
+	//Add records: blocks of variants are built in parallel, then written in order
+	int n_block = max(4 * pool.size(), (int)min(1024UL, OBLOCK_GTS / (2UL * G.n_ind)));
+	vector < bcf1_t * > records = vector < bcf1_t * > (n_block);
+	for (int r = 0 ; r < n_block ; r ++) records[r] = bcf_init1();
+	vector < vector < int > > genotypes = vector < vector < int > > (pool.size(), vector < int > (bcf_hdr_nsamples(hdr)*2));
+	for (int l0 = 0 ; l0 < V.size() ; l0 += n_block) {
+		int n_rec = min(n_block, V.size() - l0);
+		pool.run(n_rec, [this, hdr, l0, &records, &genotypes] (int id_worker, int id_job) { buildRecord(hdr, records[id_job], l0 + id_job, genotypes[id_worker].data()); });
+		for (int r = 0 ; r < n_rec ; r ++) if (bcf_write1(fp, hdr, records[r]) < 0) vrb.error("Failing to write VCF/record");
+		vrb.progress("  * VCF writing", (l0+n_rec)*1.0/V.size());
 	}
-	free(genotypes);
-	bcf_destroy1(rec);
+	for (int r = 0 ; r < n_block ; r ++) bcf_destroy1(records[r]);
 	bcf_hdr_destroy(hdr);
 	if (hts_close(fp)) vrb.error("Non zero status when closing VCF/BCF file descriptor");
 	switch (file_type) {
@@ -24,6 +24,7 @@
 #define _HAPLOTYPE_WRITER_H
 
 #include <utils/otools.h>
+#include <utils/thread_pool.h>
 
 #include <containers/variant_map.h>
 #include <containers/haplotype_set.h>
@@ -33,16 +34,17 @@
 class haplotype_writer {
 public:
 	//DATA
-	int nthreads;
+	thread_pool & pool;
 	haplotype_set & H;
 	genotype_set & G;
 	variant_map & V;
 
 	//CONSTRUCTORS/DESCTRUCTORS
-	haplotype_writer(haplotype_set &, genotype_set &, variant_map &, int);
+	haplotype_writer(haplotype_set &, genotype_set &, variant_map &, thread_pool &);
 	~haplotype_writer();
 
 	//IO
+	void buildRecord(bcf_hdr_t *, bcf1_t *, int, int *);
 	void writeHaplotypes(string foutput);
 };
 
@@ -22,7 +22,7 @@
 
 #include <models/haplotype_segment_double.h>
 
-haplotype_segment_double::haplotype_segment_double(genotype * _G, bitmatrix & H, vector < unsigned int > & idxH, window & W, hmm_parameters & _M) : G(_G), M(_M){
+haplotype_segment_double::haplotype_segment_double(genotype * _G, bitmatrix & H, vector < unsigned int > & idxH, const vector < float > & _Kweights, window & W, hmm_parameters & _M, unsigned long max_alpha_bytes) : G(_G), Kweights(_Kweights), M(_M){
 	segment_first = W.start_segment;
 	segment_last = W.stop_segment;
 	locus_first = W.start_locus;
@@ -34,19 +34,54 @@ haplotype_segment_double::haplotype_segment_double(genotype * _G, bitmatrix & H,
 	transition_first = W.start_transition;
 	transition_last = W.stop_transition;
 	n_cond_haps = idxH.size();
+	n_total_haps = 0;
+	for (int k = 0 ; k < Kweights.size() ; k ++) n_total_haps += Kweights[k];
 	n_missing = missing_last - missing_first + 1;
+	avx512 = simd_has_avx512();
 
 	probSumT = 0.0f;
-	prob = aligned_vector32 < double > (HAP_NUMBER * n_cond_haps, 0.0f);
-	probSumH = aligned_vector32 < double > (HAP_NUMBER, 0.0f);
-	probSumK = aligned_vector32 < double > (n_cond_haps, 0.0f);
-	Alpha = vector < aligned_vector32 < double > > (segment_last - segment_first + 1, aligned_vector32 < double > (HAP_NUMBER * n_cond_haps, 0.0f));
-	AlphaLocus = vector < int > (segment_last - segment_first + 1, 0);
-	AlphaSum = vector < aligned_vector32 < double > > (segment_last - segment_first + 1, aligned_vector32 < double > (HAP_NUMBER, 0.0f));
-	AlphaSumSum = aligned_vector32 < double > (segment_last - segment_first + 1, 0.0);
-	if (n_missing > 0) {
-		AlphaMissing = vector < aligned_vector32 < double > > (n_missing, aligned_vector32 < double > (HAP_NUMBER * n_cond_haps, 0.0f));
-		AlphaSumMissing = vector < aligned_vector32 < double > > (n_missing, aligned_vector32 < double > (HAP_NUMBER, 0.0f));
+	prob = aligned_vector64 < double > (HAP_NUMBER * n_cond_haps, 0.0f);
+	probSumH = aligned_vector64 < double > (HAP_NUMBER, 0.0f);
+	probSumK = aligned_vector64 < double > (n_cond_haps, 0.0f);
+
+	//Checkpointing when storing all forward probabilities would exceed the memory budget
+	unsigned int n_segments = segment_last - segment_first + 1;
+	unsigned long alpha_bytes = (n_segments + n_missing) * (HAP_NUMBER * n_cond_haps + HAP_NUMBER + 1UL) * sizeof(float);
+	checkpoint_size = (max_alpha_bytes && alpha_bytes > max_alpha_bytes)?(unsigned int)ceil(sqrt(n_segments)):0;
+	alpha_offset = 0;
+	missing_offset = 0;
+	loaded_block = -1;
+	unsigned int n_alphas = n_segments, n_alphas_missing = n_missing;
+	if (checkpoint_size) {
+		unsigned int n_blocks = (n_segments + checkpoint_size - 1) / checkpoint_size;
+		CheckAlpha = vector < aligned_vector64 < double > > (n_blocks, aligned_vector64 < double > (HAP_NUMBER * n_cond_haps, 0.0f));
+		CheckAlphaSum = vector < aligned_vector64 < double > > (n_blocks, aligned_vector64 < double > (HAP_NUMBER, 0.0f));
+		CheckAlphaSumSum = aligned_vector64 < double > (n_blocks, 0.0f);
+		CheckLocus = vector < int > (n_blocks, locus_first);
+		CheckAlphaLocus = vector < int > (n_blocks, locus_first);
+		CheckAmbiguous = vector < int > (n_blocks, ambiguous_first);
+		CheckMissing = vector < int > (n_blocks, missing_first);
+		probBackward = aligned_vector64 < double > (HAP_NUMBER * n_cond_haps, 0.0f);
+		probSumHBackward = aligned_vector64 < double > (HAP_NUMBER, 0.0f);
+		probSumKBackward = aligned_vector64 < double > (n_cond_haps, 0.0f);
+		//A block holds the forward probabilities of its segments, plus those of the segment preceding it
+		n_alphas = checkpoint_size + 1;
+		n_alphas_missing = 0;
+		for (unsigned int b = 0, s = 0, l = locus_first ; b < n_blocks ; b ++) {
+			unsigned int n_mis_block = 0;
+			for (unsigned int e = min(n_segments, (b + 1) * checkpoint_size) ; s < e ; s ++)
+				for (unsigned int vrel = 0 ; vrel < G->Lengths[segment_first + s] ; vrel ++, l ++)
+					n_mis_block += VAR_GET_MIS(MOD2(l), G->Variants[DIV2(l)]);
+			n_alphas_missing = max(n_alphas_missing, n_mis_block);
+		}
+	}
+	Alpha = vector < aligned_vector64 < double > > (n_alphas, aligned_vector64 < double > (HAP_NUMBER * n_cond_haps, 0.0f));
+	AlphaLocus = vector < int > (n_alphas, 0);
+	AlphaSum = vector < aligned_vector64 < double > > (n_alphas, aligned_vector64 < double > (HAP_NUMBER, 0.0f));
+	AlphaSumSum = aligned_vector64 < double > (n_alphas, 0.0);
+	if (n_alphas_missing > 0) {
+		AlphaMissing = vector < aligned_vector64 < double > > (n_alphas_missing, aligned_vector64 < double > (HAP_NUMBER * n_cond_haps, 0.0f));
+		AlphaSumMissing = vector < aligned_vector64 < double > > (n_alphas_missing, aligned_vector64 < double > (HAP_NUMBER, 0.0f));
 	}
 	//Cache efficient data transfer for conditioning haplotypes
 	curr_rel_locus_offset = Hhap.subset(H, idxH, locus_first, locus_last);
@@ -77,16 +112,55 @@ haplotype_segment_double::~haplotype_segment_double() {
 	Alpha.clear();
 	AlphaSum.clear();
 	AlphaSumSum.clear();
+	CheckAlpha.clear();
+	CheckAlphaSum.clear();
+	CheckAlphaSumSum.clear();
 }
 
 void haplotype_segment_double::forward() {
 	curr_segment_index = segment_first;
 	curr_segment_locus = 0;
+	curr_abs_locus = locus_first;
 	curr_abs_ambiguous = ambiguous_first;
 	curr_abs_missing = missing_first;
 	prev_abs_locus = locus_first;
+	if (checkpoint_size) {
+		//Only keep the state at block boundaries, blocks are recomputed when backward reaches them
+		loaded_block = -1;
+		sweepForward(locus_last, false);
+	} else sweepForward(locus_last, true);
+}
+
+void haplotype_segment_double::forward(int block) {
+	unsigned int n_segments = segment_last - segment_first + 1;
+	unsigned int block_first = block * checkpoint_size;
+	unsigned int block_last = min(n_segments, block_first + checkpoint_size) - 1;
+
+	//Restore state at the start of the block; the segment preceding the block goes in the first slot
+	curr_segment_index = segment_first + block_first;
+	curr_segment_locus = 0;
+	curr_abs_locus = CheckLocus[block];
+	curr_abs_ambiguous = CheckAmbiguous[block];
+	curr_abs_missing = CheckMissing[block];
+	prev_abs_locus = CheckAlphaLocus[block];
+	alpha_offset = block_first - 1;
+	missing_offset = CheckMissing[block] - missing_first;
+	if (block > 0) {
+		prob = CheckAlpha[block];
+		probSumH = CheckAlphaSum[block];
+		probSumT = CheckAlphaSumSum[block];
+		SUMK();
+		Alpha[0] = prob;
+		AlphaSum[0] = probSumH;
+		AlphaSumSum[0] = probSumT;
+		AlphaLocus[0] = prev_abs_locus;
+	}
+	sweepForward((block_last == n_segments - 1)?locus_last:(CheckLocus[block + 1] - 1), true);
+	loaded_block = block;
+}
 
-	for (curr_abs_locus = locus_first ; curr_abs_locus <= locus_last ; curr_abs_locus++) {
+void haplotype_segment_double::sweepForward(int locus_stop, bool store) {
+	for ( ; curr_abs_locus <= locus_stop ; curr_abs_locus++) {
 		curr_rel_locus = curr_abs_locus - locus_first;
 		curr_rel_missing = curr_abs_missing - missing_first;
 		bool update_prev_locus = true;
@@ -94,6 +168,20 @@ void haplotype_segment_double::forward() {
 		bool amb = VAR_GET_AMB(MOD2(curr_abs_locus), G->Variants[DIV2(curr_abs_locus)]);
 		bool mis = VAR_GET_MIS(MOD2(curr_abs_locus), G->Variants[DIV2(curr_abs_locus)]);
 		bool hom = !(amb || mis);
+
+		//Checkpoint: state at the end of the segment preceding a block
+		int curr_rel_segment_index = curr_segment_index - segment_first;
+		if (!store && curr_segment_locus == 0 && curr_rel_segment_index > 0 && (curr_rel_segment_index % checkpoint_size) == 0) {
+			int block = curr_rel_segment_index / checkpoint_size;
+			CheckAlpha[block] = prob;
+			CheckAlphaSum[block] = probSumH;
+			CheckAlphaSumSum[block] = probSumT;
+			CheckAlphaLocus[block] = prev_abs_locus;
+			CheckLocus[block] = curr_abs_locus;
+			CheckAmbiguous[block] = curr_abs_ambiguous;
+			CheckMissing[block] = curr_abs_missing;
+		}
+
 		yt = (curr_abs_locus == locus_first)?0.0:M.getForwardTransProb(prev_abs_locus, curr_abs_locus);
 		nt = 1.0f - yt;
 
@@ -113,15 +201,17 @@ void haplotype_segment_double::forward() {
 		prev_abs_locus=update_prev_locus?curr_abs_locus:prev_abs_locus;
 
 		if (curr_segment_locus == (G->Lengths[curr_segment_index] - 1)) SUMK();
-		if (curr_segment_locus == G->Lengths[curr_segment_index] - 1) {
-			Alpha[curr_segment_index - segment_first] = prob;
-			AlphaSum[curr_segment_index - segment_first] = probSumH;
-			AlphaSumSum[curr_segment_index - segment_first] = probSumT;
-			AlphaLocus[curr_segment_index - segment_first] = prev_abs_locus;
+		if (store && curr_segment_locus == G->Lengths[curr_segment_index] - 1) {
+			Alpha[curr_rel_segment_index - alpha_offset] = prob;
+			AlphaSum[curr_rel_segment_index - alpha_offset] = probSumH;
+			AlphaSumSum[curr_rel_segment_index - alpha_offset] = probSumT;
+			AlphaLocus[curr_rel_segment_index - alpha_offset] = prev_abs_locus;
 		}
 		if (mis) {
-			AlphaMissing[curr_rel_missing] = prob;
-			AlphaSumMissing[curr_rel_missing] = probSumH;
+			if (store) {
+				AlphaMissing[curr_rel_missing - missing_offset] = prob;
+				AlphaSumMissing[curr_rel_missing - missing_offset] = probSumH;
+			}
 			curr_abs_missing ++;
 		}
 
@@ -134,6 +224,25 @@ void haplotype_segment_double::forward() {
 	}
 }
 
+void haplotype_segment_double::recompute(int block) {
+	//Forward recomputation runs in the middle of backward: keep the backward state aside
+	int _curr_segment_index = curr_segment_index, _curr_segment_locus = curr_segment_locus, _curr_abs_locus = curr_abs_locus;
+	int _prev_abs_locus = prev_abs_locus, _curr_abs_ambiguous = curr_abs_ambiguous, _curr_abs_missing = curr_abs_missing;
+	double _probSumT = probSumT;
+	prob.swap(probBackward);
+	probSumH.swap(probSumHBackward);
+	probSumK.swap(probSumKBackward);
+
+	forward(block);
+
+	prob.swap(probBackward);
+	probSumH.swap(probSumHBackward);
+	probSumK.swap(probSumKBackward);
+	probSumT = _probSumT;
+	curr_segment_index = _curr_segment_index; curr_segment_locus = _curr_segment_locus; curr_abs_locus = _curr_abs_locus;
+	prev_abs_locus = _prev_abs_locus; curr_abs_ambiguous = _curr_abs_ambiguous; curr_abs_missing = _curr_abs_missing;
+}
+
 int haplotype_segment_double::backward(vector < double > & transition_probabilities, vector < float > & missing_probabilities) {
 	int n_underflow_recovered = 0;
 	curr_segment_index = segment_last;
@@ -144,6 +253,7 @@ int haplotype_segment_double::backward(vector < double > & transition_probabilit
 	prev_abs_locus = locus_last;
 
 	for (curr_abs_locus = locus_last ; curr_abs_locus >= locus_first ; curr_abs_locus--) {
+		if (checkpoint_size && (curr_segment_index - segment_first) / checkpoint_size != loaded_block) recompute((curr_segment_index - segment_first) / checkpoint_size);
 		curr_rel_locus = curr_abs_locus - locus_first;
 		curr_rel_missing = curr_abs_missing - missing_first;
 		char rare_allele = M.rare_allele[curr_abs_locus];
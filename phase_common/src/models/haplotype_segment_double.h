@@ -27,7 +27,7 @@
 #include <objects/compute_job.h>
 #include <objects/hmm_parameters.h>
 
-#include <immintrin.h>
+#include <models/simd_dispatch.h>
 #include <boost/align/aligned_allocator.hpp>
 
 template <typename T>
@@ -38,6 +38,7 @@ private:
 	//EXTERNAL DATA
 	hmm_parameters & M;
 	genotype * G;
+	const vector < float > & Kweights;
 	bitmatrix Hhap, Hvar;
 
 	//COORDINATES & CONSTANTS
@@ -52,6 +53,7 @@ private:
 	int transition_first;
 	int transition_last;
 	unsigned int n_cond_haps;
+	double n_total_haps;						// Number of conditioning haplotypes, counting identical ones collapsed into a state
 	unsigned int n_missing;
 
 	//CURSORS
@@ -69,15 +71,31 @@ private:
 
 	//DYNAMIC ARRAYS
 	double probSumT;
-	aligned_vector32 < double > prob;
-	aligned_vector32 < double > probSumK;
-	aligned_vector32 < double > probSumH;
-	vector < aligned_vector32 < double > > Alpha;
-	vector < aligned_vector32 < double > > AlphaSum;
+	aligned_vector64 < double > prob;
+	aligned_vector64 < double > probSumK;
+	aligned_vector64 < double > probSumH;
+	vector < aligned_vector64 < double > > Alpha;
+	vector < aligned_vector64 < double > > AlphaSum;
 	vector < int > AlphaLocus;
-	aligned_vector32 < double > AlphaSumSum;
-	vector < aligned_vector32 < double > > AlphaMissing;
-	vector < aligned_vector32 < double > > AlphaSumMissing;
+	aligned_vector64 < double > AlphaSumSum;
+	vector < aligned_vector64 < double > > AlphaMissing;
+	vector < aligned_vector64 < double > > AlphaSumMissing;
+
+	//CHECKPOINTING [forward probabilities stored every checkpoint_size segments only]
+	unsigned int checkpoint_size;			// Number of segments per block, 0 when all forward probabilities are stored
+	int alpha_offset;						// Relative index of the segment stored in Alpha[0]
+	int missing_offset;						// Relative index of the missing site stored in AlphaMissing[0]
+	int loaded_block;						// Block whose forward probabilities are in Alpha
+	vector < aligned_vector64 < double > > CheckAlpha;
+	vector < aligned_vector64 < double > > CheckAlphaSum;
+	aligned_vector64 < double > CheckAlphaSumSum;
+	vector < int > CheckAlphaLocus;
+	vector < int > CheckLocus;
+	vector < int > CheckAmbiguous;
+	vector < int > CheckMissing;
+	aligned_vector64 < double > probBackward;
+	aligned_vector64 < double > probSumHBackward;
+	aligned_vector64 < double > probSumKBackward;
 	double HProbs [HAP_NUMBER * HAP_NUMBER] __attribute__ ((aligned(32)));
 	double DProbs [HAP_NUMBER * HAP_NUMBER * HAP_NUMBER * HAP_NUMBER] __attribute__ ((aligned(32)));
 
@@ -86,6 +104,7 @@ private:
 	double sumDProbs;
 	double g0[HAP_NUMBER], g1[HAP_NUMBER];
 	double nt, yt;
+	bool avx512;
 
 	//INLINED AND UNROLLED ROUTINES
 	void INIT_HOM();
@@ -104,10 +123,25 @@ private:
 	bool TRANS_DIP_ADD();
 	void SET_FIRST_TRANS(vector < double > & );
 	int SET_OTHER_TRANS(vector < double > & );
+	void sweepForward(int, bool);
+	void forward(int);
+	void recompute(int);
+
+#ifdef SIMD_AVX512_DISPATCH
+	//AVX-512 VERSIONS, SELECTED AT RUNTIME
+	void INIT_HOM_AVX512();
+	void INIT_AMB_AVX512();
+	bool RUN_HOM_AVX512(char);
+	void RUN_AMB_AVX512();
+	void RUN_MIS_AVX512();
+	void COLLAPSE_HOM_AVX512();
+	void COLLAPSE_AMB_AVX512();
+	void COLLAPSE_MIS_AVX512();
+#endif
 
 public:
 	//CONSTRUCTOR/DESTRUCTOR
-	haplotype_segment_double(genotype *, bitmatrix &, vector < unsigned int > &, window &, hmm_parameters &);
+	haplotype_segment_double(genotype *, bitmatrix &, vector < unsigned int > &, const vector < float > &, window &, hmm_parameters &, unsigned long max_alpha_bytes = 0);
 	~haplotype_segment_double();
 
 	//void fetch();
@@ -121,53 +155,55 @@ public:
 
 inline
 void haplotype_segment_double::INIT_HOM() {
+	AVX512_DISPATCH(INIT_HOM_AVX512());
 	bool ag = VAR_GET_HAP0(MOD2(curr_abs_locus), G->Variants[DIV2(curr_abs_locus)]);
-	__m256d _sum0 = _mm256_set1_pd(0.0f);
-	__m256d _sum1 = _mm256_set1_pd(0.0f);
+	simd_f64x4 _sum0 = simd_zero_f64();
+	simd_f64x4 _sum1 = simd_zero_f64();
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-		__m256d _prob0 = _mm256_set1_pd((ag==ah)?1.0f:M.ed/M.ee);
-		__m256d _prob1 = _mm256_set1_pd((ag==ah)?1.0f:M.ed/M.ee);
-		_sum0 = _mm256_add_pd(_sum0, _prob0);
-		_sum1 = _mm256_add_pd(_sum1, _prob1);
-		_mm256_store_pd(&prob[i+0], _prob0);
-		_mm256_store_pd(&prob[i+4], _prob1);
+		simd_f64x4 _prob0 = simd_set1_f64((ag==ah)?1.0f:M.ed/M.ee);
+		simd_f64x4 _prob1 = simd_set1_f64((ag==ah)?1.0f:M.ed/M.ee);
+		_sum0 = simd_fmadd(_prob0, simd_set1_f64(Kweights[k]), _sum0);
+		_sum1 = simd_fmadd(_prob1, simd_set1_f64(Kweights[k]), _sum1);
+		simd_store(&prob[i+0], _prob0);
+		simd_store(&prob[i+4], _prob1);
 	}
-	_mm256_store_pd(&probSumH[0], _sum0);
-	_mm256_store_pd(&probSumH[4], _sum1);
+	simd_store(&probSumH[0], _sum0);
+	simd_store(&probSumH[4], _sum1);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
 inline
 bool haplotype_segment_double::RUN_HOM(char rare_allele) {
+	AVX512_DISPATCH(RUN_HOM_AVX512(rare_allele));
 	bool ag = VAR_GET_HAP0(MOD2(curr_abs_locus), G->Variants[DIV2(curr_abs_locus)]);
 	if (rare_allele < 0 || ag == rare_allele) {
-		__m256d _sum0 = _mm256_set1_pd(0.0f);
-		__m256d _sum1 = _mm256_set1_pd(0.0f);
-		__m256d _factor = _mm256_set1_pd(yt / (n_cond_haps * probSumT));
-		__m256d _tFreq0 = _mm256_load_pd(&probSumH[0]);
-		__m256d _tFreq1 = _mm256_load_pd(&probSumH[4]);
-		_tFreq0 = _mm256_mul_pd(_tFreq0, _factor);
-		_tFreq1 = _mm256_mul_pd(_tFreq1, _factor);
-		__m256d _nt = _mm256_set1_pd(nt / probSumT);
-		__m256d _mismatch = _mm256_set1_pd(M.ed/M.ee);
+		simd_f64x4 _sum0 = simd_zero_f64();
+		simd_f64x4 _sum1 = simd_zero_f64();
+		simd_f64x4 _factor = simd_set1_f64(yt / (n_total_haps * probSumT));
+		simd_f64x4 _tFreq0 = simd_load(&probSumH[0]);
+		simd_f64x4 _tFreq1 = simd_load(&probSumH[4]);
+		_tFreq0 = simd_mul(_tFreq0, _factor);
+		_tFreq1 = simd_mul(_tFreq1, _factor);
+		simd_f64x4 _nt = simd_set1_f64(nt / probSumT);
+		simd_f64x4 _mismatch = simd_set1_f64(M.ed/M.ee);
 		for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 			bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-			__m256d _prob0 = _mm256_load_pd(&prob[i]);
-			__m256d _prob1 = _mm256_load_pd(&prob[i+4]);
-			_prob0 = _mm256_fmadd_pd(_prob0, _nt, _tFreq0);
-			_prob1 = _mm256_fmadd_pd(_prob1, _nt, _tFreq1);
+			simd_f64x4 _prob0 = simd_load(&prob[i]);
+			simd_f64x4 _prob1 = simd_load(&prob[i+4]);
+			_prob0 = simd_fmadd(_prob0, _nt, _tFreq0);
+			_prob1 = simd_fmadd(_prob1, _nt, _tFreq1);
 			if (ag!=ah) {
-				_prob0 = _mm256_mul_pd(_prob0, _mismatch);
-				_prob1 = _mm256_mul_pd(_prob1, _mismatch);
+				_prob0 = simd_mul(_prob0, _mismatch);
+				_prob1 = simd_mul(_prob1, _mismatch);
 			}
-			_sum0 = _mm256_add_pd(_sum0, _prob0);
-			_sum1 = _mm256_add_pd(_sum1, _prob1);
-			_mm256_store_pd(&prob[i], _prob0);
-			_mm256_store_pd(&prob[i+4], _prob1);
+			_sum0 = simd_fmadd(_prob0, simd_set1_f64(Kweights[k]), _sum0);
+			_sum1 = simd_fmadd(_prob1, simd_set1_f64(Kweights[k]), _sum1);
+			simd_store(&prob[i], _prob0);
+			simd_store(&prob[i+4], _prob1);
 		}
-		_mm256_store_pd(&probSumH[0], _sum0);
-		_mm256_store_pd(&probSumH[4], _sum1);
+		simd_store(&probSumH[0], _sum0);
+		simd_store(&probSumH[4], _sum1);
 		probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 		return true;
 	}
@@ -176,29 +212,30 @@ bool haplotype_segment_double::RUN_HOM(char rare_allele) {
 
 inline
 void haplotype_segment_double::COLLAPSE_HOM() {
+	AVX512_DISPATCH(COLLAPSE_HOM_AVX512());
 	bool ag = VAR_GET_HAP0(MOD2(curr_abs_locus), G->Variants[DIV2(curr_abs_locus)]);
-	__m256d _sum0 = _mm256_set1_pd(0.0f);
-	__m256d _sum1 = _mm256_set1_pd(0.0f);
-	__m256d _tFreq = _mm256_set1_pd(yt / n_cond_haps);					//Check divide by probSumT here!
-	__m256d _nt = _mm256_set1_pd(nt / probSumT);
-	__m256d _mismatch = _mm256_set1_pd(M.ed/M.ee);
+	simd_f64x4 _sum0 = simd_zero_f64();
+	simd_f64x4 _sum1 = simd_zero_f64();
+	simd_f64x4 _tFreq = simd_set1_f64(yt / n_total_haps);					//Check divide by probSumT here!
+	simd_f64x4 _nt = simd_set1_f64(nt / probSumT);
+	simd_f64x4 _mismatch = simd_set1_f64(M.ed/M.ee);
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-		__m256d _prob0 = _mm256_set1_pd(probSumK[k]);
-		__m256d _prob1 = _mm256_set1_pd(probSumK[k]);
-		_prob0 = _mm256_fmadd_pd(_prob0, _nt, _tFreq);
-		_prob1 = _mm256_fmadd_pd(_prob1, _nt, _tFreq);
+		simd_f64x4 _prob0 = simd_set1_f64(probSumK[k]);
+		simd_f64x4 _prob1 = simd_set1_f64(probSumK[k]);
+		_prob0 = simd_fmadd(_prob0, _nt, _tFreq);
+		_prob1 = simd_fmadd(_prob1, _nt, _tFreq);
 		if (ag!=ah) {
-			_prob0 = _mm256_mul_pd(_prob0, _mismatch);
-			_prob1 = _mm256_mul_pd(_prob1, _mismatch);
+			_prob0 = simd_mul(_prob0, _mismatch);
+			_prob1 = simd_mul(_prob1, _mismatch);
 		}
-		_sum0 = _mm256_add_pd(_sum0, _prob0);
-		_sum1 = _mm256_add_pd(_sum1, _prob1);
-		_mm256_store_pd(&prob[i], _prob0);
-		_mm256_store_pd(&prob[i+4], _prob1);
+		_sum0 = simd_fmadd(_prob0, simd_set1_f64(Kweights[k]), _sum0);
+		_sum1 = simd_fmadd(_prob1, simd_set1_f64(Kweights[k]), _sum1);
+		simd_store(&prob[i], _prob0);
+		simd_store(&prob[i+4], _prob1);
 	}
-	_mm256_store_pd(&probSumH[0], _sum0);
-	_mm256_store_pd(&probSumH[4], _sum1);
+	simd_store(&probSumH[0], _sum0);
+	simd_store(&probSumH[4], _sum1);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
@@ -208,101 +245,104 @@ void haplotype_segment_double::COLLAPSE_HOM() {
 
 inline
 void haplotype_segment_double::INIT_AMB() {
+	AVX512_DISPATCH(INIT_AMB_AVX512());
 	unsigned char amb_code = G->Ambiguous[curr_abs_ambiguous];
 	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
 		g0[h] = HAP_GET(amb_code,h)?M.ed/M.ee:1.0f;
 		g1[h] = HAP_GET(amb_code,h)?1.0f:M.ed/M.ee;
 	}
-	__m256d _sum0 = _mm256_set1_pd(0.0f);
-	__m256d _sum1 = _mm256_set1_pd(0.0f);
-	__m256d _emit0[2], _emit1[2];
-	_emit0[0] = _mm256_loadu_pd(&g0[0]);
-	_emit0[1] = _mm256_loadu_pd(&g1[0]);
-	_emit1[0] = _mm256_loadu_pd(&g0[4]);
-	_emit1[1] = _mm256_loadu_pd(&g1[4]);
+	simd_f64x4 _sum0 = simd_zero_f64();
+	simd_f64x4 _sum1 = simd_zero_f64();
+	simd_f64x4 _emit0[2], _emit1[2];
+	_emit0[0] = simd_loadu(&g0[0]);
+	_emit0[1] = simd_loadu(&g1[0]);
+	_emit1[0] = simd_loadu(&g0[4]);
+	_emit1[1] = simd_loadu(&g1[4]);
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-		__m256d _prob0 = _emit0[ah];
-		__m256d _prob1 = _emit1[ah];
-		_sum0 = _mm256_add_pd(_sum0, _prob0);
-		_sum1 = _mm256_add_pd(_sum1, _prob1);
-		_mm256_store_pd(&prob[i], _prob0);
-		_mm256_store_pd(&prob[i+4], _prob1);
+		simd_f64x4 _prob0 = _emit0[ah];
+		simd_f64x4 _prob1 = _emit1[ah];
+		_sum0 = simd_fmadd(_prob0, simd_set1_f64(Kweights[k]), _sum0);
+		_sum1 = simd_fmadd(_prob1, simd_set1_f64(Kweights[k]), _sum1);
+		simd_store(&prob[i], _prob0);
+		simd_store(&prob[i+4], _prob1);
 	}
-	_mm256_store_pd(&probSumH[0], _sum0);
-	_mm256_store_pd(&probSumH[4], _sum1);
+	simd_store(&probSumH[0], _sum0);
+	simd_store(&probSumH[4], _sum1);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
 inline
 void haplotype_segment_double::RUN_AMB() {
+	AVX512_DISPATCH(RUN_AMB_AVX512());
 	unsigned char amb_code = G->Ambiguous[curr_abs_ambiguous];
 	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
 		g0[h] = HAP_GET(amb_code,h)?M.ed/M.ee:1.0f;
 		g1[h] = HAP_GET(amb_code,h)?1.0f:M.ed/M.ee;
 	}
-	__m256d _sum0 = _mm256_set1_pd(0.0f);
-	__m256d _sum1 = _mm256_set1_pd(0.0f);
-	__m256d _factor = _mm256_set1_pd(yt / (n_cond_haps * probSumT));
-	__m256d _tFreq0 = _mm256_load_pd(&probSumH[0]);
-	__m256d _tFreq1 = _mm256_load_pd(&probSumH[4]);
-	_tFreq0 = _mm256_mul_pd(_tFreq0, _factor);
-	_tFreq1 = _mm256_mul_pd(_tFreq1, _factor);
-	__m256d _nt = _mm256_set1_pd(nt / probSumT);
-	__m256d _emit0[2], _emit1[2];
-	_emit0[0] = _mm256_loadu_pd(&g0[0]);
-	_emit0[1] = _mm256_loadu_pd(&g1[0]);
-	_emit1[0] = _mm256_loadu_pd(&g0[4]);
-	_emit1[1] = _mm256_loadu_pd(&g1[4]);
+	simd_f64x4 _sum0 = simd_zero_f64();
+	simd_f64x4 _sum1 = simd_zero_f64();
+	simd_f64x4 _factor = simd_set1_f64(yt / (n_total_haps * probSumT));
+	simd_f64x4 _tFreq0 = simd_load(&probSumH[0]);
+	simd_f64x4 _tFreq1 = simd_load(&probSumH[4]);
+	_tFreq0 = simd_mul(_tFreq0, _factor);
+	_tFreq1 = simd_mul(_tFreq1, _factor);
+	simd_f64x4 _nt = simd_set1_f64(nt / probSumT);
+	simd_f64x4 _emit0[2], _emit1[2];
+	_emit0[0] = simd_loadu(&g0[0]);
+	_emit0[1] = simd_loadu(&g1[0]);
+	_emit1[0] = simd_loadu(&g0[4]);
+	_emit1[1] = simd_loadu(&g1[4]);
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-		__m256d _prob0 = _mm256_load_pd(&prob[i+0]);
-		__m256d _prob1 = _mm256_load_pd(&prob[i+4]);
-		_prob0 = _mm256_fmadd_pd(_prob0, _nt, _tFreq0);
-		_prob1 = _mm256_fmadd_pd(_prob1, _nt, _tFreq1);
-		_prob0 = _mm256_mul_pd(_prob0, _emit0[ah]);
-		_prob1 = _mm256_mul_pd(_prob1, _emit1[ah]);
-		_sum0 = _mm256_add_pd(_sum0, _prob0);
-		_sum1 = _mm256_add_pd(_sum1, _prob1);
-		_mm256_store_pd(&prob[i+0], _prob0);
-		_mm256_store_pd(&prob[i+4], _prob1);
+		simd_f64x4 _prob0 = simd_load(&prob[i+0]);
+		simd_f64x4 _prob1 = simd_load(&prob[i+4]);
+		_prob0 = simd_fmadd(_prob0, _nt, _tFreq0);
+		_prob1 = simd_fmadd(_prob1, _nt, _tFreq1);
+		_prob0 = simd_mul(_prob0, _emit0[ah]);
+		_prob1 = simd_mul(_prob1, _emit1[ah]);
+		_sum0 = simd_fmadd(_prob0, simd_set1_f64(Kweights[k]), _sum0);
+		_sum1 = simd_fmadd(_prob1, simd_set1_f64(Kweights[k]), _sum1);
+		simd_store(&prob[i+0], _prob0);
+		simd_store(&prob[i+4], _prob1);
 	}
-	_mm256_store_pd(&probSumH[0], _sum0);
-	_mm256_store_pd(&probSumH[4], _sum1);
+	simd_store(&probSumH[0], _sum0);
+	simd_store(&probSumH[4], _sum1);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
 inline
 void haplotype_segment_double::COLLAPSE_AMB() {
+	AVX512_DISPATCH(COLLAPSE_AMB_AVX512());
 	unsigned char amb_code = G->Ambiguous[curr_abs_ambiguous];
 	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
 		g0[h] = HAP_GET(amb_code,h)?M.ed/M.ee:1.0f;
 		g1[h] = HAP_GET(amb_code,h)?1.0f:M.ed/M.ee;
 	}
-	__m256d _sum0 = _mm256_set1_pd(0.0f);
-	__m256d _sum1 = _mm256_set1_pd(0.0f);
-	__m256d _tFreq = _mm256_set1_pd(yt / n_cond_haps);
-	__m256d _nt = _mm256_set1_pd(nt / probSumT);
-	__m256d _emit0[2], _emit1[2];
-	_emit0[0] = _mm256_loadu_pd(&g0[0]);
-	_emit0[1] = _mm256_loadu_pd(&g1[0]);
-	_emit1[0] = _mm256_loadu_pd(&g0[4]);
-	_emit1[1] = _mm256_loadu_pd(&g1[4]);
+	simd_f64x4 _sum0 = simd_zero_f64();
+	simd_f64x4 _sum1 = simd_zero_f64();
+	simd_f64x4 _tFreq = simd_set1_f64(yt / n_total_haps);
+	simd_f64x4 _nt = simd_set1_f64(nt / probSumT);
+	simd_f64x4 _emit0[2], _emit1[2];
+	_emit0[0] = simd_loadu(&g0[0]);
+	_emit0[1] = simd_loadu(&g1[0]);
+	_emit1[0] = simd_loadu(&g0[4]);
+	_emit1[1] = simd_loadu(&g1[4]);
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-		__m256d _prob0 = _mm256_set1_pd(probSumK[k]);
-		__m256d _prob1 = _mm256_set1_pd(probSumK[k]);
-		_prob0 = _mm256_fmadd_pd(_prob0, _nt, _tFreq);
-		_prob1 = _mm256_fmadd_pd(_prob1, _nt, _tFreq);
-		_prob0 = _mm256_mul_pd(_prob0, _emit0[ah]);
-		_prob1 = _mm256_mul_pd(_prob1, _emit1[ah]);
-		_sum0 = _mm256_add_pd(_sum0, _prob0);
-		_sum1 = _mm256_add_pd(_sum1, _prob1);
-		_mm256_store_pd(&prob[i+0], _prob0);
-		_mm256_store_pd(&prob[i+4], _prob1);
+		simd_f64x4 _prob0 = simd_set1_f64(probSumK[k]);
+		simd_f64x4 _prob1 = simd_set1_f64(probSumK[k]);
+		_prob0 = simd_fmadd(_prob0, _nt, _tFreq);
+		_prob1 = simd_fmadd(_prob1, _nt, _tFreq);
+		_prob0 = simd_mul(_prob0, _emit0[ah]);
+		_prob1 = simd_mul(_prob1, _emit1[ah]);
+		_sum0 = simd_fmadd(_prob0, simd_set1_f64(Kweights[k]), _sum0);
+		_sum1 = simd_fmadd(_prob1, simd_set1_f64(Kweights[k]), _sum1);
+		simd_store(&prob[i+0], _prob0);
+		simd_store(&prob[i+4], _prob1);
 	}
-	_mm256_store_pd(&probSumH[0], _sum0);
-	_mm256_store_pd(&probSumH[4], _sum1);
+	simd_store(&probSumH[0], _sum0);
+	simd_store(&probSumH[4], _sum1);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
@@ -312,54 +352,56 @@ void haplotype_segment_double::COLLAPSE_AMB() {
 
 inline
 void haplotype_segment_double::INIT_MIS() {
-	fill(prob.begin(), prob.end(), 1.0f/(HAP_NUMBER * n_cond_haps));
+	fill(prob.begin(), prob.end(), 1.0f/(HAP_NUMBER * n_total_haps));
 	fill(probSumH.begin(), probSumH.end(), 1.0f/HAP_NUMBER);
 	probSumT = 1.0f;
 }
 
 inline
 void haplotype_segment_double::RUN_MIS() {
-	__m256d _sum0 = _mm256_set1_pd(0.0f);
-	__m256d _sum1 = _mm256_set1_pd(0.0f);
-	__m256d _factor = _mm256_set1_pd(yt / (n_cond_haps * probSumT));
-	__m256d _tFreq0 = _mm256_load_pd(&probSumH[0]);
-	__m256d _tFreq1 = _mm256_load_pd(&probSumH[4]);
-	_tFreq0 = _mm256_mul_pd(_tFreq0, _factor);
-	_tFreq1 = _mm256_mul_pd(_tFreq1, _factor);
-	__m256d _nt = _mm256_set1_pd(nt / probSumT);
+	AVX512_DISPATCH(RUN_MIS_AVX512());
+	simd_f64x4 _sum0 = simd_zero_f64();
+	simd_f64x4 _sum1 = simd_zero_f64();
+	simd_f64x4 _factor = simd_set1_f64(yt / (n_total_haps * probSumT));
+	simd_f64x4 _tFreq0 = simd_load(&probSumH[0]);
+	simd_f64x4 _tFreq1 = simd_load(&probSumH[4]);
+	_tFreq0 = simd_mul(_tFreq0, _factor);
+	_tFreq1 = simd_mul(_tFreq1, _factor);
+	simd_f64x4 _nt = simd_set1_f64(nt / probSumT);
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
-		__m256d _prob0 = _mm256_load_pd(&prob[i]);
-		__m256d _prob1 = _mm256_load_pd(&prob[i+4]);
-		_prob0 = _mm256_fmadd_pd(_prob0, _nt, _tFreq0);
-		_prob1 = _mm256_fmadd_pd(_prob1, _nt, _tFreq1);
-		_sum0 = _mm256_add_pd(_sum0, _prob0);
-		_sum1 = _mm256_add_pd(_sum1, _prob1);
-		_mm256_store_pd(&prob[i], _prob0);
-		_mm256_store_pd(&prob[i+4], _prob1);
+		simd_f64x4 _prob0 = simd_load(&prob[i]);
+		simd_f64x4 _prob1 = simd_load(&prob[i+4]);
+		_prob0 = simd_fmadd(_prob0, _nt, _tFreq0);
+		_prob1 = simd_fmadd(_prob1, _nt, _tFreq1);
+		_sum0 = simd_fmadd(_prob0, simd_set1_f64(Kweights[k]), _sum0);
+		_sum1 = simd_fmadd(_prob1, simd_set1_f64(Kweights[k]), _sum1);
+		simd_store(&prob[i], _prob0);
+		simd_store(&prob[i+4], _prob1);
 	}
-	_mm256_store_pd(&probSumH[0], _sum0);
-	_mm256_store_pd(&probSumH[4], _sum1);
+	simd_store(&probSumH[0], _sum0);
+	simd_store(&probSumH[4], _sum1);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
 inline
 void haplotype_segment_double::COLLAPSE_MIS() {
-	__m256d _sum0 = _mm256_set1_pd(0.0f);
-	__m256d _sum1 = _mm256_set1_pd(0.0f);
-	__m256d _tFreq = _mm256_set1_pd(yt / n_cond_haps);
-	__m256d _nt = _mm256_set1_pd(nt / probSumT);
+	AVX512_DISPATCH(COLLAPSE_MIS_AVX512());
+	simd_f64x4 _sum0 = simd_zero_f64();
+	simd_f64x4 _sum1 = simd_zero_f64();
+	simd_f64x4 _tFreq = simd_set1_f64(yt / n_total_haps);
+	simd_f64x4 _nt = simd_set1_f64(nt / probSumT);
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
-		__m256d _prob0 = _mm256_set1_pd(probSumK[k]);
-		__m256d _prob1 = _mm256_set1_pd(probSumK[k]);
-		_prob0 = _mm256_fmadd_pd(_prob0, _nt, _tFreq);
-		_prob1 = _mm256_fmadd_pd(_prob1, _nt, _tFreq);
-		_sum0 = _mm256_add_pd(_sum0, _prob0);
-		_sum1 = _mm256_add_pd(_sum1, _prob1);
-		_mm256_store_pd(&prob[i], _prob0);
-		_mm256_store_pd(&prob[i+4], _prob1);
+		simd_f64x4 _prob0 = simd_set1_f64(probSumK[k]);
+		simd_f64x4 _prob1 = simd_set1_f64(probSumK[k]);
+		_prob0 = simd_fmadd(_prob0, _nt, _tFreq);
+		_prob1 = simd_fmadd(_prob1, _nt, _tFreq);
+		_sum0 = simd_fmadd(_prob0, simd_set1_f64(Kweights[k]), _sum0);
+		_sum1 = simd_fmadd(_prob1, simd_set1_f64(Kweights[k]), _sum1);
+		simd_store(&prob[i], _prob0);
+		simd_store(&prob[i+4], _prob1);
 	}
-	_mm256_store_pd(&probSumH[0], _sum0);
-	_mm256_store_pd(&probSumH[4], _sum1);
+	simd_store(&probSumH[0], _sum0);
+	simd_store(&probSumH[4], _sum1);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
@@ -382,22 +424,22 @@ inline
 bool haplotype_segment_double::TRANS_HAP() {
 	sumHProbs = 0.0f;
 	unsigned int  curr_rel_segment_index = curr_segment_index-segment_first;
-	yt = M.getForwardTransProb(AlphaLocus[curr_rel_segment_index - 1], prev_abs_locus);
+	yt = M.getForwardTransProb(AlphaLocus[curr_rel_segment_index - 1 - alpha_offset], prev_abs_locus);
 	nt = 1.0f - yt;
-	double fact1 = nt / AlphaSumSum[curr_rel_segment_index - 1];
+	double fact1 = nt / AlphaSumSum[curr_rel_segment_index - 1 - alpha_offset];
 	for (int h1 = 0 ; h1 < HAP_NUMBER ; h1++) {
-		__m256d _sum0 = _mm256_set1_pd(0.0f);
-		__m256d _sum1 = _mm256_set1_pd(0.0f);
-		double fact2 = (AlphaSum[curr_rel_segment_index-1][h1]/AlphaSumSum[curr_rel_segment_index-1]) * yt / n_cond_haps;
+		simd_f64x4 _sum0 = simd_zero_f64();
+		simd_f64x4 _sum1 = simd_zero_f64();
+		double fact2 = (AlphaSum[curr_rel_segment_index-1-alpha_offset][h1]/AlphaSumSum[curr_rel_segment_index-1-alpha_offset]) * yt / n_total_haps;
 		for (int k = 0 ; k < n_cond_haps ; k ++) {
-			__m256d _alpha = _mm256_set1_pd(Alpha[curr_rel_segment_index-1][k*HAP_NUMBER + h1] * fact1 + fact2);
-			__m256d _beta0 = _mm256_load_pd(&prob[k*HAP_NUMBER+0]);
-			__m256d _beta1 = _mm256_load_pd(&prob[k*HAP_NUMBER+4]);
-			_sum0 = _mm256_add_pd(_sum0, _mm256_mul_pd(_alpha, _beta0));
-			_sum1 = _mm256_add_pd(_sum1, _mm256_mul_pd(_alpha, _beta1));
+			simd_f64x4 _alpha = simd_set1_f64((Alpha[curr_rel_segment_index-1-alpha_offset][k*HAP_NUMBER + h1] * fact1 + fact2) * Kweights[k]);
+			simd_f64x4 _beta0 = simd_load(&prob[k*HAP_NUMBER+0]);
+			simd_f64x4 _beta1 = simd_load(&prob[k*HAP_NUMBER+4]);
+			_sum0 = simd_add(_sum0, simd_mul(_alpha, _beta0));
+			_sum1 = simd_add(_sum1, simd_mul(_alpha, _beta1));
 		}
-		_mm256_store_pd(&HProbs[h1*HAP_NUMBER+0], _sum0);
-		_mm256_store_pd(&HProbs[h1*HAP_NUMBER+4], _sum1);
+		simd_store(&HProbs[h1*HAP_NUMBER+0], _sum0);
+		simd_store(&HProbs[h1*HAP_NUMBER+4], _sum1);
 		sumHProbs += HProbs[h1*HAP_NUMBER+0]+HProbs[h1*HAP_NUMBER+1]+HProbs[h1*HAP_NUMBER+2]+HProbs[h1*HAP_NUMBER+3]+HProbs[h1*HAP_NUMBER+4]+HProbs[h1*HAP_NUMBER+5]+HProbs[h1*HAP_NUMBER+6]+HProbs[h1*HAP_NUMBER+7];
 	}
 	return (isnan(sumHProbs) || isinf(sumHProbs) || sumHProbs < numeric_limits<double>::min());
@@ -441,43 +483,209 @@ bool haplotype_segment_double::TRANS_DIP_ADD() {
 
 inline
 void haplotype_segment_double::IMPUTE(vector < float > & missing_probabilities) {
-	__m256d _sum0 = _mm256_set1_pd(0.0f);
-	__m256d _sum1 = _mm256_set1_pd(0.0f);
+	simd_f64x4 _sum0 = simd_zero_f64();
+	simd_f64x4 _sum1 = simd_zero_f64();
 
-	__m256d _sumA0[2], _sumA1[2];
-	_sumA0[0] = _mm256_set1_pd(0.0f);
-	_sumA0[1] = _mm256_set1_pd(0.0f);
-	_sumA1[0] = _mm256_set1_pd(0.0f);
-	_sumA1[1] = _mm256_set1_pd(0.0f);
+	simd_f64x4 _sumA0[2], _sumA1[2];
+	_sumA0[0] = simd_zero_f64();
+	_sumA0[1] = simd_zero_f64();
+	_sumA1[0] = simd_zero_f64();
+	_sumA1[1] = simd_zero_f64();
 
-	__m256d _alphaSum0 = _mm256_load_pd(&AlphaSumMissing[curr_rel_missing][0]);
-	__m256d _alphaSum1 = _mm256_load_pd(&AlphaSumMissing[curr_rel_missing][1]);
+	simd_f64x4 _alphaSum0 = simd_load(&AlphaSumMissing[curr_rel_missing - missing_offset][0]);
+	simd_f64x4 _alphaSum1 = simd_load(&AlphaSumMissing[curr_rel_missing - missing_offset][4]);
 
-	__m256d _ones = _mm256_set1_pd(1.0f);
+	simd_f64x4 _ones = simd_set1_f64(1.0f);
 
-	_alphaSum0 = _mm256_div_pd(_ones, _alphaSum0);
-	_alphaSum1 = _mm256_div_pd(_ones, _alphaSum1);
+	_alphaSum0 = simd_div(_ones, _alphaSum0);
+	_alphaSum1 = simd_div(_ones, _alphaSum1);
 
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-		__m256d _prob0 = _mm256_load_pd(&prob[i]);
-		__m256d _prob1 = _mm256_load_pd(&prob[i+4]);
+		simd_f64x4 _prob0 = simd_load(&prob[i]);
+		simd_f64x4 _prob1 = simd_load(&prob[i+4]);
+
+		simd_f64x4 _alpha0 = simd_load(&AlphaMissing[curr_rel_missing - missing_offset][i+0]);
+		simd_f64x4 _alpha1 = simd_load(&AlphaMissing[curr_rel_missing - missing_offset][i+4]);
+
+		_sum0 = simd_mul(simd_mul(simd_mul(_alpha0, _alphaSum0), _prob0), simd_set1_f64(Kweights[k]));
+		_sum1 = simd_mul(simd_mul(simd_mul(_alpha1, _alphaSum1), _prob1), simd_set1_f64(Kweights[k]));
+
+		_sumA0[ah] = simd_add(_sumA0[ah], _sum0);
+		_sumA1[ah] = simd_add(_sumA1[ah], _sum1);
+	}
+	double prob0 [HAP_NUMBER] __attribute__ ((aligned(32)));
+	double prob1 [HAP_NUMBER] __attribute__ ((aligned(32)));
+	simd_store(&prob0[0], _sumA0[0]);
+	simd_store(&prob1[0], _sumA0[1]);
+	simd_store(&prob0[4], _sumA1[0]);
+	simd_store(&prob1[4], _sumA1[1]);
+	for (int h = 0 ; h < HAP_NUMBER ; h ++) missing_probabilities[curr_abs_missing * HAP_NUMBER + h] = prob1[h] / (prob0[h]+prob1[h]);
+}
 
-		__m256d _alpha0 = _mm256_load_pd(&AlphaMissing[curr_rel_missing][i+0]);
-		__m256d _alpha1 = _mm256_load_pd(&AlphaMissing[curr_rel_missing][i+4]);
+#ifdef SIMD_AVX512_DISPATCH
 
-		_sum0 = _mm256_mul_pd(_mm256_mul_pd(_alpha0, _alphaSum0), _prob0);
-		_sum1 = _mm256_mul_pd(_mm256_mul_pd(_alpha1, _alphaSum1), _prob1);
+/*******************************************************************************/
+/*****************		AVX-512: ONE CONDITIONING HAP PER REGISTER		********/
+/*******************************************************************************/
+
+inline SIMD_AVX512
+void haplotype_segment_double::INIT_HOM_AVX512() {
+	bool ag = VAR_GET_HAP0(MOD2(curr_abs_locus), G->Variants[DIV2(curr_abs_locus)]);
+	__m512d _sum = _mm512_set1_pd(0.0f);
+	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
+		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
+		__m512d _prob = _mm512_set1_pd((ag==ah)?1.0f:M.ed/M.ee);
+		_sum = _mm512_fmadd_pd(_prob, _mm512_set1_pd(Kweights[k]), _sum);
+		_mm512_store_pd(&prob[i], _prob);
+	}
+	_mm512_store_pd(&probSumH[0], _sum);
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+}
+
+inline SIMD_AVX512
+bool haplotype_segment_double::RUN_HOM_AVX512(char rare_allele) {
+	bool ag = VAR_GET_HAP0(MOD2(curr_abs_locus), G->Variants[DIV2(curr_abs_locus)]);
+	if (rare_allele < 0 || ag == rare_allele) {
+		__m512d _sum = _mm512_set1_pd(0.0f);
+		__m512d _factor = _mm512_set1_pd(yt / (n_total_haps * probSumT));
+		__m512d _tFreq = _mm512_load_pd(&probSumH[0]);
+		_tFreq = _mm512_mul_pd(_tFreq, _factor);
+		__m512d _nt = _mm512_set1_pd(nt / probSumT);
+		__m512d _mismatch = _mm512_set1_pd(M.ed/M.ee);
+		for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
+			bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
+			__m512d _prob = _mm512_load_pd(&prob[i]);
+			_prob = _mm512_fmadd_pd(_prob, _nt, _tFreq);
+			if (ag!=ah) _prob = _mm512_mul_pd(_prob, _mismatch);
+			_sum = _mm512_fmadd_pd(_prob, _mm512_set1_pd(Kweights[k]), _sum);
+			_mm512_store_pd(&prob[i], _prob);
+		}
+		_mm512_store_pd(&probSumH[0], _sum);
+		probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+		return true;
+	}
+	return false;
+}
 
-		_sumA0[ah] = _mm256_add_pd(_sumA0[ah], _sum0);
-		_sumA1[ah] = _mm256_add_pd(_sumA1[ah], _sum1);
+inline SIMD_AVX512
+void haplotype_segment_double::COLLAPSE_HOM_AVX512() {
+	bool ag = VAR_GET_HAP0(MOD2(curr_abs_locus), G->Variants[DIV2(curr_abs_locus)]);
+	__m512d _sum = _mm512_set1_pd(0.0f);
+	__m512d _tFreq = _mm512_set1_pd(yt / n_total_haps);
+	__m512d _nt = _mm512_set1_pd(nt / probSumT);
+	__m512d _mismatch = _mm512_set1_pd(M.ed/M.ee);
+	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
+		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
+		__m512d _prob = _mm512_set1_pd(probSumK[k]);
+		_prob = _mm512_fmadd_pd(_prob, _nt, _tFreq);
+		if (ag!=ah) _prob = _mm512_mul_pd(_prob, _mismatch);
+		_sum = _mm512_fmadd_pd(_prob, _mm512_set1_pd(Kweights[k]), _sum);
+		_mm512_store_pd(&prob[i], _prob);
 	}
-	double * prob0 = (double*)&_sumA0[0];
-	double * prob1 = (double*)&_sumA0[1];
-	for (int h = 0 ; h < 4 ; h ++) missing_probabilities[curr_abs_missing * HAP_NUMBER + h] = prob1[h] / (prob0[h]+prob1[h]);
-	prob0 = (double*)&_sumA1[0];
-	prob1 = (double*)&_sumA1[1];
-	for (int h = 4 ; h < HAP_NUMBER ; h ++) missing_probabilities[curr_abs_missing * HAP_NUMBER + h] = prob1[h] / (prob0[h]+prob1[h]);
+	_mm512_store_pd(&probSumH[0], _sum);
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
+inline SIMD_AVX512
+void haplotype_segment_double::INIT_AMB_AVX512() {
+	unsigned char amb_code = G->Ambiguous[curr_abs_ambiguous];
+	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
+		g0[h] = HAP_GET(amb_code,h)?M.ed/M.ee:1.0f;
+		g1[h] = HAP_GET(amb_code,h)?1.0f:M.ed/M.ee;
+	}
+	__m512d _sum = _mm512_set1_pd(0.0f);
+	__m512d _emit[2]; _emit[0] = _mm512_loadu_pd(&g0[0]); _emit[1] = _mm512_loadu_pd(&g1[0]);
+	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
+		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
+		__m512d _prob = _emit[ah];
+		_sum = _mm512_fmadd_pd(_prob, _mm512_set1_pd(Kweights[k]), _sum);
+		_mm512_store_pd(&prob[i], _prob);
+	}
+	_mm512_store_pd(&probSumH[0], _sum);
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+}
+
+inline SIMD_AVX512
+void haplotype_segment_double::RUN_AMB_AVX512() {
+	unsigned char amb_code = G->Ambiguous[curr_abs_ambiguous];
+	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
+		g0[h] = HAP_GET(amb_code,h)?M.ed/M.ee:1.0f;
+		g1[h] = HAP_GET(amb_code,h)?1.0f:M.ed/M.ee;
+	}
+	__m512d _sum = _mm512_set1_pd(0.0f);
+	__m512d _factor = _mm512_set1_pd(yt / (n_total_haps * probSumT));
+	__m512d _tFreq = _mm512_load_pd(&probSumH[0]);
+	_tFreq = _mm512_mul_pd(_tFreq, _factor);
+	__m512d _nt = _mm512_set1_pd(nt / probSumT);
+	__m512d _emit[2]; _emit[0] = _mm512_loadu_pd(&g0[0]); _emit[1] = _mm512_loadu_pd(&g1[0]);
+	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
+		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
+		__m512d _prob = _mm512_load_pd(&prob[i]);
+		_prob = _mm512_fmadd_pd(_prob, _nt, _tFreq);
+		_prob = _mm512_mul_pd(_prob, _emit[ah]);
+		_sum = _mm512_fmadd_pd(_prob, _mm512_set1_pd(Kweights[k]), _sum);
+		_mm512_store_pd(&prob[i], _prob);
+	}
+	_mm512_store_pd(&probSumH[0], _sum);
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+}
+
+inline SIMD_AVX512
+void haplotype_segment_double::COLLAPSE_AMB_AVX512() {
+	unsigned char amb_code = G->Ambiguous[curr_abs_ambiguous];
+	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
+		g0[h] = HAP_GET(amb_code,h)?M.ed/M.ee:1.0f;
+		g1[h] = HAP_GET(amb_code,h)?1.0f:M.ed/M.ee;
+	}
+	__m512d _sum = _mm512_set1_pd(0.0f);
+	__m512d _tFreq = _mm512_set1_pd(yt / n_total_haps);
+	__m512d _nt = _mm512_set1_pd(nt / probSumT);
+	__m512d _emit[2]; _emit[0] = _mm512_loadu_pd(&g0[0]); _emit[1] = _mm512_loadu_pd(&g1[0]);
+	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
+		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
+		__m512d _prob = _mm512_set1_pd(probSumK[k]);
+		_prob = _mm512_fmadd_pd(_prob, _nt, _tFreq);
+		_prob = _mm512_mul_pd(_prob, _emit[ah]);
+		_sum = _mm512_fmadd_pd(_prob, _mm512_set1_pd(Kweights[k]), _sum);
+		_mm512_store_pd(&prob[i], _prob);
+	}
+	_mm512_store_pd(&probSumH[0], _sum);
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+}
+
+inline SIMD_AVX512
+void haplotype_segment_double::RUN_MIS_AVX512() {
+	__m512d _sum = _mm512_set1_pd(0.0f);
+	__m512d _factor = _mm512_set1_pd(yt / (n_total_haps * probSumT));
+	__m512d _tFreq = _mm512_load_pd(&probSumH[0]);
+	_tFreq = _mm512_mul_pd(_tFreq, _factor);
+	__m512d _nt = _mm512_set1_pd(nt / probSumT);
+	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
+		__m512d _prob = _mm512_load_pd(&prob[i]);
+		_prob = _mm512_fmadd_pd(_prob, _nt, _tFreq);
+		_sum = _mm512_fmadd_pd(_prob, _mm512_set1_pd(Kweights[k]), _sum);
+		_mm512_store_pd(&prob[i], _prob);
+	}
+	_mm512_store_pd(&probSumH[0], _sum);
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+}
+
+inline SIMD_AVX512
+void haplotype_segment_double::COLLAPSE_MIS_AVX512() {
+	__m512d _sum = _mm512_set1_pd(0.0f);
+	__m512d _tFreq = _mm512_set1_pd(yt / n_total_haps);
+	__m512d _nt = _mm512_set1_pd(nt / probSumT);
+	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
+		__m512d _prob = _mm512_set1_pd(probSumK[k]);
+		_prob = _mm512_fmadd_pd(_prob, _nt, _tFreq);
+		_sum = _mm512_fmadd_pd(_prob, _mm512_set1_pd(Kweights[k]), _sum);
+		_mm512_store_pd(&prob[i], _prob);
+	}
+	_mm512_store_pd(&probSumH[0], _sum);
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+}
+
+#endif
+
 #endif
@@ -27,9 +27,12 @@
 #include <objects/compute_job.h>
 #include <objects/hmm_parameters.h>
 
-#include <immintrin.h>
+#include <models/simd_dispatch.h>
 #include <boost/align/aligned_allocator.hpp>
 
+//Haplotype lanes falling this many powers of 2 below the total are rescaled
+#define LANE_RESCALE_EXP	32
+
 template <typename T>
 using aligned_vector32 = std::vector<T, boost::alignment::aligned_allocator < T, 32 > >;
 
@@ -38,6 +41,7 @@ private:
 	//EXTERNAL DATA
 	hmm_parameters & M;
 	genotype * G;
+	const vector < float > & Kweights;
 	bitmatrix Hhap, Hvar;
 
 	//COORDINATES & CONSTANTS
@@ -52,6 +56,7 @@ private:
 	int transition_first;
 	int transition_last;
 	unsigned int n_cond_haps;
+	float n_total_haps;						// Number of conditioning haplotypes, counting identical ones collapsed into a state
 	unsigned int n_missing;
 
 	//CURSORS
@@ -69,15 +74,40 @@ private:
 
 	//DYNAMIC ARRAYS
 	float probSumT;
-	aligned_vector32 < float > prob;
-	aligned_vector32 < float > probSumK;
-	aligned_vector32 < float > probSumH;
-	vector < aligned_vector32 < float > > Alpha;
-	vector < aligned_vector32 < float > > AlphaSum;
+	aligned_vector64 < float > prob;
+	aligned_vector64 < float > probSumK;
+	aligned_vector64 < float > probSumH;
+	vector < aligned_vector64 < float > > Alpha;
+	vector < aligned_vector64 < float > > AlphaSum;
 	vector < int > AlphaLocus;
-	aligned_vector32 < float > AlphaSumSum;
-	vector < aligned_vector32 < float > > AlphaMissing;
-	vector < aligned_vector32 < float > > AlphaSumMissing;
+	aligned_vector64 < float > AlphaSumSum;
+	vector < aligned_vector64 < float > > AlphaMissing;
+	vector < aligned_vector64 < float > > AlphaSumMissing;
+
+	//CHECKPOINTING [forward probabilities stored every checkpoint_size segments only]
+	unsigned int checkpoint_size;			// Number of segments per block, 0 when all forward probabilities are stored
+	int alpha_offset;						// Relative index of the segment stored in Alpha[0]
+	int missing_offset;						// Relative index of the missing site stored in AlphaMissing[0]
+	int loaded_block;						// Block whose forward probabilities are in Alpha
+	vector < aligned_vector64 < float > > CheckAlpha;
+	vector < aligned_vector64 < float > > CheckAlphaSum;
+	aligned_vector64 < float > CheckAlphaSumSum;
+	vector < int > CheckAlphaLocus;
+	vector < int > CheckLocus;
+	vector < int > CheckAmbiguous;
+	vector < int > CheckMissing;
+	aligned_vector64 < float > probBackward;
+	aligned_vector64 < float > probSumHBackward;
+	aligned_vector64 < float > probSumKBackward;
+
+	//LANE RESCALING [power of 2 offsets of haplotype lanes, avoids underflow in single precision]
+	bool rescaled;							// True when some lanes of prob have non-zero offsets
+	bool hrescaled;							// True when some haplotype transitions have non-zero offsets
+	int ProbOffset [HAP_NUMBER];
+	int HOffset [HAP_NUMBER * HAP_NUMBER];
+	vector < int > AlphaOffset;
+	vector < int > CheckOffset;
+	int ProbOffsetBackward [HAP_NUMBER];
 	float HProbs [HAP_NUMBER * HAP_NUMBER] __attribute__ ((aligned(32)));
 	double DProbs [HAP_NUMBER * HAP_NUMBER * HAP_NUMBER * HAP_NUMBER] __attribute__ ((aligned(32)));
 
@@ -86,6 +116,7 @@ private:
 	double sumDProbs;
 	float g0[HAP_NUMBER], g1[HAP_NUMBER];
 	float nt, yt;
+	bool avx512;
 
 	//INLINED AND UNROLLED ROUTINES
 	void INIT_HOM();
@@ -98,16 +129,33 @@ private:
 	void COLLAPSE_AMB();
 	void COLLAPSE_MIS();
 	void SUMK();
+	void RESCALE();
+	void FOLD();
 	void IMPUTE(vector < float > & );
 	bool TRANS_HAP();
 	bool TRANS_DIP_MULT();
 	bool TRANS_DIP_ADD();
 	void SET_FIRST_TRANS(vector < double > & );
 	int SET_OTHER_TRANS(vector < double > & );
+	void sweepForward(int, bool);
+	void forward(int);
+	void recompute(int);
+
+#ifdef SIMD_AVX512_DISPATCH
+	//AVX-512 VERSIONS, SELECTED AT RUNTIME
+	void INIT_HOM_AVX512();
+	void INIT_AMB_AVX512();
+	bool RUN_HOM_AVX512(char);
+	void RUN_AMB_AVX512();
+	void RUN_MIS_AVX512();
+	void COLLAPSE_HOM_AVX512();
+	void COLLAPSE_AMB_AVX512();
+	void COLLAPSE_MIS_AVX512();
+#endif
 
 public:
 	//CONSTRUCTOR/DESTRUCTOR
-	haplotype_segment_single(genotype *, bitmatrix &, vector < unsigned int > &, window &, hmm_parameters &);
+	haplotype_segment_single(genotype *, bitmatrix &, vector < unsigned int > &, const vector < float > &, window &, hmm_parameters &, unsigned long max_alpha_bytes = 0);
 	~haplotype_segment_single();
 
 	//void fetch();
@@ -121,37 +169,39 @@ public:
 
 inline
 void haplotype_segment_single::INIT_HOM() {
+	AVX512_DISPATCH(INIT_HOM_AVX512());
 	bool ag = VAR_GET_HAP0(MOD2(curr_abs_locus), G->Variants[DIV2(curr_abs_locus)]);
-	__m256 _sum = _mm256_set1_ps(0.0f);
+	simd_f32x8 _sum = simd_zero_f32();
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-		__m256 _prob = _mm256_set1_ps((ag==ah)?1.0f:M.ed/M.ee);
-		_sum = _mm256_add_ps(_sum, _prob);
-		_mm256_store_ps(&prob[i], _prob);
+		simd_f32x8 _prob = simd_set1_f32((ag==ah)?1.0f:M.ed/M.ee);
+		_sum = simd_fmadd(_prob, simd_set1_f32(Kweights[k]), _sum);
+		simd_store(&prob[i], _prob);
 	}
-	_mm256_store_ps(&probSumH[0], _sum);
+	simd_store(&probSumH[0], _sum);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
 inline
 bool haplotype_segment_single::RUN_HOM(char rare_allele) {
+	AVX512_DISPATCH(RUN_HOM_AVX512(rare_allele));
 	bool ag = VAR_GET_HAP0(MOD2(curr_abs_locus), G->Variants[DIV2(curr_abs_locus)]);
 	if (rare_allele < 0 || ag == rare_allele) {
-		__m256 _sum = _mm256_set1_ps(0.0f);
-		__m256 _factor = _mm256_set1_ps(yt / (n_cond_haps * probSumT));
-		__m256 _tFreq = _mm256_load_ps(&probSumH[0]);
-		_tFreq = _mm256_mul_ps(_tFreq, _factor);
-		__m256 _nt = _mm256_set1_ps(nt / probSumT);
-		__m256 _mismatch = _mm256_set1_ps(M.ed/M.ee);
+		simd_f32x8 _sum = simd_zero_f32();
+		simd_f32x8 _factor = simd_set1_f32(yt / (n_total_haps * probSumT));
+		simd_f32x8 _tFreq = simd_load(&probSumH[0]);
+		_tFreq = simd_mul(_tFreq, _factor);
+		simd_f32x8 _nt = simd_set1_f32(nt / probSumT);
+		simd_f32x8 _mismatch = simd_set1_f32(M.ed/M.ee);
 		for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 			bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-			__m256 _prob = _mm256_load_ps(&prob[i]);
-			_prob = _mm256_fmadd_ps(_prob, _nt, _tFreq);
-			if (ag!=ah) _prob = _mm256_mul_ps(_prob, _mismatch);
-			_sum = _mm256_add_ps(_sum, _prob);
-			_mm256_store_ps(&prob[i], _prob);
+			simd_f32x8 _prob = simd_load(&prob[i]);
+			_prob = simd_fmadd(_prob, _nt, _tFreq);
+			if (ag!=ah) _prob = simd_mul(_prob, _mismatch);
+			_sum = simd_fmadd(_prob, simd_set1_f32(Kweights[k]), _sum);
+			simd_store(&prob[i], _prob);
 		}
-		_mm256_store_ps(&probSumH[0], _sum);
+		simd_store(&probSumH[0], _sum);
 		probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 		return true;
 	}
@@ -160,20 +210,21 @@ bool haplotype_segment_single::RUN_HOM(char rare_allele) {
 
 inline
 void haplotype_segment_single::COLLAPSE_HOM() {
+	AVX512_DISPATCH(COLLAPSE_HOM_AVX512());
 	bool ag = VAR_GET_HAP0(MOD2(curr_abs_locus), G->Variants[DIV2(curr_abs_locus)]);
-	__m256 _sum = _mm256_set1_ps(0.0f);
-	__m256 _tFreq = _mm256_set1_ps(yt / n_cond_haps);					//Check divide by probSumT here!
-	__m256 _nt = _mm256_set1_ps(nt / probSumT);
-	__m256 _mismatch = _mm256_set1_ps(M.ed/M.ee);
+	simd_f32x8 _sum = simd_zero_f32();
+	simd_f32x8 _tFreq = simd_set1_f32(yt / n_total_haps);					//Check divide by probSumT here!
+	simd_f32x8 _nt = simd_set1_f32(nt / probSumT);
+	simd_f32x8 _mismatch = simd_set1_f32(M.ed/M.ee);
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-		__m256 _prob = _mm256_set1_ps(probSumK[k]);
-		_prob = _mm256_fmadd_ps(_prob, _nt, _tFreq);
-		if (ag!=ah) _prob = _mm256_mul_ps(_prob, _mismatch);
-		_sum = _mm256_add_ps(_sum, _prob);
-		_mm256_store_ps(&prob[i], _prob);
+		simd_f32x8 _prob = simd_set1_f32(probSumK[k]);
+		_prob = simd_fmadd(_prob, _nt, _tFreq);
+		if (ag!=ah) _prob = simd_mul(_prob, _mismatch);
+		_sum = simd_fmadd(_prob, simd_set1_f32(Kweights[k]), _sum);
+		simd_store(&prob[i], _prob);
 	}
-	_mm256_store_ps(&probSumH[0], _sum);
+	simd_store(&probSumH[0], _sum);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
@@ -183,45 +234,47 @@ void haplotype_segment_single::COLLAPSE_HOM() {
 
 inline
 void haplotype_segment_single::INIT_AMB() {
+	AVX512_DISPATCH(INIT_AMB_AVX512());
 	unsigned char amb_code = G->Ambiguous[curr_abs_ambiguous];
 	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
 		g0[h] = HAP_GET(amb_code,h)?M.ed/M.ee:1.0f;
 		g1[h] = HAP_GET(amb_code,h)?1.0f:M.ed/M.ee;
 	}
-	__m256 _sum = _mm256_set1_ps(0.0f);
-	__m256 _emit[2]; _emit[0] = _mm256_loadu_ps(&g0[0]); _emit[1] = _mm256_loadu_ps(&g1[0]);
+	simd_f32x8 _sum = simd_zero_f32();
+	simd_f32x8 _emit[2]; _emit[0] = simd_loadu(&g0[0]); _emit[1] = simd_loadu(&g1[0]);
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-		__m256 _prob = _emit[ah];
-		_sum = _mm256_add_ps(_sum, _prob);
-		_mm256_store_ps(&prob[i], _prob);
+		simd_f32x8 _prob = _emit[ah];
+		_sum = simd_fmadd(_prob, simd_set1_f32(Kweights[k]), _sum);
+		simd_store(&prob[i], _prob);
 	}
-	_mm256_store_ps(&probSumH[0], _sum);
+	simd_store(&probSumH[0], _sum);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
 inline
 void haplotype_segment_single::RUN_AMB() {
+	AVX512_DISPATCH(RUN_AMB_AVX512());
 	unsigned char amb_code = G->Ambiguous[curr_abs_ambiguous];
 	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
 		g0[h] = HAP_GET(amb_code,h)?M.ed/M.ee:1.0f;
 		g1[h] = HAP_GET(amb_code,h)?1.0f:M.ed/M.ee;
 	}
-	__m256 _sum = _mm256_set1_ps(0.0f);
-	__m256 _factor = _mm256_set1_ps(yt / (n_cond_haps * probSumT));
-	__m256 _tFreq = _mm256_load_ps(&probSumH[0]);
-	_tFreq = _mm256_mul_ps(_tFreq, _factor);
-	__m256 _nt = _mm256_set1_ps(nt / probSumT);
-	__m256 _emit[2]; _emit[0] = _mm256_loadu_ps(&g0[0]); _emit[1] = _mm256_loadu_ps(&g1[0]);
+	simd_f32x8 _sum = simd_zero_f32();
+	simd_f32x8 _factor = simd_set1_f32(yt / (n_total_haps * probSumT));
+	simd_f32x8 _tFreq = simd_load(&probSumH[0]);
+	_tFreq = simd_mul(_tFreq, _factor);
+	simd_f32x8 _nt = simd_set1_f32(nt / probSumT);
+	simd_f32x8 _emit[2]; _emit[0] = simd_loadu(&g0[0]); _emit[1] = simd_loadu(&g1[0]);
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-		__m256 _prob = _mm256_load_ps(&prob[i]);
-		_prob = _mm256_fmadd_ps(_prob, _nt, _tFreq);
-		_prob = _mm256_mul_ps(_prob, _emit[ah]);
-		_sum = _mm256_add_ps(_sum, _prob);
-		_mm256_store_ps(&prob[i], _prob);
+		simd_f32x8 _prob = simd_load(&prob[i]);
+		_prob = simd_fmadd(_prob, _nt, _tFreq);
+		_prob = simd_mul(_prob, _emit[ah]);
+		_sum = simd_fmadd(_prob, simd_set1_f32(Kweights[k]), _sum);
+		simd_store(&prob[i], _prob);
 	}
-	_mm256_store_ps(&probSumH[0], _sum);
+	simd_store(&probSumH[0], _sum);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
@@ -233,58 +286,59 @@ void haplotype_segment_single::RUN_AMB() {
 		g0[h] = HAP_GET(amb_code,h)?M.ed/M.ee:1.0f;
 		g1[h] = HAP_GET(amb_code,h)?1.0f:M.ed/M.ee;
 	}
-	__m256d _sum0 = _mm256_set1_pd(0.0f);
-	__m256d _sum1 = _mm256_set1_pd(0.0f);
-	__m256d _factor = _mm256_set1_pd(yt / (n_cond_haps * probSumT));
-	__m256d _tFreq0 = _mm256_load_pd(&probSumH[0]);
-	__m256d _tFreq1 = _mm256_load_pd(&probSumH[4]);
-	_tFreq0 = _mm256_mul_pd(_tFreq0, _factor);
-	_tFreq1 = _mm256_mul_pd(_tFreq1, _factor);
-	__m256d _nt = _mm256_set1_pd(nt / probSumT);
-	__m256d _emit0[2], _emit1[2];
-	_emit0[0] = _mm256_loadu_pd(&g0[0]);
-	_emit0[1] = _mm256_loadu_pd(&g1[0]);
-	_emit1[0] = _mm256_loadu_pd(&g0[4]);
-	_emit1[1] = _mm256_loadu_pd(&g1[4]);
+	simd_f64x4 _sum0 = simd_zero_f64();
+	simd_f64x4 _sum1 = simd_zero_f64();
+	simd_f64x4 _factor = simd_set1_f64(yt / (n_total_haps * probSumT));
+	simd_f64x4 _tFreq0 = simd_load(&probSumH[0]);
+	simd_f64x4 _tFreq1 = simd_load(&probSumH[4]);
+	_tFreq0 = simd_mul(_tFreq0, _factor);
+	_tFreq1 = simd_mul(_tFreq1, _factor);
+	simd_f64x4 _nt = simd_set1_f64(nt / probSumT);
+	simd_f64x4 _emit0[2], _emit1[2];
+	_emit0[0] = simd_loadu(&g0[0]);
+	_emit0[1] = simd_loadu(&g1[0]);
+	_emit1[0] = simd_loadu(&g0[4]);
+	_emit1[1] = simd_loadu(&g1[4]);
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-		__m256d _prob0 = _mm256_load_pd(&prob[i+0]);
-		__m256d _prob1 = _mm256_load_pd(&prob[i+4]);
-		_prob0 = _mm256_fmadd_pd(_prob0, _nt, _tFreq0);
-		_prob1 = _mm256_fmadd_pd(_prob1, _nt, _tFreq1);
-		_prob0 = _mm256_mul_pd(_prob0, _emit0[ah]);
-		_prob1 = _mm256_mul_pd(_prob1, _emit1[ah]);
-		_sum0 = _mm256_add_pd(_sum0, _prob0);
-		_sum1 = _mm256_add_pd(_sum1, _prob1);
-		_mm256_store_pd(&prob[i+0], _prob0);
-		_mm256_store_pd(&prob[i+4], _prob1);
-	}
-	_mm256_store_pd(&probSumH[0], _sum0);
-	_mm256_store_pd(&probSumH[4], _sum1);
+		simd_f64x4 _prob0 = simd_load(&prob[i+0]);
+		simd_f64x4 _prob1 = simd_load(&prob[i+4]);
+		_prob0 = simd_fmadd(_prob0, _nt, _tFreq0);
+		_prob1 = simd_fmadd(_prob1, _nt, _tFreq1);
+		_prob0 = simd_mul(_prob0, _emit0[ah]);
+		_prob1 = simd_mul(_prob1, _emit1[ah]);
+		_sum0 = simd_add(_sum0, _prob0);
+		_sum1 = simd_add(_sum1, _prob1);
+		simd_store(&prob[i+0], _prob0);
+		simd_store(&prob[i+4], _prob1);
+	}
+	simd_store(&probSumH[0], _sum0);
+	simd_store(&probSumH[4], _sum1);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 */
 
 inline
 void haplotype_segment_single::COLLAPSE_AMB() {
+	AVX512_DISPATCH(COLLAPSE_AMB_AVX512());
 	unsigned char amb_code = G->Ambiguous[curr_abs_ambiguous];
 	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
 		g0[h] = HAP_GET(amb_code,h)?M.ed/M.ee:1.0f;
 		g1[h] = HAP_GET(amb_code,h)?1.0f:M.ed/M.ee;
 	}
-	__m256 _sum = _mm256_set1_ps(0.0f);
-	__m256 _tFreq = _mm256_set1_ps(yt / n_cond_haps);
-	__m256 _nt = _mm256_set1_ps(nt / probSumT);
-	__m256 _emit[2]; _emit[0] = _mm256_loadu_ps(&g0[0]); _emit[1] = _mm256_loadu_ps(&g1[0]);
+	simd_f32x8 _sum = simd_zero_f32();
+	simd_f32x8 _tFreq = simd_set1_f32(yt / n_total_haps);
+	simd_f32x8 _nt = simd_set1_f32(nt / probSumT);
+	simd_f32x8 _emit[2]; _emit[0] = simd_loadu(&g0[0]); _emit[1] = simd_loadu(&g1[0]);
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-		__m256 _prob = _mm256_set1_ps(probSumK[k]);
-		_prob = _mm256_fmadd_ps(_prob, _nt, _tFreq);
-		_prob = _mm256_mul_ps(_prob, _emit[ah]);
-		_sum = _mm256_add_ps(_sum, _prob);
-		_mm256_store_ps(&prob[i], _prob);
+		simd_f32x8 _prob = simd_set1_f32(probSumK[k]);
+		_prob = simd_fmadd(_prob, _nt, _tFreq);
+		_prob = simd_mul(_prob, _emit[ah]);
+		_sum = simd_fmadd(_prob, simd_set1_f32(Kweights[k]), _sum);
+		simd_store(&prob[i], _prob);
 	}
-	_mm256_store_ps(&probSumH[0], _sum);
+	simd_store(&probSumH[0], _sum);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
@@ -294,40 +348,42 @@ void haplotype_segment_single::COLLAPSE_AMB() {
 
 inline
 void haplotype_segment_single::INIT_MIS() {
-	fill(prob.begin(), prob.end(), 1.0f/(HAP_NUMBER * n_cond_haps));
+	fill(prob.begin(), prob.end(), 1.0f/(HAP_NUMBER * n_total_haps));
 	fill(probSumH.begin(), probSumH.end(), 1.0f/HAP_NUMBER);
 	probSumT = 1.0f;
 }
 
 inline
 void haplotype_segment_single::RUN_MIS() {
-	__m256 _sum = _mm256_set1_ps(0.0f);
-	__m256 _factor = _mm256_set1_ps(yt / (n_cond_haps * probSumT));
-	__m256 _tFreq = _mm256_load_ps(&probSumH[0]);
-	_tFreq = _mm256_mul_ps(_tFreq, _factor);
-	__m256 _nt = _mm256_set1_ps(nt / probSumT);
+	AVX512_DISPATCH(RUN_MIS_AVX512());
+	simd_f32x8 _sum = simd_zero_f32();
+	simd_f32x8 _factor = simd_set1_f32(yt / (n_total_haps * probSumT));
+	simd_f32x8 _tFreq = simd_load(&probSumH[0]);
+	_tFreq = simd_mul(_tFreq, _factor);
+	simd_f32x8 _nt = simd_set1_f32(nt / probSumT);
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
-		__m256 _prob = _mm256_load_ps(&prob[i]);
-		_prob = _mm256_fmadd_ps(_prob, _nt, _tFreq);
-		_sum = _mm256_add_ps(_sum, _prob);
-		_mm256_store_ps(&prob[i], _prob);
+		simd_f32x8 _prob = simd_load(&prob[i]);
+		_prob = simd_fmadd(_prob, _nt, _tFreq);
+		_sum = simd_fmadd(_prob, simd_set1_f32(Kweights[k]), _sum);
+		simd_store(&prob[i], _prob);
 	}
-	_mm256_store_ps(&probSumH[0], _sum);
+	simd_store(&probSumH[0], _sum);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
 inline
 void haplotype_segment_single::COLLAPSE_MIS() {
-	__m256 _sum = _mm256_set1_ps(0.0f);
-	__m256 _tFreq = _mm256_set1_ps(yt / n_cond_haps);
-	__m256 _nt = _mm256_set1_ps(nt / probSumT);
+	AVX512_DISPATCH(COLLAPSE_MIS_AVX512());
+	simd_f32x8 _sum = simd_zero_f32();
+	simd_f32x8 _tFreq = simd_set1_f32(yt / n_total_haps);
+	simd_f32x8 _nt = simd_set1_f32(nt / probSumT);
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
-		__m256 _prob = _mm256_set1_ps(probSumK[k]);
-		_prob = _mm256_fmadd_ps(_prob, _nt, _tFreq);
-		_sum = _mm256_add_ps(_sum, _prob);
-		_mm256_store_ps(&prob[i], _prob);
+		simd_f32x8 _prob = simd_set1_f32(probSumK[k]);
+		_prob = simd_fmadd(_prob, _nt, _tFreq);
+		_sum = simd_fmadd(_prob, simd_set1_f32(Kweights[k]), _sum);
+		simd_store(&prob[i], _prob);
 	}
-	_mm256_store_ps(&probSumH[0], _sum);
+	simd_store(&probSumH[0], _sum);
 	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
 }
 
@@ -342,6 +398,47 @@ void haplotype_segment_single::SUMK() {
 	}
 }
 
+/*******************************************************************************/
+/*****************				LANE RESCALING			************************/
+/*******************************************************************************/
+
+inline
+void haplotype_segment_single::RESCALE() {
+	float threshold = ldexpf(probSumT, -LANE_RESCALE_EXP);
+	float factors [HAP_NUMBER] __attribute__ ((aligned(32)));
+	bool underflow = false;
+	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
+		bool low = (probSumH[h] > 0.0f && probSumH[h] < threshold);
+		factors[h] = low?ldexpf(1.0f, LANE_RESCALE_EXP):1.0f;
+		ProbOffset[h] += low?LANE_RESCALE_EXP:0;
+		underflow |= low;
+	}
+	if (!underflow) return;
+	rescaled = true;
+	simd_f32x8 _factor = simd_load(&factors[0]);
+	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) simd_store(&prob[i], simd_mul(simd_load(&prob[i]), _factor));
+	simd_store(&probSumH[0], simd_mul(simd_load(&probSumH[0]), _factor));
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+}
+
+inline
+void haplotype_segment_single::FOLD() {
+	//Lanes are mixed when collapsing: bring them back to a common scale, negligible lanes flush to zero
+	int offset_min = *min_element(ProbOffset, ProbOffset + HAP_NUMBER);
+	float factors [HAP_NUMBER] __attribute__ ((aligned(32)));
+	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
+		factors[h] = ldexpf(1.0f, offset_min - ProbOffset[h]);
+		ProbOffset[h] = 0;
+	}
+	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
+		probSumK[k] = 0.0f;
+		for (int h = 0 ; h < HAP_NUMBER ; h ++) probSumK[k] += prob[i+h] * factors[h];
+	}
+	probSumT = 0.0f;
+	for (int h = 0 ; h < HAP_NUMBER ; h ++) probSumT += probSumH[h] * factors[h];
+	rescaled = false;
+}
+
 /*******************************************************************************/
 /*****************		TRANSITION COMPUTATIONS			************************/
 /*******************************************************************************/
@@ -350,20 +447,25 @@ inline
 bool haplotype_segment_single::TRANS_HAP() {
 	sumHProbs = 0.0f;
 	unsigned int  curr_rel_segment_index = curr_segment_index-segment_first;
-	yt = M.getForwardTransProb(AlphaLocus[curr_rel_segment_index - 1], prev_abs_locus);
+	yt = M.getForwardTransProb(AlphaLocus[curr_rel_segment_index - 1 - alpha_offset], prev_abs_locus);
 	nt = 1.0f - yt;
-	float fact1 = nt / AlphaSumSum[curr_rel_segment_index - 1];
+	float fact1 = nt / AlphaSumSum[curr_rel_segment_index - 1 - alpha_offset];
 	for (int h1 = 0 ; h1 < HAP_NUMBER ; h1++) {
-		__m256 _sum = _mm256_set1_ps(0.0f);
-		float fact2 = (AlphaSum[curr_rel_segment_index-1][h1]/AlphaSumSum[curr_rel_segment_index-1]) * yt / n_cond_haps;
+		simd_f32x8 _sum = simd_zero_f32();
+		float fact2 = (AlphaSum[curr_rel_segment_index-1-alpha_offset][h1]/AlphaSumSum[curr_rel_segment_index-1-alpha_offset]) * yt / n_total_haps;
 		for (int k = 0 ; k < n_cond_haps ; k ++) {
-			__m256 _alpha = _mm256_set1_ps(Alpha[curr_rel_segment_index-1][k*HAP_NUMBER + h1] * fact1 + fact2);
-			__m256 _beta = _mm256_load_ps(&prob[k*HAP_NUMBER]);
-			_sum = _mm256_add_ps(_sum, _mm256_mul_ps(_alpha, _beta));
+			simd_f32x8 _alpha = simd_set1_f32((Alpha[curr_rel_segment_index-1-alpha_offset][k*HAP_NUMBER + h1] * fact1 + fact2) * Kweights[k]);
+			simd_f32x8 _beta = simd_load(&prob[k*HAP_NUMBER]);
+			_sum = simd_add(_sum, simd_mul(_alpha, _beta));
 		}
-		_mm256_store_ps(&HProbs[h1*HAP_NUMBER], _sum);
+		simd_store(&HProbs[h1*HAP_NUMBER], _sum);
 		sumHProbs += HProbs[h1*HAP_NUMBER+0]+HProbs[h1*HAP_NUMBER+1]+HProbs[h1*HAP_NUMBER+2]+HProbs[h1*HAP_NUMBER+3]+HProbs[h1*HAP_NUMBER+4]+HProbs[h1*HAP_NUMBER+5]+HProbs[h1*HAP_NUMBER+6]+HProbs[h1*HAP_NUMBER+7];
 	}
+	//Offsets of forward and backward lanes carry over to haplotype transitions
+	int * alpha_lane_offset = &AlphaOffset[(curr_rel_segment_index - 1 - alpha_offset) * HAP_NUMBER];
+	hrescaled = rescaled;
+	for (int h = 0 ; h < HAP_NUMBER ; h ++) hrescaled |= (alpha_lane_offset[h] != 0);
+	if (hrescaled) for (int h1 = 0 ; h1 < HAP_NUMBER ; h1++) for (int h2 = 0 ; h2 < HAP_NUMBER ; h2++) HOffset[h1*HAP_NUMBER+h2] = alpha_lane_offset[h1] + ProbOffset[h2];
 	return (isnan(sumHProbs) || isinf(sumHProbs) || sumHProbs < numeric_limits<float>::min());
 }
 
@@ -382,11 +484,49 @@ bool haplotype_segment_single::TRANS_DIP_MULT() {
 			}
 		}
 	}
+	if (hrescaled) {
+		//Apply lane offsets in double precision, relative to the largest diplotype transition
+		int exp_max = numeric_limits<int>::min();
+		for (int pd = 0, t = 0 ; pd < 64 ; ++pd) {
+			if (DIP_GET(G->Diplotypes[curr_segment_index-1], pd)) {
+				for (int nd = 0 ; nd < 64 ; ++nd) {
+					if (DIP_GET(G->Diplotypes[curr_segment_index], nd)) {
+						if (DProbs[t] > 0.0) exp_max = max(exp_max, ilogb(DProbs[t]) - HOffset[DIP_HAP0(pd)*HAP_NUMBER+DIP_HAP0(nd)] - HOffset[DIP_HAP1(pd)*HAP_NUMBER+DIP_HAP1(nd)]);
+						t++;
+					}
+				}
+			}
+		}
+		if (exp_max == numeric_limits<int>::min()) return true;
+		sumDProbs = 0.0;
+		for (int pd = 0, t = 0 ; pd < 64 ; ++pd) {
+			if (DIP_GET(G->Diplotypes[curr_segment_index-1], pd)) {
+				for (int nd = 0 ; nd < 64 ; ++nd) {
+					if (DIP_GET(G->Diplotypes[curr_segment_index], nd)) {
+						DProbs[t] = ldexp(DProbs[t], - exp_max - HOffset[DIP_HAP0(pd)*HAP_NUMBER+DIP_HAP0(nd)] - HOffset[DIP_HAP1(pd)*HAP_NUMBER+DIP_HAP1(nd)]);
+						sumDProbs += DProbs[t];
+						t++;
+					}
+				}
+			}
+		}
+	}
 	return (isnan(sumDProbs) || isinf(sumDProbs) || sumDProbs < numeric_limits<double>::min());
 }
 
 inline
 bool haplotype_segment_single::TRANS_DIP_ADD() {
+	if (hrescaled) {
+		//Sums are dominated by the largest terms: apply lane offsets relative to the largest haplotype transition
+		int exp_max = numeric_limits<int>::min();
+		for (int h = 0 ; h < HAP_NUMBER * HAP_NUMBER ; h ++) if (HProbs[h] > 0.0f) exp_max = max(exp_max, ilogbf(HProbs[h]) - HOffset[h]);
+		if (exp_max == numeric_limits<int>::min()) return true;
+		sumHProbs = 0.0f;
+		for (int h = 0 ; h < HAP_NUMBER * HAP_NUMBER ; h ++) {
+			HProbs[h] = ldexpf(HProbs[h], - exp_max - HOffset[h]);
+			sumHProbs += HProbs[h];
+		}
+	}
 	sumDProbs = 0.0f;
 	double scaling = 1.0 / sumHProbs;
 	for (int pd = 0, t = 0 ; pd < 64 ; ++pd) {
@@ -405,23 +545,267 @@ bool haplotype_segment_single::TRANS_DIP_ADD() {
 
 inline
 void haplotype_segment_single::IMPUTE(vector < float > & missing_probabilities) {
-	__m256 _sum = _mm256_set1_ps(0.0f);
-	__m256 _sumA [2]; _sumA[0] = _mm256_set1_ps(0.0f); _sumA[1] = _mm256_set1_ps(0.0f);
-	__m256 _alphaSum = _mm256_load_ps(&AlphaSumMissing[curr_rel_missing][0]);
-	__m256 _ones = _mm256_set1_ps(1.0f);
-	_alphaSum = _mm256_div_ps(_ones, _alphaSum);
+	simd_f32x8 _sum = simd_zero_f32();
+	simd_f32x8 _sumA [2]; _sumA[0] = simd_zero_f32(); _sumA[1] = simd_zero_f32();
+	simd_f32x8 _alphaSum = simd_load(&AlphaSumMissing[curr_rel_missing - missing_offset][0]);
+	simd_f32x8 _ones = simd_set1_f32(1.0f);
+	_alphaSum = simd_div(_ones, _alphaSum);
 	for(int k = 0, i = 0 ; k != n_cond_haps ; ++k, i += HAP_NUMBER) {
 		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
-		__m256 _prob = _mm256_load_ps(&prob[i]);
-		__m256 _alpha = _mm256_load_ps(&AlphaMissing[curr_rel_missing][i]);
-		_sum = _mm256_mul_ps(_mm256_mul_ps(_alpha, _alphaSum), _prob);
-		_sumA[ah] = _mm256_add_ps(_sumA[ah], _sum);
+		simd_f32x8 _prob = simd_load(&prob[i]);
+		simd_f32x8 _alpha = simd_load(&AlphaMissing[curr_rel_missing - missing_offset][i]);
+		_sum = simd_mul(simd_mul(simd_mul(_alpha, _alphaSum), _prob), simd_set1_f32(Kweights[k]));
+		_sumA[ah] = simd_add(_sumA[ah], _sum);
 	}
-	float * prob0 = (float*)&_sumA[0];
-	float * prob1 = (float*)&_sumA[1];
+	float prob0 [HAP_NUMBER] __attribute__ ((aligned(32)));
+	float prob1 [HAP_NUMBER] __attribute__ ((aligned(32)));
+	simd_store(&prob0[0], _sumA[0]);
+	simd_store(&prob1[0], _sumA[1]);
 	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
 		missing_probabilities[curr_abs_missing * HAP_NUMBER + h] = prob1[h] / (prob0[h]+prob1[h]);
 	}
 }
 
+#ifdef SIMD_AVX512_DISPATCH
+
+/*******************************************************************************/
+/*****************		AVX-512: TWO CONDITIONING HAPS PER REGISTER		********/
+/*******************************************************************************/
+
+//Per-haplotype sums are accumulated in the same order as in the AVX2 kernels: both give identical results
+
+inline SIMD_AVX512
+void haplotype_segment_single::INIT_HOM_AVX512() {
+	bool ag = VAR_GET_HAP0(MOD2(curr_abs_locus), G->Variants[DIV2(curr_abs_locus)]);
+	__m256 _sum8 = _mm256_set1_ps(0.0f);
+	__m512 _match = _mm512_set1_ps(1.0f);
+	__m512 _mismatch = _mm512_set1_ps(M.ed/M.ee);
+	int k = 0, i = 0;
+	for( ; k + 1 < n_cond_haps ; k += 2, i += 2 * HAP_NUMBER) {
+		bool ah0 = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k+0);
+		bool ah1 = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k+1);
+		__m512 _prob = _mm512_mask_blend_ps(AVX512_PAIR_MASK(ag!=ah0, ag!=ah1), _match, _mismatch);
+		_sum8 = _mm256_fmadd_ps(avx512_high8_ps(_prob), _mm256_set1_ps(Kweights[k+1]), _mm256_fmadd_ps(_mm512_castps512_ps256(_prob), _mm256_set1_ps(Kweights[k+0]), _sum8));
+		_mm512_store_ps(&prob[i], _prob);
+	}
+	if (k < n_cond_haps) {
+		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
+		__m256 _prob = _mm256_set1_ps((ag==ah)?1.0f:M.ed/M.ee);
+		_sum8 = _mm256_fmadd_ps(_prob, _mm256_set1_ps(Kweights[k]), _sum8);
+		_mm256_store_ps(&prob[i], _prob);
+	}
+	_mm256_store_ps(&probSumH[0], _sum8);
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+}
+
+inline SIMD_AVX512
+bool haplotype_segment_single::RUN_HOM_AVX512(char rare_allele) {
+	bool ag = VAR_GET_HAP0(MOD2(curr_abs_locus), G->Variants[DIV2(curr_abs_locus)]);
+	if (rare_allele < 0 || ag == rare_allele) {
+		__m256 _sum8 = _mm256_set1_ps(0.0f);
+		__m512 _factor = _mm512_set1_ps(yt / (n_total_haps * probSumT));
+		__m512 _tFreq = avx512_dup8_ps(_mm256_load_ps(&probSumH[0]));
+		_tFreq = _mm512_mul_ps(_tFreq, _factor);
+		__m512 _nt = _mm512_set1_ps(nt / probSumT);
+		__m512 _mismatch = _mm512_set1_ps(M.ed/M.ee);
+		int k = 0, i = 0;
+		for( ; k + 1 < n_cond_haps ; k += 2, i += 2 * HAP_NUMBER) {
+			bool ah0 = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k+0);
+			bool ah1 = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k+1);
+			__m512 _prob = _mm512_load_ps(&prob[i]);
+			_prob = _mm512_fmadd_ps(_prob, _nt, _tFreq);
+			_prob = _mm512_mask_mul_ps(_prob, AVX512_PAIR_MASK(ag!=ah0, ag!=ah1), _prob, _mismatch);
+			_sum8 = _mm256_fmadd_ps(avx512_high8_ps(_prob), _mm256_set1_ps(Kweights[k+1]), _mm256_fmadd_ps(_mm512_castps512_ps256(_prob), _mm256_set1_ps(Kweights[k+0]), _sum8));
+			_mm512_store_ps(&prob[i], _prob);
+		}
+		if (k < n_cond_haps) {
+			bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
+			__m256 _prob = _mm256_load_ps(&prob[i]);
+			_prob = _mm256_fmadd_ps(_prob, _mm512_castps512_ps256(_nt), _mm512_castps512_ps256(_tFreq));
+			if (ag!=ah) _prob = _mm256_mul_ps(_prob, _mm512_castps512_ps256(_mismatch));
+			_sum8 = _mm256_fmadd_ps(_prob, _mm256_set1_ps(Kweights[k]), _sum8);
+			_mm256_store_ps(&prob[i], _prob);
+		}
+		_mm256_store_ps(&probSumH[0], _sum8);
+		probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+		return true;
+	}
+	return false;
+}
+
+inline SIMD_AVX512
+void haplotype_segment_single::COLLAPSE_HOM_AVX512() {
+	bool ag = VAR_GET_HAP0(MOD2(curr_abs_locus), G->Variants[DIV2(curr_abs_locus)]);
+	__m256 _sum8 = _mm256_set1_ps(0.0f);
+	__m512 _tFreq = _mm512_set1_ps(yt / n_total_haps);
+	__m512 _nt = _mm512_set1_ps(nt / probSumT);
+	__m512 _mismatch = _mm512_set1_ps(M.ed/M.ee);
+	int k = 0, i = 0;
+	for( ; k + 1 < n_cond_haps ; k += 2, i += 2 * HAP_NUMBER) {
+		bool ah0 = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k+0);
+		bool ah1 = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k+1);
+		__m512 _prob = _mm512_mask_blend_ps(AVX512_PAIR_MASK(false, true), _mm512_set1_ps(probSumK[k+0]), _mm512_set1_ps(probSumK[k+1]));
+		_prob = _mm512_fmadd_ps(_prob, _nt, _tFreq);
+		_prob = _mm512_mask_mul_ps(_prob, AVX512_PAIR_MASK(ag!=ah0, ag!=ah1), _prob, _mismatch);
+		_sum8 = _mm256_fmadd_ps(avx512_high8_ps(_prob), _mm256_set1_ps(Kweights[k+1]), _mm256_fmadd_ps(_mm512_castps512_ps256(_prob), _mm256_set1_ps(Kweights[k+0]), _sum8));
+		_mm512_store_ps(&prob[i], _prob);
+	}
+	if (k < n_cond_haps) {
+		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
+		__m256 _prob = _mm256_set1_ps(probSumK[k]);
+		_prob = _mm256_fmadd_ps(_prob, _mm512_castps512_ps256(_nt), _mm512_castps512_ps256(_tFreq));
+		if (ag!=ah) _prob = _mm256_mul_ps(_prob, _mm512_castps512_ps256(_mismatch));
+		_sum8 = _mm256_fmadd_ps(_prob, _mm256_set1_ps(Kweights[k]), _sum8);
+		_mm256_store_ps(&prob[i], _prob);
+	}
+	_mm256_store_ps(&probSumH[0], _sum8);
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+}
+
+inline SIMD_AVX512
+void haplotype_segment_single::INIT_AMB_AVX512() {
+	unsigned char amb_code = G->Ambiguous[curr_abs_ambiguous];
+	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
+		g0[h] = HAP_GET(amb_code,h)?M.ed/M.ee:1.0f;
+		g1[h] = HAP_GET(amb_code,h)?1.0f:M.ed/M.ee;
+	}
+	__m256 _sum8 = _mm256_set1_ps(0.0f);
+	__m512 _emit0 = avx512_dup8_ps(_mm256_loadu_ps(&g0[0]));
+	__m512 _emit1 = avx512_dup8_ps(_mm256_loadu_ps(&g1[0]));
+	int k = 0, i = 0;
+	for( ; k + 1 < n_cond_haps ; k += 2, i += 2 * HAP_NUMBER) {
+		bool ah0 = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k+0);
+		bool ah1 = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k+1);
+		__m512 _prob = _mm512_mask_blend_ps(AVX512_PAIR_MASK(ah0, ah1), _emit0, _emit1);
+		_sum8 = _mm256_fmadd_ps(avx512_high8_ps(_prob), _mm256_set1_ps(Kweights[k+1]), _mm256_fmadd_ps(_mm512_castps512_ps256(_prob), _mm256_set1_ps(Kweights[k+0]), _sum8));
+		_mm512_store_ps(&prob[i], _prob);
+	}
+	if (k < n_cond_haps) {
+		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
+		__m256 _prob = _mm256_loadu_ps(ah?&g1[0]:&g0[0]);
+		_sum8 = _mm256_fmadd_ps(_prob, _mm256_set1_ps(Kweights[k]), _sum8);
+		_mm256_store_ps(&prob[i], _prob);
+	}
+	_mm256_store_ps(&probSumH[0], _sum8);
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+}
+
+inline SIMD_AVX512
+void haplotype_segment_single::RUN_AMB_AVX512() {
+	unsigned char amb_code = G->Ambiguous[curr_abs_ambiguous];
+	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
+		g0[h] = HAP_GET(amb_code,h)?M.ed/M.ee:1.0f;
+		g1[h] = HAP_GET(amb_code,h)?1.0f:M.ed/M.ee;
+	}
+	__m256 _sum8 = _mm256_set1_ps(0.0f);
+	__m512 _factor = _mm512_set1_ps(yt / (n_total_haps * probSumT));
+	__m512 _tFreq = avx512_dup8_ps(_mm256_load_ps(&probSumH[0]));
+	_tFreq = _mm512_mul_ps(_tFreq, _factor);
+	__m512 _nt = _mm512_set1_ps(nt / probSumT);
+	__m512 _emit0 = avx512_dup8_ps(_mm256_loadu_ps(&g0[0]));
+	__m512 _emit1 = avx512_dup8_ps(_mm256_loadu_ps(&g1[0]));
+	int k = 0, i = 0;
+	for( ; k + 1 < n_cond_haps ; k += 2, i += 2 * HAP_NUMBER) {
+		bool ah0 = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k+0);
+		bool ah1 = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k+1);
+		__m512 _prob = _mm512_load_ps(&prob[i]);
+		_prob = _mm512_fmadd_ps(_prob, _nt, _tFreq);
+		_prob = _mm512_mul_ps(_prob, _mm512_mask_blend_ps(AVX512_PAIR_MASK(ah0, ah1), _emit0, _emit1));
+		_sum8 = _mm256_fmadd_ps(avx512_high8_ps(_prob), _mm256_set1_ps(Kweights[k+1]), _mm256_fmadd_ps(_mm512_castps512_ps256(_prob), _mm256_set1_ps(Kweights[k+0]), _sum8));
+		_mm512_store_ps(&prob[i], _prob);
+	}
+	if (k < n_cond_haps) {
+		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
+		__m256 _prob = _mm256_load_ps(&prob[i]);
+		_prob = _mm256_fmadd_ps(_prob, _mm512_castps512_ps256(_nt), _mm512_castps512_ps256(_tFreq));
+		_prob = _mm256_mul_ps(_prob, _mm256_loadu_ps(ah?&g1[0]:&g0[0]));
+		_sum8 = _mm256_fmadd_ps(_prob, _mm256_set1_ps(Kweights[k]), _sum8);
+		_mm256_store_ps(&prob[i], _prob);
+	}
+	_mm256_store_ps(&probSumH[0], _sum8);
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+}
+
+inline SIMD_AVX512
+void haplotype_segment_single::COLLAPSE_AMB_AVX512() {
+	unsigned char amb_code = G->Ambiguous[curr_abs_ambiguous];
+	for (int h = 0 ; h < HAP_NUMBER ; h ++) {
+		g0[h] = HAP_GET(amb_code,h)?M.ed/M.ee:1.0f;
+		g1[h] = HAP_GET(amb_code,h)?1.0f:M.ed/M.ee;
+	}
+	__m256 _sum8 = _mm256_set1_ps(0.0f);
+	__m512 _tFreq = _mm512_set1_ps(yt / n_total_haps);
+	__m512 _nt = _mm512_set1_ps(nt / probSumT);
+	__m512 _emit0 = avx512_dup8_ps(_mm256_loadu_ps(&g0[0]));
+	__m512 _emit1 = avx512_dup8_ps(_mm256_loadu_ps(&g1[0]));
+	int k = 0, i = 0;
+	for( ; k + 1 < n_cond_haps ; k += 2, i += 2 * HAP_NUMBER) {
+		bool ah0 = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k+0);
+		bool ah1 = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k+1);
+		__m512 _prob = _mm512_mask_blend_ps(AVX512_PAIR_MASK(false, true), _mm512_set1_ps(probSumK[k+0]), _mm512_set1_ps(probSumK[k+1]));
+		_prob = _mm512_fmadd_ps(_prob, _nt, _tFreq);
+		_prob = _mm512_mul_ps(_prob, _mm512_mask_blend_ps(AVX512_PAIR_MASK(ah0, ah1), _emit0, _emit1));
+		_sum8 = _mm256_fmadd_ps(avx512_high8_ps(_prob), _mm256_set1_ps(Kweights[k+1]), _mm256_fmadd_ps(_mm512_castps512_ps256(_prob), _mm256_set1_ps(Kweights[k+0]), _sum8));
+		_mm512_store_ps(&prob[i], _prob);
+	}
+	if (k < n_cond_haps) {
+		bool ah = Hvar.get(curr_rel_locus+curr_rel_locus_offset, k);
+		__m256 _prob = _mm256_set1_ps(probSumK[k]);
+		_prob = _mm256_fmadd_ps(_prob, _mm512_castps512_ps256(_nt), _mm512_castps512_ps256(_tFreq));
+		_prob = _mm256_mul_ps(_prob, _mm256_loadu_ps(ah?&g1[0]:&g0[0]));
+		_sum8 = _mm256_fmadd_ps(_prob, _mm256_set1_ps(Kweights[k]), _sum8);
+		_mm256_store_ps(&prob[i], _prob);
+	}
+	_mm256_store_ps(&probSumH[0], _sum8);
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+}
+
+inline SIMD_AVX512
+void haplotype_segment_single::RUN_MIS_AVX512() {
+	__m256 _sum8 = _mm256_set1_ps(0.0f);
+	__m512 _factor = _mm512_set1_ps(yt / (n_total_haps * probSumT));
+	__m512 _tFreq = avx512_dup8_ps(_mm256_load_ps(&probSumH[0]));
+	_tFreq = _mm512_mul_ps(_tFreq, _factor);
+	__m512 _nt = _mm512_set1_ps(nt / probSumT);
+	int k = 0, i = 0;
+	for( ; k + 1 < n_cond_haps ; k += 2, i += 2 * HAP_NUMBER) {
+		__m512 _prob = _mm512_load_ps(&prob[i]);
+		_prob = _mm512_fmadd_ps(_prob, _nt, _tFreq);
+		_sum8 = _mm256_fmadd_ps(avx512_high8_ps(_prob), _mm256_set1_ps(Kweights[k+1]), _mm256_fmadd_ps(_mm512_castps512_ps256(_prob), _mm256_set1_ps(Kweights[k+0]), _sum8));
+		_mm512_store_ps(&prob[i], _prob);
+	}
+	if (k < n_cond_haps) {
+		__m256 _prob = _mm256_load_ps(&prob[i]);
+		_prob = _mm256_fmadd_ps(_prob, _mm512_castps512_ps256(_nt), _mm512_castps512_ps256(_tFreq));
+		_sum8 = _mm256_fmadd_ps(_prob, _mm256_set1_ps(Kweights[k]), _sum8);
+		_mm256_store_ps(&prob[i], _prob);
+	}
+	_mm256_store_ps(&probSumH[0], _sum8);
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+}
+
+inline SIMD_AVX512
+void haplotype_segment_single::COLLAPSE_MIS_AVX512() {
+	__m256 _sum8 = _mm256_set1_ps(0.0f);
+	__m512 _tFreq = _mm512_set1_ps(yt / n_total_haps);
+	__m512 _nt = _mm512_set1_ps(nt / probSumT);
+	int k = 0, i = 0;
+	for( ; k + 1 < n_cond_haps ; k += 2, i += 2 * HAP_NUMBER) {
+		__m512 _prob = _mm512_mask_blend_ps(AVX512_PAIR_MASK(false, true), _mm512_set1_ps(probSumK[k+0]), _mm512_set1_ps(probSumK[k+1]));
+		_prob = _mm512_fmadd_ps(_prob, _nt, _tFreq);
+		_sum8 = _mm256_fmadd_ps(avx512_high8_ps(_prob), _mm256_set1_ps(Kweights[k+1]), _mm256_fmadd_ps(_mm512_castps512_ps256(_prob), _mm256_set1_ps(Kweights[k+0]), _sum8));
+		_mm512_store_ps(&prob[i], _prob);
+	}
+	if (k < n_cond_haps) {
+		__m256 _prob = _mm256_set1_ps(probSumK[k]);
+		_prob = _mm256_fmadd_ps(_prob, _mm512_castps512_ps256(_nt), _mm512_castps512_ps256(_tFreq));
+		_sum8 = _mm256_fmadd_ps(_prob, _mm256_set1_ps(Kweights[k]), _sum8);
+		_mm256_store_ps(&prob[i], _prob);
+	}
+	_mm256_store_ps(&probSumH[0], _sum8);
+	probSumT = probSumH[0] + probSumH[1] + probSumH[2] + probSumH[3] + probSumH[4] + probSumH[5] + probSumH[6] + probSumH[7];
+}
+
+#endif
+
 #endif
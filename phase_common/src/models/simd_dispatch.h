@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _SIMD_DISPATCH_H
+#define _SIMD_DISPATCH_H
+
+#include <vector>
+#include <utils/simd_vector.h>
+#include <boost/align/aligned_allocator.hpp>
+
+template <typename T>
+using aligned_vector64 = std::vector<T, boost::alignment::aligned_allocator < T, 64 > >;
+
+#if defined(SIMD_AVX2)
+
+//AVX-512 kernels are compiled through target attributes on top of the AVX2 baseline build and selected at runtime
+#define SIMD_AVX512_DISPATCH
+#define SIMD_AVX512 __attribute__((target("avx512f")))
+#define AVX512_DISPATCH(call) if (avx512) return call
+
+//Lane mask selecting the 8 floats of the first and/or second conditioning haplotype of a 512-bit register
+#define AVX512_PAIR_MASK(b0, b1) ((__mmask16)(((b0)?0x00FF:0)|((b1)?0xFF00:0)))
+
+//Runtime CPU detection, evaluated once per process
+inline
+bool simd_has_avx512() {
+	static const bool avx512 = __builtin_cpu_supports("avx512f");
+	return avx512;
+}
+
+//Upper 8 floats of a 512-bit register
+inline SIMD_AVX512
+__m256 avx512_high8_ps(__m512 v) {
+	return _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1));
+}
+
+//Duplicate 8 floats in the two halves of a 512-bit register
+inline SIMD_AVX512
+__m512 avx512_dup8_ps(__m256 v) {
+	return _mm512_castpd_ps(_mm512_broadcast_f64x4(_mm256_castps_pd(v)));
+}
+
+#else
+
+#define AVX512_DISPATCH(call)
+
+inline
+bool simd_has_avx512() {
+	return false;
+}
+
+#endif
+
+inline
+const char * simd_kernel_name() {
+	return simd_has_avx512()?"AVX512":SIMD_BACKEND_NAME;
+}
+
+#endif
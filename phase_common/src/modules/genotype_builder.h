@@ -24,6 +24,7 @@
 #define _BUILDER_H
 
 #include <utils/otools.h>
+#include <utils/thread_pool.h>
 #include <containers/genotype_set.h>
 
 class genotype_builder {
@@ -32,13 +33,10 @@ public:
 	genotype_set & G;
 
 	//MULTI-THREADING
-	int i_workers;
-	int n_thread;
-	pthread_mutex_t mutex_workers;
-	vector < pthread_t > id_workers;
+	thread_pool & pool;
 
 	//CONSTRUCTOR/DESTRUCTOR
-	genotype_builder(genotype_set &, int n_thread = 1);
+	genotype_builder(genotype_set &, thread_pool &);
 	~genotype_builder();
 
 	//METHODS
@@ -29,9 +29,7 @@
 compute_job::compute_job(variant_map & _V, genotype_set & _G, conditioning_set & _H, unsigned int n_max_transitions, unsigned int n_max_missing) : V(_V), G(_G), H(_H) {
 	T = vector < double > (n_max_transitions, 0.0);
 	M = vector < float > (n_max_missing , 0.0);
-	Ordering = vector < unsigned int > (H.n_hap);
-	iota(Ordering.begin(), Ordering.end(), 0);
-	Oiterator = 0;
+	clearAccumulators();
 }
 
 compute_job::~compute_job() {
@@ -42,20 +40,34 @@ void compute_job::free () {
 	vector < double > ().swap(T);
 	vector < float > ().swap(M);
 	vector < vector < unsigned int > > ().swap(Kstates);
+	vector < vector < float > > ().swap(Kweights);
+	vector < pair < unsigned long, unsigned int > > ().swap(Khashes);
+	vector < int > ().swap(Kprevious);
 	Kbanned.clear();
 	Windows.clear();
 }
 
-void compute_job::make(unsigned int ind, double min_window_size) {
+void compute_job::clearAccumulators() {
+	statK.clear();
+	statW.clear();
+	n_underflow_summing = 0;
+	n_underflow_precision = 0;
+	n_heap_allocations = 0;
+	IBD2.clear();
+}
+
+void compute_job::make(unsigned int ind, double min_window_size, random_stream & R) {
 	//1. Mapping coordinates of each segment
-	int n_windows = Windows.build (V, G.vecG[ind], min_window_size);
+	int n_windows = Windows.build (V, G.vecG[ind], min_window_size, R);
 
 	//2. Update conditional haps
 	unsigned long addr_offset = H.sites_pbwt_ngroups * H.n_ind * 2UL;
-	Kstates = vector < vector < unsigned int > > (n_windows, vector < unsigned int >());
+	if (Kstates.size() < n_windows) Kstates.resize(n_windows);
 	unsigned long curr_hap0 = 2*ind+0, curr_hap1 = 2*ind+1;
 	for (int w = 0 ; w < n_windows ; w++) {
-		vector < int > phap = vector < int > (2 * H.depth, -1);
+		Kstates[w].clear();
+		vector < int > & phap = Kprevious;
+		phap.assign(2 * H.depth, -1);
 		for (int l = Windows.W[w].start_locus ; l <= Windows.W[w].stop_locus ; l++) {
 			if (H.sites_pbwt_selection[l]) {
 				for (int s = 0 ; s < H.depth ; s ++) {
@@ -98,16 +110,15 @@ void compute_job::make(unsigned int ind, double min_window_size) {
 		if (toBeRemoved.size() > 0) {
 			vector < unsigned int > Ktmp; Ktmp.reserve(Kstates[w].size() - toBeRemoved.size());
 			for (int k = 0, p = 0; k < Kstates[w].size() ; k++) {
-				if (toBeRemoved[p] == k) {
+				if (p < toBeRemoved.size() && toBeRemoved[p] == k) {
 					Ktmp.push_back(Kstates[w][k]);
 					p++;
 				}
 			}
 
 			for (int r = 0 ; r < toBeRemoved.size() ; r ++) {
-				int random_state = Ordering[Oiterator];
+				int random_state = R.getInt(H.n_hap);
 				if (random_state/2 != ind) Ktmp.push_back(random_state);
-				Oiterator=((Oiterator+1)==H.n_hap)?0:(Oiterator+1);
 			}
 
 			sort(Ktmp.begin(), Ktmp.end());
@@ -120,13 +131,62 @@ void compute_job::make(unsigned int ind, double min_window_size) {
 	for (int w = 0 ; w < n_windows; w++) {
 		if (Kstates[w].size() < 2) {
 			for (int i = 0 ; i < N_RANDOM_HAPS ; i++) {
-				int random_state = Ordering[Oiterator];
+				int random_state = R.getInt(H.n_hap);
 				if (random_state/2 != ind) Kstates[w].push_back(random_state);
-				Oiterator=((Oiterator+1)==H.n_hap)?0:(Oiterator+1);
 			}
 			sort(Kstates[w].begin(), Kstates[w].end());
 			Kstates[w].erase(unique(Kstates[w].begin(), Kstates[w].end()), Kstates[w].end());
 			vrb.warning("No PBWT states found [" + G.vecG[ind]->name  + " / w=" + stb.str(w) + "] / Using " + stb.str(Kstates[w].size()) + " random states");
 		}
 	}
+
+	//5. Collapse states carrying identical haplotypes within each window
+	if (Kweights.size() < n_windows) Kweights.resize(n_windows);
+	for (int w = 0 ; w < n_windows; w++) collapse(w);
+}
+
+void compute_job::collapse(unsigned int w) {
+	//1. Hash conditioning haplotypes over the columns spanned by the window
+	unsigned long n_bytes_per_row = H.H_opt_hap.n_cols / 8;
+	unsigned int byte_from = Windows.W[w].start_locus / 8, byte_to = Windows.W[w].stop_locus / 8;
+	unsigned char mask_from = 0xFF >> (Windows.W[w].start_locus % 8);
+	unsigned char mask_to = 0xFF << (7 - Windows.W[w].stop_locus % 8);
+	if (byte_from == byte_to) mask_from = mask_to = (mask_from & mask_to);
+	Khashes.resize(Kstates[w].size());
+	for (int k = 0 ; k < Kstates[w].size() ; k++) {
+		unsigned char * row = H.H_opt_hap.bytes + Kstates[w][k] * n_bytes_per_row;
+		unsigned long hash = 14695981039346656037UL;
+		hash = (hash ^ (row[byte_from] & mask_from)) * 1099511628211UL;
+		for (unsigned int b = byte_from + 1 ; b < byte_to ; b ++) hash = (hash ^ row[b]) * 1099511628211UL;
+		hash = (hash ^ (row[byte_to] & mask_to)) * 1099511628211UL;
+		Khashes[k] = pair < unsigned long, unsigned int > (hash, Kstates[w][k]);
+	}
+	sort(Khashes.begin(), Khashes.end());
+
+	//2. Group identical haplotypes, each group is represented by its first state and weighted by its size
+	unsigned int n_groups = 0;
+	Kweights[w].clear();
+	for (int k = 0 ; k < Khashes.size() ; k++) {
+		bool identical = false;
+		if (k > 0 && Khashes[k].first == Khashes[k-1].first) {
+			unsigned char * row0 = H.H_opt_hap.bytes + Khashes[n_groups-1].second * n_bytes_per_row;
+			unsigned char * row1 = H.H_opt_hap.bytes + Khashes[k].second * n_bytes_per_row;
+			identical = ((row0[byte_from] & mask_from) == (row1[byte_from] & mask_from)) && ((row0[byte_to] & mask_to) == (row1[byte_to] & mask_to));
+			identical = identical && (byte_to <= byte_from + 1 || memcmp(row0 + byte_from + 1, row1 + byte_from + 1, byte_to - byte_from - 1) == 0);
+		}
+		if (identical) Kweights[w][n_groups-1] += 1.0f;
+		else {
+			Kweights[w].push_back(1.0f);
+			Khashes[n_groups++] = Khashes[k];
+		}
+	}
+
+	//3. States in increasing order
+	for (int g = 0 ; g < n_groups ; g ++) Khashes[g].first = (unsigned long)Kweights[w][g];
+	sort(Khashes.begin(), Khashes.begin() + n_groups, [](const pair < unsigned long, unsigned int > & a, const pair < unsigned long, unsigned int > & b) { return a.second < b.second; });
+	Kstates[w].resize(n_groups);
+	for (int g = 0 ; g < n_groups ; g ++) {
+		Kstates[w][g] = Khashes[g].second;
+		Kweights[w][g] = Khashes[g].first;
+	}
 }
@@ -47,22 +47,30 @@ public:
 	//Windows
 	window_set Windows;
 
-	//States
+	//States [buffers are reused across jobs, only the first size() windows are valid]
 	vector < track > Kbanned;
 	vector < vector < unsigned int > > Kstates;
+	vector < vector < float > > Kweights;
+	vector < pair < unsigned long, unsigned int > > Khashes;
+	vector < int > Kprevious;
 
-	//Random states
-	vector < unsigned int > Ordering;
-	int Oiterator;
-
-
+	//Scratch memory for sampling / pruning genotypes
+	genotype_scratch Scratch;
 
+	//Per-thread accumulators [merged once all jobs are done]
+	basic_stats statK, statW;
+	int n_underflow_summing;
+	int n_underflow_precision;
+	unsigned long n_heap_allocations;
+	vector < pair < int, track > > IBD2;
 
 	compute_job(variant_map & , genotype_set & , conditioning_set & , unsigned int n_max_transitions , unsigned int n_max_missing);
 	~compute_job();
 
 	void free();
-	void make(unsigned int, double);
+	void clearAccumulators();
+	void make(unsigned int, double, random_stream &);
+	void collapse(unsigned int);
 	unsigned int size();
 };
 
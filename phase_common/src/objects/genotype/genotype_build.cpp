@@ -58,7 +58,7 @@ void genotype::build() {
 
 	//2. Build Segments
 	n_rel_unf = 0; n_rel_var = 0; n_rel_sca = 0; n_abs_seg = 0; n_abs_amb = 0; n_rel_amb = 0; n_abs_mis = 0;
-	Lengths = vector < unsigned short > (n_segments, 0U);
+	Lengths = Arena->allocate < unsigned short > (n_segments);
 	for (unsigned int v = 0 ; v < n_variants ;) {
 		bool f_sca = VAR_GET_SCA(MOD2(v),Variants[DIV2(v)]);
 		bool f_het = VAR_GET_HET(MOD2(v),Variants[DIV2(v)]);
@@ -85,7 +85,7 @@ void genotype::build() {
 	Lengths[n_abs_seg] = n_rel_var;
 
 	//3. Build Ambiguous
-	Ambiguous = vector < unsigned char >(n_ambiguous, 0U);
+	Ambiguous = Arena->allocate < unsigned char > (n_ambiguous);
 	vector < unsigned char > orderedSegments = vector < unsigned char >(n_segments, 0);
 	for (unsigned int s = 0, a0 = 0, a1 = 0, a2 = 0, vabs = 0 ; s < n_segments ; s ++) {
 		for (unsigned int vrel = 0 ; vrel < Lengths[s] ; vrel ++) {
@@ -117,7 +117,7 @@ void genotype::build() {
 	}
 
 	//4. Build Diplotypes
-	Diplotypes = vector < unsigned long > (n_segments);
+	Diplotypes = Arena->allocate < unsigned long > (n_segments);
 	for (unsigned int s = 0, vabs = 0, a = 0 ; s < n_segments ; s ++) {
 		unsigned int n_unf = orderedSegments[s];
 		Diplotypes[s]=n_unf?MASK_SCAF:MASK_INIT;
@@ -139,4 +139,29 @@ void genotype::build() {
 
 	//5. Count transitions
 	n_transitions = countTransitions();
+
+	//6. Map segment coordinates
+	mapLayout();
+}
+
+void genotype::mapLayout() {
+	unsigned int n_entries = (n_segments + 1) * LAYOUT_STRIDE;
+	if (Layout.size() < n_entries) Layout = Arena->allocate < unsigned int > (n_entries);
+	else Layout.shrink(n_entries);
+	unsigned int prev_dipcount = 1;
+	for (unsigned int s = 0, v = 0, a = 0, m = 0, t = 0 ; s <= n_segments ; s ++) {
+		Layout[s * LAYOUT_STRIDE + LAYOUT_LOC] = v;
+		Layout[s * LAYOUT_STRIDE + LAYOUT_AMB] = a;
+		Layout[s * LAYOUT_STRIDE + LAYOUT_MIS] = m;
+		Layout[s * LAYOUT_STRIDE + LAYOUT_TRA] = t;
+		if (s == n_segments) break;
+		for (unsigned int vrel = 0 ; vrel < Lengths[s] ; vrel ++) {
+			a += VAR_GET_AMB(MOD2(v+vrel), Variants[DIV2(v+vrel)]);
+			m += VAR_GET_MIS(MOD2(v+vrel), Variants[DIV2(v+vrel)]);
+		}
+		v += Lengths[s];
+		unsigned int curr_dipcount = countDiplotypes(Diplotypes[s]);
+		t += prev_dipcount * curr_dipcount;
+		prev_dipcount = curr_dipcount;
+	}
 }
@@ -24,6 +24,7 @@
 #define _GENOTYPE_H
 
 #include <utils/otools.h>
+#include <utils/slab_allocator.h>
 
 //Macros for packing/unpacking diplotypes
 #define DIP_GET(dip,idx)	(((dip)>>(idx))&1UL)
@@ -54,6 +55,17 @@
 #define VAR_SET_HAP1(e,v)	((v)|=(8<<((e)<<2)))
 #define VAR_CLR_HAP1(e,v)	((e)?((v)&=127):((v)&=247))
 
+//Sparse index of stored transitions: one byte per stored transition giving the gap to the previous one, 0 meaning a skip of PINDEX_SKIP
+#define PINDEX_SKIP			255
+#define PINDEX_NONE			0xFFFFFFFFU
+
+//Offsets of the first variant / ambiguous / missing / transition of a segment in the Layout array
+#define LAYOUT_LOC			0
+#define LAYOUT_AMB			1
+#define LAYOUT_MIS			2
+#define LAYOUT_TRA			3
+#define LAYOUT_STRIDE		4
+
 
 
 #define MASK_INIT	0xFFFFFFFFFFFFFFFFUL
@@ -62,6 +74,44 @@
 #define MASK_UNF1	0x3333CCCC3333CCCCUL
 #define MASK_UNF2	0x0F0F0F0FF0F0F0F0UL
 
+class Transition {
+public:
+	double prob;
+	unsigned int idx;
+	Transition() { prob = 0.0; idx = 0;}
+	~Transition() {}
+	bool operator < (const Transition & t) const { return prob > t.prob; }
+};
+
+class TransStatistics {
+public:
+	double entropy;
+	unsigned int idx;
+	bool merged;
+	TransStatistics() {entropy = 1000; idx = -1; merged = false; }
+	~TransStatistics() {};
+	bool operator < (const TransStatistics & s) const { return entropy < s.entropy; }
+};
+
+//Per-thread working memory for sampling, pruning and solving genotypes.
+//Buffers only grow, so that once warmed up on the largest genotype, these routines do not touch the heap anymore.
+class genotype_scratch {
+public:
+	vector < double > currProbs;				// Probabilities of the candidate diplotypes in a segment [64*64]
+	vector < unsigned char > DipSampled;		// Diplotype sampled / solved per segment
+	vector < double > maxProbs;					// Viterbi probabilities [n_segments x 64]
+	vector < unsigned char > maxIndexes;		// Viterbi back pointers [n_segments x 64]
+	vector < Transition > vecTransitions;		// Transitions of a segment pair sorted by probability [64*64]
+	vector < TransStatistics > vecTransStatistics;	// Merge statistics per pair of consecutive segments
+	vector < bool > flagMerges;					// Merges to be performed
+	vector < unsigned char > Ambiguous;			// Pruned Ambiguous
+	vector < unsigned long > Diplotypes;		// Pruned Diplotypes
+	vector < unsigned short > Lengths;			// Pruned Lengths
+
+	genotype_scratch() : currProbs(64 * 64, 0.0), vecTransitions(64 * 64) {}
+	~genotype_scratch() {}
+};
+
 
 class genotype {
 public:
@@ -78,32 +128,35 @@ public:
 	unsigned char curr_dipcodes [64];		// List of diplotypes in a given segment (buffer style variable)
 	unsigned char curr_hapcodes [16];		// List of diplotypes in a given segment (buffer style variable)
 	bool double_precision;
+	slab_allocator * Arena;					// Where the arrays below live
 
 
 	// VARIANT / HAPLOTYPE / DIPLOTYPE DATA
-	vector < unsigned char > Variants;		// 0.5 byte per variant
-	vector < unsigned char > Ambiguous;		// 1 byte per ambiguous variant
-	vector < unsigned long > Diplotypes;	// 8 bytes per segment
-	vector < unsigned short > Lengths;		// 2 bytes per segment
+	slab_array < unsigned char > Variants;		// 0.5 byte per variant
+	slab_array < unsigned char > Ambiguous;		// 1 byte per ambiguous variant
+	slab_array < unsigned long > Diplotypes;	// 8 bytes per segment
+	slab_array < unsigned short > Lengths;		// 2 bytes per segment
+	slab_array < unsigned int > Layout;			// 16 bytes per segment [LAYOUT_*], updated each time the graph changes
 
 	//PHASE PROBS
-	vector < bool > ProbMask;
-	vector < float > ProbStored;
-	vector < float > ProbMissing;
+	slab_array < unsigned char > ProbIndex;		// ~1 byte per stored transition [PINDEX_*]
+	slab_array < float > ProbStored;
+	slab_array < float > ProbMissing;
 
 	//METHODS
-	genotype(unsigned int);
+	genotype(unsigned int, slab_allocator *);
 	~genotype();
 	void free();
-	void make(vector < unsigned char > &, vector < float > &);
+	void make(vector < unsigned char > &, vector < float > &, random_stream &);
 	void make(vector < unsigned char > &);
 	void build();
-	void sample(vector < double > &, vector < float > &);
-	void sampleForward(vector < double > &, vector < float > &);
-	void sampleBackward(vector < double > &, vector < float > &);
-	void solve();
-	void mapMerges(vector < double > &, double , vector < bool > &);
-	void performMerges(vector < double > &, vector < bool > &);
+	void mapLayout();
+	void sample(vector < double > &, vector < float > &, genotype_scratch &, random_stream &);
+	void sampleForward(vector < double > &, vector < float > &, genotype_scratch &, random_stream &);
+	void sampleBackward(vector < double > &, vector < float > &, genotype_scratch &, random_stream &);
+	void solve(genotype_scratch &);
+	void mapMerges(vector < double > &, double , genotype_scratch &);
+	void performMerges(vector < double > &, genotype_scratch &);
 	void store(vector < double > &, vector < float > &);
 	void scaffoldTrio(genotype *, genotype *, vector < unsigned int > &);
 	void scaffoldDuoFather(genotype *, vector < unsigned int > &);
@@ -114,8 +167,16 @@ public:
 	void makeDiplotypes(unsigned long);
 	unsigned int countTransitions();
 	bool isOrdered(unsigned long _dip);
+	unsigned int nextStoredTransition(unsigned int &, unsigned int);
 };
 
+//Returns the stored transition following t [PINDEX_NONE for the first one] and moves the read position i in ProbIndex past it
+inline
+unsigned int genotype::nextStoredTransition(unsigned int & i, unsigned int t) {
+	while (!ProbIndex[i]) { t += PINDEX_SKIP; i ++; }
+	return t + ProbIndex[i++];
+}
+
 inline
 bool genotype::isOrdered(unsigned long _dip) {
     fill(begin(curr_hapcodes), begin(curr_hapcodes)+16, 0);
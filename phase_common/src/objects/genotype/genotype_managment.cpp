@@ -22,8 +22,9 @@
 
 #include <objects/genotype/genotype_header.h>
 
-genotype::genotype(unsigned int _index) {
+genotype::genotype(unsigned int _index, slab_allocator * _Arena) {
 	index = _index;
+	Arena = _Arena;
 	n_segments = 0;
 	n_variants = 0;
 	n_ambiguous = 0;
@@ -41,20 +42,24 @@ genotype::~genotype() {
 void genotype::free() {
 	std::fill(curr_dipcodes, curr_dipcodes + 64, 0);
 	name = "";
-	vector < unsigned char > ().swap(Variants);
-	vector < unsigned char > ().swap(Ambiguous);
-	vector < unsigned long > ().swap(Diplotypes);
-	vector < unsigned short > ().swap(Lengths);
+	Variants.clear();
+	Ambiguous.clear();
+	Diplotypes.clear();
+	Lengths.clear();
+	Layout.clear();
+	ProbIndex.clear();
+	ProbStored.clear();
+	ProbMissing.clear();
 }
 
-void genotype::make(vector < unsigned char > & DipSampled, vector < float > & CurrentMissingProbabilities) {
+void genotype::make(vector < unsigned char > & DipSampled, vector < float > & CurrentMissingProbabilities, random_stream & R) {
 	for (unsigned int s = 0, vabs = 0, a = 0, m = 0 ; s < n_segments ; s ++) {
 		unsigned char hap0 = DIP_HAP0(DipSampled[s]);
 		unsigned char hap1 = DIP_HAP1(DipSampled[s]);
 		for (unsigned int vrel = 0 ; vrel < Lengths[s] ; vrel++, vabs++) {
 			if (VAR_GET_MIS(MOD2(vabs), Variants[DIV2(vabs)])) {
-				(rng.getDouble()<=CurrentMissingProbabilities[m*HAP_NUMBER+hap0])?VAR_SET_HAP0(MOD2(vabs),Variants[DIV2(vabs)]):VAR_CLR_HAP0(MOD2(vabs),Variants[DIV2(vabs)]);
-				(rng.getDouble()<=CurrentMissingProbabilities[m*HAP_NUMBER+hap1])?VAR_SET_HAP1(MOD2(vabs),Variants[DIV2(vabs)]):VAR_CLR_HAP1(MOD2(vabs),Variants[DIV2(vabs)]);
+				(R.getDouble()<=CurrentMissingProbabilities[m*HAP_NUMBER+hap0])?VAR_SET_HAP0(MOD2(vabs),Variants[DIV2(vabs)]):VAR_CLR_HAP0(MOD2(vabs),Variants[DIV2(vabs)]);
+				(R.getDouble()<=CurrentMissingProbabilities[m*HAP_NUMBER+hap1])?VAR_SET_HAP1(MOD2(vabs),Variants[DIV2(vabs)]):VAR_CLR_HAP1(MOD2(vabs),Variants[DIV2(vabs)]);
 				//(CurrentMissingProbabilities[m*HAP_NUMBER+hap0]>0.5f)?VAR_SET_HAP0(MOD2(vabs),Variants[DIV2(vabs)]):VAR_CLR_HAP0(MOD2(vabs),Variants[DIV2(vabs)]);
 				//(CurrentMissingProbabilities[m*HAP_NUMBER+hap1]>0.5f)?VAR_SET_HAP1(MOD2(vabs),Variants[DIV2(vabs)]):VAR_CLR_HAP1(MOD2(vabs),Variants[DIV2(vabs)]);
 				m++;
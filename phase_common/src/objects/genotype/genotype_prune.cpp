@@ -22,28 +22,11 @@
 
 #include <objects/genotype/genotype_header.h>
 
-class Transition {
-public:
-	double prob;
-	unsigned int idx;
-	Transition() { prob = 0.0; idx = 0;}
-	~Transition() {}
-	bool operator < (const Transition & t) const { return prob > t.prob; }
-};
-
-class TransStatistics {
-public:
-	double entropy;
-	unsigned int idx;
-	bool merged;
-	TransStatistics() {entropy = 1000; idx = -1; merged = false; }
-	~TransStatistics() {};
-	bool operator < (const TransStatistics & s) const { return entropy < s.entropy; }
-};
-
-void genotype::mapMerges(vector < double > & currProbs, double thresholdProbMass, vector < bool > & flagMerges) {
-	vector < TransStatistics > vecTransStatistics = vector < TransStatistics > (n_segments - 1);
-	vector < Transition > vecTransitions = vector < Transition > (4096);
+void genotype::mapMerges(vector < double > & currProbs, double thresholdProbMass, genotype_scratch & S) {
+	vector < TransStatistics > & vecTransStatistics = S.vecTransStatistics;
+	vector < Transition > & vecTransitions = S.vecTransitions;
+	vector < bool > & flagMerges = S.flagMerges;
+	vecTransStatistics.resize(n_segments - 1);
 
 	//Step0: initialize cursors
 	unsigned int prev_dipcount = countDiplotypes(Diplotypes[0]);
@@ -90,7 +73,8 @@ void genotype::mapMerges(vector < double > & currProbs, double thresholdProbMass
 				}
 				//Step7: check that 8 haplotypes capture lots of the cumulative probability mass
 				double cumSumProbs = 0.0;
-				vector < int > Mhaps = vector < int >(HAP_NUMBER * HAP_NUMBER, -1);
+				int Mhaps [HAP_NUMBER * HAP_NUMBER];
+				std::fill(Mhaps, Mhaps + HAP_NUMBER * HAP_NUMBER, -1);
 				for (int t = 0, n_haps = 0 ; t < n_curr_transitions ; t ++) {
 					cumSumProbs += vecTransitions[t].prob;
 					unsigned int prev_dip = prev_dipcodes[vecTransitions[t].idx/curr_dipcount];
@@ -121,7 +105,7 @@ void genotype::mapMerges(vector < double > & currProbs, double thresholdProbMass
 	}
 	//Step9: map acceptable merges
 	sort(vecTransStatistics.begin(), vecTransStatistics.end());
-	flagMerges = vector < bool > (n_segments+1, false);
+	flagMerges.assign(n_segments+1, false);
 	for (unsigned int s = 0 ; s < vecTransStatistics.size() ; s ++) {
 		bool no_adjacent_merges = !flagMerges[vecTransStatistics[s].idx-1] && !flagMerges[vecTransStatistics[s].idx+1];
 		bool can_be_merged = vecTransStatistics[s].merged;
@@ -129,15 +113,19 @@ void genotype::mapMerges(vector < double > & currProbs, double thresholdProbMass
 	}
 }
 
-void genotype::performMerges(vector < double > & currProbs, vector < bool > & flagMerges) {
-	vector < Transition > vecTransitions = vector < Transition > (4096);
+void genotype::performMerges(vector < double > & currProbs, genotype_scratch & S) {
+	vector < Transition > & vecTransitions = S.vecTransitions;
+	vector < bool > & flagMerges = S.flagMerges;
 
 	//Step0: initialize duplicates
-	vector < unsigned char > Ambiguous2 = vector < unsigned char > (Ambiguous.size(), 0);
-	vector < unsigned long > Diplotypes2;
-	vector < unsigned short > Lengths2;
+	vector < unsigned char > & Ambiguous2 = S.Ambiguous;
+	vector < unsigned long > & Diplotypes2 = S.Diplotypes;
+	vector < unsigned short > & Lengths2 = S.Lengths;
 	unsigned int n_segments2 = n_segments;
 	for (int s = 0 ; s < flagMerges.size() ; s++) n_segments2 -= flagMerges[s];
+	Ambiguous2.assign(Ambiguous.size(), 0);
+	Diplotypes2.clear();
+	Lengths2.clear();
 	Diplotypes2.reserve(n_segments2);
 	Lengths2.reserve(n_segments2);
 
@@ -165,7 +153,8 @@ void genotype::performMerges(vector < double > & currProbs, vector < bool > & fl
 			for (int t = 0 ; t < n_curr_transitions ; t ++) { vecTransitions[t].prob = currProbs[toffset + t]; vecTransitions[t].idx = t; }
 			sort(vecTransitions.begin(), vecTransitions.begin() + n_curr_transitions);
 			int n_haps = 0;
-			vector < int > Mhaps = vector < int >(HAP_NUMBER * HAP_NUMBER, -1);
+			int Mhaps [HAP_NUMBER * HAP_NUMBER];
+			std::fill(Mhaps, Mhaps + HAP_NUMBER * HAP_NUMBER, -1);
 			for (int t = 0 ; t < n_curr_transitions ; t ++) {
 				unsigned int prev_dip = prev_dipcodes[vecTransitions[t].idx/curr_dipcount];
 				unsigned int next_dip = curr_dipcodes[vecTransitions[t].idx%curr_dipcount];
@@ -233,12 +222,13 @@ void genotype::performMerges(vector < double > & currProbs, vector < bool > & fl
 		Diplotypes2.push_back(Diplotypes.back());
 	}
 
-	//free();
-	Ambiguous = Ambiguous2;
-	Diplotypes = Diplotypes2;
-	Lengths = Lengths2;
+	//Copy back in place, which fits since a genotype only shrinks when pruned
+	Ambiguous.copyFrom(Ambiguous2);
+	Diplotypes.copyFrom(Diplotypes2);
+	Lengths.copyFrom(Lengths2);
 	n_segments = n_segments2;
 	n_transitions = countTransitions();
+	mapLayout();
 
 	/*
 	for (int s = 0 ; s < n_segments ; s++) {
@@ -22,38 +22,38 @@
 
 #include <objects/genotype/genotype_header.h>
 
-void genotype::sample(vector < double > & CurrentTransProbabilities, vector < float > & CurrentMissingProbabilities) {
-	if (rng.getDouble() < 0.5f) sampleForward(CurrentTransProbabilities, CurrentMissingProbabilities);
-	else sampleBackward(CurrentTransProbabilities, CurrentMissingProbabilities);
+void genotype::sample(vector < double > & CurrentTransProbabilities, vector < float > & CurrentMissingProbabilities, genotype_scratch & S, random_stream & R) {
+	if (R.getDouble() < 0.5f) sampleForward(CurrentTransProbabilities, CurrentMissingProbabilities, S, R);
+	else sampleBackward(CurrentTransProbabilities, CurrentMissingProbabilities, S, R);
 }
 
-void genotype::sampleForward(vector < double > & CurrentTransProbabilities, vector < float > & CurrentMissingProbabilities) {
+void genotype::sampleForward(vector < double > & CurrentTransProbabilities, vector < float > & CurrentMissingProbabilities, genotype_scratch & S, random_stream & R) {
 	double sumProbs = 0.0;
 	unsigned int prev_sampled = 0;
 	unsigned int curr_dipcount = 0, prev_dipcount = 1;
-	vector < double > currProbs = vector < double > (64, 0.0);
-	vector < unsigned char > DipSampled = vector < unsigned char >(n_segments, 0);
+	double * currProbs = S.currProbs.data();
+	S.DipSampled.assign(n_segments, 0);
 	for (unsigned int s = 0, toffset = 0 ; s < n_segments ; s ++) {
 		sumProbs = 0.0;
 		curr_dipcount = countDiplotypes(Diplotypes[s]);
 		for (unsigned int tabs = toffset + prev_sampled*curr_dipcount, trel = 0 ; trel < curr_dipcount ; ++trel, ++tabs)
 			sumProbs += (currProbs[trel] = CurrentTransProbabilities[tabs]);
-		prev_sampled = rng.sample(currProbs, sumProbs);
+		prev_sampled = R.sample(currProbs, curr_dipcount, sumProbs);
 		makeDiplotypes(Diplotypes[s]);
-		DipSampled[s] = curr_dipcodes[prev_sampled];
+		S.DipSampled[s] = curr_dipcodes[prev_sampled];
 		toffset += prev_dipcount * curr_dipcount;
 		prev_dipcount = curr_dipcount;
 	}
-	make(DipSampled, CurrentMissingProbabilities);
+	make(S.DipSampled, CurrentMissingProbabilities, R);
 }
 
-void genotype::sampleBackward(vector < double > & CurrentTransProbabilities, vector < float > & CurrentMissingProbabilities) {
+void genotype::sampleBackward(vector < double > & CurrentTransProbabilities, vector < float > & CurrentMissingProbabilities, genotype_scratch & S, random_stream & R) {
 
 	double sumProbs = 0.0;
 	int next_sampled = -1;
 	unsigned int curr_dipcount = 0, next_dipcount = countDiplotypes(Diplotypes[n_segments - 1]);
-	vector < double > currProbs = vector < double > (64 * 64, 0.0);
-	vector < unsigned char > DipSampled = vector < unsigned char >(n_segments, 0);
+	double * currProbs = S.currProbs.data();
+	S.DipSampled.assign(n_segments, 0);
 
 	for (int s = n_segments - 2, toffset = n_transitions ; s >= 0 ; s --) {
 		sumProbs = 0.0;
@@ -61,79 +61,95 @@ void genotype::sampleBackward(vector < double > & CurrentTransProbabilities, vec
 		toffset -= next_dipcount * curr_dipcount;
 
 		if (next_sampled >= 0) {
-			currProbs.resize(64);
 			for (unsigned int tabs = toffset+next_sampled, trel = 0 ; trel < curr_dipcount ; ++trel, tabs += next_dipcount)
 				sumProbs += (currProbs[trel] = CurrentTransProbabilities[tabs]);
-			next_sampled = rng.sample(currProbs, sumProbs);
+			next_sampled = R.sample(currProbs, curr_dipcount, sumProbs);
 			makeDiplotypes(Diplotypes[s]);
-			DipSampled[s] = curr_dipcodes[next_sampled];
+			S.DipSampled[s] = curr_dipcodes[next_sampled];
 		} else {
 			for (unsigned int tabs = toffset, trel = 0 ; tabs < n_transitions ; ++trel, ++tabs)
 				sumProbs += (currProbs[trel] = CurrentTransProbabilities[tabs]);
-			next_sampled = rng.sample(currProbs, sumProbs);
+			next_sampled = R.sample(currProbs, n_transitions - toffset, sumProbs);
 			makeDiplotypes(Diplotypes[s+1]);
-			DipSampled[s+1] = curr_dipcodes[next_sampled % next_dipcount];
+			S.DipSampled[s+1] = curr_dipcodes[next_sampled % next_dipcount];
 			makeDiplotypes(Diplotypes[s]);
 			next_sampled = next_sampled / next_dipcount;
-			DipSampled[s] = curr_dipcodes[next_sampled];
+			S.DipSampled[s] = curr_dipcodes[next_sampled];
 		}
 		next_dipcount = curr_dipcount;
 	}
-	make(DipSampled, CurrentMissingProbabilities);
+	make(S.DipSampled, CurrentMissingProbabilities, R);
 }
 
-void genotype::solve() {
+void genotype::solve(genotype_scratch & S) {
 	unsigned int curr_dipcount = 0, prev_dipcount = 1;
-	vector < vector < double > > maxProbs = vector < vector < double > > (n_segments, vector < double > ());
-	vector < vector < int > > maxIndexes = vector < vector < int > > (n_segments, vector < int > ());
+	S.maxProbs.resize(n_segments * 64);
+	S.maxIndexes.resize(n_segments * 64);
 
+	unsigned int iidx = 0, tnext = n_stored_transitionProbs?nextStoredTransition(iidx, PINDEX_NONE):PINDEX_NONE;
 	for (int s = 0, toffset = 0, trel = 0 ; s < n_segments ; s ++) {
 		curr_dipcount = countDiplotypes(Diplotypes[s]);
-		maxProbs[s] = vector < double > (curr_dipcount, 0.0);
-		maxIndexes[s] = vector < int > (curr_dipcount, 0);
+		double * currMaxProbs = &S.maxProbs[s * 64];
+		double * prevMaxProbs = s?&S.maxProbs[(s - 1) * 64]:NULL;
+		unsigned char * currMaxIndexes = &S.maxIndexes[s * 64];
+		std::fill(currMaxProbs, currMaxProbs + curr_dipcount, 0.0);
+		std::fill(currMaxIndexes, currMaxIndexes + curr_dipcount, 0);
 		for (int t = 0 ; t < prev_dipcount * curr_dipcount ; t++) {
 			int prev_dip = t/curr_dipcount;
 			int next_dip = t%curr_dipcount;
-			//double currProb = (s?maxProbs[s-1][prev_dip]:1.0) * StoredProbs[t+toffset];
-			double currProb = (s?maxProbs[s-1][prev_dip]:1.0) * (ProbMask[t+toffset]?ProbStored[trel++]:1e-6);
-			if (currProb > maxProbs[s][next_dip]) {
-				maxProbs[s][next_dip] = currProb;
-				maxIndexes[s][next_dip] = prev_dip;
+			double transProb = 1e-6;
+			if (t+toffset == tnext) {
+				transProb = ProbStored[trel++];
+				tnext = (trel < n_stored_transitionProbs)?nextStoredTransition(iidx, tnext):PINDEX_NONE;
+			}
+			double currProb = (s?prevMaxProbs[prev_dip]:1.0) * transProb;
+			if (currProb > currMaxProbs[next_dip]) {
+				currMaxProbs[next_dip] = currProb;
+				currMaxIndexes[next_dip] = prev_dip;
 			}
 		}
 		double sumProb = 0.0;
-		for (int d = 0 ; d < curr_dipcount ; d ++) sumProb += maxProbs[s][d];
-		for (int d = 0 ; d < curr_dipcount ; d ++) maxProbs[s][d] /= sumProb;
+		for (int d = 0 ; d < curr_dipcount ; d ++) sumProb += currMaxProbs[d];
+		for (int d = 0 ; d < curr_dipcount ; d ++) currMaxProbs[d] /= sumProb;
 		toffset += prev_dipcount * curr_dipcount;
 		prev_dipcount = curr_dipcount;
 	}
 
-	vector < unsigned char > DipSampled = vector < unsigned char >(n_segments, 0);
-	unsigned int bestDip = alg.imax(maxProbs.back());
+	S.DipSampled.assign(n_segments, 0);
+	double * lastMaxProbs = &S.maxProbs[(n_segments - 1) * 64];
+	unsigned int bestDip = std::max_element(lastMaxProbs, lastMaxProbs + curr_dipcount) - lastMaxProbs;
 	makeDiplotypes(Diplotypes.back());
-	DipSampled.back() = curr_dipcodes[bestDip];
-	for (int s = DipSampled.size() - 2 ; s >= 0 ; s --) {
-		bestDip = maxIndexes[s+1][bestDip];
+	S.DipSampled[n_segments - 1] = curr_dipcodes[bestDip];
+	for (int s = n_segments - 2 ; s >= 0 ; s --) {
+		bestDip = S.maxIndexes[(s+1) * 64 + bestDip];
 		makeDiplotypes(Diplotypes[s]);
-		DipSampled[s] = curr_dipcodes[bestDip];
+		S.DipSampled[s] = curr_dipcodes[bestDip];
 	}
-	make(DipSampled);
+	make(S.DipSampled);
 }
 
 void genotype::store(vector < double > & CurrentTransProbabilities, vector < float > & CurrentMissingProbabilities) {
-	if (ProbMask.size() == 0) {
+	if (n_storage_events == 0) {
+		unsigned int n_index_bytes = 0;
 		n_stored_transitionProbs = 0;
-		ProbMask = vector < bool > (n_transitions, false);
-		for (unsigned int t = 0 ; t < n_transitions ; t ++) if (CurrentTransProbabilities[t] >= 1e-6) {
+		for (unsigned int t = 0, tprev = PINDEX_NONE ; t < n_transitions ; t ++) if (CurrentTransProbabilities[t] >= 1e-6) {
+			n_index_bytes += (t - tprev - 1) / PINDEX_SKIP + 1;
 			n_stored_transitionProbs ++;
-			ProbMask[t] = true;
+			tprev = t;
+		}
+		ProbIndex = Arena->allocate < unsigned char > (n_index_bytes);
+		for (unsigned int t = 0, tprev = PINDEX_NONE, i = 0 ; t < n_transitions ; t ++) if (CurrentTransProbabilities[t] >= 1e-6) {
+			unsigned int gap = t - tprev;
+			for ( ; gap > PINDEX_SKIP ; gap -= PINDEX_SKIP) ProbIndex[i++] = 0;
+			ProbIndex[i++] = gap;
+			tprev = t;
 		}
-		ProbStored = vector  < float > (n_stored_transitionProbs, 0.0);
-		ProbMissing = vector < float > (n_missing * HAP_NUMBER, 0.0);
+		ProbStored = Arena->allocate < float > (n_stored_transitionProbs);
+		ProbMissing = Arena->allocate < float > (n_missing * HAP_NUMBER);
 	}
-	for (unsigned int t = 0, trel = 0 ; t < n_transitions ; t ++) {
-		if (ProbMask[t]) ProbStored[trel++] += CurrentTransProbabilities[t];
-		//if (!ProbMask[t] && CurrentTransProbabilities[t] > 0.01) cout << "Should be stored " << CurrentTransProbabilities[t] << endl;
+	for (unsigned int trel = 0, t = PINDEX_NONE, i = 0 ; trel < n_stored_transitionProbs ; trel ++) {
+		t = nextStoredTransition(i, t);
+		ProbStored[trel] += CurrentTransProbabilities[t];
 	}
 	for (unsigned int m = 0 ; m < (n_missing * HAP_NUMBER) ; m ++) ProbMissing[m] += CurrentMissingProbabilities[m];
 	n_storage_events ++;
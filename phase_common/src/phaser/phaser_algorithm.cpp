@@ -22,51 +22,42 @@
 
 #include <phaser/phaser_header.h>
 
-void * phaseWindow_callback(void * ptr) {
-	phaser * S = static_cast< phaser * >( ptr );
-	int id_worker, id_job;
-	pthread_mutex_lock(&S->mutex_workers);
-	id_worker = S->i_workers ++;
-	pthread_mutex_unlock(&S->mutex_workers);
-	for(;;) {
-		pthread_mutex_lock(&S->mutex_workers);
-		id_job = S->i_jobs ++;
-		if (id_job <= S->G.n_ind) vrb.progress("  * HMM computations", id_job*1.0/S->G.n_ind);
-		pthread_mutex_unlock(&S->mutex_workers);
-		if (id_job < S->G.n_ind) S->phaseWindow(id_worker, id_job);
-		else pthread_exit(NULL);
-	}
-}
-
 void phaser::phaseWindow(int id_worker, int id_job) {
-	threadData[id_worker].make(id_job, options["hmm-window"].as < double > ());
+	//Random streams of this job, keyed by iteration and sample so that they do not depend on the worker running it
+	random_stream Rwindows (options["seed"].as < int > (), iteration_index, id_job, RSTREAM_WINDOWS);
+	random_stream Rsampling (options["seed"].as < int > (), iteration_index, id_job, RSTREAM_SAMPLING);
+
+	threadData[id_worker].make(id_job, options["hmm-window"].as < double > (), Rwindows);
+
+	//Average number of conditioning states per variant, used to schedule this job at next iteration
+	double Kwork = 0.0;
+	for (int w = 0 ; w < threadData[id_worker].size() ; w ++) Kwork += threadData[id_worker].Kstates[w].size() * (threadData[id_worker].Windows.W[w].stop_locus - threadData[id_worker].Windows.W[w].start_locus + 1.0);
+	jobKsizes[id_job] = Kwork / V.size();
 
 	//HMM compute in windows
 	for (int w = 0 ; w < threadData[id_worker].size() ; w ++) {
-		if (options["thread"].as < int > () > 1) pthread_mutex_lock(&mutex_workers);
-		statH.push(threadData[id_worker].Kstates[w].size()*1.0);
-		statS.push(threadData[id_worker].Windows.W[w].lengthBP(V) * 1.0e-6);
-		if (options["thread"].as < int > () > 1) pthread_mutex_unlock(&mutex_workers);
+		threadData[id_worker].statK.push(threadData[id_worker].Kstates[w].size()*1.0);
+		threadData[id_worker].statW.push(threadData[id_worker].Windows.W[w].lengthBP(V) * 1.0e-6);
 
 		int outcome = 0;
 		if (G.vecG[id_job]->double_precision) {
 			//Run using double precision as underflow happened previously
-			haplotype_segment_double HS(G.vecG[id_job], H.H_opt_hap, threadData[id_worker].Kstates[w], threadData[id_worker].Windows.W[w], M);
+			haplotype_segment_double HS(G.vecG[id_job], H.H_opt_hap, threadData[id_worker].Kstates[w], threadData[id_worker].Kweights[w], threadData[id_worker].Windows.W[w], M, hmm_max_bytes);
 			HS.forward();
 			outcome = HS.backward(threadData[id_worker].T, threadData[id_worker].M);
 		} else {
 			//Try single precision as this is faster
-			haplotype_segment_single HS(G.vecG[id_job], H.H_opt_hap, threadData[id_worker].Kstates[w], threadData[id_worker].Windows.W[w], M);
+			haplotype_segment_single HS(G.vecG[id_job], H.H_opt_hap, threadData[id_worker].Kstates[w], threadData[id_worker].Kweights[w], threadData[id_worker].Windows.W[w], M, hmm_max_bytes);
 			HS.forward();
 			outcome = HS.backward(threadData[id_worker].T, threadData[id_worker].M);
 
 			//Underflow happening with single precision, rerun using double precision
 			if (outcome != 0) {
-				haplotype_segment_double HS(G.vecG[id_job], H.H_opt_hap, threadData[id_worker].Kstates[w], threadData[id_worker].Windows.W[w], M);
+				haplotype_segment_double HS(G.vecG[id_job], H.H_opt_hap, threadData[id_worker].Kstates[w], threadData[id_worker].Kweights[w], threadData[id_worker].Windows.W[w], M, hmm_max_bytes);
 				HS.forward();
 				outcome = HS.backward(threadData[id_worker].T, threadData[id_worker].M);
 				G.vecG[id_job]->double_precision = true;
-				n_underflow_recovered_precision++;
+				threadData[id_worker].n_underflow_precision++;
 			}
 		}
 
@@ -75,51 +66,68 @@ void phaser::phaseWindow(int id_worker, int id_job) {
 		case -2: vrb.error("Diploid underflow impossible to recover for [" + G.vecG[id_job]->name + "]");
 		case -1: vrb.error("Haploid underflow impossible to recover for [" + G.vecG[id_job]->name + "]");
 		}
-		n_underflow_recovered_summing += outcome;
+		threadData[id_worker].n_underflow_summing += outcome;
 	}
 
-	//Copy over new IBD2 constraints into H
-	if (options["thread"].as < int > () > 1) pthread_mutex_lock(&mutex_workers);
-	H.Kbanned.pushIBD2(id_job, threadData[id_worker].Kbanned);
-	if (options["thread"].as < int > () > 1) pthread_mutex_unlock(&mutex_workers);
+	//Buffer new IBD2 constraints, copied over into H once all jobs are done
+	for (int t = 0 ; t < threadData[id_worker].Kbanned.size() ; t ++) threadData[id_worker].IBD2.emplace_back(id_job, threadData[id_worker].Kbanned[t]);
 
 	//Sampling / Merging / Storing
-	vector < bool > flagMerges;
+	unsigned long n_heap_allocations = heapAllocations();
 	switch (iteration_types[iteration_stage]) {
-	case STAGE_BURN:	G.vecG[id_job]->sample(threadData[id_worker].T, threadData[id_worker].M);
+	case STAGE_BURN:	G.vecG[id_job]->sample(threadData[id_worker].T, threadData[id_worker].M, threadData[id_worker].Scratch, Rsampling);
 						break;
-	case STAGE_PRUN:	G.vecG[id_job]->sample(threadData[id_worker].T, threadData[id_worker].M);
-						G.vecG[id_job]->mapMerges(threadData[id_worker].T, options["mcmc-prune"].as < double > (), flagMerges);
-						G.vecG[id_job]->performMerges(threadData[id_worker].T, flagMerges);
+	case STAGE_PRUN:	G.vecG[id_job]->sample(threadData[id_worker].T, threadData[id_worker].M, threadData[id_worker].Scratch, Rsampling);
+						G.vecG[id_job]->mapMerges(threadData[id_worker].T, options["mcmc-prune"].as < double > (), threadData[id_worker].Scratch);
+						G.vecG[id_job]->performMerges(threadData[id_worker].T, threadData[id_worker].Scratch);
 						break;
-	case STAGE_MAIN:	G.vecG[id_job]->sample(threadData[id_worker].T, threadData[id_worker].M);
+	case STAGE_MAIN:	G.vecG[id_job]->sample(threadData[id_worker].T, threadData[id_worker].M, threadData[id_worker].Scratch, Rsampling);
 						G.vecG[id_job]->store(threadData[id_worker].T, threadData[id_worker].M);
 						break;
 	}
+	threadData[id_worker].n_heap_allocations += heapAllocations() - n_heap_allocations;
 }
 
 void phaser::phaseWindow() {
 	tac.clock();
-	int n_thread = options["thread"].as < int > ();
 	n_underflow_recovered_summing = 0;
 	n_underflow_recovered_precision = 0;
-	i_workers = 0; i_jobs = 0;
+	unsigned long n_heap_allocations = 0;
 	statH.clear(); statS.clear();
 	storedKsizes.clear();
-	if (n_thread > 1) {
-		for (int t = 0 ; t < n_thread ; t++) pthread_create( &id_workers[t] , NULL, phaseWindow_callback, static_cast<void *>(this));
-		for (int t = 0 ; t < n_thread ; t++) pthread_join( id_workers[t] , NULL);
-	} else for (int i = 0 ; i < G.n_ind ; i ++) {
-		phaseWindow(0, i);
-		vrb.progress("  * HMM computations", (i+1)*1.0/G.n_ind);
+	for (int t = 0 ; t < threadData.size() ; t ++) threadData[t].clearAccumulators();
+	scheduleJobs();
+	pool.run(G.n_ind, [this] (int id_worker, int id_job) {
+		auto start = std::chrono::steady_clock::now();
+		phaseWindow(id_worker, jobOrder[id_job]);
+		jobTimes[jobOrder[id_job]] = std::chrono::duration < double > (std::chrono::steady_clock::now() - start).count();
+	}, "  * HMM computations");
+	for (int t = 0 ; t < threadData.size() ; t ++) {
+		statH.merge(threadData[t].statK);
+		statS.merge(threadData[t].statW);
+		n_underflow_recovered_summing += threadData[t].n_underflow_summing;
+		n_underflow_recovered_precision += threadData[t].n_underflow_precision;
+		H.Kbanned.pushIBD2(threadData[t].IBD2);
+		n_heap_allocations += threadData[t].n_heap_allocations;
 	}
 	vrb.bullet("HMM computations [K=" + stb.str(statH.mean(), 1) + "+/-" + stb.str(statH.sd(), 1) + " / W=" + stb.str(statS.mean(), 2) + "Mb / US=" + stb.str(n_underflow_recovered_summing) + " / UP=" + stb.str(n_underflow_recovered_precision) + "] (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
+#ifdef ALLOCATION_COUNTER
+	//First iterations warm up the per-thread scratch memory; afterwards, sampling and pruning should not allocate (storage allocates once in the first main iteration)
+	vrb.bullet("Heap allocations in sampling / pruning / storing [n=" + stb.str(n_heap_allocations) + "]");
+#endif
+	if (pool.size() > 1) {
+		vector < int > indexOrder = vector < int > (G.n_ind);
+		iota(indexOrder.begin(), indexOrder.end(), 0);
+		double idle_used = scheduleIdleTail(jobOrder), idle_index = scheduleIdleTail(indexOrder);
+		vrb.bullet("Scheduling [" + options["thread-schedule"].as < string > () + " / idle tail=" + stb.str(idle_used * 100, 2) + "% / index order=" + stb.str(idle_index * 100, 2) + "%]");
+	}
 }
 
 void phaser::phase() {
-	unsigned long n_old_segments = G.numberOfSegments(), n_new_segments = 0, current_iteration = 0;
+	unsigned long n_old_segments = G.numberOfSegments(), n_new_segments = 0;
+	iteration_index = 0;
 	for (iteration_stage = 0 ; iteration_stage < iteration_counts.size() ; iteration_stage ++) {
-		for (int iter = 0 ; iter < iteration_counts[iteration_stage] ; iter ++) {
+		for (int iter = 0 ; iter < iteration_counts[iteration_stage] ; iter ++, iteration_index ++) {
 			//VERBOSE
 			switch (iteration_types[iteration_stage]) {
 			case STAGE_BURN:	vrb.title("Burn-in iteration [" + stb.str(iter+1) + "/" + stb.str(iteration_counts[iteration_stage]) + "]"); break;
@@ -132,10 +140,8 @@ void phaser::phase() {
 			phaseWindow();
 			//MERGE IBD2 PAIRS
 			H.Kbanned.collapse();
-			//UPDATE H with new sampled haplotypes
+			//UPDATE H with new sampled haplotypes (both Hfirst and Vfirst, for next PBWT compute)
 			H.updateHaplotypes(G);
-			//TRANSPOSE H from Hfirst to Vfirst (for next PBWT compute)
-			H.transposeHaplotypes_H2V(false);
 			//UPDATE PS after prunning
 			if (iteration_types[iteration_stage] == STAGE_PRUN) {
 				n_new_segments = G.numberOfSegments();
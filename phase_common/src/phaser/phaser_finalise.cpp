@@ -28,18 +28,18 @@
 void phaser::write_files_and_finalise() {
 	vrb.title("Finalization:");
 
-	//step0: multi-threading
-	if (options["thread"].as < int > () > 1) pthread_mutex_destroy(&mutex_workers);
-
 	//
+	G.reportMemory("Genotype graph memory");
 	G.solve();
 	H.updateHaplotypes(G);
-	H.transposeHaplotypes_H2V(false);
 
 	//step1: writing best guess haplotypes in VCF/BCF file
 	if (options.count("bingraph")) graph_writer(G, V).writeGraphs(options["bingraph"].as < string > ());
-	if (options.count("output")) haplotype_writer(H, G, V, options["thread"].as < int > ()).writeHaplotypes(options["output"].as < string > ());
+	if (options.count("output")) haplotype_writer(H, G, V, pool).writeHaplotypes(options["output"].as < string > ());
+
+	//step2: multi-threading
+	pool.stop();
 
-	//step2: Measure overall running time
+	//step3: Measure overall running time
 	vrb.bullet("Total running time = " + stb.str(tac.abs_time()) + " seconds");
 }
@@ -24,6 +24,7 @@
 #define _PHASER_H
 
 #include <utils/otools.h>
+#include <utils/thread_pool.h>
 #include <objects/hmm_parameters.h>
 #include <models/haplotype_segment_single.h>
 #include <models/haplotype_segment_double.h>
@@ -36,6 +37,9 @@
 #define STAGE_PRUN	1
 #define STAGE_MAIN	2
 
+#define RSTREAM_WINDOWS		0
+#define RSTREAM_SAMPLING	1
+
 class phaser {
 public:
 	//COMMAND LINE OPTIONS
@@ -54,15 +58,15 @@ public:
 	double pbwt_modulo;
 
 	//MULTI-THREADING
-	int i_workers, i_jobs;
-	vector < pthread_t > id_workers;
-	pthread_mutex_t mutex_workers;
+	thread_pool pool;
 	vector < compute_job > threadData;
 
 	//MCMC
 	vector < unsigned int > iteration_types;
 	vector < unsigned int > iteration_counts;
 	unsigned int iteration_stage;
+	unsigned int iteration_index;
+	unsigned long hmm_max_bytes;
 	int n_underflow_recovered_summing;
 	int n_underflow_recovered_precision;
 
@@ -70,6 +74,12 @@ public:
 	basic_stats statH,statS;
 	vector < double > storedKsizes;
 
+	//SCHEDULING
+	bool schedule_by_cost;
+	vector < int > jobOrder;
+	vector < double > jobKsizes;
+	vector < double > jobTimes;
+
 	//CONSTRUCTOR
 	phaser();
 	~phaser();
@@ -79,6 +89,10 @@ public:
 	void phaseWindow(int, int);
 	void phaseWindow();
 
+	//SCHEDULING
+	void scheduleJobs();
+	double scheduleIdleTail(vector < int > &);
+
 	//PARAMETERS
 	void declare_options();
 	void parse_command_line(vector < string > &);
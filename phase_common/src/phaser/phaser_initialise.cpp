@@ -23,6 +23,7 @@
 #include <phaser/phaser_header.h>
 
 #include <io/genotype_reader/genotype_reader_header.h>
+#include <io/genotype_cache.h>
 #include <io/haplotype_writer.h>
 #include <io/gmap_reader.h>
 #include <io/pedigree_reader.h>
@@ -32,27 +33,41 @@
 void phaser::read_files_and_initialise() {
 	//step0: Initialize seed and multi-threading
 	rng.setSeed(options["seed"].as < int > ());
-	if (options["thread"].as < int > () > 1) {
-		i_workers = 0; i_jobs = 0;
-		id_workers = vector < pthread_t > (options["thread"].as < int > ());
-		pthread_mutex_init(&mutex_workers, NULL);
-	}
+	pool.start(options["thread"].as < int > ());
+	H.setThreadPool(&pool);
 
-	//step1: Set up the genotype reader
+	//step1: Set up the genotype cache
 	vrb.title("Reading genotype data:");
-	genotype_reader readerG(H, G, V);
-	readerG.setThreads(options["thread"].as < int > ());
-	readerG.setRegion(options["region"].as < string > ());
-	readerG.setMainFilename(options["input"].as < string > ());
-	if (options.count("reference")) readerG.addReferenceFilename(options["reference"].as < string > ());
-	if (options.count("scaffold")) readerG.addScaffoldFilename(options["scaffold"].as < string > ());
-	if (options.count("filter-snp")) readerG.setFilterSNP();
-	if (!options["filter-maf"].defaulted()) readerG.setFilterMAF(options["filter-maf"].as < double > ());
+	genotype_cache cacheG(H, G, V);
+	bool cached = false;
+	if (options.count("cache")) {
+		vector < pair < string, string > > files = { { "input", options["input"].as < string > () } };
+		if (options.count("reference")) files.emplace_back("reference", options["reference"].as < string > ());
+		if (options.count("scaffold")) files.emplace_back("scaffold", options["scaffold"].as < string > ());
+		cacheG.setKey(files, "region=" + options["region"].as < string > () + "|snp=" + stb.str(options.count("filter-snp")) + "|maf=" + stb.str(options["filter-maf"].as < double > (), 6));
+		cached = cacheG.readCache(options["cache"].as < string > ());
+	}
 
-	//step2: Read the genotype data
-	readerG.scanGenotypes();
-	readerG.allocateGenotypes();
-	readerG.readGenotypes();
+	//step2: Read the genotype data when not cached
+	if (!cached) {
+		genotype_reader readerG(H, G, V);
+		readerG.setThreads(options["thread"].as < int > ());
+		readerG.setThreadPool(&pool);
+		readerG.setRegion(options["region"].as < string > ());
+		readerG.setMainFilename(options["input"].as < string > ());
+		if (options.count("reference")) readerG.addReferenceFilename(options["reference"].as < string > ());
+		if (options.count("scaffold")) readerG.addScaffoldFilename(options["scaffold"].as < string > ());
+		if (options.count("filter-snp")) readerG.setFilterSNP();
+		if (!options["filter-maf"].defaulted()) readerG.setFilterMAF(options["filter-maf"].as < double > ());
+		readerG.scanGenotypes();
+		readerG.allocateGenotypes();
+		readerG.readGenotypes();
+		cacheG.n_variants = readerG.n_variants;
+		cacheG.n_main_samples = readerG.n_main_samples;
+		cacheG.n_ref_samples = readerG.n_ref_samples;
+		cacheG.n_genotypes = readerG.n_genotypes;
+		if (options.count("cache")) cacheG.writeCache(options["cache"].as < string > ());
+	}
 
 	//step3: Read pedigrees
 	if (options.count("pedigree")) {
@@ -68,7 +83,7 @@ void phaser::read_files_and_initialise() {
 		readerGM.readGeneticMapFile(options["map"].as < string > ());
 		V.setGeneticMap(readerGM);
 	} else V.setGeneticMap();
-	M.initialise(V, options["hmm-ne"].as < int > (), (readerG.n_main_samples+readerG.n_ref_samples)*2);
+	M.initialise(V, options["hmm-ne"].as < int > (), (cacheG.n_main_samples+cacheG.n_ref_samples)*2);
 
 	//step5: Initialize haplotype set
 	vrb.title("Initializing data structures:");
@@ -78,7 +93,7 @@ void phaser::read_files_and_initialise() {
 
 	//step6: Initialize PBWT for selecting states
 	if (pbwt_auto) {
-		unsigned int cumulative_sample_size = readerG.n_main_samples + readerG.n_ref_samples;
+		unsigned int cumulative_sample_size = cacheG.n_main_samples + cacheG.n_ref_samples;
 		pbwt_depth = max(min((int)round(10-log10(cumulative_sample_size)), 8), 2);
 		pbwt_modulo = max(min((log(cumulative_sample_size) - log(50) + 1) * 0.01, 0.15), 0.005);
 		vrb.bullet("PBWT parameters auto setting : [modulo = " + stb.str(pbwt_modulo, 3) + " / depth = " + stb.str(pbwt_depth, 3) + "]");
@@ -91,16 +106,22 @@ void phaser::read_files_and_initialise() {
 					options["pbwt-window"].as < double > (),
 					options["pbwt-mdr"].as < double > (),
 					pbwt_depth,
-					options["pbwt-mac"].as < int > (),
-					options["thread"].as < int > ());
+					options["pbwt-mac"].as < int > ());
 
 	if (!options.count("pbwt-disable-init")) H.solve(&G);
 
 	//step6: Initialize genotype structures
-	genotype_builder(G, options["thread"].as < int > ()).build();
+	genotype_builder(G, pool).build();
 
 	//step7: Allocate data structures for computations
 	unsigned int max_number_transitions = G.largestNumberOfTransitions();
 	unsigned int max_number_missing = G.largestNumberOfMissings();
-	threadData = vector < compute_job >(options["thread"].as < int > (), compute_job(V, G, H, max_number_transitions, max_number_missing));
+	threadData = vector < compute_job >(pool.size(), compute_job(V, G, H, max_number_transitions, max_number_missing));
+
+	//step8: Initialize job scheduling
+	schedule_by_cost = (options["thread-schedule"].as < string > () == "cost");
+	jobOrder = vector < int > (G.n_ind);
+	iota(jobOrder.begin(), jobOrder.end(), 0);
+	jobKsizes = vector < double > (G.n_ind, 1.0);
+	jobTimes = vector < double > (G.n_ind, 0.0);
 }
@@ -26,7 +26,6 @@ phaser::phaser() {
 }
 
 phaser::~phaser() {
-	id_workers.clear();
 	threadData.clear();
 	iteration_types.clear();
 	iteration_counts.clear();
@@ -29,7 +29,8 @@ void phaser::declare_options() {
 	opt_base.add_options()
 			("help", "Produce help message")
 			("seed", bpo::value < int >()->default_value(15052011), "Seed of the random number generator")
-			("thread,T", bpo::value < int >()->default_value(1), "Number of thread used");
+			("thread,T", bpo::value < int >()->default_value(1), "Number of thread used")
+			("thread-schedule", bpo::value < string >()->default_value("cost"), "Order in which samples are dispatched to threads: cost (most expensive first) or index");
 
 	bpo::options_description opt_input ("Input files");
 	opt_input.add_options()
@@ -38,7 +39,8 @@ void phaser::declare_options() {
 			("scaffold,S", bpo::value < string >(), "Scaffold of haplotypes in VCF/BCF format")
 			("map,M", bpo::value < string >(), "Genetic map")
 			("pedigree", bpo::value < string >(), "Pedigree information (kid father mother)")
-			("region,R", bpo::value < string >(), "Target region");
+			("region,R", bpo::value < string >(), "Target region")
+			("cache", bpo::value < string >(), "Binary cache of the parsed genotype data [created if missing or outdated, reused otherwise]");
 
 	bpo::options_description opt_mcmc ("MCMC parameters");
 	opt_mcmc.add_options()
@@ -57,7 +59,8 @@ void phaser::declare_options() {
 	bpo::options_description opt_hmm ("HMM parameters");
 	opt_hmm.add_options()
 			("hmm-window", bpo::value < double >()->default_value(4), "Minimal size of the phasing window in cM")
-			("hmm-ne", bpo::value < int >()->default_value(15000), "Effective size of the population");
+			("hmm-ne", bpo::value < int >()->default_value(15000), "Effective size of the population")
+			("hmm-memory", bpo::value < double >()->default_value(0), "Memory budget in Mb per thread for HMM forward probabilities, checkpointed above it (0 means no limit)");
 
 	bpo::options_description opt_filter ("FILTER parameters");
 	opt_filter.add_options()
@@ -107,6 +110,9 @@ void phaser::check_options() {
 	if (options.count("thread") && options["thread"].as < int > () < 1)
 		vrb.error("You must use at least 1 thread");
 
+	if (options["thread-schedule"].as < string > () != "cost" && options["thread-schedule"].as < string > () != "index")
+		vrb.error("Unrecognized scheduling mode [" + options["thread-schedule"].as < string > () + "], use cost or index");
+
 	if (!options["thread"].defaulted() && !options["seed"].defaulted())
 		vrb.warning("Using multi-threading prevents reproducing a run by specifying --seed");
 
@@ -116,6 +122,10 @@ void phaser::check_options() {
 	if (!options["hmm-window"].defaulted() && (options["hmm-window"].as < double > () < 0.5 || options["hmm-window"].as < double > () > 10))
 		vrb.error("You must specify a HMM window size comprised between 0.5 and 10 cM");
 
+	if (options["hmm-memory"].as < double > () < 0)
+		vrb.error("You must specify a positive HMM memory budget");
+	hmm_max_bytes = (unsigned long)(options["hmm-memory"].as < double > () * 1024 * 1024);
+
 	if (!options["pbwt-window"].defaulted() && (options["pbwt-window"].as < double > () < 0.5 || options["pbwt-window"].as < double > () > 10))
 		vrb.error("You must specify a PBWT window size comprised between 0.5 and 10 cM");
 
@@ -129,6 +139,7 @@ void phaser::verbose_files() {
 	if (options.count("scaffold")) vrb.bullet("Scaffold VCF  : [" + options["scaffold"].as < string > () + "]");
 	if (options.count("pedigree")) vrb.bullet("Pedigree file : [" + options["pedigree"].as < string > () + "]");
 	if (options.count("map")) vrb.bullet("Genetic Map   : [" + options["map"].as < string > () + "]");
+	if (options.count("cache")) vrb.bullet("Genotype cache: [" + options["cache"].as < string > () + "]");
 	if (options.count("output")) vrb.bullet("Output VCF    : [" + options["output"].as < string > () + "]");
 	if (options.count("bingraph")) vrb.bullet("Output BIN    : [" + options["bingraph"].as < string > () + "]");
 	if (options.count("log")) vrb.bullet("Output LOG    : [" + options["log"].as < string > () + "]");
@@ -137,8 +148,9 @@ void phaser::verbose_files() {
 void phaser::verbose_options() {
 	vrb.title("Parameters:");
 	vrb.bullet("Seed    : " + stb.str(options["seed"].as < int > ()));
-	vrb.bullet("Threads : " + stb.str(options["thread"].as < int > ()) + " threads");
+	vrb.bullet("Threads : " + stb.str(options["thread"].as < int > ()) + " threads / " + options["thread-schedule"].as < string > () + " scheduling");
 	vrb.bullet("MCMC    : " + get_iteration_scheme());
+	vrb.bullet("SIMD    : " + string(simd_kernel_name()) + " HMM kernels");
 
 	pbwt_auto = options["pbwt-modulo"].defaulted() && options["pbwt-depth"].defaulted();
 	if (!pbwt_auto)
@@ -148,6 +160,7 @@ void phaser::verbose_options() {
 
 	if (options.count("map"))  vrb.bullet("HMM     : [window = " + stb.str(options["hmm-window"].as < double > ()) + "cM / Ne = " + stb.str(options["hmm-ne"].as < int > ()) + " / Recombination rates given by genetic map]");
 	else vrb.bullet("HMM     : [window = " + stb.str(options["hmm-window"].as < double > ()) + "cM / Ne = " + stb.str(options["hmm-ne"].as < int > ()) + " / Constant recombination rate of 1cM per Mb]");
+	if (hmm_max_bytes) vrb.bullet("HMM     : [memory = " + stb.str(options["hmm-memory"].as < double > ()) + "Mb per thread / forward probabilities checkpointed above]");
 	if (options.count("filter-snp") || (!options["filter-maf"].defaulted()))
 		vrb.bullet("FILTERS : [snp only = " + stb.str(options.count("filter-snp")) + " / MAF = " + stb.str(options["filter-maf"].as < double > ()) + "]");
 }
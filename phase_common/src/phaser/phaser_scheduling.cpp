@@ -0,0 +1,60 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <phaser/phaser_header.h>
+
+/*
+ * Longest-processing-time-first scheduling of the per-sample HMM jobs.
+ * Cost of a sample is dominated by the number of conditioning states times
+ * the number of variants, plus extra work at ambiguous / missing sites and
+ * in the sampling step which is linear in the number of transitions.
+ * K per variant is taken from the previous iteration (1.0 before the first).
+ */
+void phaser::scheduleJobs() {
+	iota(jobOrder.begin(), jobOrder.end(), 0);
+	if (!schedule_by_cost || pool.size() == 1) return;
+	vector < double > jobCosts = vector < double > (G.n_ind, 0.0);
+	for (int i = 0 ; i < G.n_ind ; i ++) {
+		genotype * g = G.vecG[i];
+		jobCosts[i] = jobKsizes[i] * (V.size() + (g->n_ambiguous + g->n_missing) * HAP_NUMBER) + g->n_transitions;
+	}
+	stable_sort(jobOrder.begin(), jobOrder.end(), [&jobCosts] (int a, int b) { return jobCosts[a] > jobCosts[b]; });
+}
+
+/*
+ * Replays the measured job durations in the given order on a greedy list
+ * scheduler with as many workers as the pool, and returns the fraction of
+ * worker time left idle while waiting for the last job to complete.
+ */
+double phaser::scheduleIdleTail(vector < int > & order) {
+	priority_queue < double, vector < double >, greater < double > > loads;
+	for (int t = 0 ; t < pool.size() ; t ++) loads.push(0.0);
+	double total = 0.0, makespan = 0.0;
+	for (int j = 0 ; j < order.size() ; j ++) {
+		double end = loads.top() + jobTimes[order[j]];
+		loads.pop();
+		loads.push(end);
+		total += jobTimes[order[j]];
+		makespan = max(makespan, end);
+	}
+	return (makespan > 0.0) ? (1.0 - total / (makespan * pool.size())) : 0.0;
+}
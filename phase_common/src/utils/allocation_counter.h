@@ -0,0 +1,71 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _ALLOCATION_COUNTER_H
+#define _ALLOCATION_COUNTER_H
+
+#include <cstdlib>
+#include <new>
+
+/*
+ * Debug builds (-DALLOCATION_COUNTER) replace the global operator new with a version counting heap allocations
+ * per thread, so that code paths meant to be allocation-free can be checked by differencing heapAllocations().
+ * In release builds, heapAllocations() always returns 0 and nothing is replaced.
+ */
+#ifdef ALLOCATION_COUNTER
+
+extern thread_local unsigned long n_heap_allocations;
+
+inline
+unsigned long heapAllocations() {
+	return n_heap_allocations;
+}
+
+#ifdef _DECLARE_TOOLBOX_HERE
+thread_local unsigned long n_heap_allocations = 0;
+
+void * operator new(std::size_t size) {
+	n_heap_allocations ++;
+	void * ptr = std::malloc(size ? size : 1);
+	if (!ptr) throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete(void * ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void * ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+#endif
+
+#else
+
+inline
+unsigned long heapAllocations() {
+	return 0;
+}
+
+#endif
+
+#endif
@@ -64,6 +64,7 @@ extern "C" {
 #include <utils/string_utils.h>
 #include <utils/timer.h>
 #include <utils/verbose.h>
+#include <utils/allocation_counter.h>
 
 //CONSTANTS
 #define RARE_VARIANT_FREQ	0.001f
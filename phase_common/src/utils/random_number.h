@@ -98,4 +98,97 @@ public:
 	}
 };
 
+/*
+ * Counter-based random stream [Philox4x32-10, Salmon et al. 2011].
+ * A stream is fully determined by its key (seed, iteration) and by the first half of its counter (sample, substream), the second half
+ * counting the blocks of 4 x 32 random bits drawn so far. Streams are therefore independent of the thread that consumes them and of
+ * the order in which they are consumed: a job creates its own stream from its coordinates and draws from it without any shared state.
+ */
+class random_stream {
+protected:
+	uint32_t key[2];
+	uint32_t ctr[4];
+	uint32_t block[4];
+	unsigned int nleft;
+
+	static inline void mulhilo(uint32_t a, uint32_t b, uint32_t & hi, uint32_t & lo) {
+		uint64_t p = (uint64_t)a * b;
+		hi = (uint32_t)(p >> 32);
+		lo = (uint32_t)p;
+	}
+
+	void generate() {
+		uint32_t x[4] = { ctr[0], ctr[1], ctr[2], ctr[3] };
+		uint32_t k[2] = { key[0], key[1] };
+		for (int r = 0 ; r < 10 ; r ++) {
+			uint32_t hi0, lo0, hi1, lo1;
+			mulhilo(0xD2511F53U, x[0], hi0, lo0);
+			mulhilo(0xCD9E8D57U, x[2], hi1, lo1);
+			x[0] = hi1 ^ x[1] ^ k[0];
+			x[1] = lo1;
+			x[2] = hi0 ^ x[3] ^ k[1];
+			x[3] = lo0;
+			k[0] += 0x9E3779B9U;
+			k[1] += 0xBB67AE85U;
+		}
+		block[0] = x[0]; block[1] = x[1]; block[2] = x[2]; block[3] = x[3];
+		if (!(++ctr[0])) ++ctr[1];
+		nleft = 4;
+	}
+
+	uint32_t next() {
+		if (!nleft) generate();
+		return block[4 - (nleft--)];
+	}
+
+public:
+
+	random_stream(unsigned int seed, unsigned int iteration, unsigned int sample, unsigned int substream) {
+		key[0] = seed; key[1] = iteration;
+		ctr[0] = 0; ctr[1] = 0; ctr[2] = sample; ctr[3] = substream;
+		nleft = 0;
+	}
+
+	unsigned int getInt(unsigned int imin, unsigned int imax) {
+		return imin + (unsigned int)(((uint64_t)next() * ((uint64_t)imax - imin + 1)) >> 32);
+	}
+
+	unsigned int getInt(unsigned int isize) {
+		return getInt(0, isize - 1);
+	}
+
+	double getDouble() {
+		uint64_t a = next() >> 5, b = next() >> 6;
+		return (a * 67108864.0 + b) * (1.0 / 9007199254740992.0);
+	}
+
+	double getDouble(double fmin, double fmax) {
+		return fmin + (fmax - fmin) * getDouble();
+	}
+
+	bool flipCoin() {
+		return (next() >> 31);
+	}
+
+	int sample(std::vector < double > & vec, double sum) {
+		double csum = vec[0];
+		double u = getDouble() * sum;
+		for (int i = 0; i < vec.size() - 1; ++i) {
+			if ( u < csum ) return i;
+			csum += vec[i+1];
+		}
+		return vec.size() - 1;
+	}
+
+	int sample(const double * vec, unsigned int n, double sum) {
+		double csum = vec[0];
+		double u = getDouble() * sum;
+		for (unsigned int i = 0; i < n - 1; ++i) {
+			if ( u < csum ) return i;
+			csum += vec[i+1];
+		}
+		return n - 1;
+	}
+};
+
 #endif
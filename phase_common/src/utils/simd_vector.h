@@ -0,0 +1,221 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _SIMD_VECTOR_H
+#define _SIMD_VECTOR_H
+
+/*
+ * Thin fixed-width vector types used by the HMM kernels:
+ *  - simd_f32x8: 8 floats (one lane per HAP_NUMBER haplotype)
+ *  - simd_f64x4: 4 doubles
+ * Backend is selected at compile time: AVX2 (x86_64 with -mavx2 -mfma), NEON (AArch64) or scalar (-DSIMD_SCALAR or anything else).
+ * All backends perform the same lane-wise operations in the same order (fused multiply-add included), so that they produce bit-for-bit identical results.
+ */
+
+#include <cmath>
+
+#if !defined(SIMD_SCALAR) && defined(__AVX2__) && defined(__FMA__)
+	#define SIMD_AVX2
+	#include <immintrin.h>
+#elif !defined(SIMD_SCALAR) && defined(__ARM_NEON) && defined(__aarch64__)
+	#define SIMD_NEON
+	#include <arm_neon.h>
+#else
+	#ifndef SIMD_SCALAR
+		#define SIMD_SCALAR
+	#endif
+#endif
+
+/*******************************************************************************/
+/*****************					AVX2 BACKEND				****************/
+/*******************************************************************************/
+
+#if defined(SIMD_AVX2)
+
+#define SIMD_BACKEND_NAME "AVX2"
+
+struct simd_f32x8 { __m256 v; };
+struct simd_f64x4 { __m256d v; };
+
+inline simd_f32x8 simd_set1_f32(float a) { return { _mm256_set1_ps(a) }; }
+inline simd_f32x8 simd_load(const float * p) { return { _mm256_load_ps(p) }; }
+inline simd_f32x8 simd_loadu(const float * p) { return { _mm256_loadu_ps(p) }; }
+inline void simd_store(float * p, simd_f32x8 a) { _mm256_store_ps(p, a.v); }
+inline simd_f32x8 simd_add(simd_f32x8 a, simd_f32x8 b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline simd_f32x8 simd_mul(simd_f32x8 a, simd_f32x8 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline simd_f32x8 simd_div(simd_f32x8 a, simd_f32x8 b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline simd_f32x8 simd_fmadd(simd_f32x8 a, simd_f32x8 b, simd_f32x8 c) { return { _mm256_fmadd_ps(a.v, b.v, c.v) }; }
+
+//Lane j takes b when bit (7-j) of byte is set (i.e. bitmatrix column order), a otherwise
+inline simd_f32x8 simd_select_bits(unsigned char byte, simd_f32x8 a, simd_f32x8 b) {
+	const __m256i _vshift_count = _mm256_set_epi32(31,30,29,28,27,26,25,24);
+	const __m256i _mask = _mm256_sllv_epi32(_mm256_set1_epi32((unsigned int)byte), _vshift_count);
+	return { _mm256_blendv_ps(a.v, b.v, _mm256_castsi256_ps(_mask)) };
+}
+
+//((v0+v4)+(v1+v5)) + ((v2+v6)+(v3+v7))
+inline float simd_hsum(simd_f32x8 a) {
+	__m128 vlow = _mm256_castps256_ps128(a.v);
+	__m128 vhigh = _mm256_extractf128_ps(a.v, 1);
+	vlow = _mm_add_ps(vlow, vhigh);
+	__m128 shuf = _mm_movehdup_ps(vlow);
+	__m128 sums = _mm_add_ps(vlow, shuf);
+	shuf = _mm_movehl_ps(shuf, sums);
+	sums = _mm_add_ss(sums, shuf);
+	return _mm_cvtss_f32(sums);
+}
+
+inline simd_f32x8 simd_max(simd_f32x8 a, simd_f32x8 b) { return { _mm256_max_ps(a.v, b.v) }; }
+
+//Bit (7-j) of the returned byte is set when lane j of a is greater than lane j of b (i.e. bitmatrix column order)
+inline unsigned char simd_cmpgt_bits(simd_f32x8 a, simd_f32x8 b) {
+	const __m256i _vreverse = _mm256_set_epi32(0,1,2,3,4,5,6,7);
+	return (unsigned char)_mm256_movemask_ps(_mm256_permutevar8x32_ps(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ), _vreverse));
+}
+
+inline float simd_hmax(simd_f32x8 a) {
+	__m128 m = _mm_max_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+	m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+	m = _mm_max_ss(m, _mm_movehdup_ps(m));
+	return _mm_cvtss_f32(m);
+}
+
+inline simd_f64x4 simd_set1_f64(double a) { return { _mm256_set1_pd(a) }; }
+inline simd_f64x4 simd_load(const double * p) { return { _mm256_load_pd(p) }; }
+inline simd_f64x4 simd_loadu(const double * p) { return { _mm256_loadu_pd(p) }; }
+inline void simd_store(double * p, simd_f64x4 a) { _mm256_store_pd(p, a.v); }
+inline simd_f64x4 simd_add(simd_f64x4 a, simd_f64x4 b) { return { _mm256_add_pd(a.v, b.v) }; }
+inline simd_f64x4 simd_mul(simd_f64x4 a, simd_f64x4 b) { return { _mm256_mul_pd(a.v, b.v) }; }
+inline simd_f64x4 simd_div(simd_f64x4 a, simd_f64x4 b) { return { _mm256_div_pd(a.v, b.v) }; }
+inline simd_f64x4 simd_fmadd(simd_f64x4 a, simd_f64x4 b, simd_f64x4 c) { return { _mm256_fmadd_pd(a.v, b.v, c.v) }; }
+
+/*******************************************************************************/
+/*****************					NEON BACKEND				****************/
+/*******************************************************************************/
+
+#elif defined(SIMD_NEON)
+
+#define SIMD_BACKEND_NAME "NEON"
+
+struct simd_f32x8 { float32x4_t lo, hi; };
+struct simd_f64x4 { float64x2_t lo, hi; };
+
+inline simd_f32x8 simd_set1_f32(float a) { return { vdupq_n_f32(a), vdupq_n_f32(a) }; }
+inline simd_f32x8 simd_load(const float * p) { return { vld1q_f32(p), vld1q_f32(p+4) }; }
+inline simd_f32x8 simd_loadu(const float * p) { return { vld1q_f32(p), vld1q_f32(p+4) }; }
+inline void simd_store(float * p, simd_f32x8 a) { vst1q_f32(p, a.lo); vst1q_f32(p+4, a.hi); }
+inline simd_f32x8 simd_add(simd_f32x8 a, simd_f32x8 b) { return { vaddq_f32(a.lo, b.lo), vaddq_f32(a.hi, b.hi) }; }
+inline simd_f32x8 simd_mul(simd_f32x8 a, simd_f32x8 b) { return { vmulq_f32(a.lo, b.lo), vmulq_f32(a.hi, b.hi) }; }
+inline simd_f32x8 simd_div(simd_f32x8 a, simd_f32x8 b) { return { vdivq_f32(a.lo, b.lo), vdivq_f32(a.hi, b.hi) }; }
+inline simd_f32x8 simd_fmadd(simd_f32x8 a, simd_f32x8 b, simd_f32x8 c) { return { vfmaq_f32(c.lo, a.lo, b.lo), vfmaq_f32(c.hi, a.hi, b.hi) }; }
+
+inline simd_f32x8 simd_select_bits(unsigned char byte, simd_f32x8 a, simd_f32x8 b) {
+	const uint32_t bits_lo [4] = { 128, 64, 32, 16 };
+	const uint32_t bits_hi [4] = { 8, 4, 2, 1 };
+	const uint32x4_t _byte = vdupq_n_u32((uint32_t)byte);
+	return { vbslq_f32(vtstq_u32(_byte, vld1q_u32(bits_lo)), b.lo, a.lo), vbslq_f32(vtstq_u32(_byte, vld1q_u32(bits_hi)), b.hi, a.hi) };
+}
+
+inline float simd_hsum(simd_f32x8 a) {
+	float32x4_t s = vaddq_f32(a.lo, a.hi);
+	return (vgetq_lane_f32(s, 0) + vgetq_lane_f32(s, 1)) + (vgetq_lane_f32(s, 2) + vgetq_lane_f32(s, 3));
+}
+
+inline simd_f32x8 simd_max(simd_f32x8 a, simd_f32x8 b) { return { vmaxq_f32(a.lo, b.lo), vmaxq_f32(a.hi, b.hi) }; }
+
+inline unsigned char simd_cmpgt_bits(simd_f32x8 a, simd_f32x8 b) {
+	const uint32_t bits_lo [4] = { 128, 64, 32, 16 };
+	const uint32_t bits_hi [4] = { 8, 4, 2, 1 };
+	return (unsigned char)(vaddvq_u32(vandq_u32(vcgtq_f32(a.lo, b.lo), vld1q_u32(bits_lo))) + vaddvq_u32(vandq_u32(vcgtq_f32(a.hi, b.hi), vld1q_u32(bits_hi))));
+}
+
+inline float simd_hmax(simd_f32x8 a) { return vmaxvq_f32(vmaxq_f32(a.lo, a.hi)); }
+
+inline simd_f64x4 simd_set1_f64(double a) { return { vdupq_n_f64(a), vdupq_n_f64(a) }; }
+inline simd_f64x4 simd_load(const double * p) { return { vld1q_f64(p), vld1q_f64(p+2) }; }
+inline simd_f64x4 simd_loadu(const double * p) { return { vld1q_f64(p), vld1q_f64(p+2) }; }
+inline void simd_store(double * p, simd_f64x4 a) { vst1q_f64(p, a.lo); vst1q_f64(p+2, a.hi); }
+inline simd_f64x4 simd_add(simd_f64x4 a, simd_f64x4 b) { return { vaddq_f64(a.lo, b.lo), vaddq_f64(a.hi, b.hi) }; }
+inline simd_f64x4 simd_mul(simd_f64x4 a, simd_f64x4 b) { return { vmulq_f64(a.lo, b.lo), vmulq_f64(a.hi, b.hi) }; }
+inline simd_f64x4 simd_div(simd_f64x4 a, simd_f64x4 b) { return { vdivq_f64(a.lo, b.lo), vdivq_f64(a.hi, b.hi) }; }
+inline simd_f64x4 simd_fmadd(simd_f64x4 a, simd_f64x4 b, simd_f64x4 c) { return { vfmaq_f64(c.lo, a.lo, b.lo), vfmaq_f64(c.hi, a.hi, b.hi) }; }
+
+/*******************************************************************************/
+/*****************					SCALAR BACKEND				****************/
+/*******************************************************************************/
+
+#else
+
+#define SIMD_BACKEND_NAME "scalar"
+
+struct simd_f32x8 { float v[8]; };
+struct simd_f64x4 { double v[4]; };
+
+inline simd_f32x8 simd_set1_f32(float a) { simd_f32x8 r; for (int j = 0 ; j < 8 ; j++) r.v[j] = a; return r; }
+inline simd_f32x8 simd_load(const float * p) { simd_f32x8 r; for (int j = 0 ; j < 8 ; j++) r.v[j] = p[j]; return r; }
+inline simd_f32x8 simd_loadu(const float * p) { return simd_load(p); }
+inline void simd_store(float * p, simd_f32x8 a) { for (int j = 0 ; j < 8 ; j++) p[j] = a.v[j]; }
+inline simd_f32x8 simd_add(simd_f32x8 a, simd_f32x8 b) { for (int j = 0 ; j < 8 ; j++) a.v[j] += b.v[j]; return a; }
+inline simd_f32x8 simd_mul(simd_f32x8 a, simd_f32x8 b) { for (int j = 0 ; j < 8 ; j++) a.v[j] *= b.v[j]; return a; }
+inline simd_f32x8 simd_div(simd_f32x8 a, simd_f32x8 b) { for (int j = 0 ; j < 8 ; j++) a.v[j] /= b.v[j]; return a; }
+inline simd_f32x8 simd_fmadd(simd_f32x8 a, simd_f32x8 b, simd_f32x8 c) { for (int j = 0 ; j < 8 ; j++) c.v[j] = std::fma(a.v[j], b.v[j], c.v[j]); return c; }
+
+inline simd_f32x8 simd_select_bits(unsigned char byte, simd_f32x8 a, simd_f32x8 b) {
+	for (int j = 0 ; j < 8 ; j++) if ((byte >> (7-j)) & 1) a.v[j] = b.v[j];
+	return a;
+}
+
+inline float simd_hsum(simd_f32x8 a) {
+	float s[4];
+	for (int j = 0 ; j < 4 ; j++) s[j] = a.v[j] + a.v[j+4];
+	return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+inline simd_f32x8 simd_max(simd_f32x8 a, simd_f32x8 b) { for (int j = 0 ; j < 8 ; j++) a.v[j] = (a.v[j] > b.v[j])?a.v[j]:b.v[j]; return a; }
+
+inline unsigned char simd_cmpgt_bits(simd_f32x8 a, simd_f32x8 b) {
+	unsigned char byte = 0;
+	for (int j = 0 ; j < 8 ; j++) byte |= (a.v[j] > b.v[j]) << (7-j);
+	return byte;
+}
+
+inline float simd_hmax(simd_f32x8 a) {
+	float m = a.v[0];
+	for (int j = 1 ; j < 8 ; j++) m = (a.v[j] > m)?a.v[j]:m;
+	return m;
+}
+
+inline simd_f64x4 simd_set1_f64(double a) { simd_f64x4 r; for (int j = 0 ; j < 4 ; j++) r.v[j] = a; return r; }
+inline simd_f64x4 simd_load(const double * p) { simd_f64x4 r; for (int j = 0 ; j < 4 ; j++) r.v[j] = p[j]; return r; }
+inline simd_f64x4 simd_loadu(const double * p) { return simd_load(p); }
+inline void simd_store(double * p, simd_f64x4 a) { for (int j = 0 ; j < 4 ; j++) p[j] = a.v[j]; }
+inline simd_f64x4 simd_add(simd_f64x4 a, simd_f64x4 b) { for (int j = 0 ; j < 4 ; j++) a.v[j] += b.v[j]; return a; }
+inline simd_f64x4 simd_mul(simd_f64x4 a, simd_f64x4 b) { for (int j = 0 ; j < 4 ; j++) a.v[j] *= b.v[j]; return a; }
+inline simd_f64x4 simd_div(simd_f64x4 a, simd_f64x4 b) { for (int j = 0 ; j < 4 ; j++) a.v[j] /= b.v[j]; return a; }
+inline simd_f64x4 simd_fmadd(simd_f64x4 a, simd_f64x4 b, simd_f64x4 c) { for (int j = 0 ; j < 4 ; j++) c.v[j] = std::fma(a.v[j], b.v[j], c.v[j]); return c; }
+
+#endif
+
+inline simd_f32x8 simd_zero_f32() { return simd_set1_f32(0.0f); }
+inline simd_f64x4 simd_zero_f64() { return simd_set1_f64(0.0); }
+
+#endif
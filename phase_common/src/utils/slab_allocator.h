@@ -0,0 +1,143 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _SLAB_ALLOCATOR_H
+#define _SLAB_ALLOCATOR_H
+
+#include <utils/otools.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+
+#define SLAB_SIZE		(16UL * 1024 * 1024)
+#define SLAB_ALIGN		64
+#define SLAB_GRAIN		16
+
+/*
+ * Fixed size array living in the slabs of a slab_allocator. It only holds a pointer and a length: memory
+ * is owned by the allocator and released all at once with it. An array can shrink in place but not grow.
+ */
+template < class T >
+class slab_array {
+protected:
+	T * ptr;
+	unsigned int n;
+
+public:
+	slab_array() { ptr = NULL; n = 0; }
+	slab_array(T * _ptr, unsigned int _n) { ptr = _ptr; n = _n; }
+
+	unsigned int size() const { return n; }
+	bool empty() const { return n == 0; }
+	T * data() { return ptr; }
+	const T * data() const { return ptr; }
+	T * begin() { return ptr; }
+	T * end() { return ptr + n; }
+	const T * begin() const { return ptr; }
+	const T * end() const { return ptr + n; }
+	T & operator [] (unsigned int i) { return ptr[i]; }
+	const T & operator [] (unsigned int i) const { return ptr[i]; }
+	T & back() { return ptr[n - 1]; }
+	const T & back() const { return ptr[n - 1]; }
+
+	void clear() { ptr = NULL; n = 0; }
+	void shrink(unsigned int _n) { assert(_n <= n); n = _n; }
+
+	void copyFrom(const vector < T > & vec) {
+		assert(vec.size() <= n);
+		std::copy(vec.begin(), vec.end(), ptr);
+		n = vec.size();
+	}
+};
+
+/*
+ * Bump allocator carving small arrays out of large aligned slabs. Replaces millions of small heap blocks
+ * (one per array per sample) by a few large ones, so that per-block allocator overhead disappears and
+ * arrays of consecutive allocations sit next to each other in memory. Thread safe; arrays are zeroed.
+ */
+class slab_allocator {
+protected:
+	vector < unsigned char * > slabs;
+	unsigned long slab_offset, slab_capacity;
+	pthread_mutex_t mutex_slab;
+
+	unsigned long n_arrays;					// Number of arrays allocated
+	unsigned long n_bytes_used;				// Bytes handed out, rounded to SLAB_GRAIN
+	unsigned long n_bytes_reserved;			// Bytes in slabs
+	unsigned long n_bytes_heap;				// Bytes the same arrays would take as individual heap blocks
+
+	unsigned char * allocateBytes(unsigned long n_bytes) {
+		unsigned long n_grain = (n_bytes + SLAB_GRAIN - 1) & ~(SLAB_GRAIN - 1);
+		pthread_mutex_lock(&mutex_slab);
+		if (slabs.empty() || slab_offset + n_grain > slab_capacity) {
+			unsigned long n_slab = max(SLAB_SIZE, (n_grain + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1UL));
+			unsigned char * slab = (unsigned char *)aligned_alloc(SLAB_ALIGN, n_slab);
+			if (!slab) vrb.error("Could not allocate a slab of " + stb.str(n_slab) + " bytes");
+			slabs.push_back(slab);
+			slab_offset = 0;
+			slab_capacity = n_slab;
+			n_bytes_reserved += n_slab;
+		}
+		unsigned char * ptr = slabs.back() + slab_offset;
+		slab_offset += n_grain;
+		n_arrays ++;
+		n_bytes_used += n_grain;
+		n_bytes_heap += max(32UL, (n_bytes + sizeof(size_t) + 15) & ~15UL) + sizeof(vector < unsigned char >) - sizeof(slab_array < unsigned char >);
+		pthread_mutex_unlock(&mutex_slab);
+		memset(ptr, 0, n_bytes);
+		return ptr;
+	}
+
+public:
+	slab_allocator() {
+		slab_offset = slab_capacity = 0;
+		n_arrays = n_bytes_used = n_bytes_reserved = n_bytes_heap = 0;
+		pthread_mutex_init(&mutex_slab, NULL);
+	}
+
+	~slab_allocator() {
+		clear();
+		pthread_mutex_destroy(&mutex_slab);
+	}
+
+	void clear() {
+		for (int s = 0 ; s < slabs.size() ; s ++) std::free(slabs[s]);
+		slabs.clear();
+		slab_offset = slab_capacity = 0;
+		n_arrays = n_bytes_used = n_bytes_reserved = n_bytes_heap = 0;
+	}
+
+	template < class T >
+	slab_array < T > allocate(unsigned int n) {
+		if (n == 0) return slab_array < T > ();
+		return slab_array < T > ((T *)allocateBytes(n * sizeof(T)), n);
+	}
+
+	unsigned long numberOfArrays() const { return n_arrays; }
+	unsigned long numberOfSlabs() const { return slabs.size(); }
+	unsigned long bytesUsed() const { return n_bytes_used; }
+	unsigned long bytesReserved() const { return n_bytes_reserved; }
+	unsigned long bytesHeapEquivalent() const { return n_bytes_heap; }
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * Micro-benchmarks of the scaffold HMM of phase_rare. Kernels run on synthetic
+ * data simulated in-process and timings are written as JSON.
+ */
+
+#define _DECLARE_TOOLBOX_HERE
+#include <bench_header.h>
+
+bench::bench() : R("phase_rare") {
+	n_reps = 0;
+}
+
+bench::~bench() {
+}
+
+void bench::declare_options() {
+	bpo::options_description opt_base ("Basic options");
+	opt_base.add_options()
+			("help", "Produce help message")
+			("seed", bpo::value < int >()->default_value(15052011), "Seed of the random number generator")
+			("thread,T", bpo::value < int >()->default_value(1), "Number of thread used")
+			("reps", bpo::value < int >()->default_value(5), "Number of timed repetitions per benchmark")
+			("filter", bpo::value < string >()->default_value("hmm_scaffold"), "Comma-separated prefixes of the benchmarks to run");
+
+	bpo::options_description opt_data ("Synthetic data");
+	opt_data.add_options()
+			("samples", bpo::value < int >()->default_value(2000), "Number of simulated samples")
+			("sites", bpo::value < int >()->default_value(20000), "Number of simulated scaffold variant sites")
+			("founders", bpo::value < int >()->default_value(64), "Number of founder haplotypes the simulated haplotypes are mosaics of");
+
+	bpo::options_description opt_output ("Output files");
+	opt_output.add_options()
+			("output,O", bpo::value< string >(), "Benchmark results in JSON format [stdout by default]");
+
+	descriptions.add(opt_base).add(opt_data).add(opt_output);
+}
+
+void bench::parse_command_line(vector < string > & args) {
+	try {
+		bpo::store(bpo::command_line_parser(args).options(descriptions).run(), options);
+		bpo::notify(options);
+	} catch ( const boost::program_options::error& e ) { cerr << "Error parsing command line arguments: " << string(e.what()) << endl; exit(0); }
+
+	if (options.count("help")) { cout << descriptions << endl; exit(0); }
+	if (options["reps"].as < int > () < 1) vrb.error("--reps must be at least 1");
+	if (options["samples"].as < int > () < 8) vrb.error("--samples must be at least 8");
+	if (options["sites"].as < int > () < 1000) vrb.error("--sites must be at least 1000");
+	if (options.count("output") && !ofstream(options["output"].as < string > ()).good()) vrb.error("Cannot open [" + options["output"].as < string > () + "] for writing");
+}
+
+//A benchmark runs when a filter prefix matches its name; a group (e.g. "hmm") runs when it contains at least one of them
+bool bench::enabled(string name) {
+	vector < string > prefixes;
+	stb.split(options["filter"].as < string > (), prefixes, ",");
+	for (int p = 0 ; p < prefixes.size() ; p ++) {
+		if (name.compare(0, prefixes[p].size(), prefixes[p]) == 0) return true;
+		if (prefixes[p].compare(0, name.size(), name) == 0) return true;
+	}
+	return false;
+}
+
+void bench::run(vector < string > & args) {
+	declare_options();
+	parse_command_line(args);
+	n_reps = options["reps"].as < int > ();
+	rng.setSeed(options["seed"].as < int > ());
+	pool.start(options["thread"].as < int > ());
+	vrb.set_silent();
+
+	R.context.emplace_back("commit", bench_report::jstr(string(__COMMIT_ID__)));
+	R.context.emplace_back("simd", bench_report::jstr(bench_report::simd()));
+	R.context.emplace_back("threads", stb.str(pool.size()));
+	R.context.emplace_back("reps", stb.str(n_reps));
+	R.context.emplace_back("seed", stb.str(options["seed"].as < int > ()));
+
+	if (enabled("hmm_scaffold")) {
+		simulate();
+		R.context.emplace_back("samples", stb.str(C.n_samples));
+		R.context.emplace_back("sites", stb.str(C.n_scaffold_variants));
+		benchScaffold();
+	}
+
+	if (options.count("output")) {
+		ofstream fd (options["output"].as < string > ());
+		R.write(fd);
+	} else R.write(cout);
+	pool.stop();
+}
+
+int main(int argc, char ** argv) {
+	vector < string > args;
+	for (int a = 1 ; a < argc ; a ++) args.push_back(string(argv[a]));
+	bench().run(args);
+	return 0;
+}
@@ -0,0 +1,89 @@
+/*******************************************************************************
+ * Copyright (C) 2022-2023 Olivier Delaneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <bench_header.h>
+
+#include <models/hmm_scaffold/hmm_scaffold_header.h>
+
+/*
+ * Simulates the scaffold haplotypes of --samples samples at --sites variant sites
+ * (one every kb on average) as mosaics of --founders founder haplotypes.
+ */
+void bench::simulate() {
+	int n_samples = options["samples"].as < int > ();
+	int n_sites = options["sites"].as < int > ();
+	int n_founders = options["founders"].as < int > ();
+
+	string chr = "1", ref = "A", alt = "T";
+	vector < double > freq = vector < double > (n_sites);
+	for (int l = 0, bp = 1 ; l < n_sites ; l ++, bp += 1 + rng.getInt(2000)) {
+		string id = "rs" + stb.str(l + 1);
+		V.push(new variant (chr, bp, id, ref, alt, false, VARTYPE_SCAF));
+		freq[l] = pow(rng.getDouble(), 3.0);
+	}
+	V.setGeneticMap();
+	M.initialise(V, 15000, 2 * n_samples);
+
+	vector < vector < bool > > founders = vector < vector < bool > > (n_founders, vector < bool > (n_sites));
+	for (int f = 0 ; f < n_founders ; f ++) for (int l = 0 ; l < n_sites ; l ++) founders[f][l] = (rng.getDouble() < freq[l]);
+	C.allocate(n_samples, n_sites);
+	for (int h = 0 ; h < C.n_haplotypes ; h ++) {
+		int f = rng.getInt(n_founders);
+		for (int l = 0 ; l < n_sites ; l ++) {
+			if (rng.getDouble() < 0.002) f = rng.getInt(n_founders);
+			C.Hhap.set(h, l, founders[f][l] ^ (rng.getDouble() < 0.0005));
+		}
+	}
+	C.transposeHaplotypes_H2V(&pool);
+}
+
+/*
+ * Forward, forward+backward, Viterbi and fused forward+Viterbi passes of the scaffold HMM of one
+ * haplotype over all scaffold sites, for several numbers of conditioning
+ * haplotypes (K) drawn at random among the other samples.
+ */
+void bench::benchScaffold() {
+	vector < int > Ksizes = { 100, 400, 1600 };
+	vector < unsigned int > candidates = vector < unsigned int > (C.n_haplotypes - 2);
+	iota(candidates.begin(), candidates.end(), 2);
+	vector < vector < unsigned int > > cevents = vector < vector < unsigned int > > (C.n_scaffold_variants + 1);
+	vector < int > vpath;
+
+	for (int k = 0 ; k < Ksizes.size() ; k ++) {
+		if (Ksizes[k] > candidates.size()) continue;
+		C.indexes_pbwt_neighbour = vector < vector < unsigned int > > (C.n_haplotypes);
+		C.indexes_pbwt_neighbour[0] = candidates;
+		shuffle(C.indexes_pbwt_neighbour[0].begin(), C.indexes_pbwt_neighbour[0].end(), rng.getEngine());
+		C.indexes_pbwt_neighbour[0].resize(Ksizes[k]);
+		sort(C.indexes_pbwt_neighbour[0].begin(), C.indexes_pbwt_neighbour[0].end());
+
+		hmm_scaffold HMM(V, G, C, M);
+		vector < pair < string, string > > params = { { "K", stb.str(Ksizes[k]) }, { "L", stb.str(C.n_scaffold_variants) } };
+		if (enabled("hmm_scaffold_setup")) R.measure("hmm_scaffold_setup", params, n_reps, [&] () { HMM.setup(0); });
+		HMM.setup(0);
+		if (enabled("hmm_scaffold_forward")) R.measure("hmm_scaffold_forward", params, n_reps, [&] () { HMM.forward(); });
+		if (enabled("hmm_scaffold_forward_backward")) R.measure("hmm_scaffold_forward_backward", params, n_reps, [&] () { HMM.forward(); HMM.backward(cevents, vpath); });
+		if (enabled("hmm_scaffold_viterbi")) R.measure("hmm_scaffold_viterbi", params, n_reps, [&] () { HMM.viterbi(vpath); });
+		if (enabled("hmm_scaffold_viterbi_then_forward")) R.measure("hmm_scaffold_viterbi_then_forward", params, n_reps, [&] () { HMM.viterbi(vpath); HMM.forward(); });
+		if (enabled("hmm_scaffold_forward_viterbi")) R.measure("hmm_scaffold_forward_viterbi", params, n_reps, [&] () { HMM.forwardViterbi(vpath); });
+	}
+}
@@ -24,10 +24,11 @@
 #define _BITMATRIX_H
 
 #include <utils/otools.h>
+#include <utils/thread_pool.h>
 
-inline static unsigned int abracadabra(const unsigned int &i1, const unsigned int &i2) {
-	return static_cast<unsigned int>((static_cast<unsigned long int>(i1) * static_cast<unsigned long int>(i2)) >> 32);
-}
+//Transpose tiling: 512 rows give one cache line per destination row, 256 columns keep both sides of a tile in L1
+#define TRANSPOSE_TILE_ROWS	512
+#define TRANSPOSE_TILE_COLS	256
 
 class bitmatrix	{
 public:
@@ -46,11 +47,15 @@ public:
 
 
 	void subset(bitmatrix & BM, vector < unsigned int > & rows);
+	void subsetColumns(bitmatrix & BM, unsigned int col_from, unsigned int col_to);
 	void getMatchHetCount(unsigned int i0, unsigned int i1, int & c1, int & m1);
 	void set(unsigned int row, unsigned int col, unsigned char bit);
 	unsigned char get(unsigned int row, unsigned int col);
+	unsigned long expandRow(unsigned int row, unsigned int n, int * out, int val0, int val1);
 	unsigned char getByte(unsigned int row, unsigned int col);
-	void transpose(bitmatrix & BM, unsigned int _max_row, unsigned int _max_col);
+	void setByte(unsigned int row, unsigned int col, unsigned char byte);
+	void transposeTile(bitmatrix & BM, unsigned int row_from, unsigned int row_to, unsigned int max_col);
+	void transpose(bitmatrix & BM, unsigned int _max_row, unsigned int _max_col, thread_pool * pool = NULL);
 	void transpose(bitmatrix & BM);
 };
 
@@ -75,5 +80,11 @@ unsigned char bitmatrix::getByte(unsigned int row, unsigned int col) {
 	return bytes[targetAddr];
 }
 
+inline
+void bitmatrix::setByte(unsigned int row, unsigned int col, unsigned char byte) {
+	unsigned long targetAddr = ((unsigned long)row) * (n_cols>>3) +  (col>>3);
+	bytes[targetAddr] = byte;
+}
+
 
 #endif
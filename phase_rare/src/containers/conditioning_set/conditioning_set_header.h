@@ -24,11 +24,15 @@
 #define _CONDITIONING_SET_H
 
 #include <utils/otools.h>
+#include <utils/thread_pool.h>
 
 #include <containers/variant_map.h>
 #include <containers/haplotype_set.h>
+#include <containers/pbwt_sweep.h>
 #include <containers/genotype_set/genotype_set_header.h>
 
+#define SELECT_BLOCK 1024
+
 class cflip {
 public:
 	unsigned int pgenotype;
@@ -62,9 +66,13 @@ public:
 	vector < bool > sites_pbwt_evaluation;
 	vector < bool > sites_pbwt_selection;
 	vector < int > sites_pbwt_grouping;
+	vector < int > sites_pbwt_mthreading;
+	vector < int > starts_pbwt_mthreading;
+	vector < int > stops_pbwt_mthreading;
 	unsigned int sites_pbwt_ngroups;
-	unsigned long int ncollisions;
-	unsigned long int npushes;
+	unsigned int sites_pbwt_nchunks;
+	vector < unsigned long int > ncollisions;
+	vector < unsigned long int > npushes;
 
 	//PARAMETERS FOR PBWT
 	int depth_common;
@@ -74,20 +82,24 @@ public:
 	vector < cflip > CF;
 
 	//STATE DATA
+	vector < int > shuffledA;
 	unsigned int shuffledI;
 	vector < unsigned int > shuffledO;
-	vector < pair < unsigned int, unsigned int > > indexes_pbwt_neighbour_serialized;
+	vector < vector < pair < unsigned int, unsigned int > > > indexes_pbwt_neighbour_serialized;
 	vector < vector < unsigned int > > indexes_pbwt_neighbour;
 
 	//CONSTRUCTOR/DESTRUCTOR
 	conditioning_set();
 	~conditioning_set();
-	void initialize(variant_map &, float, float, int, int, int);
+	bool split(variant_map &, float, int, int, vector < int > &);
+	void initialize(variant_map &, float, float, float, int, int, int);
 
 	//STATES PROCESSING
-	void storeCommon(vector < int > & A, vector < int > & M);
-	void storeRare(vector < int > & R, vector < rare_genotype > & G);
-	void select(variant_map &, genotype_set & G);
+	void storeCommon(int job, vector < int > & A, vector < int > & M);
+	void storeRare(int job, vector < int > & R, vector < rare_genotype > & G);
+	void selectForward(int chunk, variant_map &, genotype_set & G);
+	void selectBackward(int chunk, variant_map &, genotype_set & G);
+	void select(variant_map &, genotype_set & G, thread_pool * pool = NULL);
 
 	/*
 	void solveRare1(vector < int > &, vector < int > &, genotype_set &, unsigned int);
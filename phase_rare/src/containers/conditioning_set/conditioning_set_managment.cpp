@@ -33,6 +33,9 @@ conditioning_set::~conditioning_set() {
 	sites_pbwt_evaluation.clear();
 	sites_pbwt_selection.clear();
 	sites_pbwt_grouping.clear();
+	sites_pbwt_mthreading.clear();
+	starts_pbwt_mthreading.clear();
+	stops_pbwt_mthreading.clear();
 	for (int h = 0 ; h < indexes_pbwt_neighbour.size() ; h ++) {
 		indexes_pbwt_neighbour[h].clear();
 		indexes_pbwt_neighbour[h].shrink_to_fit();
@@ -41,7 +44,29 @@ conditioning_set::~conditioning_set() {
 	indexes_pbwt_neighbour.shrink_to_fit();
 }
 
-void conditioning_set::initialize(variant_map & V, float _modulo_selection, float _mdr, int _depth_common, int _depth_rare, int _mac) {
+bool conditioning_set::split(variant_map & V, float min_length, int left_index, int right_index, vector < int > & output) {
+	int chunkSize = right_index - left_index + 1;
+	float chunkLength = V.vec_full[right_index]->cm - V.vec_full[left_index]->cm;
+
+	if ((chunkSize > 2) && (chunkLength > min_length)) {
+		vector <  int > left_output, right_output;
+		bool ret1 = split(V, min_length, left_index, left_index + chunkSize/2 - 1, left_output);
+		bool ret2 = split(V, min_length, left_index + chunkSize/2, right_index, right_output);
+
+		if (ret1 && ret2) {
+			output = vector < int >(left_output.size() + right_output.size());
+			std::copy(left_output.begin(), left_output.end(), output.begin());
+			std::copy(right_output.begin(), right_output.end(), output.begin() + left_output.size());
+		} else {
+			output.clear();
+			output.push_back(left_index);
+			output.push_back(right_index);
+		}
+		return true;
+	} else return false;
+}
+
+void conditioning_set::initialize(variant_map & V, float _modulo_selection, float _modulo_multithreading, float _mdr, int _depth_common, int _depth_rare, int _mac) {
 	tac.clock();
 
 	//SETTING PARAMETERS
@@ -63,10 +88,33 @@ void conditioning_set::initialize(variant_map & V, float _modulo_selection, floa
 	}
 	sites_pbwt_ngroups = sites_pbwt_grouping.back() + 1;
 
+	//MAPPING MT+STOR [chunks are defined on the full variant list since rare variants are stored along the sweeps]
+	sites_pbwt_mthreading = vector < int > (V.sizeFull(), -1);
+	vector < int > outputMT; outputMT.push_back(0); outputMT.push_back(V.sizeFull() - 1);
+	split(V, _modulo_multithreading, 0, V.sizeFull() - 1, outputMT);
+	for (int c = 0 ; c < outputMT.size() ; c += 2) {
+		for (int l = outputMT[c] ; l <= outputMT[c+1] ; l++) sites_pbwt_mthreading[l] = c/2;
+	}
+	sites_pbwt_nchunks = sites_pbwt_mthreading.back() + 1;
+
+	//MAPPING START/STOP OF MT [0.5cM of burn-in before the chunk for the forward sweep, after for the backward sweep]
+	starts_pbwt_mthreading = vector < int > (sites_pbwt_nchunks, -1);
+	stops_pbwt_mthreading = vector < int > (sites_pbwt_nchunks, -1);
+	for (int l = 0 ; l < V.sizeFull() ; l ++) {
+		if (starts_pbwt_mthreading[sites_pbwt_mthreading[l]] < 0) starts_pbwt_mthreading[sites_pbwt_mthreading[l]] = l;
+		stops_pbwt_mthreading[sites_pbwt_mthreading[l]] = l;
+	}
+	for (int c = 0 ; c < sites_pbwt_nchunks ; c ++) {
+		float storage_pos = V.vec_full[starts_pbwt_mthreading[c]]->cm;
+		while (starts_pbwt_mthreading[c] > 0 && (storage_pos - V.vec_full[starts_pbwt_mthreading[c]]->cm) < 0.5f) starts_pbwt_mthreading[c] --;
+		storage_pos = V.vec_full[stops_pbwt_mthreading[c]]->cm;
+		while (stops_pbwt_mthreading[c] < (V.sizeFull() - 1) && (V.vec_full[stops_pbwt_mthreading[c]]->cm - storage_pos) < 0.5f) stops_pbwt_mthreading[c] ++;
+	}
+
 	//ALLOCATE
 	indexes_pbwt_neighbour = vector < vector < unsigned int > > (n_haplotypes);
 	shuffledI = 0;
 	shuffledO = vector < unsigned int > (n_haplotypes);
 	iota(shuffledO.begin(), shuffledO.end(), 0);
-	vrb.bullet("PBWT initialization [#eval=" + stb.str(n_evaluated) + " / #select=" + stb.str(sites_pbwt_grouping.back() + 1) + "] (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
+	vrb.bullet("PBWT initialization [#eval=" + stb.str(n_evaluated) + " / #select=" + stb.str(sites_pbwt_grouping.back() + 1) + " / #chunk=" + stb.str(sites_pbwt_nchunks) + "] (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
 }
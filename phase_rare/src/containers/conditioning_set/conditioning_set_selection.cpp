@@ -22,90 +22,114 @@
 
 #include <containers/conditioning_set/conditioning_set_header.h>
 
-void conditioning_set::select(variant_map & V, genotype_set & G) {
-	tac.clock();
-
-	npushes = 0;
-	ncollisions = 0;
-
-	vector < int > A = vector < int > (n_haplotypes, 0);
-	vector < int > B = vector < int > (n_haplotypes, 0);
+void conditioning_set::selectForward(int chunk, variant_map & V, genotype_set & G) {
+	vector < int > A = shuffledA;
 	vector < int > R = vector < int > (n_haplotypes, 0);
 	vector < int > M = vector < int > (depth_common * n_haplotypes, -1);
-	iota(A.begin(), A.end(), 0);
-	random_shuffle(A.begin(), A.end());
+	pbwt_sweep PS (n_haplotypes);
+	for (int h = 0 ; h < n_haplotypes ; h ++) R[A[h]] = h;
 
-	//Select new sites at which to trigger storage
-	vector < vector < int > > candidates = vector < vector < int > > (sites_pbwt_grouping.back() + 1);
-	for (int l = 0 ; l < n_scaffold_variants ; l++) if (sites_pbwt_evaluation[l]) candidates[sites_pbwt_grouping[l]].push_back(l);
-	sites_pbwt_selection = vector < bool > (n_scaffold_variants , false);
-	for (int g = 0 ; g < candidates.size() ; g++) {
-		if (candidates[g].size() > 0) {
-			sites_pbwt_selection[candidates[g][rng.getInt(candidates[g].size())]] = true;
-		}
-	}
-
-	//PBWT forward sweep
-	tac.clock();
-	for (int vt = 0 ; vt < V.sizeFull() ; vt ++) {
-		int vc = V.vec_full[vt]->idx_common;
+	for (int vt = starts_pbwt_mthreading[chunk] ; vt <= stops_pbwt_mthreading[chunk] && sites_pbwt_mthreading[vt] <= chunk ; vt ++) {
 		int vr = V.vec_full[vt]->idx_rare;
 		int vs = V.vec_full[vt]->idx_scaffold;
+		bool chnk = (sites_pbwt_mthreading[vt] == chunk);
 
 		if (vs >= 0) {
-			bool eval = sites_pbwt_evaluation[vs];
-			bool selc = sites_pbwt_selection[vs];
-			if (eval) {
-				int u = 0, v = 0;
-				for (int h = 0 ; h < n_haplotypes ; h ++) {
-					if (!Hvar.get(vs, A[h])) A[u++] = A[h];
-					else B[v++] = A[h];
-				}
-				std::copy(B.begin(), B.begin()+v, A.begin()+u);
+			if (sites_pbwt_evaluation[vs]) {
+				PS.sort(Hvar, vs, A);
 				for (int h = 0 ; h < n_haplotypes ; h ++) R[A[h]] = h;
-				if (selc) storeCommon(A, M);
+				if (chnk && sites_pbwt_selection[vs]) storeCommon(chunk, A, M);
 			}
-		} else if (vr >= 0 && G.GRvar_genotypes[vr].size() > 1) storeRare(R, G.GRvar_genotypes[vr]);
-		vrb.progress("  * PBWT forward selection", vt * 1.0 / V.sizeFull());
+		} else if (chnk && vr >= 0 && G.GRvar_genotypes[vr].size() > 1) storeRare(chunk, R, G.GRvar_genotypes[vr]);
 	}
-	sort(indexes_pbwt_neighbour_serialized.begin(), indexes_pbwt_neighbour_serialized.end());
-	indexes_pbwt_neighbour_serialized.erase(unique(indexes_pbwt_neighbour_serialized.begin(), indexes_pbwt_neighbour_serialized.end()), indexes_pbwt_neighbour_serialized.end());
-	vrb.bullet("PBWT forward selection (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
+	sort(indexes_pbwt_neighbour_serialized[chunk].begin(), indexes_pbwt_neighbour_serialized[chunk].end());
+	indexes_pbwt_neighbour_serialized[chunk].erase(unique(indexes_pbwt_neighbour_serialized[chunk].begin(), indexes_pbwt_neighbour_serialized[chunk].end()), indexes_pbwt_neighbour_serialized[chunk].end());
+}
 
-	//PBWT backward sweep
-	tac.clock();
-	for (int vt = V.sizeFull()-1 ; vt >= 0 ; vt --) {
-		int vc = V.vec_full[vt]->idx_common;
+void conditioning_set::selectBackward(int chunk, variant_map & V, genotype_set & G) {
+	int job = sites_pbwt_nchunks + chunk;
+	vector < int > A = shuffledA;
+	vector < int > R = vector < int > (n_haplotypes, 0);
+	vector < int > M = vector < int > (depth_common * n_haplotypes, -1);
+	pbwt_sweep PS (n_haplotypes);
+	for (int h = 0 ; h < n_haplotypes ; h ++) R[A[h]] = h;
+
+	for (int vt = stops_pbwt_mthreading[chunk] ; vt >= starts_pbwt_mthreading[chunk] && sites_pbwt_mthreading[vt] >= chunk ; vt --) {
 		int vr = V.vec_full[vt]->idx_rare;
 		int vs = V.vec_full[vt]->idx_scaffold;
+		bool chnk = (sites_pbwt_mthreading[vt] == chunk);
 
 		if (vs >= 0) {
-			bool eval = sites_pbwt_evaluation[vs];
-			bool selc = sites_pbwt_selection[vs];
-			if (eval) {
-				int u = 0, v = 0;
-				for (int h = 0 ; h < n_haplotypes ; h ++) {
-					if (!Hvar.get(vs, A[h])) A[u++] = A[h];
-					else B[v++] = A[h];
-				}
-				std::copy(B.begin(), B.begin()+v, A.begin()+u);
+			if (sites_pbwt_evaluation[vs]) {
+				PS.sort(Hvar, vs, A);
 				for (int h = 0 ; h < n_haplotypes ; h ++) R[A[h]] = h;
-				if (selc) storeCommon(A, M);
+				if (chnk && sites_pbwt_selection[vs]) storeCommon(job, A, M);
 			}
-		} else if (vr >= 0 && G.GRvar_genotypes[vr].size() > 1) storeRare(R, G.GRvar_genotypes[vr]);
-		vrb.progress("  * PBWT backward selection", (V.sizeFull()-vt) * 1.0 / V.sizeFull());
+		} else if (chnk && vr >= 0 && G.GRvar_genotypes[vr].size() > 1) storeRare(job, R, G.GRvar_genotypes[vr]);
 	}
-	sort(indexes_pbwt_neighbour_serialized.begin(), indexes_pbwt_neighbour_serialized.end());
-	indexes_pbwt_neighbour_serialized.erase(unique(indexes_pbwt_neighbour_serialized.begin(), indexes_pbwt_neighbour_serialized.end()), indexes_pbwt_neighbour_serialized.end());
-	vrb.bullet("PBWT backward selection (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
+	sort(indexes_pbwt_neighbour_serialized[job].begin(), indexes_pbwt_neighbour_serialized[job].end());
+	indexes_pbwt_neighbour_serialized[job].erase(unique(indexes_pbwt_neighbour_serialized[job].begin(), indexes_pbwt_neighbour_serialized[job].end()), indexes_pbwt_neighbour_serialized[job].end());
+}
 
-	basic_stats statK;
-	for (long int h = 0, e = 0 ; h < n_haplotypes ; h ++) {
-		vector < unsigned int > buffer;
-		while (indexes_pbwt_neighbour_serialized[e].first == h) {
-			buffer.push_back(indexes_pbwt_neighbour_serialized[e].second);
-			e++;
+void conditioning_set::select(variant_map & V, genotype_set & G, thread_pool * pool) {
+	tac.clock();
+
+	//Select new sites at which to trigger storage
+	vector < vector < int > > candidates = vector < vector < int > > (sites_pbwt_grouping.back() + 1);
+	for (int l = 0 ; l < n_scaffold_variants ; l++) if (sites_pbwt_evaluation[l]) candidates[sites_pbwt_grouping[l]].push_back(l);
+	sites_pbwt_selection = vector < bool > (n_scaffold_variants , false);
+	for (int g = 0 ; g < candidates.size() ; g++) {
+		if (candidates[g].size() > 0) {
+			sites_pbwt_selection[candidates[g][rng.getInt(candidates[g].size())]] = true;
+		}
+	}
+
+	//Initial order of the PBWT sweeps: one seeded shuffle shared by all chunks and directions, so that ties are broken at random whatever the chunking
+	shuffledA = vector < int > (n_haplotypes);
+	iota(shuffledA.begin(), shuffledA.end(), 0);
+	shuffle(shuffledA.begin(), shuffledA.end(), rng.getEngine());
+
+	//PBWT forward and backward sweeps [one job per chunk and direction, each with its own output]
+	unsigned int n_jobs = 2 * sites_pbwt_nchunks;
+	npushes = vector < unsigned long int > (n_jobs, 0);
+	ncollisions = vector < unsigned long int > (n_jobs, 0);
+	indexes_pbwt_neighbour_serialized = vector < vector < pair < unsigned int, unsigned int > > > (n_jobs);
+	auto sweep = [&] (int id_worker, int id_job) {
+		if (id_job < sites_pbwt_nchunks) selectForward(id_job, V, G);
+		else selectBackward(id_job - sites_pbwt_nchunks, V, G);
+	};
+	if (pool) pool->run(n_jobs, sweep, "  * PBWT selection");
+	else for (int j = 0 ; j < n_jobs ; j ++) {
+		sweep(0, j);
+		vrb.progress("  * PBWT selection", (j+1) * 1.0 / n_jobs);
+	}
+	vrb.bullet("PBWT forward/backward selection (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
+
+	//Merge the neighbours found by all jobs, by blocks of haplotypes
+	tac.clock();
+	unsigned int n_blocks = (n_haplotypes + SELECT_BLOCK - 1) / SELECT_BLOCK;
+	auto merge = [&] (int id_worker, int id_block) {
+		unsigned int h_from = id_block * SELECT_BLOCK;
+		unsigned int h_to = min(h_from + SELECT_BLOCK, n_haplotypes);
+		for (int j = 0 ; j < n_jobs ; j ++) {
+			vector < pair < unsigned int, unsigned int > > & O = indexes_pbwt_neighbour_serialized[j];
+			auto it = lower_bound(O.begin(), O.end(), pair < unsigned int, unsigned int > (h_from, 0));
+			for ( ; it != O.end() && it->first < h_to ; ++it) indexes_pbwt_neighbour[it->first].push_back(it->second);
+		}
+		for (int h = h_from ; h < h_to ; h ++) {
+			sort(indexes_pbwt_neighbour[h].begin(), indexes_pbwt_neighbour[h].end());
+			indexes_pbwt_neighbour[h].erase(unique(indexes_pbwt_neighbour[h].begin(), indexes_pbwt_neighbour[h].end()), indexes_pbwt_neighbour[h].end());
 		}
+	};
+	for (int h = 0 ; h < n_haplotypes ; h ++) indexes_pbwt_neighbour[h].clear();
+	if (pool) pool->run(n_blocks, merge);
+	else for (int b = 0 ; b < n_blocks ; b ++) merge(0, b);
+	indexes_pbwt_neighbour_serialized.clear();
+	indexes_pbwt_neighbour_serialized.shrink_to_fit();
+
+	basic_stats statK;
+	for (long int h = 0 ; h < n_haplotypes ; h ++) {
+		vector < unsigned int > & buffer = indexes_pbwt_neighbour[h];
 
 		//Minimal number of states is 50
 		if (buffer.size() < 50) {
@@ -117,19 +141,19 @@ void conditioning_set::select(variant_map & V, genotype_set & G) {
 			buffer.erase(unique(buffer.begin(), buffer.end()), buffer.end());
 		}
 
-		indexes_pbwt_neighbour[h].reserve(buffer.size());
-		indexes_pbwt_neighbour[h] = buffer;
+		buffer.shrink_to_fit();
 		assert(indexes_pbwt_neighbour[h].size());
 		statK.push(indexes_pbwt_neighbour[h].size());
 	}
 
-	indexes_pbwt_neighbour_serialized.clear();
-	indexes_pbwt_neighbour_serialized.shrink_to_fit();
+	unsigned long int tpushes = accumulate(npushes.begin(), npushes.end(), 0UL);
+	unsigned long int tcollisions = accumulate(ncollisions.begin(), ncollisions.end(), 0UL);
+	vrb.bullet("PBWT merging (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
 	vrb.bullet2("#states="+ stb.str(statK.mean(), 2) + "+/-" + stb.str(statK.sd(), 2));
-	vrb.bullet2("#collisions = "+ stb.str(ncollisions) + " / #pushes = "+ stb.str(npushes) + " / rate = " + stb.str(npushes * 100.0 / (npushes + ncollisions), 2) + "%");
+	vrb.bullet2("#collisions = "+ stb.str(tcollisions) + " / #pushes = "+ stb.str(tpushes) + " / rate = " + stb.str(tpushes * 100.0 / (tpushes + tcollisions), 2) + "%");
 }
 
-void conditioning_set::storeRare(vector < int > & R, vector < rare_genotype > & G) {
+void conditioning_set::storeRare(int job, vector < int > & R, vector < rare_genotype > & G) {
 	vector < pair < int, int > > N;
 	for (int g = 0 ; g < G.size() ; g ++) {
 		if (!G[g].mis) {
@@ -148,14 +172,14 @@ void conditioning_set::storeRare(vector < int > & R, vector < rare_genotype > &
 			done = 1;
 			if (h-offset >= 0) {
 				if (N[h-offset].second/2 != target_hap/2) {
-					indexes_pbwt_neighbour_serialized.push_back(pair < unsigned int, unsigned int > (target_hap, N[h-offset].second));
+					indexes_pbwt_neighbour_serialized[job].push_back(pair < unsigned int, unsigned int > (target_hap, N[h-offset].second));
 					nstored ++;
 				}
 				done = 0;
 			}
 			if (h+offset < N.size()) {
 				if (N[h+offset].second/2 != target_hap/2) {
-					indexes_pbwt_neighbour_serialized.push_back(pair < unsigned int, unsigned int > (target_hap, N[h+offset].second));
+					indexes_pbwt_neighbour_serialized[job].push_back(pair < unsigned int, unsigned int > (target_hap, N[h+offset].second));
 					nstored ++;
 				}
 				done = 0;
@@ -165,7 +189,7 @@ void conditioning_set::storeRare(vector < int > & R, vector < rare_genotype > &
 	}
 }
 
-void conditioning_set::storeCommon(vector < int > & A, vector < int > & M) {
+void conditioning_set::storeCommon(int job, vector < int > & A, vector < int > & M) {
 	for (int h = 0 ; h < n_haplotypes ; h ++) {
 		int chap = A[h], add_guess0 = 0, add_guess1 = 0, offset0 = 1, offset1 = 1, hap_guess0 = -1, hap_guess1 = -1;
 		for (int n_added = 0 ; n_added < depth_common ; ) {
@@ -179,30 +203,30 @@ void conditioning_set::storeCommon(vector < int > & A, vector < int > & M) {
 			} else add_guess1 = 0;
 			if (add_guess0 && add_guess1) {
 				if (hap_guess0 != M[chap * depth_common + n_added]) {
-					indexes_pbwt_neighbour_serialized.push_back(pair < unsigned int, unsigned int > (chap, hap_guess0));
+					indexes_pbwt_neighbour_serialized[job].push_back(pair < unsigned int, unsigned int > (chap, hap_guess0));
 					M[chap * depth_common + n_added] = hap_guess0;
-					npushes++;
-				} else ncollisions++;
+					npushes[job]++;
+				} else ncollisions[job]++;
 				offset0++; n_added++;
 				if (hap_guess1 != M[chap * depth_common + n_added]) {
-					indexes_pbwt_neighbour_serialized.push_back(pair < unsigned int, unsigned int > (chap, hap_guess1));
+					indexes_pbwt_neighbour_serialized[job].push_back(pair < unsigned int, unsigned int > (chap, hap_guess1));
 					M[chap * depth_common + n_added] = hap_guess1;
-					npushes++;
-				} else ncollisions++;
+					npushes[job]++;
+				} else ncollisions[job]++;
 				offset1++; n_added++;
 			} else if (add_guess0) {
 				if (hap_guess0 != M[chap * depth_common + n_added]) {
-					indexes_pbwt_neighbour_serialized.push_back(pair < unsigned int, unsigned int > (chap, hap_guess0));
+					indexes_pbwt_neighbour_serialized[job].push_back(pair < unsigned int, unsigned int > (chap, hap_guess0));
 					M[chap * depth_common + n_added] = hap_guess0;
-					npushes++;
-				} else ncollisions++;
+					npushes[job]++;
+				} else ncollisions[job]++;
 				offset0++; n_added++;
 			} else if (add_guess1) {
 				if (hap_guess1 != M[chap * depth_common + n_added]) {
-					indexes_pbwt_neighbour_serialized.push_back(pair < unsigned int, unsigned int > (chap, hap_guess1));
+					indexes_pbwt_neighbour_serialized[job].push_back(pair < unsigned int, unsigned int > (chap, hap_guess1));
 					M[chap * depth_common + n_added] = hap_guess1;
-					npushes++;
-				} else ncollisions++;
+					npushes[job]++;
+				} else ncollisions[job]++;
 				offset1++; n_added++;
 			} else {
 				offset0++;
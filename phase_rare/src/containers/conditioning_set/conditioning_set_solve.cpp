@@ -27,10 +27,9 @@ void conditioning_set::solve(variant_map & V, genotype_set & G) {
 
 	//
 	vector < int > A = vector < int > (n_haplotypes, 0);
-	vector < int > B = vector < int > (n_haplotypes, 0);
 	vector < int > C = vector < int > (n_haplotypes, 0);
-	vector < int > D = vector < int > (n_haplotypes, 0);
 	vector < int > R = vector < int > (n_haplotypes, 0);
+	pbwt_sweep PS (n_haplotypes);
 	iota(A.begin(), A.end(), 0);
 	random_shuffle(A.begin(), A.end());
 
@@ -49,25 +48,7 @@ void conditioning_set::solve(variant_map & V, genotype_set & G) {
 			bool eval = sites_pbwt_evaluation[vs];
 			bool selc = sites_pbwt_selection[vs];
 			if (eval) {
-				int u = 0, v = 0, p = vs, q = vs;
-				for (int h = 0 ; h < n_haplotypes ; h ++) {
-					int alookup = A[h], dlookup = C[h];
-					if (dlookup > p) p = dlookup;
-					if (dlookup > q) q = dlookup;
-					if (!Hvar.get(vs, alookup)) {
-						A[u] = alookup;
-						C[u] = p;
-						p = 0;
-						u++;
-					} else {
-						B[v] = alookup;
-						D[v] = q;
-						q = 0;
-						v++;
-					}
-				}
-				std::copy(B.begin(), B.begin()+v, A.begin()+u);
-				std::copy(D.begin(), D.begin()+v, C.begin()+u);
+				PS.sortForward(Hvar, vs, A, C);
 				for (int h = 0 ; h < n_haplotypes ; h ++) R[A[h]] = h;
 			}
 		} else if (vr >= 0) solveRareForward(A, C, R, G, vr, V.vec_rare[vr]->cm, vs_cm);
@@ -87,25 +68,7 @@ void conditioning_set::solve(variant_map & V, genotype_set & G) {
 			bool eval = sites_pbwt_evaluation[vs];
 			bool selc = sites_pbwt_selection[vs];
 			if (eval) {
-				int u = 0, v = 0, p = vs, q = vs;
-				for (int h = 0 ; h < n_haplotypes ; h ++) {
-					int alookup = A[h], dlookup = C[h];
-					if (dlookup < p) p = dlookup;
-					if (dlookup < q) q = dlookup;
-					if (!Hvar.get(vs, alookup)) {
-						A[u] = alookup;
-						C[u] = p;
-						p = V.sizeScaffold() - 1;
-						u++;
-					} else {
-						B[v] = alookup;
-						D[v] = q;
-						q = V.sizeScaffold() - 1;
-						v++;
-					}
-				}
-				std::copy(B.begin(), B.begin()+v, A.begin()+u);
-				std::copy(D.begin(), D.begin()+v, C.begin()+u);
+				PS.sortBackward(Hvar, vs, A, C, V.sizeScaffold() - 1);
 				for (int h = 0 ; h < n_haplotypes ; h ++) R[A[h]] = h;
 			}
 		} else if (vr >= 0) solveRareBackward(A, C, R, G, vr, V.vec_rare[vr]->cm, vs_cm);
@@ -49,14 +49,14 @@ void haplotype_set::allocate(unsigned int _n_samples, unsigned int _n_scaffold_v
 	vrb.bullet("HAP allocation [#scaffold=" + stb.str(n_scaffold_variants) + " / #samples=" + stb.str(n_samples) + "] (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
 }
 
-void haplotype_set::transposeHaplotypes_H2V() {
+void haplotype_set::transposeHaplotypes_H2V(thread_pool * pool) {
 	tac.clock();
-	Hhap.transpose(Hvar, n_haplotypes, n_scaffold_variants);
+	Hhap.transpose(Hvar, n_haplotypes, n_scaffold_variants, pool);
 	vrb.bullet("H2V transpose (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
 }
 
-void haplotype_set::transposeHaplotypes_V2H() {
+void haplotype_set::transposeHaplotypes_V2H(thread_pool * pool) {
 	tac.clock();
-	Hvar.transpose(Hhap, n_scaffold_variants, n_haplotypes);
+	Hvar.transpose(Hhap, n_scaffold_variants, n_haplotypes, pool);
 	vrb.bullet("V2H transpose (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
 }
@@ -42,8 +42,8 @@ public:
 	~haplotype_set();
 	void clear();
 	void allocate(unsigned int, unsigned int);
-	void transposeHaplotypes_H2V();
-	void transposeHaplotypes_V2H();
+	void transposeHaplotypes_H2V(thread_pool * pool = NULL);
+	void transposeHaplotypes_V2H(thread_pool * pool = NULL);
 
 };
 #endif
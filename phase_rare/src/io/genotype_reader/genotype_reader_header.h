@@ -49,8 +49,8 @@ public:
 	string fphased;
 	string fbinary;
 	string scaffold_region;
-	int input_start;
-	int input_stop;
+	vector < int > input_starts;		//Sorted and non-overlapping input regions, [start, stop)
+	vector < int > input_stops;
 	int nthreads;
 	float minmaf;
 
@@ -61,8 +61,9 @@ public:
 	//PARAMS
 	void setFilenames(string, string, string);
 	void setThreads(int);
-	void setRegions(string, int, int);
+	void setRegions(string, vector < int > &, vector < int > &);
 	void setMAF(float);
+	bool inInputRegions(int);
 
 	//IO
 	void scanGenotypesPlain();
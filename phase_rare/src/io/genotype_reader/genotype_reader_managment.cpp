@@ -30,8 +30,8 @@ genotype_reader::genotype_reader(haplotype_set & _H, genotype_set & _G, variant_
 	funphased = "";
 	fphased = "";
 	scaffold_region = "";
-	input_start = 0;
-	input_start = 1000000000;
+	input_starts.clear();
+	input_stops.clear();
 	n_scaffold_genotypes = vector < unsigned long > (4, 0);
 	n_rare_genotypes = vector < unsigned long > (4, 0);
 }
@@ -44,8 +44,8 @@ genotype_reader::~genotype_reader() {
 	funphased = "";
 	fphased = "";
 	scaffold_region = "";
-	input_start = 0;
-	input_start = 1000000000;
+	input_starts.clear();
+	input_stops.clear();
 	n_scaffold_genotypes = vector < unsigned long > (4, 0);
 	n_rare_genotypes = vector < unsigned long > (4, 0);
 }
@@ -63,10 +63,15 @@ void genotype_reader::setFilenames (string _funphased, string _fbinary, string _
 
 void genotype_reader::setThreads(int _nthreads) { nthreads = _nthreads; }
 
-void genotype_reader::setRegions(string _scaffold_region, int _input_start, int _input_stop) {
-	input_start = _input_start;
-	input_stop = _input_stop;
+void genotype_reader::setRegions(string _scaffold_region, vector < int > & _input_starts, vector < int > & _input_stops) {
+	input_starts = _input_starts;
+	input_stops = _input_stops;
 	scaffold_region = _scaffold_region;
 }
 
 void genotype_reader::setMAF(float _minmaf) { minmaf = _minmaf; }
+
+bool genotype_reader::inInputRegions(int pos) {
+	int r = upper_bound(input_starts.begin(), input_starts.end(), pos) - input_starts.begin() - 1;
+	return (r >= 0 && pos < input_stops[r]);
+}
@@ -21,6 +21,7 @@
  ******************************************************************************/
 
 #include <io/genotype_reader/genotype_reader_header.h>
+#include <io/sparse_bin.h>
 
 void genotype_reader::readGenotypesPlain() {
 	tac.clock();
@@ -85,7 +86,7 @@ void genotype_reader::readGenotypesPlain() {
 			vs++; vt ++;
 		} else {
 			int pos = line_unphased->pos + 1;
-			if (pos >= input_start && pos < input_stop) {
+			if (inInputRegions(pos)) {
 				if (V.vec_full[vt]->type == VARTYPE_RARE) {
 					bool minor =  V.vec_full[vt]->minor;
 					ngt_unphased = bcf_get_genotypes(sr->readers[0].header, line_unphased, &gt_arr_unphased, &ngt_arr_unphased); assert(ngt_unphased == 2 * n_samples);
@@ -158,9 +159,9 @@ void genotype_reader::readGenotypesSparse() {
 		}
 	}
 
-	//Opening sparse BIN file
-	std::ifstream fp_binary (fbinary, std::ios::in | std::ios::binary);
-	if (!fp_binary) vrb.error("Cannot open " + fbinary + " for reading, check permissions");
+	//Mapping sparse BIN file in memory [v1 or v2]; rare genotypes are stored in the same order as the variants so that it is read sequentially
+	sparse_bin_reader fp_binary;
+	fp_binary.open(fbinary);
 
 	//Sample processing
 	n_samples = bcf_hdr_nsamples(sr->readers[0].header);
@@ -195,18 +196,17 @@ void genotype_reader::readGenotypesSparse() {
 			vs++; vt ++;
 		} else {
 			int pos = line_unphased->pos + 1;
-			if (pos >= input_start && pos < input_stop) {
+			if (inInputRegions(pos)) {
 				assert(V.vec_full[vt]->type == VARTYPE_RARE);
 				bool minor =  V.vec_full[vt]->minor;
 
 				rsk = bcf_get_info_int32(sr->readers[1].header, line_unphased, "SEEK", &vsk, &nsk); if (nsk!=2) vrb.error("SEEK field is needed in rare file");
 
-				unsigned int * rg_buffer = (unsigned int *)malloc(vsk[1] * sizeof(unsigned int));
-				fp_binary.seekg(vsk[0]*sizeof(unsigned int), fp_binary.beg);
-				fp_binary.read((char *)rg_buffer, vsk[1] * sizeof(unsigned int));
-				for (int r = 0 ; r < vsk[1] ; r++) n_rare_genotypes[G.pushRare(vr, rg_buffer[r])] ++;
-				n_rare_genotypes[2*(1-minor)] += n_samples-vsk[1];
-				free(rg_buffer);
+				unsigned int rg_count = vsk[1];
+				const unsigned int * rg_words = fp_binary.read(vsk[0], rg_count, pos);
+				G.GRvar_genotypes[vr].reserve(rg_count);
+				for (unsigned int r = 0 ; r < rg_count ; r++) n_rare_genotypes[G.pushRare(vr, rg_words[r])] ++;
+				n_rare_genotypes[2*(1-minor)] += n_samples-rg_count;
 
 				vr++; vt ++;
 			}
@@ -80,7 +80,7 @@ void genotype_reader::scanGenotypesPlain() {
 		} else {
 			bcf_unpack(line_unphased, BCF_UN_STR);
 			int pos = line_unphased->pos + 1;
-			if (pos >= input_start && pos < input_stop) {
+			if (inInputRegions(pos)) {
 				string chr = bcf_hdr_id2name(sr->readers[0].header, line_unphased->rid);
 				string id = string(line_unphased->d.id);
 				string ref = string(line_unphased->d.allele[0]);
@@ -158,7 +158,7 @@ void genotype_reader::scanGenotypesSparse() {
 		} else {
 			bcf_unpack(line_unphased, BCF_UN_STR);
 			int pos = line_unphased->pos + 1;
-			if (pos >= input_start && pos < input_stop) {
+			if (inInputRegions(pos)) {
 				string chr = bcf_hdr_id2name(sr->readers[1].header, line_unphased->rid);
 				string id = string(line_unphased->d.id);
 				string ref = string(line_unphased->d.allele[0]);
@@ -27,21 +27,70 @@
 #define OFILE_VCFC	1
 #define OFILE_BCFC	2
 
-haplotype_writer::haplotype_writer(haplotype_set & _H, genotype_set & _G, variant_map & _V, int _nthreads): H(_H), G(_G), V(_V) {
-	nthreads = _nthreads;
+//Maximum number of GT values held by the records of a block built in parallel
+#define OBLOCK_GTS	(1UL << 27)
+
+haplotype_writer::haplotype_writer(haplotype_set & _H, genotype_set & _G, variant_map & _V, thread_pool & _pool): pool(_pool), H(_H), G(_G), V(_V) {
 }
 
 haplotype_writer::~haplotype_writer() {
 }
 
 
-void haplotype_writer::setRegions(int _input_start, int _input_stop) {
-	input_start = _input_start;
-	input_stop = _input_stop;
+void haplotype_writer::setRegions(vector < int > & _input_starts, vector < int > & _input_stops) {
+	input_starts = _input_starts;
+	input_stops = _input_stops;
+}
+
+//Is bp within the given input region, or within any of them when region < 0
+bool haplotype_writer::inInputRegion(int bp, int region) {
+	if (region >= 0) return (bp >= input_starts[region] && bp < input_stops[region]);
+	int r = upper_bound(input_starts.begin(), input_starts.end(), bp) - input_starts.begin() - 1;
+	return (r >= 0 && bp < input_stops[r]);
 }
 
 
-void haplotype_writer::writeHaplotypes(string fname, bool output_buffer) {
+void haplotype_writer::buildRecord(bcf_hdr_t * hdr, bcf1_t * rec, int vt, int vs, int vr, int * genotypes, float * probabilities) {
+	//Variant informations
+	bcf_clear1(rec);
+	rec->rid = bcf_hdr_name2id(hdr, V.vec_full[vt]->chr.c_str());
+	rec->pos = V.vec_full[vt]->bp - 1;
+	bcf_update_id(hdr, rec, V.vec_full[vt]->id.c_str());
+	string alleles = V.vec_full[vt]->ref + "," + V.vec_full[vt]->alt;
+	bcf_update_alleles_str(hdr, rec, alleles.c_str());
+
+	//Genotypes
+	int count_alt = 0;
+
+	if (V.vec_full[vt]->type == VARTYPE_RARE) {
+		bool major_allele = !V.vec_full[vt]->minor;
+		for (int i = 0 ; i < G.n_samples ; i++) {
+			genotypes[2*i+0] = bcf_gt_phased(major_allele);
+			genotypes[2*i+1] = bcf_gt_phased(major_allele);
+			bcf_float_set_missing(probabilities[i]);
+			count_alt += 2 * major_allele;
+		}
+		for (int i = 0 ; i < G.GRvar_genotypes[vr].size() ; i++) {
+			bool a0 = G.GRvar_genotypes[vr][i].al0;
+			bool a1 = G.GRvar_genotypes[vr][i].al1;
+			genotypes[2*G.GRvar_genotypes[vr][i].idx+0] = bcf_gt_phased(a0);
+			genotypes[2*G.GRvar_genotypes[vr][i].idx+1] = bcf_gt_phased(a1);
+			probabilities[G.GRvar_genotypes[vr][i].idx] = roundf(G.GRvar_genotypes[vr][i].prob * 1000.0) / 1000.0;
+			count_alt -= 2 * major_allele;
+			count_alt += a0+a1;
+		}
+		bcf_update_format_float(hdr, rec, "PP", probabilities, bcf_hdr_nsamples(hdr)*1);
+	} else {
+		count_alt = H.Hvar.expandRow(vs, 2 * H.n_samples, genotypes, bcf_gt_phased(0), bcf_gt_phased(1));
+	}
+
+	bcf_update_info_int32(hdr, rec, "AC", &count_alt, 1);
+	bcf_update_info_int32(hdr, rec, "AN", &G.n_samples, 1);
+	bcf_update_genotypes(hdr, rec, genotypes, bcf_hdr_nsamples(hdr)*2);
+	if (V.vec_full[vt]->type == VARTYPE_RARE) bcf_update_format_float(hdr, rec, "PP", probabilities, bcf_hdr_nsamples(hdr)*1);
+}
+
+void haplotype_writer::writeHaplotypes(string fname, bool output_buffer, int region) {
 	// Init
 	tac.clock();
 	string file_format = "w";
@@ -49,9 +98,8 @@ void haplotype_writer::writeHaplotypes(string fname, bool output_buffer) {
 	if (fname.size() > 6 && fname.substr(fname.size()-6) == "vcf.gz") { file_format = "wz"; file_type = OFILE_VCFC; }
 	if (fname.size() > 3 && fname.substr(fname.size()-3) == "bcf") { file_format = "wb"; file_type = OFILE_BCFC; }
 	htsFile * fp = hts_open(fname.c_str(),file_format.c_str());
-	if (nthreads > 1) hts_set_threads(fp, nthreads);
+	if (pool.size() > 1) hts_set_threads(fp, pool.size());
 	bcf_hdr_t * hdr = bcf_hdr_init("w");
-	bcf1_t *rec = bcf_init1();
 
 	// Create VCF header
 	bcf_hdr_append(hdr, string("##source=shapeit5 phase 2 v" + string(PHASE2_VERSION)).c_str());
@@ -66,77 +114,43 @@ void haplotype_writer::writeHaplotypes(string fname, bool output_buffer) {
 	bcf_hdr_add_sample(hdr, NULL);      // to update internal structures
 	if (bcf_hdr_write(fp, hdr) < 0) vrb.error("Failing to write VCF/header");
 
-	//Add records
-	int * genotypes = (int*)malloc(bcf_hdr_nsamples(hdr)*2*sizeof(int));
-	float * probabilities = (float*)malloc(bcf_hdr_nsamples(hdr)*1*sizeof(float));
-
+	//Map variants to be written onto their scaffold / rare indexes
+	vector < int > index_vt, index_vs, index_vr;
 	for (int vt = 0, vc = 0, vs = 0, vr = 0 ; vt < V.sizeFull() ; vt ++) {
-
-		if (output_buffer || (V.vec_full[vt]->bp >= input_start && V.vec_full[vt]->bp < input_stop)) {
-
-			//Variant informations
-			bcf_clear1(rec);
-			rec->rid = bcf_hdr_name2id(hdr, V.vec_full[vt]->chr.c_str());
-			rec->pos = V.vec_full[vt]->bp - 1;
-			bcf_update_id(hdr, rec, V.vec_full[vt]->id.c_str());
-			string alleles = V.vec_full[vt]->ref + "," + V.vec_full[vt]->alt;
-			bcf_update_alleles_str(hdr, rec, alleles.c_str());
-
-			//Genotypes
-			int count_alt = 0;
-
-			if (V.vec_full[vt]->type == VARTYPE_RARE) {
-				bool major_allele = !V.vec_full[vt]->minor;
-				for (int i = 0 ; i < G.n_samples ; i++) {
-					genotypes[2*i+0] = bcf_gt_phased(major_allele);
-					genotypes[2*i+1] = bcf_gt_phased(major_allele);
-					bcf_float_set_missing(probabilities[i]);
-					count_alt += 2 * major_allele;
-				}
-				for (int i = 0 ; i < G.GRvar_genotypes[vr].size() ; i++) {
-					bool a0 = G.GRvar_genotypes[vr][i].al0;
-					bool a1 = G.GRvar_genotypes[vr][i].al1;
-					genotypes[2*G.GRvar_genotypes[vr][i].idx+0] = bcf_gt_phased(a0);
-					genotypes[2*G.GRvar_genotypes[vr][i].idx+1] = bcf_gt_phased(a1);
-					probabilities[G.GRvar_genotypes[vr][i].idx] = roundf(G.GRvar_genotypes[vr][i].prob * 1000.0) / 1000.0;
-					count_alt -= 2 * major_allele;
-					count_alt += a0+a1;
-				}
-				bcf_update_format_float(hdr, rec, "PP", probabilities, bcf_hdr_nsamples(hdr)*1);
-			} else {
-				for (int i = 0 ; i < H.n_samples ; i++) {
-					bool a0 = H.Hvar.get(vs, 2*i+0);
-					bool a1 = H.Hvar.get(vs, 2*i+1);
-					count_alt += a0+a1;
-					genotypes[2*i+0] = bcf_gt_phased(a0);
-					genotypes[2*i+1] = bcf_gt_phased(a1);
-					count_alt += a0+a1;
-				}
-			}
-
-			bcf_update_info_int32(hdr, rec, "AC", &count_alt, 1);
-			bcf_update_info_int32(hdr, rec, "AN", &G.n_samples, 1);
-			bcf_update_genotypes(hdr, rec, genotypes, bcf_hdr_nsamples(hdr)*2);
-			if (V.vec_full[vt]->type == VARTYPE_RARE) bcf_update_format_float(hdr, rec, "PP", probabilities, bcf_hdr_nsamples(hdr)*1);
-
-			if (bcf_write1(fp, hdr, rec) < 0) vrb.error("Failing to write VCF/record");
+		if (output_buffer || inInputRegion(V.vec_full[vt]->bp, region)) {
+			index_vt.push_back(vt);
+			index_vs.push_back(vs);
+			index_vr.push_back(vr);
 		}
-
 		switch (V.vec_full[vt]->type) {
 		case VARTYPE_SCAF :	vs++; break;
 		case VARTYPE_COMM :	vc++; break;
 		case VARTYPE_RARE :	vr++; break;
 		}
+	}
 
-		vrb.progress("  * VCF writing", (vt+1)*1.0/V.sizeFull());
+	//Add records: blocks of variants are built in parallel, then written in order
+	int n_output = index_vt.size();
+	int n_block = max(4 * pool.size(), (int)min(1024UL, OBLOCK_GTS / (2UL * G.n_samples)));
+	vector < bcf1_t * > records = vector < bcf1_t * > (n_block);
+	for (int r = 0 ; r < n_block ; r ++) records[r] = bcf_init1();
+	vector < vector < int > > genotypes = vector < vector < int > > (pool.size(), vector < int > (bcf_hdr_nsamples(hdr)*2));
+	vector < vector < float > > probabilities = vector < vector < float > > (pool.size(), vector < float > (bcf_hdr_nsamples(hdr)*1));
+	for (int o0 = 0 ; o0 < n_output ; o0 += n_block) {
+		int n_rec = min(n_block, n_output - o0);
+		pool.run(n_rec, [&] (int id_worker, int id_job) {
+			int o = o0 + id_job;
+			buildRecord(hdr, records[id_job], index_vt[o], index_vs[o], index_vr[o], genotypes[id_worker].data(), probabilities[id_worker].data());
+		});
+		for (int r = 0 ; r < n_rec ; r ++) if (bcf_write1(fp, hdr, records[r]) < 0) vrb.error("Failing to write VCF/record");
+		vrb.progress("  * VCF writing", (o0+n_rec)*1.0/n_output);
 	}
-	free(genotypes);
-	bcf_destroy1(rec);
+	for (int r = 0 ; r < n_block ; r ++) bcf_destroy1(records[r]);
 	bcf_hdr_destroy(hdr);
 	if (hts_close(fp)) vrb.error("Non zero status when closing VCF/BCF file descriptor");
 	switch (file_type) {
-	case OFILE_VCFU: vrb.bullet("VCF writing [Uncompressed / N=" + stb.str(G.n_samples) + " / L=" + stb.str(V.sizeFull()) + "] (" + stb.str(tac.rel_time()*0.001, 2) + "s)"); break;
-	case OFILE_VCFC: vrb.bullet("VCF writing [Compressed / N=" + stb.str(G.n_samples) + " / L=" + stb.str(V.sizeFull()) + "] (" + stb.str(tac.rel_time()*0.001, 2) + "s)"); break;
-	case OFILE_BCFC: vrb.bullet("BCF writing [Compressed / N=" + stb.str(G.n_samples) + " / L=" + stb.str(V.sizeFull()) + "] (" + stb.str(tac.rel_time()*0.001, 2) + "s)"); break;
+	case OFILE_VCFU: vrb.bullet("VCF writing [Uncompressed / N=" + stb.str(G.n_samples) + " / L=" + stb.str(n_output) + "] (" + stb.str(tac.rel_time()*0.001, 2) + "s)"); break;
+	case OFILE_VCFC: vrb.bullet("VCF writing [Compressed / N=" + stb.str(G.n_samples) + " / L=" + stb.str(n_output) + "] (" + stb.str(tac.rel_time()*0.001, 2) + "s)"); break;
+	case OFILE_BCFC: vrb.bullet("BCF writing [Compressed / N=" + stb.str(G.n_samples) + " / L=" + stb.str(n_output) + "] (" + stb.str(tac.rel_time()*0.001, 2) + "s)"); break;
 	}
 }
@@ -24,6 +24,7 @@
 #define _HAPLOTYPE_WRITER_H
 
 #include <utils/otools.h>
+#include <utils/thread_pool.h>
 
 #include <containers/variant_map.h>
 #include <containers/haplotype_set.h>
@@ -33,21 +34,23 @@
 class haplotype_writer {
 public:
 	//DATA
-	int nthreads;
+	thread_pool & pool;
 	haplotype_set & H;
 	genotype_set & G;
 	variant_map & V;
-	int input_start;
-	int input_stop;
+	vector < int > input_starts;
+	vector < int > input_stops;
 
 	//CONSTRUCTORS/DESCTRUCTORS
-	haplotype_writer(haplotype_set &, genotype_set &, variant_map &, int);
+	haplotype_writer(haplotype_set &, genotype_set &, variant_map &, thread_pool &);
 	~haplotype_writer();
-	void setRegions(int _input_start, int _input_stop);
+	void setRegions(vector < int > &, vector < int > &);
+	bool inInputRegion(int, int);
 
 
 	//IO
-	void writeHaplotypes(string foutput, bool);
+	void buildRecord(bcf_hdr_t *, bcf1_t *, int, int, int, int *, float *);
+	void writeHaplotypes(string foutput, bool, int region = -1);
 };
 
 #endif
@@ -29,19 +29,7 @@
 #include <objects/hmm_parameters.h>
 #include <containers/state_set.h>
 
-#include <immintrin.h>
-
-inline
-float horizontal_add (const __m256& a) {
-	__m128 vlow = _mm256_castps256_ps128(a);
-	__m128 vhigh = _mm256_extractf128_ps(a, 1); // high 128
-	vlow = _mm_add_ps(vlow, vhigh);     // add the low 128
-	__m128 shuf = _mm_movehdup_ps(vlow);        // broadcast elements 3,1 to 2,0
-	__m128 sums = _mm_add_ps(vlow, shuf);
-	shuf = _mm_movehl_ps(shuf, sums); // high half -> low half
-	sums = _mm_add_ss(sums, shuf);    // (no wasted instructions, and all of them are the 4B minimum)
-	return _mm_cvtss_f32(sums);
-}
+#include <utils/simd_vector.h>
 
 class hmm_scaffold {
 public:
@@ -64,6 +52,11 @@ public:
 	vector < aligned_vector32 < float > > alpha;
 	aligned_vector32 < float > beta;
 
+	//VITERBI
+	aligned_vector32 < float > vprob;		//Viterbi probabilities at the current variant
+	bitmatrix vswitch;						//Traceback: bit is set when the state switched from the most likely state of the previous variant
+	vector < int > vmaxi;					//Most likely state at each variant
+
 public:
 	//CONSTRUCTOR/DESTRUCTOR
 	hmm_scaffold(variant_map & _V, genotype_set & _G, conditioning_set & _C, hmm_parameters & _M);
@@ -73,6 +66,7 @@ public:
 	double forward();
 	void backward(vector < vector < unsigned int > > & cevents, vector < int > & vpath);
 	void viterbi(vector < int > & path);
+	double forwardViterbi(vector < int > & path);
 
 };
 
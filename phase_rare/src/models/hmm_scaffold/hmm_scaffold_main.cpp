@@ -31,6 +31,9 @@ hmm_scaffold::hmm_scaffold(variant_map & _V, genotype_set & _G, conditioning_set
 	beta = aligned_vector32 < float > (max_nstates, 1.0f);
 	Hvar.allocate(C.n_scaffold_variants, max_nstates);
 	Hhap.allocate(max_nstates, C.n_scaffold_variants);
+	vprob = aligned_vector32 < float > (max_nstates, 0.0f);
+	vswitch.allocate(C.n_scaffold_variants, max_nstates);
+	vmaxi = vector < int > (C.n_scaffold_variants, -1);
 }
 
 hmm_scaffold::~hmm_scaffold() {
@@ -44,6 +47,7 @@ void hmm_scaffold::setup(unsigned int _hap) {
 
 	Hvar.reallocateFast(C.n_scaffold_variants, nstates);
 	Hhap.reallocateFast(nstates, C.n_scaffold_variants);
+	vswitch.reallocateFast(C.n_scaffold_variants, nstates);
 
 	Hhap.subset(C.Hhap, C.indexes_pbwt_neighbour[hap]);
 	Hhap.transpose(Hvar);
@@ -53,26 +57,24 @@ double hmm_scaffold::forward() {
 	float sum;
 	double loglik = 0.0;
 	const unsigned int nstatesMD8 = (nstates / 8) * 8;
-	const __m256i _vshift_count = _mm256_set_epi32(31,30,29,28,27,26,25,24);
 	for (int vs = 0 ; vs < C.n_scaffold_variants ; vs ++) {
 		const std::array<float,2> emit = {match_prob[C.Hhap.get(hap, vs)], match_prob[1-C.Hhap.get(hap, vs)]};
-		const __m256 _emit0 = _mm256_set1_ps(emit[0]);
-		const __m256 _emit1 = _mm256_set1_ps(emit[1]);
+		const simd_f32x8 _emit0 = simd_set1_f32(emit[0]);
+		const simd_f32x8 _emit1 = simd_set1_f32(emit[1]);
 
 		if (!vs) {
 			const float f0 = 1.0f / nstates;
-			const __m256 _f0 = _mm256_set1_ps(f0);
-			__m256 _sum = _mm256_set1_ps(0.0f);
+			const simd_f32x8 _f0 = simd_set1_f32(f0);
+			simd_f32x8 _sum = simd_zero_f32();
 			int offset = 0;
 			for (int k = 0 ; k < nstatesMD8 ; k += 8) {
-				const __m256i _mask = _mm256_sllv_epi32(_mm256_set1_epi32((unsigned int )Hvar.getByte(vs, k)), _vshift_count);
-				const __m256 _emiss = _mm256_blendv_ps (_emit0, _emit1, _mm256_castsi256_ps(_mask));
-				const __m256 _prob_curr = _mm256_mul_ps(_emiss, _f0);
-				_sum = _mm256_add_ps(_sum, _prob_curr);
-				_mm256_store_ps(&alpha[vs][k], _prob_curr);
+				const simd_f32x8 _emiss = simd_select_bits(Hvar.getByte(vs, k), _emit0, _emit1);
+				const simd_f32x8 _prob_curr = simd_mul(_emiss, _f0);
+				_sum = simd_add(_sum, _prob_curr);
+				simd_store(&alpha[vs][k], _prob_curr);
 				offset += 8;
 			}
-			sum = (offset > 0)?horizontal_add(_sum):0.0f;
+			sum = (offset > 0)?simd_hsum(_sum):0.0f;
 			for (; offset < nstates ; offset ++) {
 				alpha[vs][offset] = f0 * emit[Hvar.get(vs, offset)];
 				sum += alpha[vs][offset];
@@ -81,21 +83,20 @@ double hmm_scaffold::forward() {
 		} else {
 			const float f0 = M.t[vs-1] / nstates;
 			const float f1 = M.nt[vs-1] / sum;
-			const __m256 _f0 = _mm256_set1_ps(f0);
-			const __m256 _f1 = _mm256_set1_ps(f1);
-			__m256 _sum = _mm256_set1_ps(0.0f);
+			const simd_f32x8 _f0 = simd_set1_f32(f0);
+			const simd_f32x8 _f1 = simd_set1_f32(f1);
+			simd_f32x8 _sum = simd_zero_f32();
 			int offset = 0;
 			for (int k = 0 ; k < nstatesMD8 ; k += 8) {
-				const __m256i _mask = _mm256_sllv_epi32(_mm256_set1_epi32((unsigned int )Hvar.getByte(vs, k)), _vshift_count);
-				const __m256 _emiss = _mm256_blendv_ps (_emit0, _emit1, _mm256_castsi256_ps(_mask));
-				const __m256 _prob_prev = _mm256_load_ps(&alpha[vs-1][k]);
-				const __m256 _prob_temp = _mm256_fmadd_ps(_prob_prev, _f1, _f0);
-				const __m256 _prob_curr = _mm256_mul_ps(_prob_temp, _emiss);
-				_sum = _mm256_add_ps(_sum, _prob_curr);
-				_mm256_store_ps(&alpha[vs][k], _prob_curr);
+				const simd_f32x8 _emiss = simd_select_bits(Hvar.getByte(vs, k), _emit0, _emit1);
+				const simd_f32x8 _prob_prev = simd_load(&alpha[vs-1][k]);
+				const simd_f32x8 _prob_temp = simd_fmadd(_prob_prev, _f1, _f0);
+				const simd_f32x8 _prob_curr = simd_mul(_prob_temp, _emiss);
+				_sum = simd_add(_sum, _prob_curr);
+				simd_store(&alpha[vs][k], _prob_curr);
 				offset += 8;
 			}
-			sum = (offset > 0)?horizontal_add(_sum):0.0f;
+			sum = (offset > 0)?simd_hsum(_sum):0.0f;
 			for (; offset < nstates ; offset ++) {
 				alpha[vs][offset] = (alpha[vs-1][offset]*f1+f0)*emit[Hvar.get(vs, offset)];
 				sum += alpha[vs][offset];
@@ -109,7 +110,6 @@ double hmm_scaffold::forward() {
 void hmm_scaffold::backward(vector < vector < unsigned int > > & cevents, vector < int > & vpath) {
 	float sum = 0.0f, scale = 0.0f;
 	const unsigned int nstatesMD8 = (nstates / 8) * 8;
-	const __m256i _vshift_count = _mm256_set_epi32(31,30,29,28,27,26,25,24);
 	aligned_vector32 < float > alphaXbeta_curr = aligned_vector32 < float >(nstates, 0.0f);
 	aligned_vector32 < float > alphaXbeta_prev = aligned_vector32 < float >(nstates, 0.0f);
 
@@ -119,63 +119,62 @@ void hmm_scaffold::backward(vector < vector < unsigned int > > & cevents, vector
 
 		//
 		const std::array<float,2> emit = {match_prob[C.Hhap.get(hap, vs)], match_prob[1-C.Hhap.get(hap, vs)]};
-		const __m256 _emit0 = _mm256_set1_ps(emit[0]);
-		const __m256 _emit1 = _mm256_set1_ps(emit[1]);
+		const simd_f32x8 _emit0 = simd_set1_f32(emit[0]);
+		const simd_f32x8 _emit1 = simd_set1_f32(emit[1]);
 
 		//Transitions
 		if (vs == C.n_scaffold_variants - 1) fill (beta.begin(), beta.end(), 1.0f / nstates);
 		else {
 			const float f0 = M.t[vs] / nstates;
 			const float f1 = M.nt[vs] / sum;
-			const __m256 _f0 = _mm256_set1_ps(f0);
-			const __m256 _f1 = _mm256_set1_ps(f1);
+			const simd_f32x8 _f0 = simd_set1_f32(f0);
+			const simd_f32x8 _f1 = simd_set1_f32(f1);
 			int offset = 0;
 			for (int k = 0 ; k < nstatesMD8 ; k += 8) {
-				const __m256 _prob_prev = _mm256_load_ps(&beta[k]);
-				const __m256 _prob_curr = _mm256_fmadd_ps(_prob_prev, _f1, _f0);
-				_mm256_store_ps(&beta[k], _prob_curr);
+				const simd_f32x8 _prob_prev = simd_load(&beta[k]);
+				const simd_f32x8 _prob_curr = simd_fmadd(_prob_prev, _f1, _f0);
+				simd_store(&beta[k], _prob_curr);
 				offset += 8;
 			}
 			for (; offset < nstates ; offset ++) beta[offset] = (beta[offset]*f1+f0);
 		}
 
 		//Products
-		__m256 _scale = _mm256_set1_ps(0.0f);
+		simd_f32x8 _scale = simd_zero_f32();
 		int offset = 0;
 		for (int k = 0 ; k < nstatesMD8 ; k += 8) {
-			const __m256 _prob_temp = _mm256_mul_ps(_mm256_load_ps(&alpha[vs][k]), _mm256_load_ps(&beta[k]));
-			_mm256_store_ps(&alphaXbeta_curr[k], _prob_temp);
-			_scale = _mm256_add_ps(_scale, _prob_temp);
+			const simd_f32x8 _prob_temp = simd_mul(simd_load(&alpha[vs][k]), simd_load(&beta[k]));
+			simd_store(&alphaXbeta_curr[k], _prob_temp);
+			_scale = simd_add(_scale, _prob_temp);
 			offset += 8;
 		}
-		scale = (offset > 0)?horizontal_add(_scale):0.0f;
+		scale = (offset > 0)?simd_hsum(_scale):0.0f;
 		for (; offset < nstates ; offset ++) {
 			alphaXbeta_curr[offset] = alpha[vs][offset] * beta[offset];
 			scale += alphaXbeta_curr[offset];
 		}
 		scale = 1.0f / scale;
-		_scale = _mm256_set1_ps(scale);
+		_scale = simd_set1_f32(scale);
 		offset = 0;
 		for (int k = 0 ; k < nstatesMD8 ; k += 8) {
-			const __m256 _prob_temp = _mm256_mul_ps(_mm256_load_ps(&alphaXbeta_curr[k]), _scale);
-			_mm256_store_ps(&alphaXbeta_curr[k], _prob_temp);
+			const simd_f32x8 _prob_temp = simd_mul(simd_load(&alphaXbeta_curr[k]), _scale);
+			simd_store(&alphaXbeta_curr[k], _prob_temp);
 			offset += 8;
 		}
 		for (; offset < nstates ; offset ++) alphaXbeta_curr[offset] *= scale;
 
 		//Emission
-		__m256 _sum = _mm256_set1_ps(0.0f);
+		simd_f32x8 _sum = simd_zero_f32();
 		offset = 0;
 		for (int k = 0 ; k < nstatesMD8 ; k += 8) {
-			const __m256i _mask = _mm256_sllv_epi32(_mm256_set1_epi32((unsigned int )Hvar.getByte(vs, k)), _vshift_count);
-			const __m256 _emiss = _mm256_blendv_ps (_emit0, _emit1, _mm256_castsi256_ps(_mask));
-			const __m256 _prob_prev = _mm256_load_ps(&beta[k]);
-			const __m256 _prob_curr = _mm256_mul_ps(_prob_prev, _emiss);
-			_sum = _mm256_add_ps(_sum, _prob_curr);
-			_mm256_store_ps(&beta[k], _prob_curr);
+			const simd_f32x8 _emiss = simd_select_bits(Hvar.getByte(vs, k), _emit0, _emit1);
+			const simd_f32x8 _prob_prev = simd_load(&beta[k]);
+			const simd_f32x8 _prob_curr = simd_mul(_prob_prev, _emiss);
+			_sum = simd_add(_sum, _prob_curr);
+			simd_store(&beta[k], _prob_curr);
 			offset += 8;
 		}
-		sum = (offset > 0)?horizontal_add(_sum):0.0f;
+		sum = (offset > 0)?simd_hsum(_sum):0.0f;
 		for (; offset < nstates ; offset ++) {
 			beta[offset] *= emit[Hvar.get(vs, offset)];
 			sum += beta[offset];
@@ -265,3 +264,81 @@ void hmm_scaffold::viterbi(vector < int > & path) {
 	for (int vs = C.n_scaffold_variants - 1 ; vs > 0; vs --)
 		path[vs-1] = _viterbi_paths[vs][path[vs]];
 }
+
+//Same recursions as forward() and viterbi(), run in a single sweep: each byte of Hvar gives one emission vector used by both.
+//Viterbi traceback is stored as one bit per state (stay or switch from the most likely state) instead of one int per state.
+double hmm_scaffold::forwardViterbi(vector < int > & path) {
+	float sum = 0.0f, vsum = 0.0f, vmax_prev = 0.0f;
+	double loglik = 0.0;
+	const unsigned int nstatesMD8 = (nstates / 8) * 8;
+	for (int vs = 0 ; vs < C.n_scaffold_variants ; vs ++) {
+		const std::array<float,2> emit = {match_prob[C.Hhap.get(hap, vs)], match_prob[1-C.Hhap.get(hap, vs)]};
+		const simd_f32x8 _emit0 = simd_set1_f32(emit[0]);
+		const simd_f32x8 _emit1 = simd_set1_f32(emit[1]);
+
+		//Forward transitions [uniform at first variant]
+		const float f0 = vs ? (M.t[vs-1] / nstates) : (1.0f / nstates);
+		const float f1 = vs ? (M.nt[vs-1] / sum) : 0.0f;
+		const simd_f32x8 _f0 = simd_set1_f32(f0);
+		const simd_f32x8 _f1 = simd_set1_f32(f1);
+
+		//Viterbi transitions [emissions only at first variant]
+		const float vscale = vs ? (1.0f / vsum) : 0.0f;
+		const float prob_yrecomb = vs ? (M.t[vs-1] * vmax_prev * vscale) : 0.0f;
+		const float vf1 = vs ? M.nt[vs-1] : 0.0f;
+		const simd_f32x8 _prob_yrecomb = simd_set1_f32(prob_yrecomb);
+		const simd_f32x8 _vf1 = simd_set1_f32(vf1);
+		const simd_f32x8 _vscale = simd_set1_f32(vscale);
+
+		simd_f32x8 _sum = simd_zero_f32(), _vsum = simd_zero_f32(), _vmax = simd_zero_f32();
+		int offset = 0;
+		for (int k = 0 ; k < nstatesMD8 ; k += 8) {
+			const simd_f32x8 _emiss = simd_select_bits(Hvar.getByte(vs, k), _emit0, _emit1);
+
+			//Forward
+			const simd_f32x8 _prob_temp = vs ? simd_fmadd(simd_load(&alpha[vs-1][k]), _f1, _f0) : _f0;
+			const simd_f32x8 _prob_curr = simd_mul(_prob_temp, _emiss);
+			_sum = simd_add(_sum, _prob_curr);
+			simd_store(&alpha[vs][k], _prob_curr);
+
+			//Viterbi
+			simd_f32x8 _vprob_curr = _emiss;
+			if (vs) {
+				const simd_f32x8 _prob_nrecomb = simd_mul(simd_mul(_vf1, simd_load(&vprob[k])), _vscale);
+				vswitch.setByte(vs, k, simd_cmpgt_bits(_prob_yrecomb, _prob_nrecomb));
+				_vprob_curr = simd_mul(simd_max(_prob_yrecomb, _prob_nrecomb), _emiss);
+			}
+			_vsum = simd_add(_vsum, _vprob_curr);
+			_vmax = simd_max(_vmax, _vprob_curr);
+			simd_store(&vprob[k], _vprob_curr);
+			offset += 8;
+		}
+		sum = (offset > 0)?simd_hsum(_sum):0.0f;
+		vsum = (offset > 0)?simd_hsum(_vsum):0.0f;
+		float vmax_curr = (offset > 0)?simd_hmax(_vmax):0.0f;
+		for (; offset < nstates ; offset ++) {
+			const float emiss = emit[Hvar.get(vs, offset)];
+			alpha[vs][offset] = (vs ? (alpha[vs-1][offset]*f1+f0) : f0) * emiss;
+			sum += alpha[vs][offset];
+			if (vs) {
+				const float prob_nrecomb = vf1 * vprob[offset] * vscale;
+				vswitch.set(vs, offset, prob_yrecomb > prob_nrecomb);
+				vprob[offset] = max(prob_yrecomb, prob_nrecomb) * emiss;
+			} else vprob[offset] = emiss;
+			vsum += vprob[offset];
+			vmax_curr = max(vmax_curr, vprob[offset]);
+		}
+		loglik += log(sum);
+
+		//Most likely state [first one in case of ties]
+		vmaxi[vs] = -1;
+		if (vmax_curr > 0.0f) for (int k = 0 ; k < nstates && vmaxi[vs] < 0 ; k ++) if (vprob[k] == vmax_curr) vmaxi[vs] = k;
+		vmax_prev = vmax_curr;
+	}
+
+	//Backtracking
+	path.assign(C.n_scaffold_variants, vmaxi[C.n_scaffold_variants-1]);
+	for (int vs = C.n_scaffold_variants - 1 ; vs > 0; vs --)
+		path[vs-1] = vswitch.get(vs, path[vs]) ? vmaxi[vs-1] : path[vs];
+	return loglik;
+}
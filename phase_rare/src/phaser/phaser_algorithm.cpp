@@ -22,74 +22,136 @@
 
 #include <phaser/phaser_header.h>
 
-void * hmmcompute_callback(void * ptr) {
-	phaser * S = static_cast< phaser * >( ptr );
-	int id_job, id_thread;
-
-	pthread_mutex_lock(&S->mutex_workers);
-	id_thread = S->i_threads ++;
-	pthread_mutex_unlock(&S->mutex_workers);
-
-	for(;;) {
-		pthread_mutex_lock(&S->mutex_workers);
-		id_job = S->i_jobs ++;
-		if (id_job <= S->G.n_samples) vrb.progress("  * Processing", (id_job+1)*1.0/S->G.n_samples);
-		pthread_mutex_unlock(&S->mutex_workers);
-		if (id_job < S->G.n_samples) S->hmmcompute(id_job, id_thread);
-		else pthread_exit(NULL);
-	}
-}
-
-void phaser::hmmcompute(int id_job, int id_thread) {
+void phaser::hmmcompute(genotype_set & GW, hmm_parameters & MW, int id_job, int id_thread) {
 	//Mapping storage events
 	vector < vector < unsigned int > > cevents;
-	G.mapUnphasedOntoScaffold(id_job, cevents);
+	GW.mapUnphasedOntoScaffold(id_job, cevents);
 
 	//Viterbi paths
 	vector < int > path0, path1;
 
-	//Forward-Backward-Viterbi passes for hap0
+	//Fused Forward-Viterbi pass, then Backward pass for hap0
 	thread_hmms[id_thread]->setup(2*id_job+0);
-	thread_hmms[id_thread]->viterbi(path0);
-	double pf0 = thread_hmms[id_thread]->forward();
+	double pf0 = thread_hmms[id_thread]->forwardViterbi(path0);
 	thread_hmms[id_thread]->backward(cevents, path0);
 
 
-	//Forward-Backward-Viterbi passes for hap1
+	//Fused Forward-Viterbi pass, then Backward pass for hap1
 	thread_hmms[id_thread]->setup(2*id_job+1);
-	thread_hmms[id_thread]->viterbi(path1);
-	double pf1 = thread_hmms[id_thread]->forward();
+	double pf1 = thread_hmms[id_thread]->forwardViterbi(path1);
 	thread_hmms[id_thread]->backward(cevents, path1);
 
 	//Phase remaining unphased using viterbi [singletons, etc ...]
-	G.phaseCoalescentViterbi(id_job, path0, path1, M);
+	GW.phaseCoalescentViterbi(id_job, path0, path1, MW);
 }
 
-void phaser::phase() {
+void phaser::phaseWindow(variant_map & VW, conditioning_set & HW, genotype_set & GW, hmm_parameters & MW) {
+	//STEP0: reseed so that selection in a window does not depend on what was read or phased before
+	rng.setSeed(options["seed"].as < int > ());
+
 	//STEP1: haplotype selection
 	vrb.title("PBWT pass");
-	H.initialize(V,	options["pbwt-modulo"].as < double > (),
+	HW.initialize(VW,	options["pbwt-modulo"].as < double > (),
+			options["pbwt-window"].as < double > (),
 			options["pbwt-mdr"].as < double > (),
 			options["pbwt-depth-common"].as < int > (),
 			options["pbwt-depth-rare"].as < int > (),
 			options["pbwt-mac"].as < int > ());
-	H.select(V, G);
+	HW.select(VW, GW, &pool);
 
 	//STEP2: HMM computations
 	vrb.title("HMM computations");
-	thread_hmms = vector < hmm_scaffold * > (nthreads);
-	for(int t = 0; t < nthreads ; t ++) thread_hmms[t] = new hmm_scaffold(V, G, H, M);
-	if (nthreads > 1) {
-		i_jobs = i_threads = 0;
-		for (int t = 0 ; t < nthreads ; t++) pthread_create( &id_workers[t] , NULL, hmmcompute_callback, static_cast<void *>(this));
-		for (int t = 0 ; t < nthreads ; t++) pthread_join( id_workers[t] , NULL);
-	} else for (int i = 0 ; i < G.n_samples ; i ++) {
-		hmmcompute(i, 0);
-		vrb.progress("  * Processing", (i+1)*1.0/G.n_samples);
-	}
-	for(int t = 0; t < nthreads ; t ++) delete thread_hmms[t];
+	thread_hmms = vector < hmm_scaffold * > (pool.size());
+	for(int t = 0; t < pool.size() ; t ++) thread_hmms[t] = new hmm_scaffold(VW, GW, HW, MW);
+	pool.run(GW.n_samples, [&] (int id_thread, int id_job) { hmmcompute(GW, MW, id_job, id_thread); }, "  * Processing");
+	for(int t = 0; t < pool.size() ; t ++) delete thread_hmms[t];
 	vrb.bullet("Processing (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
 
 	//STEP3: MERGE BACK ALL TOGETHER
-	G.merge_by_transpose_I2V();
+	GW.merge_by_transpose_I2V();
+}
+
+/*
+ * Extracts the data of input region r and of its scaffold window from the sets read once for all regions:
+ * the scaffold variants overlapping the window, the rare variants of the input region, their genotypes
+ * [moved, not copied] and the slices of the scaffold haplotypes. Returns false if there is nothing to phase.
+ */
+bool phaser::buildWindow(int r, variant_map & VW, conditioning_set & HW, genotype_set & GW, hmm_parameters & MW) {
+	tac.clock();
+
+	//Variants, with genetic positions computed over the window only as in a run over this window
+	int vr0 = -1, vr1 = -1;
+	vector < unsigned int > scaffold_rows;
+	for (int vt = 0 ; vt < V.sizeFull() ; vt ++) {
+		variant * v = V.vec_full[vt];
+		if (v->type == VARTYPE_SCAF) {
+			if (v->bp > scaffold_stops[r] || (v->bp + (int)v->ref.size() - 1) < scaffold_starts[r]) continue;
+			scaffold_rows.push_back(v->idx_scaffold);
+		} else {
+			if (v->bp < input_starts[r] || v->bp >= input_stops[r]) continue;
+			if (vr0 < 0) vr0 = v->idx_rare;
+			vr1 = v->idx_rare + 1;
+		}
+		variant * vw = new variant (*v);
+		vw->cm = -1;
+		VW.push(vw);
+	}
+	if (vr0 < 0) {
+		vrb.warning("No variants to be phased in input region [" + input_gregions[r] + "]");
+		return false;
+	}
+	if (scaffold_rows.empty()) vrb.error("No scaffold variants in scaffold region [" + scaffold_gregions[r] + "]");
+	if (options.count("map")) VW.setGeneticMap(readerGM);
+	else VW.setGeneticMap();
+	MW.initialise(VW, options["effective-size"].as < int > (), G.n_samples*2);
+
+	//Scaffold haplotypes of the window [columns are taken from the haplotype-first matrix transposed once]
+	HW.allocate(G.n_samples, scaffold_rows.size());
+	HW.Hvar.subset(H.Hvar, scaffold_rows);
+	if (scaffold_rows.back() - scaffold_rows[0] + 1 == scaffold_rows.size()) HW.Hhap.subsetColumns(H.Hhap, scaffold_rows[0], scaffold_rows.back() + 1);
+	else HW.transposeHaplotypes_V2H(&pool);
+
+	//Rare genotypes of the input region, already phased using pedigrees if any
+	GW.allocate(VW, G.n_samples, scaffold_rows.size(), vr1 - vr0);
+	for (int vr = vr0 ; vr < vr1 ; vr ++) GW.GRvar_genotypes[vr - vr0].swap(G.GRvar_genotypes[vr]);
+	for (int i = 0 ; i < G.n_samples ; i ++) {
+		for (int e = 0 ; e < G.GRind_genotypes[i].size() ; e ++) {
+			if (G.GRind_genotypes[i][e].idx < vr0 || G.GRind_genotypes[i][e].idx >= vr1) continue;
+			GW.GRind_genotypes[i].push_back(G.GRind_genotypes[i][e]);
+			GW.GRind_genotypes[i].back().idx -= vr0;
+		}
+	}
+	vrb.bullet("Window extraction [#scaffold=" + stb.str(scaffold_rows.size()) + " / #rare=" + stb.str(vr1 - vr0) + "] (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
+	return true;
+}
+
+//Moves the phased rare genotypes of input region r back to the global set used for writing
+void phaser::mergeWindow(int r, genotype_set & GW) {
+	int vr0 = -1;
+	for (int vt = 0 ; vt < V.sizeFull() && vr0 < 0 ; vt ++) {
+		if (V.vec_full[vt]->type == VARTYPE_RARE && V.vec_full[vt]->bp >= input_starts[r]) vr0 = V.vec_full[vt]->idx_rare;
+	}
+	for (int vr = 0 ; vr < GW.n_rare_variants ; vr ++) G.GRvar_genotypes[vr0 + vr].swap(GW.GRvar_genotypes[vr]);
+	G.nhets_imputation += GW.nhets_imputation;
+	G.nmiss_imputation += GW.nmiss_imputation;
+}
+
+void phaser::phase() {
+	//One input region: phased directly over the scaffold that was read
+	if (input_starts.size() == 1) {
+		phaseWindow(V, H, G, M);
+		return;
+	}
+
+	//Several input regions: selection and HMM run in turn over the scaffold window of each region, as separate runs would do
+	for (int r = 0 ; r < input_starts.size() ; r ++) {
+		vrb.title("Input region [" + input_gregions[r] + "] over scaffold region [" + scaffold_gregions[r] + "]");
+		variant_map VW;
+		conditioning_set HW;
+		genotype_set GW;
+		hmm_parameters MW;
+		if (!buildWindow(r, VW, HW, GW, MW)) continue;
+		phaseWindow(VW, HW, GW, MW);
+		mergeWindow(r, GW);
+	}
 }
@@ -27,14 +27,17 @@
 void phaser::write_files_and_finalise() {
 	vrb.title("Finalization:");
 
-	//step0: multi-threading
-	if (options["thread"].as < int > () > 1) pthread_mutex_destroy(&mutex_workers);
+	//step1: writing best guess haplotypes in VCF/BCF file [either all input regions in one file or one file per input region]
+	vector < string > output_files;
+	stb.split(options["output"].as < string > (), output_files, ",");
+	haplotype_writer writerH (H, G, V, pool);
+	writerH.setRegions(input_starts, input_stops);
+	if (output_files.size() == 1) writerH.writeHaplotypes(output_files[0], options.count("output-buffer"));
+	else for (int r = 0 ; r < output_files.size() ; r ++) writerH.writeHaplotypes(output_files[r], false, r);
 
-	//step1: writing best guess haplotypes in VCF/BCF file
-	haplotype_writer writerH (H, G, V, options["thread"].as < int > ());
-	writerH.setRegions(input_start, input_stop);
-	writerH.writeHaplotypes(options["output"].as < string > (), options.count("output-buffer"));
+	//step2: multi-threading
+	pool.stop();
 
-	//step2: Measure overall running time
+	//step3: Measure overall running time
 	vrb.bullet("Total running time = " + stb.str(tac.abs_time()) + " seconds");
 }
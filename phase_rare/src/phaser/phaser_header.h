@@ -24,6 +24,7 @@
 #define _PHASER_H
 
 #include <utils/otools.h>
+#include <utils/thread_pool.h>
 #include <objects/hmm_parameters.h>
 
 #include <containers/genotype_set/genotype_set_header.h>
@@ -33,6 +34,8 @@
 
 #include <models/hmm_scaffold/hmm_scaffold_header.h>
 
+#include <io/gmap_reader.h>
+
 
 class phaser {
 public:
@@ -46,11 +49,11 @@ public:
 	hmm_parameters M;
 	variant_map V;
 	state_set P;
+	gmap_reader readerGM;
 
 	//MULTI-THREADING
-	int i_jobs, i_threads, nthreads;
-	vector < pthread_t > id_workers;
-	pthread_mutex_t mutex_workers;
+	int nthreads;
+	thread_pool pool;
 	vector < vector < pair < int, float > > > thread_data;
 	vector < hmm_scaffold * > thread_hmms;
 
@@ -62,13 +65,14 @@ public:
 	unsigned long int n_rare_nphased;
 	basic_stats statCS;
 
-	//GENOMIC REGION
+	//GENOMIC REGION [one scaffold window per input region]
 	string chrid;
-	int input_start;
-	int input_stop;
-	int scaffold_start;
-	int scaffold_stop;
-	string input_gregion;
+	vector < int > input_starts;
+	vector < int > input_stops;
+	vector < int > scaffold_starts;
+	vector < int > scaffold_stops;
+	vector < string > input_gregions;
+	vector < string > scaffold_gregions;
 	string scaffold_gregion;
 
 	//CONSTRUCTOR
@@ -76,7 +80,10 @@ public:
 	~phaser();
 
 	//METHODS
-	void hmmcompute(int, int);
+	void hmmcompute(genotype_set &, hmm_parameters &, int, int);
+	void phaseWindow(variant_map &, conditioning_set &, genotype_set &, hmm_parameters &);
+	bool buildWindow(int, variant_map &, conditioning_set &, genotype_set &, hmm_parameters &);
+	void mergeWindow(int, genotype_set &);
 	void phase();
 
 
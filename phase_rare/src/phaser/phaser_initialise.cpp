@@ -32,11 +32,7 @@ void phaser::read_files_and_initialise() {
 	//step0: Initialize seed
 	rng.setSeed(options["seed"].as < int > ());
 	nthreads = options["thread"].as < int > ();
-	if (nthreads > 1) {
-		i_jobs = 0;
-		id_workers = vector < pthread_t > (options["thread"].as < int > ());
-		pthread_mutex_init(&mutex_workers, NULL);
-	}
+	pool.start(nthreads);
 
     //step1: Parsing region string
 	buildCoordinates();
@@ -45,7 +41,7 @@ void phaser::read_files_and_initialise() {
 	vrb.title("Reading genotype data:");
 	genotype_reader readerG(H, G, V);
 	readerG.setThreads(options["thread"].as < int > ());
-	readerG.setRegions(options["scaffold-region"].as < string > (), input_start, input_stop);
+	readerG.setRegions(scaffold_gregion, input_starts, input_stops);
 	readerG.setMAF(options["input-maf"].as < double > ());
 
 	//step3: Read the genotype data
@@ -72,19 +68,19 @@ void phaser::read_files_and_initialise() {
 		G.phaseUsingPedigrees(readerP);
 	}
 
-	//step5: Read and initialise genetic map
+	//step5: Read and initialise genetic map [done per scaffold window when several input regions are phased]
 	vrb.title("Setting up genetic map:");
-	if (options.count("map")) {
-		gmap_reader readerGM;
-		readerGM.readGeneticMapFile(options["map"].as < string > ());
-		V.setGeneticMap(readerGM);
-	} else V.setGeneticMap();
-	M.initialise(V, options["effective-size"].as < int > (), readerG.n_samples*2);
+	if (options.count("map")) readerGM.readGeneticMapFile(options["map"].as < string > ());
+	if (input_starts.size() == 1) {
+		if (options.count("map")) V.setGeneticMap(readerGM);
+		else V.setGeneticMap();
+		M.initialise(V, options["effective-size"].as < int > (), readerG.n_samples*2);
+	}
 	/*
 	double theta = 1.0f / (log(readerG.n_samples*2) + 0.5);
 	rare_genotype::ed = theta / (2*( readerG.n_samples*2 + theta ));
 	rare_genotype::ee = 1.0f - rare_genotype::ed;
 	vrb.bullet("Emission probability = " + stb.str(rare_genotype::ed));
 	*/
-	H.transposeHaplotypes_V2H();
+	H.transposeHaplotypes_V2H(&pool);
 }
@@ -26,7 +26,6 @@ phaser::phaser() {
 }
 
 phaser::~phaser() {
-	id_workers.clear();
 }
 
 void phaser::phase(vector < string > & args) {
@@ -41,33 +40,66 @@ void phaser::phase(vector < string > & args) {
 }
 
 void phaser::buildCoordinates() {
-        string scaffold_region = options["scaffold-region"].as < string > ();
-        string input_region = options["input-region"].as < string > ();
+        vector < string > scaffold_regions, input_regions;
+        stb.split(options["scaffold-region"].as < string > (), scaffold_regions, ",");
+        stb.split(options["input-region"].as < string > (), input_regions, ",");
         vrb.title("Parsing specified genomic regions");
-        vector < string > scaffold_t1, scaffold_t2;
-        vector < string > input_t1, input_t2;
-        int scaffold_ret = stb.split(scaffold_region, scaffold_t1, ":");
-        int input_ret = stb.split(input_region, input_t1, ":");
-        if (scaffold_ret != 2) vrb.error("Input region needs to be specificied as chrX:Y-Z (chromosome ID cannot be extracted)");
-        if (input_ret != 2) vrb.error("Scaffold region needs to be specificied as chrX:Y-Z (chromosome ID cannot be extracted)");
-        chrid = scaffold_t1[0];
-        if (chrid != input_t1[0]) vrb.error("Chromosome IDs in scaffold and input regions are different!");
-        scaffold_ret = stb.split(scaffold_t1[1], scaffold_t2, "-");
-        input_ret = stb.split(input_t1[1], input_t2, "-");
-        if (scaffold_ret != 2) vrb.error("Input region needs to be specificied as chrX:Y-Z (genomic positions cannot be extracted)");
-        if (input_ret != 2) vrb.error("input region needs to be specificied as chrX:Y-Z (genomic positions cannot be extracted)");
-        scaffold_start = atoi(scaffold_t2[0].c_str());
-        scaffold_stop = atoi(scaffold_t2[1].c_str());
-        input_start = atoi(input_t2[0].c_str());
-        input_stop = atoi(input_t2[1].c_str());
-        if (scaffold_start >= scaffold_stop) vrb.error("Input genomic region coordinates are incorrect (start >= stop)");
-        if (input_start >= input_stop) vrb.error("input genomic region coordinates are incorrect (start >= stop)");
-        if (scaffold_start > input_start) vrb.error("Input/input genomic region coordinates are imcompatible (scaffold_start > input_start)");
-        if (scaffold_stop < input_stop) vrb.error("Input/input genomic region coordinates are incompatible (scaffold_stop < input_stop)");
-        if (scaffold_start < 0) vrb.error("Input genomic region coordinates are incorrect (scaffold_start < 0)");
-        if (input_start < 0) vrb.error("Input genomic region coordinates are incorrect (input_start < 0)");
-        scaffold_gregion = chrid + ":" + stb.str(scaffold_start) + "-" + stb.str(scaffold_stop);
-        input_gregion = chrid + ":" + stb.str(input_start) + "-" + stb.str(input_stop);
-        vrb.bullet("Scaffold region  [" + scaffold_gregion + "]");
-        vrb.bullet("Input region  [" + input_gregion + "]");
+        if (scaffold_regions.size() != 1 && scaffold_regions.size() != input_regions.size()) vrb.error("--scaffold-region must specify either one region or one region per input region");
+
+        //Each input region is phased over its own scaffold window [a single window is shared by all input regions]
+        chrid = "";
+        scaffold_starts.clear(); scaffold_stops.clear(); scaffold_gregions.clear();
+        for (int r = 0 ; r < scaffold_regions.size() ; r ++) {
+                vector < string > scaffold_t1, scaffold_t2;
+                int scaffold_ret = stb.split(scaffold_regions[r], scaffold_t1, ":");
+                if (scaffold_ret != 2) vrb.error("Scaffold region needs to be specificied as chrX:Y-Z (chromosome ID cannot be extracted)");
+                if (r > 0 && chrid != scaffold_t1[0]) vrb.error("Chromosome IDs in scaffold regions are different!");
+                chrid = scaffold_t1[0];
+                scaffold_ret = stb.split(scaffold_t1[1], scaffold_t2, "-");
+                if (scaffold_ret != 2) vrb.error("Scaffold region needs to be specificied as chrX:Y-Z (genomic positions cannot be extracted)");
+                int scaffold_start = atoi(scaffold_t2[0].c_str());
+                int scaffold_stop = atoi(scaffold_t2[1].c_str());
+                if (scaffold_start >= scaffold_stop) vrb.error("Scaffold genomic region coordinates are incorrect (start >= stop)");
+                if (scaffold_start < 0) vrb.error("Scaffold genomic region coordinates are incorrect (scaffold_start < 0)");
+                if (r > 0 && scaffold_start < scaffold_starts.back()) vrb.error("Scaffold regions need to be sorted");
+                scaffold_starts.push_back(scaffold_start);
+                scaffold_stops.push_back(scaffold_stop);
+                scaffold_gregions.push_back(chrid + ":" + stb.str(scaffold_start) + "-" + stb.str(scaffold_stop));
+                vrb.bullet("Scaffold region  [" + scaffold_gregions.back() + "]");
+        }
+        if (scaffold_regions.size() == 1 && input_regions.size() > 1) {
+                scaffold_starts = vector < int > (input_regions.size(), scaffold_starts[0]);
+                scaffold_stops = vector < int > (input_regions.size(), scaffold_stops[0]);
+                scaffold_gregions = vector < string > (input_regions.size(), scaffold_gregions[0]);
+        }
+
+        input_starts.clear(); input_stops.clear(); input_gregions.clear();
+        for (int r = 0 ; r < input_regions.size() ; r ++) {
+                vector < string > input_t1, input_t2;
+                int input_ret = stb.split(input_regions[r], input_t1, ":");
+                if (input_ret != 2) vrb.error("Input region needs to be specificied as chrX:Y-Z (chromosome ID cannot be extracted)");
+                if (chrid != input_t1[0]) vrb.error("Chromosome IDs in scaffold and input regions are different!");
+                input_ret = stb.split(input_t1[1], input_t2, "-");
+                if (input_ret != 2) vrb.error("Input region needs to be specificied as chrX:Y-Z (genomic positions cannot be extracted)");
+                int input_start = atoi(input_t2[0].c_str());
+                int input_stop = atoi(input_t2[1].c_str());
+                if (input_start >= input_stop) vrb.error("Input genomic region coordinates are incorrect (start >= stop)");
+                if (input_start < 0) vrb.error("Input genomic region coordinates are incorrect (input_start < 0)");
+                if (scaffold_starts[r] > input_start) vrb.error("Scaffold/input genomic region coordinates are incompatible (scaffold_start > input_start)");
+                if (scaffold_stops[r] < input_stop) vrb.error("Scaffold/input genomic region coordinates are incompatible (scaffold_stop < input_stop)");
+                if (r > 0 && input_start < input_stops.back()) vrb.error("Input regions need to be sorted and non-overlapping");
+                input_starts.push_back(input_start);
+                input_stops.push_back(input_stop);
+                input_gregions.push_back(chrid + ":" + stb.str(input_start) + "-" + stb.str(input_stop));
+                vrb.bullet("Input region  [" + input_gregions.back() + "]");
+        }
+
+        //The scaffold is read once over the union of the windows
+        scaffold_gregion = "";
+        for (int r = 0, start = scaffold_starts[0], stop = scaffold_stops[0] ; r < scaffold_starts.size() ; r ++) {
+                if (scaffold_starts[r] <= stop + 1) stop = max(stop, scaffold_stops[r]);
+                else { scaffold_gregion += chrid + ":" + stb.str(start) + "-" + stb.str(stop) + ","; start = scaffold_starts[r]; stop = scaffold_stops[r]; }
+                if (r == scaffold_starts.size() - 1) scaffold_gregion += chrid + ":" + stb.str(start) + "-" + stb.str(stop);
+        }
+        if (input_regions.size() > 1) vrb.bullet("Scaffold read over [" + scaffold_gregion + "]");
 }
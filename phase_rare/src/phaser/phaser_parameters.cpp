@@ -35,10 +35,10 @@ void phaser::declare_options() {
 	opt_input.add_options()
 			("input-plain", bpo::value< string >(), "Genotypes to be phased in plain VCF/BCF format")
 			("input-sparse", bpo::value< string >(), "Genotypes to be phased in sparse binary format")
-			("input-region", bpo::value< string >(), "Region to be considered in --input-sparse or --input-plain")
+			("input-region", bpo::value< string >(), "Region(s) to be considered in --input-sparse or --input-plain (comma-separated list of sorted regions to phase them in one run)")
 			("input-maf", bpo::value< double >()->default_value(0.001), "Threshold for sparse genotype representation in --input-plain")
 			("scaffold", bpo::value< string >(), "Scaffold of haplotypes in VCF/BCF format")
-			("scaffold-region", bpo::value< string >(), "Region to be considered in --scaffold")
+			("scaffold-region", bpo::value< string >(), "Region(s) to be considered in --scaffold (one region including all input regions, or a comma-separated list of one region per input region)")
 			("map", bpo::value< string >(), "Genetic map")
 			("pedigree", bpo::value< string >(), "Pedigree file (kid father mother");
 
@@ -48,7 +48,8 @@ void phaser::declare_options() {
 			("pbwt-depth-common", bpo::value< int >()->default_value(2), "Depth of PBWT indexes at common sites to condition on")
 			("pbwt-depth-rare", bpo::value< int >()->default_value(2), "Depth of PBWT indexes at rare hets to condition on")
 			("pbwt-mac", bpo::value< int >()->default_value(2), "Minimal Minor Allele Count at which PBWT is evaluated")
-			("pbwt-mdr", bpo::value < double >()->default_value(0.10), "Maximal Missing Data Rate at which PBWT is evaluated");
+			("pbwt-mdr", bpo::value < double >()->default_value(0.10), "Maximal Missing Data Rate at which PBWT is evaluated")
+			("pbwt-window", bpo::value < double >()->default_value(4), "Run PBWT selection in windows of this size");
 	
 	bpo::options_description opt_hmm ("HMM parameters");
 	opt_hmm.add_options()
@@ -56,7 +57,7 @@ void phaser::declare_options() {
 
 	bpo::options_description opt_output ("Output files");
 	opt_output.add_options()
-			("output,O", bpo::value< string >(), "Phased haplotypes in VCF/BCF format")
+			("output,O", bpo::value< string >(), "Phased haplotypes in VCF/BCF format (one file, or a comma-separated list of one file per input region)")
 			("output-buffer", "Write right and left buffers too in output")
 			("log", bpo::value< string >(), "Log file");
 
@@ -94,9 +95,20 @@ void phaser::check_options() {
 	if (!options.count("scaffold-region"))
 		vrb.error("--scaffold-region missing");
 
+	if (!options["pbwt-window"].defaulted() && (options["pbwt-window"].as < double > () < 0.5 || options["pbwt-window"].as < double > () > 10))
+		vrb.error("You must specify a PBWT window size comprised between 0.5 and 10 cM");
+
 	if (!options.count("output"))
 		vrb.error("You must specify a phased output file with --output");
 
+	vector < string > input_regions, output_files;
+	if (options.count("input-region") && stb.split(options["output"].as < string > (), output_files, ",") > 1) {
+		if (stb.split(options["input-region"].as < string > (), input_regions, ",") != output_files.size())
+			vrb.error("--output must specify either one file or one file per region in --input-region");
+		if (options.count("output-buffer"))
+			vrb.error("--output-buffer cannot be used with one output file per input region");
+	}
+
 	if (options.count("seed") && options["seed"].as < int > () < 0)
 		vrb.error("Random number generator needs a positive seed value");
 
@@ -122,7 +134,11 @@ void phaser::verbose_files() {
 	vrb.bullet("Scaff [V/B]CF : [" + options["scaffold"].as < string > () + "]");
 	if (options.count("map")) vrb.bullet("Genetic Map   : [" + options["map"].as < string > () + "]");
 	if (options.count("pedigree")) vrb.bullet("Pedigree file : [" + options["pedigree"].as < string > () + "]");
-	if (options.count("output")) vrb.bullet("Output VCF    : [" + options["output"].as < string > () + "]");
+	if (options.count("output")) {
+		vector < string > output_files;
+		stb.split(options["output"].as < string > (), output_files, ",");
+		for (int f = 0 ; f < output_files.size() ; f ++) vrb.bullet("Output VCF    : [" + output_files[f] + "]");
+	}
 	if (options.count("log")) vrb.bullet("Output LOG    : [" + options["log"].as < string > () + "]");
 }
 
@@ -130,7 +146,7 @@ void phaser::verbose_options() {
 	vrb.title("Parameters:");
 	vrb.bullet("Seed    : " + stb.str(options["seed"].as < int > ()));
 	vrb.bullet("Threads : " + stb.str(options["thread"].as < int > ()) + " threads");
-	vrb.bullet("PBWT    : [depth = " + stb.str(options["pbwt-depth-common"].as < int > ()) + "," + stb.str(options["pbwt-depth-rare"].as < int > ()) + " / modulo = " + stb.str(options["pbwt-modulo"].as < double > ()) + " / mac = " + stb.str(options["pbwt-mac"].as < int > ()) + " / mdr = " + stb.str(options["pbwt-mdr"].as < double > ()) + "]");
+	vrb.bullet("PBWT    : [depth = " + stb.str(options["pbwt-depth-common"].as < int > ()) + "," + stb.str(options["pbwt-depth-rare"].as < int > ()) + " / modulo = " + stb.str(options["pbwt-modulo"].as < double > ()) + " / mac = " + stb.str(options["pbwt-mac"].as < int > ()) + " / mdr = " + stb.str(options["pbwt-mdr"].as < double > ()) + " / window = " + stb.str(options["pbwt-window"].as < double > ()) + "cM]");
 	if (options.count("map")) vrb.bullet("HMM     : [Ne = " + stb.str(options["effective-size"].as < int > ()) + " / Recombination rates given by genetic map]");
 	else vrb.bullet("HMM     : [Ne = " + stb.str(options["effective-size"].as < int > ()) + " / Constant recombination rate of 1cM per Mb]");
 }
@@ -76,6 +76,19 @@ public:
 		}
 	}
 
+	//Combines the statistics of two disjoint sets of values (Chan et al.)
+	void merge(const basic_stats & rhs) {
+		if (rhs.m_n == 0) return;
+		if (m_n == 0) { *this = rhs; return; }
+		uint32_t n = m_n + rhs.m_n;
+		double delta = rhs.m_oldM - m_oldM;
+		m_newM = m_oldM + delta * rhs.m_n / n;
+		m_newS = m_oldS + rhs.m_oldS + delta * delta * m_n * rhs.m_n / n;
+		m_oldM = m_newM;
+		m_oldS = m_newS;
+		m_n = n;
+	}
+
 	int size() const {
 		return m_n;
 	}
@@ -0,0 +1,36 @@
+#!/bin/bash
+
+#Checks that block-parallel conversion (--thread > 1) gives the same files as --thread 1 on the 10k data, for a plain2sparse -> sparse2plain round-trip
+#Usage: ./convert.sh [makefile target, e.g. system] [thread counts to compare against --thread 1]
+TARGET=${1:-system}
+THREADS=${2:-"4 8"}
+REGION=1
+
+#step0: build
+make -C ../convert clean > /dev/null
+make -C ../convert $TARGET -j4 > /dev/null
+cp ../convert/bin/SHAPEIT5_convert 10k/SHAPEIT5_convert.test
+
+#step1: round-trip with each thread count, timings are wall-clock seconds
+for T in 1 $THREADS; do
+	/usr/bin/time -f "thread $T: plain2sparse %e s" ./10k/SHAPEIT5_convert.test --input-plain 10k/msprime.nodup.bcf --output-sparse 10k/msprime.convert.t$T --region $REGION --thread $T > /dev/null
+	bcftools index -f 10k/msprime.convert.t$T.comm.bcf
+	bcftools index -f 10k/msprime.convert.t$T.rare.bcf
+	/usr/bin/time -f "thread $T: sparse2plain %e s" ./10k/SHAPEIT5_convert.test --input-sparse 10k/msprime.convert.t$T --output-plain 10k/msprime.convert.t$T.plain.bcf --region $REGION --thread $T > /dev/null
+done
+
+#step2: compare every intermediate and final file against --thread 1
+STATUS=0
+for T in $THREADS; do
+	for FILE in comm.bcf rare.bcf plain.bcf; do
+		MD5_REF=$(bcftools view -H 10k/msprime.convert.t1.$FILE | md5sum | cut -d" " -f1)
+		MD5_THR=$(bcftools view -H 10k/msprime.convert.t$T.$FILE | md5sum | cut -d" " -f1)
+		if [ "$MD5_REF" == "$MD5_THR" ]; then echo "thread $T: $FILE identical [$MD5_REF]"
+		else echo "thread $T: $FILE DIFFERENT [$MD5_REF / $MD5_THR]"; STATUS=1; fi
+	done
+	if cmp -s 10k/msprime.convert.t1.rare.bin 10k/msprime.convert.t$T.rare.bin; then echo "thread $T: rare.bin identical"
+	else echo "thread $T: rare.bin DIFFERENT"; STATUS=1; fi
+done
+
+rm -f 10k/SHAPEIT5_convert.test 10k/msprime.convert.t*
+exit $STATUS
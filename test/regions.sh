@@ -0,0 +1,33 @@
+#!/bin/bash
+
+#Checks phase_rare multi-region mode (--input-region r1,r2,... with one --scaffold-region window per input region) on the 10k data:
+#a multi-region run must be identical to separate runs of each input region over its own scaffold window
+#Usage: ./regions.sh [makefile target, e.g. system]
+TARGET=${1:-system}
+SEED=15052011
+SCAF1=1:1000000-3000000
+SCAF2=1:2000000-4000000
+REG1=1:1500000-2500000
+REG2=1:2500001-3500000
+
+#step0: build
+make -C ../phase_rare clean > /dev/null
+make -C ../phase_rare $TARGET -j4 > /dev/null
+cp ../phase_rare/bin/SHAPEIT5_phase_rare 10k/SHAPEIT5_phase_rare.current
+
+#step1: two regions in one run vs two separate runs, timings are wall-clock seconds and peak memory
+/usr/bin/time -f "multi    : %e s / %M kB" ./10k/SHAPEIT5_phase_rare.current --input-plain 10k/msprime.nodup.bcf --scaffold 10k/msprime.common.truth.bcf --output 10k/msprime.rare.regions.multi1.bcf,10k/msprime.rare.regions.multi2.bcf --scaffold-region $SCAF1,$SCAF2 --input-region $REG1,$REG2 --thread 4 --seed $SEED > /dev/null
+/usr/bin/time -f "separate : %e s / %M kB [$REG1]" ./10k/SHAPEIT5_phase_rare.current --input-plain 10k/msprime.nodup.bcf --scaffold 10k/msprime.common.truth.bcf --output 10k/msprime.rare.regions.single1.bcf --scaffold-region $SCAF1 --input-region $REG1 --thread 4 --seed $SEED > /dev/null
+/usr/bin/time -f "separate : %e s / %M kB [$REG2]" ./10k/SHAPEIT5_phase_rare.current --input-plain 10k/msprime.nodup.bcf --scaffold 10k/msprime.common.truth.bcf --output 10k/msprime.rare.regions.single2.bcf --scaffold-region $SCAF2 --input-region $REG2 --thread 4 --seed $SEED > /dev/null
+
+#step2: compare
+STATUS=0
+for I in 1 2; do
+	MD5_MULTI=$(bcftools view -H 10k/msprime.rare.regions.multi$I.bcf | md5sum | cut -d" " -f1)
+	MD5_SINGLE=$(bcftools view -H 10k/msprime.rare.regions.single$I.bcf | md5sum | cut -d" " -f1)
+	if [ "$MD5_MULTI" == "$MD5_SINGLE" ]; then echo "region $I: identical to separate run [$MD5_MULTI]"
+	else echo "region $I: DIFFERENT from separate run [$MD5_MULTI / $MD5_SINGLE]"; STATUS=1; fi
+done
+
+rm -f 10k/SHAPEIT5_phase_rare.current 10k/msprime.rare.regions.*.bcf*
+exit $STATUS
@@ -0,0 +1,34 @@
+#!/bin/bash
+
+#Checks that all SIMD backends (AVX2 / AVX-512 dispatch, NEON, scalar) produce bit-for-bit identical haplotypes on the 10k data
+#Usage: ./simd.sh [makefile target, e.g. system]
+TARGET=${1:-system}
+SEED=15052011
+
+#step0: build native and scalar binaries
+for BACKEND in native scalar; do
+	for TOOL in phase_common phase_rare; do
+		make -C ../$TOOL clean > /dev/null
+		if [ $BACKEND == "scalar" ]; then make -C ../$TOOL $TARGET SIMD_FLAG=-DSIMD_SCALAR -j4 > /dev/null
+		else make -C ../$TOOL $TARGET -j4 > /dev/null; fi
+		cp ../$TOOL/bin/SHAPEIT5_$TOOL 10k/SHAPEIT5_$TOOL.$BACKEND
+	done
+done
+
+#step1: phase common and rare variants with both backends (single thread, fixed seed)
+for BACKEND in native scalar; do
+	./10k/SHAPEIT5_phase_common.$BACKEND --input 10k/msprime.nodup.bcf --filter-maf 0.001 --output 10k/msprime.common.simd.$BACKEND.bcf --region 1 --thread 1 --seed $SEED
+	./10k/SHAPEIT5_phase_rare.$BACKEND --input-plain 10k/msprime.nodup.bcf --scaffold 10k/msprime.common.truth.bcf --output 10k/msprime.rare.simd.$BACKEND.bcf --scaffold-region 1:1000000-3000000 --input-region 1:1500000-2500000 --thread 1 --seed $SEED
+done
+
+#step2: compare
+STATUS=0
+for STEP in common rare; do
+	MD5_NATIVE=$(bcftools view -H 10k/msprime.$STEP.simd.native.bcf | md5sum | cut -d" " -f1)
+	MD5_SCALAR=$(bcftools view -H 10k/msprime.$STEP.simd.scalar.bcf | md5sum | cut -d" " -f1)
+	if [ "$MD5_NATIVE" == "$MD5_SCALAR" ]; then echo "$STEP: identical [$MD5_NATIVE]"
+	else echo "$STEP: DIFFERENT [$MD5_NATIVE / $MD5_SCALAR]"; STATUS=1; fi
+done
+
+rm -f 10k/SHAPEIT5_phase_*.native 10k/SHAPEIT5_phase_*.scalar 10k/msprime.*.simd.*.bcf
+exit $STATUS